@@ -10,6 +10,17 @@ L="-lglfw -lvulkan -L/home/solly/vulkan/1.3.283.0/x86_64/lib/ -lshaderc_combined
 CL="gcc"
 CLPP="g++"
 
+# './build.sh cook' builds the offline model cooker instead (see src/cook.c).
+if [[ $1 == "cook" ]]; then
+    if $CL -std=c99 src/cook.c -o cook $CF -lm; then
+        echo "Build complete"
+        exit 0
+    else
+        echo "Build failed: cook"
+        exit 1
+    fi
+fi
+
 if $CL -c -std=c99 src/source.c $CF; then
     echo "Compiled source"
 else
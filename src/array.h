@@ -3,6 +3,7 @@
 
 #include "defs.h"
 #include "allocator.h"
+#include "file.h"
 
 #define ARRAY_METADATA_WIDTH 4
 #define ARRAY_METADATA_SIZE (sizeof(uint64) * ARRAY_METADATA_WIDTH)
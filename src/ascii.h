@@ -186,10 +186,13 @@ static inline uint32 simd_skip_to_whitespace(const char *data) {
     return i + ctz16(m0) - 16;
 }
 
+// Skips the json whitespace set: ' ', '\n', '\r' and '\t'.
 static inline uint32 simd_skip_over_whitespace(const char *data) {
     __m128i a;
     __m128i b = _mm_set1_epi8(' ');
     __m128i c = _mm_set1_epi8('\n');
+    __m128i f = _mm_set1_epi8('\r');
+    __m128i g = _mm_set1_epi8('\t');
     __m128i d, e;
     uint16 m0 = 0xffff;
     uint32 i;
@@ -198,6 +201,10 @@ static inline uint32 simd_skip_over_whitespace(const char *data) {
         d = _mm_cmpeq_epi8(a, b);
         e = _mm_cmpeq_epi8(a, c);
         d = _mm_or_si128(d, e);
+        e = _mm_cmpeq_epi8(a, f);
+        d = _mm_or_si128(d, e);
+        e = _mm_cmpeq_epi8(a, g);
+        d = _mm_or_si128(d, e);
         m0 = _mm_movemask_epi8(d);
     }
     return i + ctz16(~m0) - 16;
@@ -282,6 +289,32 @@ static inline double ascii_to_double(const char *data) {
     return ret;
 }
 
+// A json number, scanned but not yet converted: (-1)^neg * w * 10^exp.
+// 'w' holds the first 19 significant digits, and has overflowed if
+// digit_count > 19.
+struct ascii_number {
+    uint64 w;
+    int64 exp;
+    uint32 digit_count;
+    bool neg;
+    bool is_integer; // no fraction or exponent
+};
+
+// Scans json number syntax. Returns the number of chars consumed, zero if
+// 'data' does not start with a valid number.
+uint32 ascii_scan_number(const char *data, struct ascii_number *num);
+
+// 'data' must be the string that 'num' was scanned from.
+double ascii_number_to_double(const char *data, struct ascii_number *num);
+float ascii_number_to_float(const char *data, struct ascii_number *num);
+
+// Correctly rounded, unlike ascii_to_double. Return the number of chars
+// consumed, zero if 'data' does not start with a number, or for
+// ascii_parse_u32, if the number is not an integer in range.
+uint32 ascii_parse_double(const char *data, double *ret);
+uint32 ascii_parse_float(const char *data, float *ret);
+uint32 ascii_parse_u32(const char *data, uint32 *ret);
+
 // Appendix
 
 /* Aligned load version of 'simd_find_char_interrupted_by_not_whitespace_reverse'
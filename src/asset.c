@@ -28,7 +28,7 @@ struct model_offsets {
     struct pair_uint material_ubo_dsl;
     #endif
     uint             material_ubo;
-    uint64           skin_mask;
+    uint64          *skin_mask; // bitset of the model's skins used by the loaded scenes
 };
 
 enum {
@@ -165,6 +165,7 @@ void load_model_tf(struct thread_work_arg *arg)
         struct model_offsets *offsets;
         #if NO_DESCRIPTOR_BUFFER
         uint offset_size = sizeof(*offsets)                       *  1                                          +
+                           sizeof(*offsets->skin_mask)            *  bitset_word_count(model->skin_count)       +
                            sizeof(*offsets->buffers)              *  model->buffer_count                        +
                            sizeof(*offsets->transforms_ubos)      *  model->mesh_count                          +
                            sizeof(*offsets->mesh_instance_counts) *  model->mesh_count                          +
@@ -172,6 +173,7 @@ void load_model_tf(struct thread_work_arg *arg)
                            sizeof(*offsets->tex_ds)               *  model->material_count;
         #else
         uint offset_size = sizeof(*offsets)                         * 1                     +
+                           sizeof(*offsets->skin_mask)              * bitset_word_count(model->skin_count) +
                            sizeof(*offsets->buffers)                * model->buffer_count   +
                            sizeof(*offsets->transforms_ubos)        * model->mesh_count     +
                            sizeof(*offsets->transforms_ubo_dsls)    * model->mesh_count     +
@@ -201,14 +203,16 @@ void load_model_tf(struct thread_work_arg *arg)
         draw_info->bind_buffers          =                         (VkBuffer*)(draw_info->mesh_primitive_counts + model->mesh_count);
         draw_info->primitive_infos       = (struct model_primitive_draw_info*)(draw_info->bind_buffers          + attr_count_upper_bound);
 
+        offsets->skin_mask = (uint64*)(offsets + 1);
+
         #if NO_DESCRIPTOR_BUFFER
-        offsets->buffers              =            (uint*)(offsets + 1);
+        offsets->buffers              =            (uint*)(offsets->skin_mask + bitset_word_count(model->skin_count));
         offsets->transforms_ubos      =                    offsets->buffers         + model->buffer_count;
         offsets->mesh_instance_counts =                    offsets->transforms_ubos + model->mesh_count;
         offsets->tex_ds               = (VkDescriptorSet*)(offsets->mesh_instance_counts + model->mesh_count);
         offsets->rsc_ds               = (VkDescriptorSet*)(offsets->tex_ds               + model->material_count);
         #else
-        offsets->buffers                = offsets + 1;
+        offsets->buffers                = (uint*)(offsets->skin_mask + bitset_word_count(model->skin_count));
         offsets->transforms_ubos        = offsets->buffers              + model->buffer_count;
         offsets->transforms_ubo_dsls    = offsets->transforms_ubos      + model->mesh_count;
         offsets->mesh_instance_counts   = offsets->transforms_ubo_dsls  + model->mesh_count;
@@ -571,12 +575,12 @@ static uint allocate_model_resources(
     smemset(offsets->mesh_instance_counts, 0,
            *offsets->mesh_instance_counts, model->mesh_count);
 
-    offsets->skin_mask = 0;
+    bitset_zero(offsets->skin_mask, model->skin_count);
     for(uint i=0; i < arg->scene_count; ++i)
         for(uint j=0; j < model->scenes[arg->scenes[i]].node_count; ++j)
             gltf_count_mesh_instances(model->nodes,
                                       model->scenes[arg->scenes[i]].nodes[j],
-                                      offsets->mesh_instance_counts, &offsets->skin_mask);
+                                      offsets->mesh_instance_counts, offsets->skin_mask);
 
     uint buffers_size = 0;
     for(uint i=0; i < model->buffer_count; ++i) {
@@ -650,8 +654,16 @@ static uint allocate_model_resources(
     uint images_size_stage = 0;
     uint images_size_device = 0;
     uint images_base_alignment = 0;
+    // This runs on a worker of gpu->threads, so the other workers do the
+    // reads. With only one worker, an item queued behind this one could never
+    // run before the batch is waited on, so the reads stay on this thread.
+    thread_pool *io_pool = THREAD_COUNT > 1 ? gpu->threads : NULL;
+
+    struct image *images = sallocate(allocs->temp, *images, model->image_count);
+    gltf_load_images(model, images, io_pool, allocs->temp);
+
     for(uint i=0; i < model->image_count; ++i) {
-        struct image image = gltf_load_image(model, i);
+        struct image image = images[i];
 
         // @Optimise Might be better to create images after allocating to staging
         // buffer? Probably not, since stage allocation unlikely to fail.
@@ -668,7 +680,7 @@ static uint allocate_model_resources(
                 buffers_size + transforms_ubos_size + material_ubos_size);
 
         // Each image will require a bufcpy, so each should be aligned.
-        images_size_stage += gpu_buffer_align(gpu, image_size(&image));
+        images_size_stage += gpu_buffer_align(gpu, image_data_size(&image));
 
         resources->image_count++;
     }
@@ -803,14 +815,19 @@ static uint allocate_model_resources(
     // to the gpu, such as animation keyframes. There could be marks in the buffers which
     // indicate where the buffer data is that is useful, or mark buffer views. But this would
     // require reading and coagulating every mesh primitive attribute.
-    if (gpu->flags & GPU_UMA_BIT) {
-        for(uint i=0; i < model->buffer_count; ++i)
-            gltf_read_buffer(model, i,
-                             (char*)gpu->mem.bind_buffer.data + offsets->base_bind + offsets->buffers[i]);
-    } else {
-        for(uint i=0; i < model->buffer_count; ++i)
-            gltf_read_buffer(model, i,
-                             (char*)gpu->mem.transfer_buffer.data + offsets->base_stage + offsets->buffers[i]);
+    char **buffers = sallocate(allocs->temp, *buffers, model->buffer_count);
+    for(uint i=0; i < model->buffer_count; ++i)
+        buffers[i] = gpu->flags & GPU_UMA_BIT ?
+            (char*)gpu->mem.bind_buffer.data + offsets->base_bind + offsets->buffers[i] :
+            (char*)gpu->mem.transfer_buffer.data + offsets->base_stage + offsets->buffers[i];
+    gltf_read_buffers(model, buffers, io_pool, allocs->temp);
+
+    #if GLTF_OPTIMIZE_MESHES_ON_LOAD
+    if (!model->cook.buffers) // already optimized by the cooker
+        gltf_optimize_meshes(model, buffers, allocs->temp);
+    #endif
+
+    if (!(gpu->flags & GPU_UMA_BIT)) {
         VkBufferCopy bufcpy = {
             .srcOffset = offsets->base_stage,
             .dstOffset = offsets->base_bind,
@@ -822,16 +839,20 @@ static uint allocate_model_resources(
 
     for(uint i=0; i < model->image_count; ++i) {
         memcpy((char*)gpu->mem.transfer_buffer.data + offsets->base_stage + image_offsets_stage[i],
-                resources->images[i].image.data, image_size(&resources->images[i].image));
+                resources->images[i].image.data, image_data_size(&resources->images[i].image));
         gpu_bind_image(gpu, resources->images[i].vkimage, base_image_device_offset + image_offsets_device[i]);
 
-        gpu_create_texture_view(gpu, &resources->images[i], arg->flags & LOAD_MODEL_BLIT_MIPMAPS_BIT);
+        gpu_create_texture_view(gpu, &resources->images[i],
+                (arg->flags & LOAD_MODEL_BLIT_MIPMAPS_BIT) || resources->images[i].image.mip_chain);
     }
 
     gpu_upload_images_with_base_offset(gpu, model->image_count, resources->images,
             offsets->base_stage, image_offsets_stage, ret->cmd_transfer, ret->cmd_graphics);
 
-    if (arg->flags & LOAD_MODEL_BLIT_MIPMAPS_BIT) {
+    if (model->cook.images) {
+        // Every level of a cooked image was uploaded with level zero.
+        transition_texture_layouts(ret->cmd_graphics, true, model->image_count, resources->images, allocs->temp);
+    } else if (arg->flags & LOAD_MODEL_BLIT_MIPMAPS_BIT) {
         // This also transfers the image layout to shader read only.
         gpu_blit_gltf_texture_mipmaps(model, resources->images, ret->cmd_graphics);
     } else {
@@ -1685,93 +1706,145 @@ static uint model_vertex_state_and_draw_info(
     return ac;
 }
 
-struct model_animations_arg {
-    matrix *xforms;
-    uint   *weight_offsets;
-    float  *weight_data;
+// Bitsets of node_count bits.
+struct model_animation_masks {
+    uint64 *xforms;
+    uint64 *weights;
 };
 
-struct model_animation_masks {
-    uint64 xforms[GLTF_U64_NODE_MASK];
-    uint64 weights[GLTF_U64_NODE_MASK];
+// The nodes of one mesh under one scene root, as a list of flat indices
+// threaded through model_animator.next. Every node in the list writes the
+// same ubo, at 'ubo' bytes from the model's ubo data.
+struct model_mesh_instance {
+    uint mesh;
+    uint head;
+    uint ubo;
 };
 
-#if GLTF_U64_SKIN_MASK > 1
-    #error The below member 'struct model_scene_meshes.skin_mask' needs to be an array
-#endif
+// A gltf animation sampler with its keyframes converted to floats. Cubic
+// spline samplers keep only their values, not their tangents.
+struct model_animation_sampler {
+    gltf_animation_interpolation interpolation;
+    uint   count; // keyframes
+    uint   width; // floats per keyframe in 'values', zero if no target uses the sampler
+    float  min;
+    float  max;
+    uint   cursor; // frame_0 of the last sample (see get_model_animation_timestep)
+    float *times;
+    float *values;
+};
+
+struct model_animation_target {
+    uint node;
+    uint path_mask;
+    uint samplers[popcnt(GLTF_ANIMATION_PATH_BITS)]; // into model_animator.samplers, by path bit
+};
+
+// Four channels of the same path, sampled together: lane i reads
+// samplers[i] and blends into the pose of nodes[i]. A path's last batch
+// repeats its last channel past 'lanes'.
+struct model_animation_batch {
+    uint samplers[4];
+    uint nodes[4];
+    uint lanes;
+};
+
+// Rows of the animator's pose, each of align(node_count, 4) floats.
+enum {
+    MODEL_ANIMATION_POSE_TX, MODEL_ANIMATION_POSE_TY, MODEL_ANIMATION_POSE_TZ,
+    MODEL_ANIMATION_POSE_RX, MODEL_ANIMATION_POSE_RY, MODEL_ANIMATION_POSE_RZ, MODEL_ANIMATION_POSE_RW,
+    MODEL_ANIMATION_POSE_SX, MODEL_ANIMATION_POSE_SY, MODEL_ANIMATION_POSE_SZ,
+    MODEL_ANIMATION_POSE_ROWS,
+};
 
-struct model_scene_meshes {
-    uint64 skin_mask;
-    uint64 node_mask[GLTF_U64_NODE_MASK];
+struct model_animation_clip {
+    uint                           target_count; // zero if the clip was not built
+    uint                           batch_counts[3]; // translation, rotation, scale
+    struct model_animation_target *targets;
+    struct model_animation_batch  *batches[3];
 };
 
-struct model_build_transform_ubo_arg {
-    gltf                         *model;
-    uchar                        *ubo_data;
-    struct model_animation_masks *anim_masks;
-    uint                         *ibm_ofs;
-    matrix                       *ibm; // inverse bind matrices
-    matrix                       *xforms;
-    uint                         *weight_offsets;
-    float                        *weight_data;
-    struct model_scene_meshes    *meshes;
+struct model_animator {
+    gltf                           *model;
+    allocator                      *alloc;
+    struct model_animation_sampler *samplers;        // every animation's samplers back to back
+    struct model_animation_clip    *clips;           // per animation
+    uint64                         *skin_mask;       // skins used by the scenes, skin_count bits
+    uint                           *ibm_ofs;         // per skin, into 'ibm'
+    matrix                         *ibm;             // inverse bind matrices
+    uint                           *weight_offsets;  // per node, into 'weight_data'
+    uint                            pose_stride;     // align(node_count, 4)
+    float                          *rest;            // the nodes' trs, as a pose
+
+    // The scenes' nodes in pre-order, so that a parent's global transform is
+    // always computed before its children's (see model_flatten_node). A node
+    // in more than one scene appears once per scene.
+    uint                            flat_count;
+    uint                           *flat_nodes;
+    uint                           *flat_parents;    // per flat node, its parent's node, node_count for a root
+    uint                           *flat_ends;       // per flat node, the flat index past its subtree
+    uint64                         *flat_animated;   // flat_count bits, whether a built clip targets the node or one of its ancestors or descendants
+    matrix                         *flat_locals;     // per flat node, its transform when it is not animated
+    uint                            instance_count;
+    struct model_mesh_instance     *instances;       // by scene root, then by mesh
+    uint                           *next;            // per flat node, the next node of its instance, Max_u32 at the end
+    uint64                         *skin_scratch;    // for model_build_transform_ubo, skin_count bits
+
+    // Rewritten by every update.
+    float                          *pose;            // rest with the layers blended over it
+    matrix                         *anim_xforms;
+    matrix                         *global_xforms;   // per node, then the identity for the roots' parent
+    float                          *weight_data;
+    struct model_animation_masks    anim_masks;
+    bool                            globals_valid;   // the nodes outside flat_animated are up to date
+    bool                            at_rest;         // the last update animated no node
 };
 
+static struct model_animator* model_new_animator(
+    gltf                 *model,
+    struct gpu           *gpu,
+    struct model_offsets *offsets,
+    uint                  scene_count,
+    uint                 *scenes,
+    uint64               *clip_mask, // animations to build, NULL for all
+    allocator            *alloc);
+
 static void model_animations(
-    struct load_model_arg        *lm_arg,
-    struct model_offsets  *offsets,
-    struct model_animations_arg  *arg,
-    struct model_animation_masks *ret);
+    struct model_animator *animator,
+    uint                   animation_count,
+    struct animation_info *animations);
 
 static void model_build_transform_ubo(
-    uint                                  mesh,
-    struct model_build_transform_ubo_arg *arg);
-
-// @Optimise This is a lot of arguments for a function that I
-// want to be lightning... Maybe it would be faster to visit
-// fields in pieces, so one pass does the transforms, and a
-// different pass does the weights?
-static inline void model_node_global_transforms(
-    uint64                     xforms_mask[GLTF_U64_NODE_MASK],
-    matrix                    *anim_xforms,
-    matrix                    *global_xforms,
-    struct model_scene_meshes *meshes,
-    matrix                    *parent_xform,
-    gltf_node                 *nodes,
-    uint                       node,
-    uint64                    *mesh_mask)
+    struct model_animator      *animator,
+    struct model_mesh_instance *instance,
+    uchar                      *ubo_data);
+
+// Global transforms of the flattened nodes, in one pass with no recursion and
+// no branch on how a node is transformed: each is its parent's times either
+// its animated or its static local transform. Once every node has been
+// computed, only the subtrees which a clip can move are visited again, and not
+// even those while nothing is animated.
+static void model_node_global_transforms(struct model_animator *animator)
 {
-    uint64 one = 1;
+    uint node_count = animator->model->node_count;
+    uint64 *xforms_mask = animator->anim_masks.xforms;
+    bool at_rest = bitset_is_zero(xforms_mask, node_count);
+    if (at_rest && animator->at_rest && animator->globals_valid)
+        return;
 
-    // @Optimise It would be really nice to remove all these branches. Maybe the setup
-    // of the data layout before this function can be better.
-    if (xforms_mask[node>>6] & (one << (node & 63))) {
-        mul_matrix(parent_xform, &anim_xforms[node], &global_xforms[node]);
-    } else {
-        if (nodes[node].flags & GLTF_NODE_MATRIX_BIT) {
-            mul_matrix(parent_xform, &nodes[node].mat, &global_xforms[node]);
-        } else if (nodes[node].flags & GLTF_NODE_TRS_BIT) {
-            convert_trs(&nodes[node].trs, &global_xforms[node]);
-            mul_matrix(parent_xform, &global_xforms[node], &global_xforms[node]);
-        } else {
-            copy_matrix(&global_xforms[node], parent_xform);
+    bool valid = animator->globals_valid;
+    for(uint i=0; i < animator->flat_count;) {
+        if (valid && !bitset_test(animator->flat_animated, i)) {
+            i = animator->flat_ends[i];
+            continue;
         }
+        uint node = animator->flat_nodes[i];
+        matrix *local = bitset_test(xforms_mask, node) ? &animator->anim_xforms[node] : &animator->flat_locals[i];
+        mul_matrix(&animator->global_xforms[animator->flat_parents[i]], local, &animator->global_xforms[node]);
+        ++i;
     }
-
-    log_print_error_if(nodes[node].mesh == Max_u32 && nodes[node].skin != Max_u32,
-                       "node declares a skin but not a mesh.");
-
-    uint64 mesh_test = maxif(nodes[node].mesh + 1);
-    uint64 skin_test = maxif(nodes[node].skin + 1);
-    *mesh_mask |= (one & mesh_test) << (nodes[node].mesh & mesh_test);
-
-    struct model_scene_meshes *mesh = &meshes[nodes[node].mesh & mesh_test];
-    mesh->node_mask[node>>6] |= (one & mesh_test) << (node & 63);
-    mesh->skin_mask |= (one & skin_test) << (nodes[node].skin & skin_test);
-
-    for(uint i=0; i < nodes[node].child_count; ++i)
-        model_node_global_transforms(xforms_mask, anim_xforms, global_xforms, meshes,
-                &global_xforms[node], nodes, nodes[node].children[i], mesh_mask);
+    animator->globals_valid = true;
+    animator->at_rest = at_rest;
 }
 
 inline static uchar* model_get_accessor_data(
@@ -1801,90 +1874,14 @@ static void model_node_transforms(
     struct gpu *gpu = arg->gpu;
     gltf *model = arg->model;
 
-    struct model_scene_meshes *scene_meshes;
-    uint *mesh_counts;
-    uint *weight_offsets = allocate_and_zero(allocs->temp,
-                                             sizeof(*weight_offsets) * model->node_count +
-                                             sizeof(*scene_meshes) * model->mesh_count +
-                                             sizeof(*mesh_counts) * model->mesh_count);
-    scene_meshes = (struct model_scene_meshes*)(weight_offsets + model->node_count);
-    mesh_counts = (uint*)(scene_meshes + model->mesh_count);
-
-    // @Optimise Make a node mask like I am doing for skins? Probably overkill
-    // for just a count, especially as a 64bit mask would be likely
-    // insufficient. I would not have done it for skins if it was not for the
-    // loading of the inverse bind matrices, and the rather guaranteed low count.
-    uint weight_count = 0;
-    for(uint i=0; i < model->node_count; ++i) {
-        weight_offsets[i] = weight_count;
-        weight_count += model->nodes[i].weight_count;
-    }
-    uint joint_count = 0;
-    uint pc = popcnt(offsets->skin_mask);
-    uint64 skin_mask = offsets->skin_mask;
-    for(uint i=0; i < pc; ++i) {
-        uint tz = ctz(skin_mask);
-        skin_mask &= ~(1<<tz);
-        joint_count += model->skins[tz].joint_count;
-    }
-
-    float  *weight_data;
-    uint   *ibm_ofs;
-    matrix *global_xforms;
-    matrix *ibm;
-    matrix *anim_xforms = allocate(allocs->temp, sizeof(*anim_xforms)   * model->node_count +
-                                                 sizeof(*global_xforms) * model->node_count +
-                                                 sizeof(*ibm)           * joint_count       +
-                                                 sizeof(*weight_data)   * weight_count      +
-                                                 sizeof(*ibm_ofs)       * model->skin_count);
-    global_xforms = anim_xforms           + model->node_count;
-    ibm           = global_xforms         + model->node_count;
-    weight_data   = (float*)(ibm          + joint_count);
-    ibm_ofs       =  (uint*)(weight_data  + weight_count);
-
-    joint_count = 0;
-    skin_mask = offsets->skin_mask;
-    for(uint i=0; i < pc; ++i) {
-        uint tz = ctz(skin_mask);
-        skin_mask &= ~(1<<tz);
+    // Only the clips being sampled are built. Everything comes from temp,
+    // which load_model resets.
+    uint64 *clip_mask = new_bitset(model->animation_count, allocs->temp);
+    for(uint i=0; i < arg->animation_count; ++i)
+        bitset_set(clip_mask, arg->animations[i].index);
 
-        gltf_skin *skin = &model->skins[tz];
-        if (skin->inverse_bind_matrices == Max_u32)
-            continue;
-
-        float *data = (float*)model_get_accessor_data(gpu, model, skin->inverse_bind_matrices, offsets);
-        load_count_matrices_ua(skin->joint_count, data, ibm);
-        ibm_ofs[tz] = joint_count;
-        joint_count += skin->joint_count;
-    }
-
-    // @Todo This memset is to be able to sum animated weights together. I
-    // think that this is the correct behaviour, but now I think about it it
-    // might instead be to multiply? Not sure.
-    smemset(weight_data, 0, *weight_data, weight_count);
-
-    // @Todo I do not know what I meant by the below comment.
-    // @Optimise The compiler might be copying the pointers here rather than
-    // just optimising out anim_arg. It seems to pretty aggressively optimise
-    // out even on -Og so I assume its fine.
-    struct model_animations_arg anim_arg = {
-        .xforms = anim_xforms,
-        .weight_offsets = weight_offsets,
-        .weight_data = weight_data,
-    };
-    struct model_animation_masks anim_masks;
-    count_identity_matrix(model->node_count, anim_arg.xforms);
-    model_animations(arg, offsets, &anim_arg, &anim_masks);
-
-    struct model_build_transform_ubo_arg ubo_build_arg;
-    ubo_build_arg.model = model;
-    ubo_build_arg.meshes = scene_meshes;
-    ubo_build_arg.anim_masks = &anim_masks;
-    ubo_build_arg.xforms = global_xforms;
-    ubo_build_arg.ibm_ofs = ibm_ofs;
-    ubo_build_arg.ibm = ibm;
-    ubo_build_arg.weight_offsets = weight_offsets;
-    ubo_build_arg.weight_data = weight_data;
+    struct model_animator *animator = model_new_animator(model, gpu, offsets, arg->scene_count,
+                                                         arg->scenes, clip_mask, allocs->temp);
 
     uchar* ubo_data_base;
     if (gpu->flags & GPU_UMA_BIT)
@@ -1892,28 +1889,7 @@ static void model_node_transforms(
     else
         ubo_data_base = gpu->mem.transfer_buffer.data + offsets->base_stage;
 
-    for(uint i=0; i < arg->scene_count; ++i)
-        for(uint j=0; j < model->scenes[arg->scenes[i]].node_count; ++j) {
-            assert(model->mesh_count <= 64);
-            uint64 mesh_mask = 0;
-
-            memset(scene_meshes, 0, sizeof(*scene_meshes) * model->mesh_count);
-            model_node_global_transforms(anim_masks.xforms, anim_arg.xforms, global_xforms,
-                                        scene_meshes, &IDENTITY_MATRIX, model->nodes,
-                                        model->scenes[arg->scenes[i]].nodes[j], &mesh_mask);
-
-            uint pc = popcnt(mesh_mask);
-            for(uint k=0; k < pc; ++k) {
-                uint tz = ctz(mesh_mask);
-                mesh_mask &= ~(1<<tz);
-
-                ubo_build_arg.ubo_data = ubo_data_base + offsets->transforms_ubos[tz] + vt_ubo_sz() * mesh_counts[tz];
-                model_build_transform_ubo(tz, &ubo_build_arg);
-
-                mesh_counts[tz]++;
-            }
-        }
-
+    update_model_animator(animator, arg->animation_count, arg->animations, ubo_data_base);
 }
 
 struct model_animation_timestep {
@@ -1926,14 +1902,56 @@ static inline void println_timestep(struct model_animation_timestep ts)
     println("[frame_0 %u, frame_1 %u, lerp %f]", ts.frame_0, ts.frame_1, ts.lerp_constant);
 }
 
+// Below this many keyframes a seek stops halving and counts the rest with sse.
+#define MODEL_ANIMATION_SEEK_WINDOW 16
+
+// The number of keyframes in data[0..count) at or before 'time', given that
+// data[0] is. Branchless halving until the window is small, then the window is
+// compared four keys at a time, each lane subtracting its all-ones mask from
+// the count.
+static inline uint model_animation_seek(float time, uint count, const float *data)
+{
+    uint lo = 0;
+    uint n = count;
+    while(n > MODEL_ANIMATION_SEEK_WINDOW) {
+        uint half = n >> 1;
+        lo = data[lo + half] <= time ? lo + half : lo;
+        n -= half;
+    }
+
+    __m128 t = _mm_set1_ps(time);
+    __m128i acc = _mm_setzero_si128();
+    uint i = 0;
+    for(; i + 4 <= n; i += 4)
+        acc = _mm_sub_epi32(acc, _mm_castps_si128(_mm_cmple_ps(_mm_loadu_ps(data + lo + i), t)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    uint ret = lo + _mm_cvtsi128_si32(acc);
+    for(; i < n; ++i)
+        ret += data[lo + i] <= time;
+    return ret;
+}
+
+// 'cursor' is the frame_0 of the sampler's last timestep. Animations mostly
+// play forward by less than a keyframe per frame, so the same or the next
+// pair of keyframes is tried before seeking.
 inline static
 struct model_animation_timestep get_model_animation_timestep(
     float  time,
     float  min,
     float  max,
     uint   count,
-    float *data)
+    float *data,
+    uint  *cursor)
 {
+    // A single key, or keys which all share a time, is a static pose. The
+    // modulo below would divide by zero.
+    if (count == 1 || max <= min) {
+        *cursor = 0;
+        return (struct model_animation_timestep){0,0,0};
+    }
+
     time -= max * floorf(time / max);
 
     if (time < 0) { // @Todo This is little clumsy in my eyes.
@@ -1946,13 +1964,20 @@ struct model_animation_timestep get_model_animation_timestep(
 
     // gltf spec, clamp animation to frame 0 if time < min
     if (time <= min) {
+        *cursor = 0;
         return (struct model_animation_timestep){0,0};
     }
 
-    uint i;
-    for(i=0; i < count; ++i)
-        if (data[i] > time)
-            break;
+    uint i = *cursor + 1;
+    if (i < count && data[i-1] <= time && time < data[i]) {
+        // same pair
+    } else if (i + 1 < count && data[i] <= time && time < data[i+1]) {
+        i++;
+    } else {
+        i = model_animation_seek(time, count, data);
+        i = i < 1 ? 1 : i < count ? i : count-1;
+    }
+    *cursor = i-1;
 
     struct model_animation_timestep ts = {
         .frame_0 = i-1,
@@ -2087,188 +2112,352 @@ convert_accessor(uint ofs, uint accessor_flags, void *data, uint count, float *r
 #endif
 }
 
-static inline void model_anim_transform_translation(struct model_animation_timestep timestep, float weight,
-                                                    uint accessor_flags, float* data, matrix* ret)
+// Sample the four channels of 'batch' at 'time', transposed so that ret[c]
+// holds component c of every lane. Rotations take the shorter way round and
+// are normalized (nlerp). Step samplers hold their first key; cubic spline
+// samplers only kept their values (see model_new_animator).
+static inline void model_anim_sample_batch(struct model_animator *animator, struct model_animation_batch *batch,
+                                           float time, bool rotation, __m128 ret[4])
 {
-    float *uvec1 = data + (timestep.frame_0) * 3;
-    float *uvec2 = data + (timestep.frame_1) * 3;
-    vector v1 = get_vector(uvec1[0], uvec1[1], uvec1[2], 0);
-    vector v2 = get_vector(uvec2[0], uvec2[1], uvec2[2], 0);
-    vector vt = lerp_vector(v1, v2, timestep.lerp_constant);
-    translation_matrix(scale_vector(vt, weight), ret);
+    __m128 a[4];
+    __m128 b[4];
+    float lerp_constants[4];
+    for(uint l=0; l < 4; ++l) {
+        struct model_animation_sampler *s = &animator->samplers[batch->samplers[l]];
+        struct model_animation_timestep ts =
+            get_model_animation_timestep(time, s->min, s->max, s->count, s->times, &s->cursor);
+        lerp_constants[l] = s->interpolation == GLTF_ANIMATION_INTERPOLATION_STEP ? 0 : ts.lerp_constant;
+        a[l] = _mm_loadu_ps(s->values + ts.frame_0 * s->width);
+        b[l] = _mm_loadu_ps(s->values + ts.frame_1 * s->width);
+    }
+    _MM_TRANSPOSE4_PS(a[0], a[1], a[2], a[3]);
+    _MM_TRANSPOSE4_PS(b[0], b[1], b[2], b[3]);
+    __m128 t = _mm_loadu_ps(lerp_constants);
+
+    if (rotation) {
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])),
+                              _mm_add_ps(_mm_mul_ps(a[2], b[2]), _mm_mul_ps(a[3], b[3])));
+        __m128 flip = _mm_and_ps(d, _mm_set1_ps(-0.0f));
+        for(uint c=0; c < 4; ++c)
+            b[c] = _mm_xor_ps(b[c], flip);
+    }
+    for(uint c=0; c < 4; ++c)
+        ret[c] = _mm_add_ps(a[c], _mm_mul_ps(_mm_sub_ps(b[c], a[c]), t));
 }
 
-static inline void model_anim_transform_rotation(struct model_animation_timestep timestep, float weight,
-                                                 uint accessor_flags, float* data, matrix* ret)
+static inline __m128 model_anim_inv_len4(__m128 x[4])
 {
-/*
-    @Todo Something to try when I am more confident that all the other stuff is working.
-    I am 100% on gltf data alignment yet.
-    vector qa[2];
-    convert_accessor_vector(timestep.frame_i, accessor_flags, data, 8, qa);
-*/
-    vector q1 = {0};
-    vector q2 = {0};
-    convert_accessor((timestep.frame_0) * 4, accessor_flags, data, 4, (float*)&q1);
-    convert_accessor((timestep.frame_1) * 4, accessor_flags, data, 4, (float*)&q2);
-
-    vector q = lerp_vector(q1, q2, timestep.lerp_constant);
-    float t = quaternion_angle(q);
-    vector a = feq(t, 0) ? vector3(0, 0, 1) : quaternion_axis(q);
-    rotation_matrix(quaternion(t * weight, a), ret);
+    __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[0], x[0]), _mm_mul_ps(x[1], x[1])),
+                          _mm_add_ps(_mm_mul_ps(x[2], x[2]), _mm_mul_ps(x[3], x[3])));
+    return _mm_div_ps(_mm_set1_ps(1), _mm_sqrt_ps(d));
 }
 
-static inline void model_anim_transform_scale(struct model_animation_timestep timestep, float weight,
-                                              uint accessor_flags, float* data, matrix* ret)
+static inline void model_anim_gather(const float *pose, uint stride, uint row, uint count,
+                                     struct model_animation_batch *batch, __m128 *ret)
 {
-    float *uvec1 = data + (timestep.frame_0) * 3;
-    float *uvec2 = data + (timestep.frame_1) * 3;
-    vector v1 = get_vector(uvec1[0], uvec1[1], uvec1[2], 0);
-    vector v2 = get_vector(uvec2[0], uvec2[1], uvec2[2], 0);
-    vector vs = lerp_vector(v1, v2, timestep.lerp_constant);
-    scale_matrix(scale_vector(vs, weight), ret);
+    const uint *n = batch->nodes;
+    for(uint c=0; c < count; ++c) {
+        const float *r = pose + (row + c) * stride;
+        ret[c] = _mm_setr_ps(r[n[0]], r[n[1]], r[n[2]], r[n[3]]);
+    }
 }
 
-typedef void (*model_anim_transform_fn)(struct model_animation_timestep, float, uint, float*, matrix*);
-model_anim_transform_fn MODEL_ANIM_TRANSFORM_FNS[3] = {
-    model_anim_transform_translation,
-    model_anim_transform_rotation,
-    model_anim_transform_scale,
-};
+static inline void model_anim_scatter(float *pose, uint stride, uint row, uint count,
+                                      struct model_animation_batch *batch, __m128 *v)
+{
+    float f[4];
+    for(uint c=0; c < count; ++c) {
+        _mm_storeu_ps(f, v[c]);
+        for(uint l=0; l < batch->lanes; ++l)
+            pose[(row + c) * stride + batch->nodes[l]] = f[l];
+    }
+}
 
-static inline void model_node_translation(struct trs *trs, matrix *ret)
+// A layer's weight for each lane of 'batch', zero past batch->lanes and for
+// the nodes outside 'mask'. The nodes of the other lanes are marked as
+// animated.
+static inline __m128 model_anim_lane_weights(struct model_animator *animator, struct model_animation_batch *batch,
+                                             const uint64 *mask, float weight)
 {
-    translation_matrix(trs->t, ret);
+    float w[4];
+    for(uint l=0; l < 4; ++l) {
+        bool moved = l < batch->lanes && weight != 0 && (!mask || bitset_test(mask, batch->nodes[l]));
+        w[l] = moved ? weight : 0;
+        bitset_set_if(animator->anim_masks.xforms, batch->nodes[l], moved);
+    }
+    return _mm_loadu_ps(w);
 }
 
-static inline void model_node_rotation(struct trs *trs, matrix *ret)
+// a * b for four quaternions at a time, as rows of x, y, z and w.
+static inline void model_anim_quat_mul(__m128 a[4], __m128 b[4], __m128 ret[4])
 {
-    rotation_matrix(trs->r, ret);
+    __m128 x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[3], b[0]), _mm_mul_ps(a[0], b[3])),
+                          _mm_sub_ps(_mm_mul_ps(a[1], b[2]), _mm_mul_ps(a[2], b[1])));
+    __m128 y = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(a[3], b[1]), _mm_mul_ps(a[0], b[2])),
+                          _mm_add_ps(_mm_mul_ps(a[1], b[3]), _mm_mul_ps(a[2], b[0])));
+    __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[3], b[2]), _mm_mul_ps(a[0], b[1])),
+                          _mm_sub_ps(_mm_mul_ps(a[2], b[3]), _mm_mul_ps(a[1], b[0])));
+    __m128 w = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(a[3], b[3]), _mm_mul_ps(a[0], b[0])),
+                          _mm_add_ps(_mm_mul_ps(a[1], b[1]), _mm_mul_ps(a[2], b[2])));
+    ret[0] = x;
+    ret[1] = y;
+    ret[2] = z;
+    ret[3] = w;
 }
 
-static inline void model_node_scale(struct trs *trs, matrix *ret)
+// Flip the lanes of 'q' whose 'd' is negative.
+static inline void model_anim_quat_flip(__m128 q[4], __m128 d)
 {
-    scale_matrix(trs->s, ret);
+    __m128 flip = _mm_and_ps(d, _mm_set1_ps(-0.0f));
+    for(uint c=0; c < 4; ++c)
+        q[c] = _mm_xor_ps(q[c], flip);
 }
 
-typedef void (*model_node_trs_fn)(struct trs *trs, matrix *ret);
-model_node_trs_fn NODE_TRS_FNS[3] = {
-    model_node_translation,
-    model_node_rotation,
-    model_node_scale,
-};
+static inline void model_anim_quat_normalize(__m128 q[4])
+{
+    __m128 n = model_anim_inv_len4(q);
+    for(uint c=0; c < 4; ++c)
+        q[c] = _mm_mul_ps(q[c], n);
+}
 
-float model_anim_weight_buffer[512];
+// Blend one layer's batches into the pose. An override lerps (nlerps for
+// rotations) from the pose towards the clip; an additive layer adds the
+// clip's difference from the rest pose: its offset for translations, its
+// rotation from the rest rotation and its ratio to the rest scale.
+static void model_anim_blend_layer(struct model_animator *animator, struct model_animation_clip *clip,
+                                   struct animation_info *layer)
+{
+    uint stride = animator->pose_stride;
+    float *pose = animator->pose;
+    float *rest = animator->rest;
+    bool additive = layer->blend == ANIMATION_BLEND_ADDITIVE;
+
+    __m128 v[4];
+    __m128 p[4];
+    __m128 r[4];
+    for(uint b=0; b < clip->batch_counts[0]; ++b) {
+        struct model_animation_batch *batch = &clip->batches[0][b];
+        __m128 w = model_anim_lane_weights(animator, batch, layer->mask, layer->weights[ANIMATION_WEIGHTS_TRANSLATION]);
+        model_anim_sample_batch(animator, batch, layer->time, false, v);
+        model_anim_gather(pose, stride, MODEL_ANIMATION_POSE_TX, 3, batch, p);
+        model_anim_gather(additive ? rest : pose, stride, MODEL_ANIMATION_POSE_TX, 3, batch, r);
+        for(uint c=0; c < 3; ++c)
+            p[c] = _mm_add_ps(p[c], _mm_mul_ps(_mm_sub_ps(v[c], r[c]), w));
+        model_anim_scatter(pose, stride, MODEL_ANIMATION_POSE_TX, 3, batch, p);
+    }
 
-static inline void
-model_anim_weights(struct model_animation_timestep timestep, uint accessor_flags,
-                   uint count, void *output_data, float *weight_data_to, float anim_weight)
+    for(uint b=0; b < clip->batch_counts[1]; ++b) {
+        struct model_animation_batch *batch = &clip->batches[1][b];
+        __m128 w = model_anim_lane_weights(animator, batch, layer->mask, layer->weights[ANIMATION_WEIGHTS_ROTATION]);
+        model_anim_sample_batch(animator, batch, layer->time, true, v);
+        model_anim_quat_normalize(v);
+        model_anim_gather(pose, stride, MODEL_ANIMATION_POSE_RX, 4, batch, p);
+
+        // The quaternion to nlerp towards, and what from.
+        __m128 from[4];
+        if (additive) {
+            model_anim_gather(rest, stride, MODEL_ANIMATION_POSE_RX, 4, batch, r);
+            for(uint c=0; c < 3; ++c)
+                r[c] = _mm_xor_ps(r[c], _mm_set1_ps(-0.0f));
+            model_anim_quat_mul(r, v, v);
+            model_anim_quat_flip(v, v[3]);
+            from[0] = from[1] = from[2] = _mm_setzero_ps();
+            from[3] = _mm_set1_ps(1);
+        } else {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p[0], v[0]), _mm_mul_ps(p[1], v[1])),
+                                  _mm_add_ps(_mm_mul_ps(p[2], v[2]), _mm_mul_ps(p[3], v[3])));
+            model_anim_quat_flip(v, d);
+            for(uint c=0; c < 4; ++c)
+                from[c] = p[c];
+        }
+        for(uint c=0; c < 4; ++c)
+            v[c] = _mm_add_ps(from[c], _mm_mul_ps(_mm_sub_ps(v[c], from[c]), w));
+        model_anim_quat_normalize(v);
+
+        if (additive) {
+            model_anim_quat_mul(p, v, p);
+            model_anim_quat_normalize(p);
+        } else {
+            for(uint c=0; c < 4; ++c)
+                p[c] = v[c];
+        }
+        model_anim_scatter(pose, stride, MODEL_ANIMATION_POSE_RX, 4, batch, p);
+    }
+
+    for(uint b=0; b < clip->batch_counts[2]; ++b) {
+        struct model_animation_batch *batch = &clip->batches[2][b];
+        __m128 w = model_anim_lane_weights(animator, batch, layer->mask, layer->weights[ANIMATION_WEIGHTS_SCALE]);
+        model_anim_sample_batch(animator, batch, layer->time, false, v);
+        model_anim_gather(pose, stride, MODEL_ANIMATION_POSE_SX, 3, batch, p);
+        if (additive) {
+            // A zero rest scale has no ratio to the clip, so it is left as is
+            // rather than made inf or nan.
+            model_anim_gather(rest, stride, MODEL_ANIMATION_POSE_SX, 3, batch, r);
+            __m128 one = _mm_set1_ps(1);
+            for(uint c=0; c < 3; ++c) {
+                __m128 nonzero = _mm_cmpneq_ps(r[c], _mm_setzero_ps());
+                __m128 ratio = _mm_or_ps(_mm_and_ps(nonzero, _mm_div_ps(v[c], r[c])), _mm_andnot_ps(nonzero, one));
+                p[c] = _mm_mul_ps(p[c], _mm_add_ps(one, _mm_mul_ps(_mm_sub_ps(ratio, one), w)));
+            }
+        } else {
+            for(uint c=0; c < 3; ++c)
+                p[c] = _mm_add_ps(p[c], _mm_mul_ps(_mm_sub_ps(v[c], p[c]), w));
+        }
+        model_anim_scatter(pose, stride, MODEL_ANIMATION_POSE_SX, 3, batch, p);
+    }
+}
+
+// Build T * R * S for four nodes at a time straight from the pose, rather
+// than multiplying three matrices, for the nodes which a layer moved.
+static void model_anim_compose(struct model_animator *animator)
 {
-    assert(count < carrlen(model_anim_weight_buffer) && "Below array too small");
+    uint node_count = animator->model->node_count;
+    uint stride = animator->pose_stride;
+    uint64 *xforms_mask = animator->anim_masks.xforms;
+    float *p = animator->pose;
+    for(uint i = bitset_next(xforms_mask, node_count, 0); i != Max_u32;
+             i = bitset_next(xforms_mask, node_count, i + 4))
+    {
+        i &= ~3;
+        __m128 tx = _mm_loadu_ps(p + stride * MODEL_ANIMATION_POSE_TX + i);
+        __m128 ty = _mm_loadu_ps(p + stride * MODEL_ANIMATION_POSE_TY + i);
+        __m128 tz = _mm_loadu_ps(p + stride * MODEL_ANIMATION_POSE_TZ + i);
+        __m128 x  = _mm_loadu_ps(p + stride * MODEL_ANIMATION_POSE_RX + i);
+        __m128 y  = _mm_loadu_ps(p + stride * MODEL_ANIMATION_POSE_RY + i);
+        __m128 z  = _mm_loadu_ps(p + stride * MODEL_ANIMATION_POSE_RZ + i);
+        __m128 w  = _mm_loadu_ps(p + stride * MODEL_ANIMATION_POSE_RW + i);
+        __m128 sx = _mm_loadu_ps(p + stride * MODEL_ANIMATION_POSE_SX + i);
+        __m128 sy = _mm_loadu_ps(p + stride * MODEL_ANIMATION_POSE_SY + i);
+        __m128 sz = _mm_loadu_ps(p + stride * MODEL_ANIMATION_POSE_SZ + i);
+
+        __m128 two = _mm_set1_ps(2);
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z), ww = _mm_mul_ps(w, w);
+        __m128 xy = _mm_mul_ps(two, _mm_mul_ps(x, y));
+        __m128 xz = _mm_mul_ps(two, _mm_mul_ps(x, z));
+        __m128 yz = _mm_mul_ps(two, _mm_mul_ps(y, z));
+        __m128 wx = _mm_mul_ps(two, _mm_mul_ps(w, x));
+        __m128 wy = _mm_mul_ps(two, _mm_mul_ps(w, y));
+        __m128 wz = _mm_mul_ps(two, _mm_mul_ps(w, z));
+
+        // Columns as in rotation_matrix, scaled by the scale of their axis.
+        __m128 cols[4][4] = {
+            {_mm_mul_ps(sx, _mm_sub_ps(_mm_add_ps(ww, xx), _mm_add_ps(yy, zz))),
+             _mm_mul_ps(sx, _mm_add_ps(xy, wz)),
+             _mm_mul_ps(sx, _mm_sub_ps(xz, wy)),
+             _mm_setzero_ps()},
+            {_mm_mul_ps(sy, _mm_sub_ps(xy, wz)),
+             _mm_mul_ps(sy, _mm_sub_ps(_mm_add_ps(ww, yy), _mm_add_ps(xx, zz))),
+             _mm_mul_ps(sy, _mm_add_ps(yz, wx)),
+             _mm_setzero_ps()},
+            {_mm_mul_ps(sz, _mm_add_ps(xz, wy)),
+             _mm_mul_ps(sz, _mm_sub_ps(yz, wx)),
+             _mm_mul_ps(sz, _mm_sub_ps(_mm_add_ps(ww, zz), _mm_add_ps(xx, yy))),
+             _mm_setzero_ps()},
+            {tx, ty, tz, _mm_set1_ps(1)},
+        };
+        for(uint c=0; c < 4; ++c)
+            _MM_TRANSPOSE4_PS(cols[c][0], cols[c][1], cols[c][2], cols[c][3]);
+
+        for(uint l=0; l < 4; ++l) {
+            if (!bitset_test(xforms_mask, i + l))
+                continue;
+            for(uint c=0; c < 4; ++c)
+                _mm_store_ps(animator->anim_xforms[i + l].m + c * 4, cols[c][l]);
+        }
+    }
+}
 
+static inline void
+model_anim_weights(struct model_animation_timestep timestep, uint count, float *data,
+                   float *weight_data_to, float *rest, bool additive, float anim_weight)
+{
     // @Todo This is messy. I did not pay anything like the same attention to morph weights as I did
     // skinned animation. Skinned animation is much more interesting to me.
-    convert_accessor(timestep.frame_0, accessor_flags, output_data, count*2, model_anim_weight_buffer);
-    for(uint i=0; i < count; ++i)
-        weight_data_to[i] += lerp(model_anim_weight_buffer[i], model_anim_weight_buffer[count+i],
-                timestep.lerp_constant) * anim_weight;
+    float *w0 = data + timestep.frame_0 * count;
+    float *w1 = data + timestep.frame_1 * count;
+    for(uint i=0; i < count; ++i) {
+        float from = additive ? rest[i] : weight_data_to[i];
+        weight_data_to[i] += (lerp(w0[i], w1[i], timestep.lerp_constant) - from) * anim_weight;
+    }
 }
 
+// Blend the layers into the pose, then build the transform of every node
+// which they moved, once.
 static void model_animations(
-    struct load_model_arg        *lm_arg,
-    struct model_offsets         *offsets,
-    struct model_animations_arg  *arg,
-    struct model_animation_masks *ret)
+    struct model_animator *animator,
+    uint                   animation_count,
+    struct animation_info *animations)
 {
-    struct gpu *gpu = lm_arg->gpu;
-    gltf *model = lm_arg->model;
-    memset(ret, 0, sizeof(*ret));
-
-    uint64 one = 1;
-    for(uint j=0; j < lm_arg->animation_count; ++j) {
-        gltf_animation *anim = &model->animations[lm_arg->animations[j].index];
-        for(uint i=0; i < anim->target_count; ++i) {
-            uint mask = anim->targets[i].path_mask;
-            uint pc = popcnt(mask);
-            matrix trs[3];
-            uint node = anim->targets[i].node;
-            log_print_error_if(model->nodes[node].flags & GLTF_NODE_MATRIX_BIT,
-                               "node is targeted for animation but has matrix property set, this is disallowed by the spec.");
-            for(uint k=0; k < pc; ++k) {
-                uint tz = ctz(mask);
-                mask &= ~(1<<tz);
-
-                gltf_animation_sampler *sampler = &anim->samplers[anim->targets[i].samplers[tz]];
-                gltf_accessor *input = &model->accessors[sampler->input];
-
-                struct model_animation_timestep timestep =
-                    get_model_animation_timestep(
-                        lm_arg->animations[j].time,
-                        input->max_min.min[0],
-                        input->max_min.max[0],
-                        input->count,
-                        (float*)model_get_accessor_data(gpu, model, sampler->input, offsets));
-
-                gltf_accessor *output = &model->accessors[sampler->output];
-
-                // The below 'if else' block relies on this assertion.
-                assert(GLTF_ANIMATION_PATH_WEIGHTS_BIT == 0x08 && "animation path flag bits have changed");
-
-                if (tz == 3) {
-                    model_anim_weights(
-                            timestep,
-                            output->flags,
-                            output->count,
-                            model_get_accessor_data(gpu, model, sampler->output, offsets),
-                            arg->weight_data + arg->weight_offsets[node],
-                            lm_arg->animations[j].weights[ANIMATION_WEIGHTS_WEIGHT]);
-                    ret->weights[node>>6] |= one << (node & 63);
-                } else {
-                    assert(GLTF_ANIMATION_PATH_TRANSLATION_BIT == 1 &&
-                           GLTF_ANIMATION_PATH_ROTATION_BIT == 2 &&
-                           GLTF_ANIMATION_PATH_SCALE_BIT == 4);
-                    // @Optimise @Test Maybe this is faster as a switch?
-                    MODEL_ANIM_TRANSFORM_FNS[tz](
-                            timestep,
-                            lm_arg->animations[j].weights[tz],
-                            output->flags,
-                            (float*)model_get_accessor_data(gpu, model, sampler->output, offsets),
-                            &trs[tz]);
-                    ret->xforms[node>>6] |= one << (node & 63);
-                }
-            }
+    gltf *model = animator->model;
+    struct model_animation_masks *ret = &animator->anim_masks;
+    bitset_zero(ret->xforms, model->node_count);
+    bitset_zero(ret->weights, model->node_count);
+    if (!animation_count)
+        return;
 
-            // if unanimated, get default transform
-            mask = ~(anim->targets[i].path_mask | GLTF_ANIMATION_PATH_WEIGHTS_BIT) & GLTF_ANIMATION_PATH_BITS;
-            pc = popcnt(mask);
-            for(uint k=0; k < pc; ++k) {
-                uint tz = ctz(mask);
-                mask &= ~(1<<tz);
-                NODE_TRS_FNS[tz](&model->nodes[node].trs, &trs[tz]);
-            }
-            mul_matrix(&trs[0], &trs[1], &trs[1]);
-            mul_matrix(&trs[1], &trs[2], &trs[2]);
-            mul_matrix(&trs[2], &arg->xforms[node], &arg->xforms[node]);
+    memcpy(animator->pose, animator->rest, sizeof(*animator->pose) * animator->pose_stride * MODEL_ANIMATION_POSE_ROWS);
+
+    for(uint j=0; j < animation_count; ++j) {
+        struct model_animation_clip *clip = &animator->clips[animations[j].index];
+        model_anim_blend_layer(animator, clip, &animations[j]);
+
+        for(uint i=0; i < clip->target_count; ++i) {
+            struct model_animation_target *target = &clip->targets[i];
+            if (!(target->path_mask & GLTF_ANIMATION_PATH_WEIGHTS_BIT) ||
+                (animations[j].mask && !bitset_test(animations[j].mask, target->node)))
+                continue;
+
+            struct model_animation_sampler *sampler = &animator->samplers[target->samplers[3]];
+            struct model_animation_timestep timestep =
+                get_model_animation_timestep(animations[j].time, sampler->min, sampler->max, sampler->count,
+                                             sampler->times, &sampler->cursor);
+            if (sampler->interpolation == GLTF_ANIMATION_INTERPOLATION_STEP)
+                timestep.lerp_constant = 0;
+
+            // The first layer to touch a node's weights starts from its own.
+            gltf_node *node = &model->nodes[target->node];
+            float *to = animator->weight_data + animator->weight_offsets[target->node];
+            if (!bitset_test(ret->weights, target->node))
+                memcpy(to, node->weights, sizeof(*to) * node->weight_count);
+
+            model_anim_weights(
+                    timestep,
+                    sampler->width,
+                    sampler->values,
+                    to,
+                    node->weights,
+                    animations[j].blend == ANIMATION_BLEND_ADDITIVE,
+                    animations[j].weights[ANIMATION_WEIGHTS_WEIGHT]);
+            bitset_set(ret->weights, target->node);
         }
     }
+
+    model_anim_compose(animator);
 }
 
-static void model_build_transform_ubo(uint mesh, struct model_build_transform_ubo_arg *arg)
+static void model_build_transform_ubo(
+    struct model_animator      *arg,
+    struct model_mesh_instance *instance,
+    uchar                      *ubo_data)
 {
-    gltf       *model      = arg->model;
-    uchar      *ubo_data   = arg->ubo_data;
-    uint64      skin_mask  = arg->meshes[mesh].skin_mask;
-    uint64     *node_masks = arg->meshes[mesh].node_mask;
-    uint64      one        = 1;
+    gltf *model = arg->model;
+    uint  mesh  = instance->mesh;
+    ubo_data += instance->ubo;
 
     uint joints_trs_ofs = vt_ubo_ofs(false);
 
-    uint pc = popcnt(skin_mask);
-    for(uint j=0; j < pc; ++j) {
-        uint tz = ctz(skin_mask);
-        skin_mask &= ~(one<<tz);
+    for(uint i = instance->head; i != Max_u32; i = arg->next[i]) {
+        uint n = arg->flat_nodes[i];
+        bool skinned = model->nodes[n].skin != Max_u32;
+        bitset_set_if(arg->skin_scratch, model->nodes[n].skin & maxif(skinned), skinned);
+    }
+
+    for(uint s = bitset_next(arg->skin_scratch, model->skin_count, 0); s != Max_u32;
+             s = bitset_next(arg->skin_scratch, model->skin_count, s+1))
+    {
+        bitset_clear(arg->skin_scratch, s);
 
-        gltf_skin *skin = &model->skins[tz];
+        gltf_skin *skin = &model->skins[s];
         matrix global_invert;
 
         // log_print_error_if(skin->skeleton == Max_u32, "Go find the root yourself");
@@ -2280,53 +2469,758 @@ static void model_build_transform_ubo(uint mesh, struct model_build_transform_ub
             }
             identity_matrix(&global_invert);
         } else {
-            invert_transform(arg->xforms + skin->skeleton, &global_invert);
+            invert_transform(arg->global_xforms + skin->skeleton, &global_invert);
         }
 
+        // The joints' global transforms are left alone, as they are only
+        // recomputed when they are animated.
         for(uint i=0; i < skin->joint_count; ++i) {
-            mul_matrix(&global_invert,
-                       arg->xforms + skin->joints[i],
-                       arg->xforms + skin->joints[i]);
+            matrix joint;
+            mul_matrix(&global_invert, arg->global_xforms + skin->joints[i], &joint);
 
             if (skin->inverse_bind_matrices != Max_u32)
-                mul_matrix(arg->xforms + skin->joints[i],
-                           arg->ibm    + arg->ibm_ofs[tz] + i,
-                           arg->xforms + skin->joints[i]);
-        }
+                mul_matrix(&joint, arg->ibm + arg->ibm_ofs[s] + i, &joint);
 
-        for(uint i=0; i < skin->joint_count; ++i) {
-            memcpy(ubo_data + joints_trs_ofs + sizeof(*arg->xforms) * i,
-                   arg->xforms + skin->joints[i], sizeof(*arg->xforms));
+            memcpy(ubo_data + joints_trs_ofs + sizeof(joint) * i, &joint, sizeof(joint));
         }
     }
 
     uint node_trs_ofs = vt_ubo_ofs(false);
     uint node_w_ofs   = vt_ubo_ofs(true);
 
-    bool skinned = model->meshes[mesh].joint_count;
-    for(uint i=0; i < carrlen(arg->meshes[mesh].node_mask); ++i) {
-        pc = popcnt(node_masks[i]);
-        for(uint j=0; j < pc; ++j) {
-            uint tz = ctz(node_masks[i]);
-            node_masks[i] &= ~(one<<tz);
-
-            uint node_i = tz + (i * 64);
-
-            if (!skinned)
-                memcpy(ubo_data + node_trs_ofs, arg->xforms + node_i, sizeof(*arg->xforms));
-
-            // @Test @Optimise Weights should maybe be copied into weight_data in the animation
-            // function regardless of their being animated as that would remove the branch here. It
-            // would increase the run time of the animations function, but I think that is worth it
-            // as I feel that this loop will run more times than the animation function.
-            if (model->nodes[node_i].weight_count) {
-                if (arg->anim_masks->weights[node_i>>6] & (one << (node_i & 63)))
-                    memcpy(ubo_data + node_w_ofs, arg->weight_data + arg->weight_offsets[node_i],
-                           sizeof(*arg->weight_data) * model->nodes[node_i].weight_count);
-                else
-                    memcpy(ubo_data + node_w_ofs, model->nodes[node_i].weights,
-                           sizeof(*model->nodes[node_i].weights) * model->nodes[node_i].weight_count);
+    // Quantized positions are mapped back to the mesh's bounds before the
+    // node's transform (see gltf_quantize_meshes). Skinned meshes are never
+    // quantized.
+    gltf_mesh *m = &model->meshes[mesh];
+    matrix dequant;
+    if (m->position_scale) {
+        matrix s;
+        translation_matrix((vector){m->position_offset[0], m->position_offset[1], m->position_offset[2], 1}, &dequant);
+        scale_matrix((vector){m->position_scale, m->position_scale, m->position_scale, 1}, &s);
+        mul_matrix(&dequant, &s, &dequant);
+    }
+
+    bool skinned = m->joint_count;
+    for(uint i = instance->head; i != Max_u32; i = arg->next[i]) {
+        uint node_i = arg->flat_nodes[i];
+        if (!skinned && m->position_scale) {
+            matrix trs;
+            mul_matrix(arg->global_xforms + node_i, &dequant, &trs);
+            memcpy(ubo_data + node_trs_ofs, &trs, sizeof(trs));
+        } else if (!skinned) {
+            memcpy(ubo_data + node_trs_ofs, arg->global_xforms + node_i, sizeof(*arg->global_xforms));
+        }
+
+        // @Test @Optimise Weights should maybe be copied into weight_data in the animation
+        // function regardless of their being animated as that would remove the branch here. It
+        // would increase the run time of the animations function, but I think that is worth it
+        // as I feel that this loop will run more times than the animation function.
+        if (model->nodes[node_i].weight_count) {
+            if (bitset_test(arg->anim_masks.weights, node_i))
+                memcpy(ubo_data + node_w_ofs, arg->weight_data + arg->weight_offsets[node_i],
+                       sizeof(*arg->weight_data) * model->nodes[node_i].weight_count);
+            else
+                memcpy(ubo_data + node_w_ofs, model->nodes[node_i].weights,
+                       sizeof(*model->nodes[node_i].weights) * model->nodes[node_i].weight_count);
+        }
+    }
+}
+
+static inline void* model_animator_carve(uchar **p, uint64 size)
+{
+    void *ret = *p;
+    *p += align(size, 16);
+    return ret;
+}
+
+static uint model_subtree_size(gltf_node *nodes, uint node)
+{
+    uint ret = 1;
+    for(uint i=0; i < nodes[node].child_count; ++i)
+        ret += model_subtree_size(nodes, nodes[node].children[i]);
+    return ret;
+}
+
+// Append 'node' and its subtree to the animator's flat arrays, resolving how
+// the node is transformed at rest once here rather than on every update.
+// Returns whether 'targeted' has a bit set for any node of the subtree.
+static bool model_flatten_node(
+    struct model_animator *animator,
+    uint64                *targeted,
+    bool                   ancestor_targeted,
+    uint                   parent,
+    uint                   node)
+{
+    gltf_node *n = &animator->model->nodes[node];
+    uint i = animator->flat_count++;
+    animator->flat_nodes[i] = node;
+    animator->flat_parents[i] = parent;
+
+    if (n->flags & GLTF_NODE_MATRIX_BIT)
+        copy_matrix(&animator->flat_locals[i], &n->mat);
+    else if (n->flags & GLTF_NODE_TRS_BIT)
+        convert_trs(&n->trs, &animator->flat_locals[i]);
+    else
+        identity_matrix(&animator->flat_locals[i]);
+
+    log_print_error_if(n->mesh == Max_u32 && n->skin != Max_u32,
+                       "node declares a skin but not a mesh.");
+
+    bool self = bitset_test(targeted, node);
+    bool below = false;
+    for(uint c=0; c < n->child_count; ++c)
+        below |= model_flatten_node(animator, targeted, ancestor_targeted || self, node, n->children[c]);
+
+    animator->flat_ends[i] = animator->flat_count;
+    bitset_set_if(animator->flat_animated, i, ancestor_targeted || self || below);
+    return self || below;
+}
+
+static struct model_animator* model_new_animator(
+    gltf                 *model,
+    struct gpu           *gpu,
+    struct model_offsets *offsets,
+    uint                  scene_count,
+    uint                 *scenes,
+    uint64               *clip_mask,
+    allocator            *alloc)
+{
+    uint sampler_count = 0;
+    uint target_count = 0;
+    uint batch_count = 0;
+    uint pose_floats = align(model->node_count, 4) * MODEL_ANIMATION_POSE_ROWS * 2;
+    uint keyframe_floats = 4; // sampling loads whole vectors, so a vec3 key reads one float past its end
+    for(uint i=0; i < model->animation_count; ++i) {
+        sampler_count += model->animations[i].sampler_count;
+        if (clip_mask && !bitset_test(clip_mask, i))
+            continue;
+
+        gltf_animation *anim = &model->animations[i];
+        target_count += anim->target_count;
+        uint path_counts[3] = {0};
+        for(uint j=0; j < anim->target_count; ++j) {
+            uint mask = anim->targets[j].path_mask;
+            for(uint k = 0; k < popcnt(GLTF_ANIMATION_PATH_BITS); ++k) {
+                if (!(mask & (1 << k)))
+                    continue;
+                if (k < 3)
+                    path_counts[k]++;
+                // Overcounts shared samplers, which are rare.
+                uint frames = model->accessors[anim->samplers[anim->targets[j].samplers[k]].input].count;
+                uint width = k == 3 ? model->nodes[anim->targets[j].node].weight_count : k == 1 ? 4 : 3;
+                keyframe_floats += frames * (1 + width);
+            }
+        }
+        for(uint k=0; k < 3; ++k)
+            batch_count += (path_counts[k] + 3) / 4;
+    }
+
+    uint joint_count = 0;
+    for(uint s = bitset_next(offsets->skin_mask, model->skin_count, 0); s != Max_u32;
+             s = bitset_next(offsets->skin_mask, model->skin_count, s+1))
+        joint_count += model->skins[s].joint_count;
+
+    uint weight_count = 0;
+    for(uint i=0; i < model->node_count; ++i)
+        weight_count += model->nodes[i].weight_count;
+
+    uint flat_count = 0;
+    for(uint i=0; i < scene_count; ++i)
+        for(uint j=0; j < model->scenes[scenes[i]].node_count; ++j)
+            flat_count += model_subtree_size(model->nodes, model->scenes[scenes[i]].nodes[j]);
+
+    struct model_animator *ret;
+    uint *mesh_heads;
+    uint *mesh_counts;
+    uint64 size = align(sizeof(*ret), 16)                                                   +
+                  align(sizeof(*ret->ibm)             * joint_count, 16)                    +
+                  align(sizeof(*ret->anim_xforms)     * model->node_count, 16)              +
+                  align(sizeof(*ret->global_xforms)   * (model->node_count + 1), 16)        +
+                  align(sizeof(*ret->samplers)        * sampler_count, 16)                  +
+                  align(sizeof(*ret->clips)           * model->animation_count, 16)         +
+                  align(sizeof(*ret->clips->targets)  * target_count, 16)                   +
+                  align(sizeof(struct model_animation_batch) * batch_count, 16)             +
+                  align(sizeof(float)                 * pose_floats, 16)                    +
+                  align(sizeof(float)                 * keyframe_floats, 16)                +
+                  align(sizeof(*ret->ibm_ofs)         * model->skin_count, 16)              +
+                  align(sizeof(*ret->weight_offsets)  * model->node_count, 16)              +
+                  align(sizeof(*ret->weight_data)     * weight_count, 16)                   +
+                  align(sizeof(*ret->flat_nodes)      * flat_count, 16) * 4                 +
+                  align(sizeof(*ret->flat_locals)     * flat_count, 16)                     +
+                  align(sizeof(*ret->instances)       * flat_count, 16)                     +
+                  align(sizeof(*mesh_heads)           * model->mesh_count, 16) * 2          +
+                  sizeof(uint64) * (bitset_word_count(model->skin_count) * 2 +
+                                    bitset_word_count(model->node_count) * 2 +
+                                    bitset_word_count(model->mesh_count)     +
+                                    bitset_word_count(flat_count));
+
+    uchar *p = allocate(alloc, size);
+    ret = model_animator_carve(&p, sizeof(*ret));
+    ret->model                = model;
+    ret->alloc                = alloc;
+    ret->ibm                  = model_animator_carve(&p, sizeof(*ret->ibm)             * joint_count);
+    ret->anim_xforms          = model_animator_carve(&p, sizeof(*ret->anim_xforms)     * model->node_count);
+    ret->global_xforms        = model_animator_carve(&p, sizeof(*ret->global_xforms)   * (model->node_count + 1));
+    ret->samplers             = model_animator_carve(&p, sizeof(*ret->samplers)        * sampler_count);
+    ret->clips                = model_animator_carve(&p, sizeof(*ret->clips)           * model->animation_count);
+    struct model_animation_target *targets =
+                                model_animator_carve(&p, sizeof(*targets)              * target_count);
+    struct model_animation_batch *batches =
+                                model_animator_carve(&p, sizeof(*batches)              * batch_count);
+    float *poses              = model_animator_carve(&p, sizeof(*poses)                * pose_floats);
+    float *keyframes          = model_animator_carve(&p, sizeof(*keyframes)            * keyframe_floats);
+    ret->ibm_ofs              = model_animator_carve(&p, sizeof(*ret->ibm_ofs)         * model->skin_count);
+    ret->weight_offsets       = model_animator_carve(&p, sizeof(*ret->weight_offsets)  * model->node_count);
+    ret->weight_data          = model_animator_carve(&p, sizeof(*ret->weight_data)     * weight_count);
+    ret->flat_nodes           = model_animator_carve(&p, sizeof(*ret->flat_nodes)      * flat_count);
+    ret->flat_parents         = model_animator_carve(&p, sizeof(*ret->flat_parents)    * flat_count);
+    ret->flat_ends            = model_animator_carve(&p, sizeof(*ret->flat_ends)       * flat_count);
+    ret->next                 = model_animator_carve(&p, sizeof(*ret->next)            * flat_count);
+    ret->flat_locals          = model_animator_carve(&p, sizeof(*ret->flat_locals)     * flat_count);
+    ret->instances            = model_animator_carve(&p, sizeof(*ret->instances)       * flat_count);
+    mesh_heads                = model_animator_carve(&p, sizeof(*mesh_heads)           * model->mesh_count);
+    mesh_counts               = model_animator_carve(&p, sizeof(*mesh_counts)          * model->mesh_count);
+    ret->skin_mask            = (uint64*)p;
+    ret->skin_scratch         = ret->skin_mask            + bitset_word_count(model->skin_count);
+    ret->anim_masks.xforms    = ret->skin_scratch         + bitset_word_count(model->skin_count);
+    ret->anim_masks.weights   = ret->anim_masks.xforms    + bitset_word_count(model->node_count);
+    uint64 *mesh_mask         = ret->anim_masks.weights   + bitset_word_count(model->node_count);
+    ret->flat_animated        = mesh_mask                 + bitset_word_count(model->mesh_count);
+    ret->flat_count           = 0;
+    ret->instance_count       = 0;
+    ret->globals_valid        = false;
+    ret->at_rest              = false;
+
+    memcpy(ret->skin_mask, offsets->skin_mask, sizeof(*ret->skin_mask) * bitset_word_count(model->skin_count));
+    bitset_zero(ret->skin_scratch, model->skin_count);
+    bitset_zero(ret->anim_masks.xforms, model->node_count);
+    bitset_zero(ret->anim_masks.weights, model->node_count);
+    bitset_zero(mesh_mask, model->mesh_count);
+    bitset_zero(ret->flat_animated, flat_count);
+    copy_matrix(&ret->global_xforms[model->node_count], &IDENTITY_MATRIX);
+
+    weight_count = 0;
+    for(uint i=0; i < model->node_count; ++i) {
+        ret->weight_offsets[i] = weight_count;
+        weight_count += model->nodes[i].weight_count;
+    }
+
+    joint_count = 0;
+    for(uint s = bitset_next(ret->skin_mask, model->skin_count, 0); s != Max_u32;
+             s = bitset_next(ret->skin_mask, model->skin_count, s+1))
+    {
+        gltf_skin *skin = &model->skins[s];
+        if (skin->inverse_bind_matrices == Max_u32)
+            continue;
+
+        float *data = (float*)model_get_accessor_data(gpu, model, skin->inverse_bind_matrices, offsets);
+        load_count_matrices_ua(skin->joint_count, data, ret->ibm + joint_count);
+        ret->ibm_ofs[s] = joint_count;
+        joint_count += skin->joint_count;
+    }
+
+    // The keyframes of every sampler of the built clips are converted once
+    // here, so that sampling does not depend on the accessors' types or on
+    // the gpu memory staying mapped.
+    assert(GLTF_ANIMATION_PATH_TRANSLATION_BIT == 1 &&
+           GLTF_ANIMATION_PATH_ROTATION_BIT == 2 &&
+           GLTF_ANIMATION_PATH_SCALE_BIT == 4 &&
+           GLTF_ANIMATION_PATH_WEIGHTS_BIT == 8);
+
+    memset(ret->samplers, 0, sizeof(*ret->samplers) * sampler_count);
+    uint sampler_base = 0;
+    for(uint i=0; i < model->animation_count; ++i) {
+        gltf_animation *anim = &model->animations[i];
+        memset(&ret->clips[i], 0, sizeof(ret->clips[i]));
+        ret->clips[i].targets = targets;
+        if (clip_mask && !bitset_test(clip_mask, i)) {
+            sampler_base += anim->sampler_count;
+            continue;
+        }
+
+        ret->clips[i].target_count = anim->target_count;
+        for(uint j=0; j < anim->target_count; ++j) {
+            struct model_animation_target *target = &targets[j];
+            target->node = anim->targets[j].node;
+            target->path_mask = anim->targets[j].path_mask;
+            log_print_error_if(model->nodes[target->node].flags & GLTF_NODE_MATRIX_BIT,
+                               "node is targeted for animation but has matrix property set, this is disallowed by the spec.");
+
+            for(uint k=0; k < carrlen(target->samplers); ++k) {
+                target->samplers[k] = Max_u32;
+                if (!(target->path_mask & (1 << k)))
+                    continue;
+
+                target->samplers[k] = sampler_base + anim->targets[j].samplers[k];
+                struct model_animation_sampler *sampler = &ret->samplers[target->samplers[k]];
+                if (sampler->width)
+                    continue;
+
+                gltf_animation_sampler *from = &anim->samplers[anim->targets[j].samplers[k]];
+                gltf_accessor *input = &model->accessors[from->input];
+                gltf_accessor *output = &model->accessors[from->output];
+
+                sampler->interpolation = from->interpolation;
+                sampler->count = input->count;
+                sampler->width = k == 3 ? model->nodes[target->node].weight_count : k == 1 ? 4 : 3;
+                sampler->min = input->max_min.min[0];
+                sampler->max = input->max_min.max[0];
+                sampler->times = keyframes;
+                sampler->values = keyframes + sampler->count;
+                keyframes += sampler->count * (1 + sampler->width);
+
+                memcpy(sampler->times, model_get_accessor_data(gpu, model, from->input, offsets),
+                       sizeof(*sampler->times) * sampler->count);
+
+                void *data = model_get_accessor_data(gpu, model, from->output, offsets);
+                if (from->interpolation == GLTF_ANIMATION_INTERPOLATION_CUBICSPLINE) {
+                    for(uint f=0; f < sampler->count; ++f)
+                        convert_accessor((f * 3 + 1) * sampler->width, output->flags, data, sampler->width,
+                                         sampler->values + f * sampler->width);
+                } else {
+                    convert_accessor(0, output->flags, data, sampler->count * sampler->width, sampler->values);
+                }
+            }
+        }
+
+        // The channels of each transform path in batches of four.
+        struct model_animation_clip *clip = &ret->clips[i];
+        for(uint k=0; k < 3; ++k) {
+            clip->batches[k] = batches;
+            clip->batch_counts[k] = 0;
+            uint lane = 0;
+            for(uint j=0; j < anim->target_count; ++j) {
+                if (!(targets[j].path_mask & (1 << k)))
+                    continue;
+                batches->samplers[lane] = targets[j].samplers[k];
+                batches->nodes[lane] = targets[j].node;
+                if (++lane == 4) {
+                    batches->lanes = 4;
+                    batches++;
+                    clip->batch_counts[k]++;
+                    lane = 0;
+                }
+            }
+            if (lane) {
+                for(uint l = lane; l < 4; ++l) {
+                    batches->samplers[l] = batches->samplers[lane-1];
+                    batches->nodes[l] = batches->nodes[lane-1];
+                }
+                batches->lanes = lane;
+                batches++;
+                clip->batch_counts[k]++;
+            }
+        }
+
+        targets += anim->target_count;
+        sampler_base += anim->sampler_count;
+    }
+
+    // Nodes with a matrix are never animated, and rest as the identity.
+    ret->pose_stride = align(model->node_count, 4);
+    ret->rest = poses;
+    ret->pose = poses + ret->pose_stride * MODEL_ANIMATION_POSE_ROWS;
+    for(uint i=0; i < ret->pose_stride; ++i) {
+        struct trs trs = {.r = {0, 0, 0, 1}, .s = {1, 1, 1, 0}};
+        if (i < model->node_count && !(model->nodes[i].flags & GLTF_NODE_MATRIX_BIT))
+            trs = model->nodes[i].trs;
+        float *r = ret->rest + i;
+        r[ret->pose_stride * MODEL_ANIMATION_POSE_TX] = trs.t.x;
+        r[ret->pose_stride * MODEL_ANIMATION_POSE_TY] = trs.t.y;
+        r[ret->pose_stride * MODEL_ANIMATION_POSE_TZ] = trs.t.z;
+        r[ret->pose_stride * MODEL_ANIMATION_POSE_RX] = trs.r.x;
+        r[ret->pose_stride * MODEL_ANIMATION_POSE_RY] = trs.r.y;
+        r[ret->pose_stride * MODEL_ANIMATION_POSE_RZ] = trs.r.z;
+        r[ret->pose_stride * MODEL_ANIMATION_POSE_RW] = trs.r.w;
+        r[ret->pose_stride * MODEL_ANIMATION_POSE_SX] = trs.s.x;
+        r[ret->pose_stride * MODEL_ANIMATION_POSE_SY] = trs.s.y;
+        r[ret->pose_stride * MODEL_ANIMATION_POSE_SZ] = trs.s.z;
+    }
+
+    // Flatten the scenes, marking the nodes which the built clips can move
+    // with the xforms mask, which every update clears before it is read.
+    uint64 *targeted = ret->anim_masks.xforms;
+    for(uint i=0; i < model->animation_count; ++i)
+        for(uint j=0; j < ret->clips[i].target_count; ++j)
+            bitset_set(targeted, ret->clips[i].targets[j].node);
+
+    for(uint i=0; i < scene_count; ++i)
+        for(uint j=0; j < model->scenes[scenes[i]].node_count; ++j)
+            model_flatten_node(ret, targeted, false, model->node_count, model->scenes[scenes[i]].nodes[j]);
+    bitset_zero(targeted, model->node_count);
+
+    // The nodes under each root are listed per mesh, and each root's
+    // instance of a mesh writes the next of the mesh's ubos.
+    memset(mesh_heads, 0xff, sizeof(*mesh_heads) * model->mesh_count);
+    memset(mesh_counts, 0, sizeof(*mesh_counts) * model->mesh_count);
+    for(uint r=0; r < flat_count; r = ret->flat_ends[r]) {
+        for(uint i=r; i < ret->flat_ends[r]; ++i) {
+            uint mesh = model->nodes[ret->flat_nodes[i]].mesh;
+            if (mesh == Max_u32)
+                continue;
+            bitset_set(mesh_mask, mesh);
+            ret->next[i] = mesh_heads[mesh];
+            mesh_heads[mesh] = i;
+        }
+        for(uint m = bitset_next(mesh_mask, model->mesh_count, 0); m != Max_u32;
+                 m = bitset_next(mesh_mask, model->mesh_count, m+1))
+        {
+            bitset_clear(mesh_mask, m);
+            struct model_mesh_instance *instance = &ret->instances[ret->instance_count++];
+            instance->mesh = m;
+            instance->head = mesh_heads[m];
+            instance->ubo  = offsets->transforms_ubos[m] + vt_ubo_sz() * mesh_counts[m]++;
+            mesh_heads[m] = Max_u32;
+        }
+    }
+
+    return ret;
+}
+
+struct model_animator* new_model_animator(struct load_model_arg *arg, struct load_model_ret *ret, allocator *alloc)
+{
+    return model_new_animator(arg->model, arg->gpu, ret->offsets, arg->scene_count, arg->scenes, NULL, alloc);
+}
+
+void free_model_animator(struct model_animator *animator)
+{
+    deallocate(animator->alloc, animator);
+}
+
+void update_model_animator(struct model_animator *animator, uint animation_count,
+                           struct animation_info *animations, uchar *ubo_data)
+{
+    model_animations(animator, animation_count, animations);
+    model_node_global_transforms(animator);
+
+    for(uint i=0; i < animator->instance_count; ++i)
+        model_build_transform_ubo(animator, &animator->instances[i], ubo_data);
+}
+
+#if TEST
+static void test_model_animation_timestep(test_suite *suite);
+static void test_model_animator(test_suite *suite);
+
+void test_asset(test_suite *suite)
+{
+    test_model_animation_timestep(suite);
+    test_model_animator(suite);
+}
+
+// What get_model_animation_timestep should find, by a linear scan.
+static struct model_animation_timestep test_asset_timestep(float time, uint count, const float *data)
+{
+    float min = data[0];
+    float max = data[count-1];
+    if (count == 1 || max <= min)
+        return (struct model_animation_timestep){0,0,0};
+    time -= max * floorf(time / max);
+    if (time <= min)
+        return (struct model_animation_timestep){0,0,0};
+    uint i;
+    for(i=0; i < count && data[i] <= time; ++i);
+    i = i < count ? i : count-1;
+    return (struct model_animation_timestep){i-1, i, (time - data[i-1]) / (data[i] - data[i-1])};
+}
+
+static void test_model_animation_timestep(test_suite *suite)
+{
+    BEGIN_TEST_MODULE("model_animation_timestep", false, false);
+
+    struct model_animation_timestep ts;
+    uint cursor = 0;
+
+    // A one key clip is a static pose at any time.
+    float one[] = {0};
+    float one_times[] = {0, 0.5f, 3};
+    for(uint i=0; i < carrlen(one_times); ++i) {
+        ts = get_model_animation_timestep(one_times[i], 0, 0, 1, one, &cursor);
+        TEST_EQ("one key frame_0", ts.frame_0, 0, false);
+        TEST_EQ("one key frame_1", ts.frame_1, 0, false);
+        TEST_FEQ("one key lerp", ts.lerp_constant, 0, false);
+    }
+
+    float two[] = {0, 1};
+    ts = get_model_animation_timestep(0.25f, 0, 1, 2, two, &cursor);
+    TEST_EQ("two keys frame_0", ts.frame_0, 0, false);
+    TEST_EQ("two keys frame_1", ts.frame_1, 1, false);
+    TEST_FEQ("two keys lerp", ts.lerp_constant, 0.25f, false);
+    ts = get_model_animation_timestep(1.25f, 0, 1, 2, two, &cursor);
+    TEST_EQ("two keys wrapped frame_0", ts.frame_0, 0, false);
+    TEST_FEQ("two keys wrapped lerp", ts.lerp_constant, 0.25f, false);
+
+    // Past the end wraps around, the cursor still pointing at the last pair.
+    float four[] = {0, 0.5f, 1, 2};
+    cursor = 2;
+    ts = get_model_animation_timestep(2.75f, 0, 2, 4, four, &cursor);
+    TEST_EQ("past the end frame_0", ts.frame_0, 1, false);
+    TEST_EQ("past the end frame_1", ts.frame_1, 2, false);
+    TEST_FEQ("past the end lerp", ts.lerp_constant, 0.5f, false);
+    TEST_EQ("past the end cursor", cursor, 1, false);
+
+    // Random seeks, each from wherever the last one left the cursor, across
+    // the sse window and the halving above it.
+    uint key_counts[] = {3, 17, 100};
+    float keys[100];
+    uint rng = 1;
+    uint bad = 0;
+    for(uint k=0; k < carrlen(key_counts); ++k) {
+        uint kc = key_counts[k];
+        float t = 0;
+        for(uint i=0; i < kc; ++i) {
+            rng = rng * 1664525 + 1013904223;
+            keys[i] = t;
+            t += 0.01f + (rng >> 8) / (float)(1 << 24);
+        }
+        cursor = 0;
+        for(uint i=0; i < 1000; ++i) {
+            rng = rng * 1664525 + 1013904223;
+            float time = (rng >> 8) / (float)(1 << 24) * keys[kc-1] * 3;
+            struct model_animation_timestep a = get_model_animation_timestep(time, keys[0], keys[kc-1], kc, keys, &cursor);
+            struct model_animation_timestep b = test_asset_timestep(time, kc, keys);
+            bad += a.frame_0 != b.frame_0 || a.frame_1 != b.frame_1 || a.lerp_constant != b.lerp_constant;
+        }
+    }
+    TEST_EQ("random seeks", bad, 0, false);
+
+    END_TEST_MODULE();
+}
+
+static float test_asset_matrix_diff(matrix *a, matrix *b)
+{
+    float ret = 0;
+    for(uint i=0; i < 16; ++i)
+        ret = fmaxf(ret, fabsf(a->m[i] - b->m[i]));
+    return ret;
+}
+
+// Column 'node' of the animator's pose equals that of its rest pose.
+static bool test_asset_pose_at_rest(struct model_animator *animator, uint node)
+{
+    for(uint r=0; r < MODEL_ANIMATION_POSE_ROWS; ++r) {
+        uint i = r * animator->pose_stride + node;
+        if (animator->pose[i] != animator->rest[i])
+            return false;
+    }
+    return true;
+}
+
+// test/test_anim.gltf: node 0 (translation) is the parent of node 1 (rotation
+// and scale) and of the static node 2, whose child 3 is static too. Node 4 is
+// a root with a rest scale of (1, 0, 1) and a scale channel, and node 5 is a
+// static root with a static child 6. Every sampler keys times 0, 1 and 2.
+static void test_model_animator(test_suite *suite)
+{
+    BEGIN_TEST_MODULE("model_animator", false, false);
+
+    allocator temp = new_linear_allocator(1 << 20, NULL);
+    gltf g;
+    bool parsed = parse_gltf("test/test_anim.gltf", NULL, NULL, NULL, &temp, suite->alloc, &g);
+    TEST_EQ("parse", parsed, true, false);
+    if (!parsed) {
+        free_allocator(&temp);
+        END_TEST_MODULE();
+        return;
+    }
+
+    // Accessor data is read from the bind buffer of a host visible gpu.
+    uchar *bind = allocate(suite->alloc, g.buffers[0].byte_length);
+    char *to[] = {(char*)bind};
+    gltf_read_buffers(&g, to, NULL, &temp);
+    struct gpu *gpu = allocate_and_zero(suite->alloc, sizeof(*gpu));
+    gpu->flags = GPU_UMA_BIT;
+    gpu->mem.bind_buffer.data = bind;
+    uint buffer_offset = 0;
+    struct model_offsets offsets = {.buffers = &buffer_offset, .skin_mask = new_bitset(g.skin_count, suite->alloc)};
+    uint scene = 0;
+    struct model_animator *animator = model_new_animator(&g, gpu, &offsets, 1, &scene, NULL, suite->alloc);
+    uint node_count = g.node_count;
+
+    // One override layer at weight 1 is exactly the sampled trs. At 0.5 the
+    // keys are halfway from the first to the second.
+    struct animation_info layer = {.index = 0, .time = 0.5f, .weights = {1, 1, 1, 1}};
+    update_model_animator(animator, 1, &layer, NULL);
+
+    float s = sqrtf(0.5f);
+    float qlen = sqrtf(0.25f * s * s + (0.5f + 0.5f * s) * (0.5f + 0.5f * s));
+    struct trs expect[] = {
+        {.t = {0.5f, 1, 1.5f}, .r = {0, 0, 0, 1}, .s = {1, 1, 1}},
+        {.t = {0, 1, 0}, .r = {0, 0, 0.5f * s / qlen, (0.5f + 0.5f * s) / qlen}, .s = {1.5f, 1.5f, 1.5f}},
+        {.t = {0, 0, 0}, .r = {0, 0, 0, 1}, .s = {2, 2, 2}},
+    };
+    uint expect_nodes[] = {0, 1, 4};
+    matrix m;
+    for(uint i=0; i < carrlen(expect); ++i) {
+        convert_trs(&expect[i], &m);
+        TEST_EQ("override.animated", bitset_test(animator->anim_masks.xforms, expect_nodes[i]), true, false);
+        TEST_EQ("override.matrix", test_asset_matrix_diff(&m, &animator->anim_xforms[expect_nodes[i]]) < 1e-5f, true, false);
+    }
+    TEST_EQ("override.count", bitset_count(animator->anim_masks.xforms, node_count), 3, false);
+
+    // While a clip plays, only the subtrees it moves are recomputed, which
+    // gives the same globals as computing every node.
+    matrix *globals = allocate(suite->alloc, sizeof(*globals) * (node_count + 1));
+    memcpy(globals, animator->global_xforms, sizeof(*globals) * (node_count + 1));
+    animator->globals_valid = false;
+    model_node_global_transforms(animator);
+    TEST_EQ("playing.globals", memcmp(globals, animator->global_xforms, sizeof(*globals) * node_count), 0, false);
+
+    // Then once it stops, and again while it stays stopped.
+    for(uint i=0; i < 2; ++i) {
+        update_model_animator(animator, 0, NULL, NULL);
+        memcpy(globals, animator->global_xforms, sizeof(*globals) * (node_count + 1));
+        animator->globals_valid = false;
+        model_node_global_transforms(animator);
+        TEST_EQ("stopped.globals", memcmp(globals, animator->global_xforms, sizeof(*globals) * node_count), 0, false);
+    }
+    convert_trs(&(struct trs){.t = {0, 1, 0}, .r = {0, 0, 0, 1}, .s = {1, 1, 1}}, &m);
+    TEST_EQ("stopped.rest", test_asset_matrix_diff(&m, &animator->global_xforms[1]) < 1e-5f, true, false);
+
+    // A layer at weight 0, or masked off, leaves the rest pose and moves no
+    // node.
+    struct animation_info none = {.index = 0, .time = 0.5f};
+    update_model_animator(animator, 1, &none, NULL);
+    TEST_EQ("weight_0.is_zero", bitset_is_zero(animator->anim_masks.xforms, node_count), true, false);
+    bool at_rest = true;
+    for(uint i=0; i < node_count; ++i)
+        at_rest = at_rest && test_asset_pose_at_rest(animator, i);
+    TEST_EQ("weight_0.pose", at_rest, true, false);
+
+    uint64 *mask = new_bitset(node_count, suite->alloc);
+    layer.mask = mask;
+    update_model_animator(animator, 1, &layer, NULL);
+    TEST_EQ("masked.is_zero", bitset_is_zero(animator->anim_masks.xforms, node_count), true, false);
+    at_rest = true;
+    for(uint i=0; i < node_count; ++i)
+        at_rest = at_rest && test_asset_pose_at_rest(animator, i);
+    TEST_EQ("masked.pose", at_rest, true, false);
+
+    bitset_set(mask, 1);
+    update_model_animator(animator, 1, &layer, NULL);
+    TEST_EQ("mask_1.count", bitset_count(animator->anim_masks.xforms, node_count), 1, false);
+    TEST_EQ("mask_1.node_1", bitset_test(animator->anim_masks.xforms, 1), true, false);
+    at_rest = true;
+    for(uint i=0; i < node_count; ++i)
+        at_rest = at_rest && (i == 1 || test_asset_pose_at_rest(animator, i));
+    TEST_EQ("mask_1.pose", at_rest, true, false);
+    layer.mask = NULL;
+
+    // An additive scale over a zero rest scale keeps the zero, rather than
+    // dividing by it.
+    layer.blend = ANIMATION_BLEND_ADDITIVE;
+    update_model_animator(animator, 1, &layer, NULL);
+    float *pose = animator->pose;
+    uint stride = animator->pose_stride;
+    TEST_FEQ("additive.sx", pose[MODEL_ANIMATION_POSE_SX * stride + 4], 2, false);
+    TEST_FEQ("additive.sy", pose[MODEL_ANIMATION_POSE_SY * stride + 4], 0, false);
+    TEST_FEQ("additive.sz", pose[MODEL_ANIMATION_POSE_SZ * stride + 4], 2, false);
+    bool finite = true;
+    for(uint i=0; i < 16; ++i)
+        finite = finite && isfinite(animator->global_xforms[4].m[i]);
+    TEST_EQ("additive.finite", finite, true, false);
+
+    deallocate(suite->alloc, mask);
+    deallocate(suite->alloc, globals);
+    free_model_animator(animator);
+    deallocate(suite->alloc, offsets.skin_mask);
+    deallocate(suite->alloc, gpu);
+    deallocate(suite->alloc, bind);
+    deallocate(suite->alloc, g.meta.data);
+    free_allocator(&temp);
+
+    END_TEST_MODULE();
+}
+#endif
+
+#if BENCH
+#include "bench.h"
+
+#define ASSET_BENCH_CHANNELS 1000
+#define ASSET_BENCH_FRAMES 600
+
+// The search which get_model_animation_timestep used to do, for comparison.
+static inline uint bench_asset_linear(float time, uint count, const float *data)
+{
+    uint i;
+    for(i=0; i < count; ++i)
+        if (data[i] > time)
+            break;
+    return i;
+}
+
+static void bench_asset_print(const char *name, uint key_count, double sec)
+{
+    println("    %s, %u keys: %f us/frame, %f ns/channel (%f sec)", name, key_count,
+            sec / ASSET_BENCH_FRAMES * 1e6, sec / ASSET_BENCH_FRAMES / ASSET_BENCH_CHANNELS * 1e9, sec);
+}
+
+void bench_asset(thread_pool *pool, allocator *alloc)
+{
+    // Own linear allocator, as the keys of the longest clips do not fit in
+    // the main temp allocator.
+    allocator a = new_linear_allocator(64 * 1024 * 1024, NULL);
+    println("asset:");
+    println("  animation sampling, %u channels, %u frames at 60hz:", ASSET_BENCH_CHANNELS, ASSET_BENCH_FRAMES);
+
+    uint key_counts[] = {100, 1000, 10000};
+    uint *cursors = sallocate(&a, uint, ASSET_BENCH_CHANNELS);
+    float *offsets = sallocate(&a, float, ASSET_BENCH_CHANNELS);
+    float *seeks = sallocate(&a, float, ASSET_BENCH_CHANNELS * ASSET_BENCH_FRAMES);
+    uint64 mark = allocator_used(&a);
+
+    volatile float sink = 0;
+    for(uint k=0; k < carrlen(key_counts); ++k) {
+        // Keys at 30hz with some jitter, each channel its own clip.
+        uint kc = key_counts[k];
+        float *keys = sallocate(&a, float, kc * ASSET_BENCH_CHANNELS);
+        uint rng = 1;
+        for(uint c=0; c < ASSET_BENCH_CHANNELS; ++c) {
+            float t = 0;
+            for(uint i=0; i < kc; ++i) {
+                rng = rng * 1664525 + 1013904223;
+                keys[c * kc + i] = t;
+                t += (1.0f + (rng >> 8) / (float)(1 << 24)) / 45.0f;
             }
+            cursors[c] = 0;
+            rng = rng * 1664525 + 1013904223;
+            offsets[c] = (rng >> 8) / (float)(1 << 24) * keys[c * kc + kc - 1];
         }
+        for(uint i=0; i < ASSET_BENCH_CHANNELS * ASSET_BENCH_FRAMES; ++i) {
+            rng = rng * 1664525 + 1013904223;
+            seeks[i] = (rng >> 8) / (float)(1 << 24);
+        }
+
+        double t = bench_time();
+        for(uint f=0; f < ASSET_BENCH_FRAMES; ++f)
+            for(uint c=0; c < ASSET_BENCH_CHANNELS; ++c) {
+                float *d = keys + c * kc;
+                sink += get_model_animation_timestep(offsets[c] + f / 60.0f, d[0], d[kc-1], kc, d,
+                                                     &cursors[c]).lerp_constant;
+            }
+        bench_asset_print("playback", kc, bench_time() - t);
+
+        t = bench_time();
+        for(uint f=0; f < ASSET_BENCH_FRAMES; ++f)
+            for(uint c=0; c < ASSET_BENCH_CHANNELS; ++c) {
+                float *d = keys + c * kc;
+                sink += get_model_animation_timestep(seeks[f * ASSET_BENCH_CHANNELS + c] * d[kc-1], d[0], d[kc-1],
+                                                     kc, d, &cursors[c]).lerp_constant;
+            }
+        bench_asset_print("random seek", kc, bench_time() - t);
+
+        t = bench_time();
+        for(uint f=0; f < ASSET_BENCH_FRAMES; ++f)
+            for(uint c=0; c < ASSET_BENCH_CHANNELS; ++c) {
+                float *d = keys + c * kc;
+                float time = offsets[c] + f / 60.0f;
+                time -= d[kc-1] * floorf(time / d[kc-1]);
+                sink += bench_asset_linear(time, kc, d);
+            }
+        bench_asset_print("playback, linear scan", kc, bench_time() - t);
+
+        allocator_reset_linear_to(&a, mark);
     }
+
+    free_allocator(&a);
 }
+#endif
@@ -68,10 +68,25 @@ enum {
     ANIMATION_WEIGHTS_SCALE,
     ANIMATION_WEIGHTS_WEIGHT,
 };
+
+// How a layer is blended into the pose of the layers before it, which starts
+// as the nodes' own trs. An override layer moves the pose towards the clip's
+// by its weights, so a layer weighted 1 replaces it. An additive layer adds
+// the clip's difference from the nodes' own trs, scaled by its weights.
+typedef enum {
+    ANIMATION_BLEND_OVERRIDE,
+    ANIMATION_BLEND_ADDITIVE,
+} animation_blend;
+
+// A layer: one of the model's animations, sampled at 'time'. 'mask' is a
+// bitset of node_count bits, the nodes which the layer may move, or NULL for
+// every node.
 struct animation_info {
-    uint  index;
-    float time;
-    float weights[4];
+    uint             index;
+    float            time;
+    float            weights[4];
+    animation_blend  blend;
+    const uint64    *mask;
 };
 
 struct load_model_arg {
@@ -161,11 +176,40 @@ struct load_model_info {
    freed, the address itself must not be moved. */
 void load_model_tf(struct thread_work_arg *arg);
 
+// Samples a loaded model's animations each frame without going back through
+// load_model_tf. The keyframes, inverse bind matrices and the scratch for
+// the node transforms are laid out when it is made, so an update only samples
+// and writes the ubos: it neither allocates nor touches vulkan.
+struct model_animator;
+
+// Call once 'ret' holds a successful load of 'arg', before the transfer
+// memory is reused, as the keyframes are copied out of it. arg->scenes are
+// the scenes which are animated; arg->animations is not used.
+struct model_animator* new_model_animator(struct load_model_arg *arg, struct load_model_ret *ret, allocator *alloc);
+void free_model_animator(struct model_animator *animator);
+
+// Write the transforms and morph weights of the animator's scenes, with the
+// layers 'animations' blended in order, to the model's transform ubos, which
+// begin at 'ubo_data': the model's base in the bind buffer when it is host
+// visible, else wherever the caller stages them for upload. Every layer is
+// blended as poses before any node's transform is built, so a layer costs its
+// sampling and not a matrix per node.
+void update_model_animator(struct model_animator *animator, uint animation_count,
+                           struct animation_info *animations, uchar *ubo_data);
+
 void draw_model_color(VkCommandBuffer cmd, struct draw_model_info *info);
 void draw_model_depth(VkCommandBuffer cmd, struct draw_model_info *info, uint pass);
 void model_signal_cleanup(struct load_model_ret *ret);
 void model_signal_pipeline_cleanup(struct load_model_ret *ret);
 
+#if TEST
+void test_asset(test_suite *suite);
+#endif
+
+#if BENCH
+void bench_asset(thread_pool *pool, allocator *alloc);
+#endif
+
 #if DEBUG
 void check_load_result(uint r);
 #else
@@ -0,0 +1,31 @@
+#ifndef SOL_BENCH_H_INCLUDE_GUARD_
+#define SOL_BENCH_H_INCLUDE_GUARD_
+
+#include "defs.h"
+#include "print.h"
+
+// Benchmarks are compiled in with BENCH (see defs.h) and run from main.c after
+// the tests. Each module exposes a bench_<module>(allocator*) function.
+
+// Wall clock rather than the thread cpu clock used by timer.h, so that page
+// faults on freshly allocated memory are included.
+static inline double bench_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Enough iterations to process roughly 'target' bytes, at least one.
+static inline uint32 bench_iterations(size_t bytes, size_t target)
+{
+    return bytes >= target ? 1 : (uint32)(target / bytes);
+}
+
+static inline void bench_print_throughput(const char *name, size_t bytes, uint32 iterations, double sec)
+{
+    double mb = ((double)bytes * iterations) / (1024.0 * 1024.0);
+    println("    %s: %f MB/s (%f MB, %u iterations, %f sec)", name, mb / sec, (double)bytes / (1024.0 * 1024.0), iterations, sec);
+}
+
+#endif // include guard
@@ -0,0 +1,111 @@
+#ifndef SOL_BITSET_H_INCLUDE_GUARD_
+#define SOL_BITSET_H_INCLUDE_GUARD_
+
+#include "defs.h"
+#include "allocator.h"
+
+// A bitset is an array of uint64 words holding 'bit_count' bits, which is
+// passed alongside it. The array is rounded up to whole 128 bit lanes so that
+// it can be scanned with SSE, and the bits past bit_count are always zero. It
+// is at least one lane even when empty, so the branchless setters can always
+// write to bit zero.
+#define BITSET_LANE_WORDS 2
+
+static inline uint bitset_word_count(uint bit_count)
+{
+    return align(bit_count + !bit_count, 64 * BITSET_LANE_WORDS) >> 6;
+}
+
+static inline uint64* new_bitset(uint bit_count, allocator *alloc)
+{
+    uint words = bitset_word_count(bit_count);
+    uint64 *ret = sallocate(alloc, *ret, words);
+    memset(ret, 0, sizeof(*ret) * words);
+    return ret;
+}
+
+static inline void bitset_zero(uint64 *set, uint bit_count)
+{
+    memset(set, 0, sizeof(*set) * bitset_word_count(bit_count));
+}
+
+static inline bool bitset_test(const uint64 *set, uint i)
+{
+    return (set[i >> 6] >> (i & 63)) & 1;
+}
+
+static inline void bitset_set(uint64 *set, uint i)
+{
+    set[i >> 6] |= (uint64)1 << (i & 63);
+}
+
+// Branchless, 'i' must still be in range when 'b' is false.
+static inline void bitset_set_if(uint64 *set, uint i, bool b)
+{
+    set[i >> 6] |= (uint64)b << (i & 63);
+}
+
+static inline void bitset_clear(uint64 *set, uint i)
+{
+    set[i >> 6] &= ~((uint64)1 << (i & 63));
+}
+
+// popcnt is not enabled by the build flags, so a lane is counted a nibble at a
+// time with pshufb and the byte counts are summed with psadbw.
+static inline uint bitset_count(const uint64 *set, uint bit_count)
+{
+    const __m128i lut = _mm_setr_epi8(0,1,1,2, 1,2,2,3, 1,2,2,3, 2,3,3,4);
+    const __m128i nib = _mm_set1_epi8(0x0f);
+    __m128i acc = _mm_setzero_si128();
+
+    uint words = bitset_word_count(bit_count);
+    for(uint i=0; i < words; i += BITSET_LANE_WORDS) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(set + i));
+        __m128i c = _mm_add_epi8(_mm_shuffle_epi8(lut, _mm_and_si128(v, nib)),
+                                 _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), nib)));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(c, _mm_setzero_si128()));
+    }
+    return _mm_cvtsi128_si64(acc) + _mm_extract_epi64(acc, 1);
+}
+
+static inline bool bitset_is_zero(const uint64 *set, uint bit_count)
+{
+    uint words = bitset_word_count(bit_count);
+    for(uint i=0; i < words; i += BITSET_LANE_WORDS) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(set + i));
+        if (!_mm_testz_si128(v, v))
+            return false;
+    }
+    return true;
+}
+
+// Index of the first set bit at or after 'i', or Max_u32. Empty lanes are
+// skipped 128 bits at a time, so iterating a sparse set costs little more
+// than the number of bits set:
+//
+//     for(uint i = bitset_next(set, cnt, 0); i != Max_u32; i = bitset_next(set, cnt, i+1))
+static inline uint bitset_next(const uint64 *set, uint bit_count, uint i)
+{
+    uint words = bitset_word_count(bit_count);
+    uint w = i >> 6;
+    if (w >= words)
+        return Max_u32;
+
+    uint64 m = set[w] & (Max_u64 << (i & 63));
+    if (m)
+        return (w << 6) + ctz(m);
+
+    if (++w & 1) {
+        if (set[w])
+            return (w << 6) + ctz(set[w]);
+        ++w;
+    }
+    for(; w < words; w += BITSET_LANE_WORDS) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(set + w));
+        if (!_mm_testz_si128(v, v))
+            return set[w] ? (w << 6) + ctz(set[w]) : ((w+1) << 6) + ctz(set[w+1]);
+    }
+    return Max_u32;
+}
+
+#endif // include guard
@@ -0,0 +1,79 @@
+// The model loading code without the renderer, built by 'build.sh cook' to
+// bake models into .cook files ahead of time (see cook_gltf in gltf.h):
+//
+//     ./cook [-q] <model.gltf|model.glb>...
+//
+// -q quantizes vertex attributes (see gltf_quantize_meshes) in the models
+// which follow it.
+//
+// Nothing here touches the gpu, so this needs the vulkan headers but not the
+// loader, glfw or shaderc.
+
+#include "defs.h"
+
+#include "external/stb_sprintf.c"
+#include "external/stb_image.c"
+
+#include "allocator.c"
+#include "thread.c"
+#include "dict.c"
+#include "math.c"
+#include "mesh.c"
+#include "print.c"
+#include "ascii.c"
+#include "string.c"
+#include "file.c"
+#include "json.c"
+#include "gltf.c"
+#include "image.c"
+
+// sol_vulkan.h defines some of its wrappers out of line, which reference the
+// dispatch table. It is never filled in here.
+struct vulkan_dispatch_table vulkan_dispatch_table;
+
+#define COOK_HEAP_ALLOCATOR_SIZE (64 * 1024 * 1024)
+#define COOK_TEMP_ALLOCATOR_SIZE (512 * 1024 * 1024)
+#define COOK_THREAD_ALLOCATOR_SIZE (1024 * 1024)
+
+int main(int argc, const char **argv)
+{
+    if (argc < 2) {
+        println("usage: %s [-q] <model.gltf|model.glb>...", argv[0]);
+        return 1;
+    }
+
+    allocator heap = new_arena_allocator(COOK_HEAP_ALLOCATOR_SIZE, NULL);
+    allocator temp = new_linear_allocator(COOK_TEMP_ALLOCATOR_SIZE, NULL);
+
+    // The workers only read files, so their allocators are small.
+    thread_pool pool;
+    struct allocation heap_buffers[THREAD_COUNT];
+    struct allocation temp_buffers[THREAD_COUNT];
+    uint i;
+    for(i = 0; i < THREAD_COUNT; ++i) {
+        heap_buffers[i] = (struct allocation){.size = COOK_THREAD_ALLOCATOR_SIZE};
+        temp_buffers[i] = (struct allocation){allocate(&heap, COOK_THREAD_ALLOCATOR_SIZE), COOK_THREAD_ALLOCATOR_SIZE};
+    }
+    new_thread_pool(heap_buffers, temp_buffers, &heap, &pool);
+
+    int ret = 0;
+    uint flags = 0;
+    for(i = 1; i < (uint)argc; ++i) {
+        if (!strcmp(argv[i], "-q")) {
+            flags |= GLTF_COOK_QUANTIZE_BIT;
+            continue;
+        }
+        if (!cook_gltf(argv[i], flags, &pool, &temp, &heap)) {
+            println("failed to cook %s", argv[i]);
+            ret = 1;
+        }
+        allocator_reset_linear(&temp);
+    }
+
+    free_thread_pool(&pool, true);
+    for(i = THREAD_COUNT; i > 0; --i)
+        free_allocator(&pool.threads[i - 1].persistent);
+    free_allocator(&temp);
+    free_allocator(&heap);
+    return ret;
+}
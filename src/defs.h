@@ -21,6 +21,7 @@ extern float FOV;
 
 #define DEBUG 1
 #define TEST  0
+#define BENCH 0
 #define MULTITHREADED 1
 #define GPU 1
 #define CHECK_END_STATE 1
@@ -1,4 +1,8 @@
+#include <sys/mman.h>
+
 #include "file.h"
+#include "bench.h"
+#include "external/wyhash.h"
 
 int file_open(const char *path, int flags)
 {
@@ -8,6 +12,52 @@ int file_open(const char *path, int flags)
     return e;
 }
 
+struct file file_map_private(const char *path)
+{
+    int fd = file_open(path, READ);
+    if (!check_file_result(fd))
+        return (struct file){};
+
+    struct file ret = {.size = file_size_fd(fd)};
+    if (ret.size) {
+        ret.data = mmap(NULL, ret.size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+        log_print_error_if(ret.data == MAP_FAILED, "failed to map file %s: %s", path, strerror(errno));
+        if (ret.data == MAP_FAILED)
+            ret = (struct file){};
+    }
+    file_close(fd); // the mapping holds its own reference
+    return ret;
+}
+
+void file_unmap(struct file *f)
+{
+    if (f->data)
+        munmap(f->data, f->size);
+    *f = (struct file){};
+}
+
+uint64 file_hash(const char *path, uint64 seed)
+{
+    int fd = file_open(path, READ);
+    if (!check_file_result(fd))
+        return seed;
+
+    uint64 size = file_size_fd(fd);
+    seed = wyhash(&size, sizeof(size), seed, _wyp);
+    if (size) {
+        char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        log_print_error_if(data == MAP_FAILED, "failed to map file %s: %s", path, strerror(errno));
+        if (data != MAP_FAILED) {
+            madvise(data, size, MADV_SEQUENTIAL);
+            for(uint64 i = 0; i < size; i += FILE_HASH_CHUNK_SIZE)
+                seed = wyhash(data + i, size - i < FILE_HASH_CHUNK_SIZE ? size - i : FILE_HASH_CHUNK_SIZE, seed, _wyp);
+            munmap(data, size);
+        }
+    }
+    file_close(fd);
+    return seed;
+}
+
 bool file_close(int fd)
 {
     int e = close(fd);
@@ -70,6 +120,96 @@ struct file file_read_all(const char *path, allocator *alloc)
     return (struct file) {.size = stat.st_size, .data = data};
 }
 
+static void file_read_batch_do(struct file_read *r)
+{
+    double t = bench_time();
+    int fd = file_open(r->path, READ);
+    if (check_file_result(fd)) {
+        r->failed = file_read(fd, r->offset, r->size, r->to) != (int64)r->size;
+        file_close(fd);
+    } else {
+        r->failed = true;
+    }
+    r->sec = bench_time() - t;
+    signal_thread_true(&r->done);
+}
+
+// Return false once every read has been claimed.
+static bool file_read_batch_claim(struct file_read_batch *batch)
+{
+    uint32 i = atomic_add(&batch->next, 1);
+    if (i >= batch->count)
+        return false;
+    file_read_batch_do(&batch->reads[i]);
+    atomic_add(&batch->done, 1);
+    return true;
+}
+
+static void* file_read_batch_tf(struct thread_work_arg *arg)
+{
+    struct file_read_batch *batch = arg->arg;
+    while(file_read_batch_claim(batch))
+        ;
+    atomic_add(&batch->exited, 1);
+    return NULL;
+}
+
+void file_read_batch_begin(struct file_read_batch *batch, uint32 count, struct file_read *reads, thread_pool *pool)
+{
+    *batch = (struct file_read_batch) {.reads = reads, .count = count};
+    for(uint32 i = 0; i < count; ++i)
+        reads[i].done = false;
+
+    // The caller is expected to do some of the reads while it waits, so one
+    // less work item than reads.
+    if (pool && count > 1) {
+        struct thread_work work[THREAD_COUNT];
+        uint32 work_count = count - 1 < THREAD_COUNT ? count - 1 : THREAD_COUNT;
+        for(uint32 i = 0; i < work_count; ++i) {
+            work[i].fn = cast_work_fn(file_read_batch_tf);
+            work[i].arg = cast_work_arg(batch);
+        }
+        batch->submitted = thread_add_work_high(pool, work_count, work);
+    }
+}
+
+bool file_read_wait(struct file_read_batch *batch, uint32 i)
+{
+    bool32 done;
+    while(1) {
+        atomic_load(&batch->reads[i].done, &done);
+        if (done)
+            return !batch->reads[i].failed;
+        if (!file_read_batch_claim(batch))
+            _mm_pause();
+    }
+}
+
+bool file_read_batch_end(struct file_read_batch *batch)
+{
+    while(file_read_batch_claim(batch))
+        ;
+
+    uint32 done, exited;
+    while(1) {
+        atomic_load(&batch->done, &done);
+        atomic_load(&batch->exited, &exited);
+        if (done == batch->count && exited == batch->submitted)
+            break;
+        _mm_pause();
+    }
+
+    bool ok = true;
+    for(uint32 i = 0; i < batch->count; ++i) {
+        ok &= !batch->reads[i].failed;
+        #if FILE_PRINT_READ_TIMES
+        struct file_read *r = &batch->reads[i];
+        println("read %s: %f MB in %f ms", r->path, (double)r->size / (1024.0 * 1024.0), r->sec * 1000.0);
+        #endif
+    }
+    return ok;
+}
+
 /*--------------------------------------------------------------------------------*/
 // @Deprecated
 struct file file_read_bin_all(const char *file_name, allocator *alloc)
@@ -8,6 +8,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include "log.h"
+#include "thread.h"
 
 struct file {
     char *data;
@@ -101,6 +102,58 @@ int64 file_open_write_create(const char *path, uint64 offset, uint64 count, void
 int64 file_open_read(const char *path, uint64 offset, uint64 count, void *data);
 struct file file_read_all(const char *path, allocator *alloc);
 
+// Map a whole file copy-on-write: the pages are read on first touch, and
+// writes go to private copies which never reach the file. data is NULL if
+// the file is empty or could not be mapped.
+struct file file_map_private(const char *path);
+void file_unmap(struct file *f);
+
+// Hash of a file's contents, chained onto 'seed' so that several files can be
+// hashed into one value. The file is mapped read only and hashed in chunks of
+// FILE_HASH_CHUNK_SIZE, so it is streamed through memory rather than read
+// into a buffer.
+#define FILE_HASH_CHUNK_SIZE (1 << 20)
+uint64 file_hash(const char *path, uint64 seed);
+
+// A batch of reads into destinations which the caller has already sized, so
+// nothing is allocated once the batch has begun. The reads are claimed from a
+// shared counter by the pool's workers and by any thread waiting on the batch,
+// so the caller can decode one file while the rest are still in flight, and a
+// busy (or NULL) pool only means that the caller does the reads itself.
+//
+//     file_read_batch_begin(&b, count, reads, pool);
+//     for(i...) { file_read_wait(&b, i); ...use reads[i].to... }
+//     file_read_batch_end(&b);
+//
+// 'sec' is the wall time each read spent in open, pread and close.
+#define FILE_PRINT_READ_TIMES 1
+
+struct file_read {
+    const char *path;
+    uint64 offset;
+    uint64 size;
+    void *to;
+    double sec;
+    bool32 done;
+    bool32 failed;
+};
+
+struct file_read_batch {
+    struct file_read *reads;
+    uint32 count;
+    uint32 next;
+    uint32 done;
+    uint32 exited;
+    uint32 submitted;
+};
+
+void file_read_batch_begin(struct file_read_batch *batch, uint32 count, struct file_read *reads, thread_pool *pool);
+// Return false if the read failed.
+bool file_read_wait(struct file_read_batch *batch, uint32 i);
+// Must be called before 'reads' goes out of scope, as work items may still be
+// queued behind other work. Return false if any read failed.
+bool file_read_batch_end(struct file_read_batch *batch);
+
 // @Deprecated
 struct file file_read_bin_all(const char *file_name, allocator *alloc);
 struct file file_read_char_all(const char *file_name, allocator *alloc);
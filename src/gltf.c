@@ -1,5 +1,6 @@
 #include "gltf.h"
 #include "json.h"
+#include "dict.h"
 #include "log.h"
 #include "shader.h"
 #include "timer.h"
@@ -7,114 +8,519 @@
 
 #define PROCESSED_GLTF_FILE_EXTENSION ".sol"
 
-void store_gltf(gltf *model, const char *file_name, allocator *alloc)
+// A .sol file is a processed gltf which is mapped and used in place:
+//
+//     gltf_sol_header
+//     gltf                (header_size bytes in)
+//     meta                (meta_offset bytes in, page aligned)
+//
+// Every pointer in the gltf and in meta is stored as the file offset of what
+// it points to, or zero for NULL. Loading maps the file copy-on-write and adds
+// the mapping's address to each of them, so nothing is read or copied up
+// front, and only the pages holding pointers are dirtied.
+//
+// GLTF_SOL_VERSION must change with any change to the layout of the file or
+// of the gltf structs. GLTF_PARSER_VERSION must change with any change to
+// what parse_gltf puts in them, as it seeds the source hash: a cache is used
+// only if the hash of the parser version, the .gltf and the buffers it
+// references matches the one stored with it, so caches stay valid across
+// builds and deployments, and only changed models are parsed again.
+#define GLTF_SOL_MAGIC 0x474c4f53 // "SOLG"
+#define GLTF_SOL_VERSION 6
+#define GLTF_PARSER_VERSION 1
+#define GLTF_SOL_ENDIAN 0x01020304
+#define GLTF_SOL_META_ALIGNMENT 4096
+
+typedef struct {
+    uint32 magic;
+    uint32 version;
+    uint32 endian;      // GLTF_SOL_ENDIAN as written by the storing machine
+    uint32 header_size; // sizeof(gltf_sol_header) + sizeof(gltf)
+    uint64 hash;        // of everything after the header
+    uint64 source_hash; // gltf_source_hash
+    uint64 meta_offset;
+    uint64 meta_size;
+    uint64 file_size;
+} gltf_sol_header;
+
+// Call 'fn' on every pointer in 'g' and in the arrays it points to. 'fn' is
+// called on a pointer before anything it points to is read, so it may rewrite
+// pointers in place as long as they are valid once it returns.
+static void gltf_for_each_pointer(gltf *g, void (*fn)(void **ptr, void *arg), void *arg)
 {
-    assert(strlen(file_name) < 150);
+    #define GLTF_POINTER(p) fn((void**)&(p), arg)
+
+    GLTF_POINTER(g->meta.data);
+    GLTF_POINTER(g->accessors);
+    GLTF_POINTER(g->animations);
+    GLTF_POINTER(g->buffers);
+    GLTF_POINTER(g->buffer_views);
+    GLTF_POINTER(g->cameras);
+    GLTF_POINTER(g->images);
+    GLTF_POINTER(g->materials);
+    GLTF_POINTER(g->meshes);
+    GLTF_POINTER(g->nodes);
+    GLTF_POINTER(g->samplers);
+    GLTF_POINTER(g->scenes);
+    GLTF_POINTER(g->skins);
+    GLTF_POINTER(g->textures);
+    GLTF_POINTER(g->dir.cstr);
 
-    char buf[128];
+    for(uint i=0; i < g->animation_count; ++i) {
+        GLTF_POINTER(g->animations[i].targets);
+        GLTF_POINTER(g->animations[i].samplers);
+    }
+    for(uint i=0; i < g->buffer_count; ++i)
+        GLTF_POINTER(g->buffers[i].uri.cstr);
+    for(uint i=0; i < g->image_count; ++i)
+        GLTF_POINTER(g->images[i].uri.cstr);
+    for(uint i=0; i < g->mesh_count; ++i) {
+        GLTF_POINTER(g->meshes[i].primitives);
+        for(uint j=0; j < g->meshes[i].primitive_count; ++j) {
+            GLTF_POINTER(g->meshes[i].primitives[j].attributes);
+            GLTF_POINTER(g->meshes[i].primitives[j].morph_targets);
+            GLTF_POINTER(g->meshes[i].primitives[j].clusters);
+            for(uint k=0; k < g->meshes[i].primitives[j].target_count; ++k)
+                GLTF_POINTER(g->meshes[i].primitives[j].morph_targets[k].attributes);
+        }
+        GLTF_POINTER(g->meshes[i].weights);
+    }
+    for(uint i=0; i < g->node_count; ++i) {
+        GLTF_POINTER(g->nodes[i].children);
+        GLTF_POINTER(g->nodes[i].weights);
+    }
+    for(uint i=0; i < g->scene_count; ++i) {
+        GLTF_POINTER(g->scenes[i].name.cstr);
+        GLTF_POINTER(g->scenes[i].nodes);
+    }
+    for(uint i=0; i < g->skin_count; ++i)
+        GLTF_POINTER(g->skins[i].joints);
+
+    #undef GLTF_POINTER
+}
+
+struct gltf_sol_store {
+    gltf *g;
+    char *file;
+    uint64 meta_offset;
+};
+
+// File offset of an address in the gltf struct or in meta.
+static uint64 gltf_sol_file_offset(struct gltf_sol_store *s, const void *p)
+{
+    const char *c = p;
+    const char *g = (const char*)s->g;
+    const char *meta = s->g->meta.data;
+    if (c >= g && c < g + sizeof(*s->g))
+        return sizeof(gltf_sol_header) + (c - g);
+    assert(c >= meta && c <= meta + s->g->meta.size && "gltf pointer outside of meta");
+    return s->meta_offset + (c - meta);
+}
+
+// Writes the offset form of the pointer at 'ptr' to the same place in the file
+// image, leaving the gltf itself untouched.
+static void gltf_sol_store_pointer(void **ptr, void *arg)
+{
+    struct gltf_sol_store *s = arg;
+    uint64 off = *ptr ? gltf_sol_file_offset(s, *ptr) : 0;
+    memcpy(s->file + gltf_sol_file_offset(s, ptr), &off, sizeof(off));
+}
+
+static void gltf_sol_load_pointer(void **ptr, void *arg)
+{
+    if (*ptr)
+        *ptr = (char*)arg + (uint64)*ptr;
+}
+
+// A .glb is a 12 byte header followed by a JSON chunk and an optional BIN
+// chunk, each of which is a 4 byte aligned length, a type and the data. The
+// container is mapped rather than read, the JSON chunk is parsed where it lies
+// and the BIN chunk is used in place as the data of the buffer without a uri.
+#define GLB_MAGIC 0x46546c67 // "glTF"
+#define GLB_VERSION 2
+#define GLB_CHUNK_JSON 0x4e4f534a
+#define GLB_CHUNK_BIN 0x004e4942
+#define GLB_HEADER_SIZE 12
+#define GLB_CHUNK_HEADER_SIZE 8
+
+// file_extension writes the whole path up to the first '.' to its buffer on
+// the way, so the name is compared in place rather than sizing a buffer.
+static inline bool gltf_is_glb(const char *file_name)
+{
     uint len = strlen(file_name);
-    memcpy(buf, file_name, len);
-    memcpy(buf + len, PROCESSED_GLTF_FILE_EXTENSION, 5);
+    return len > 4 && !memcmp(file_name + len - 4, ".glb", 4);
+}
+
+// Returns false after printing why if the file is not a valid .glb. On success
+// 'glb' is the mapping, which owns the memory of 'json' and 'bin'.
+static bool gltf_map_glb(const char *file_name, struct file *glb, struct file *json, struct file *bin)
+{
+    *glb = file_map_private(file_name);
+    *json = (struct file){};
+    *bin = (struct file){};
+
+    uint32 h[3];
+    if (glb->size < GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE)
+        goto fail;
+    memcpy(h, glb->data, sizeof(h));
+    if (h[0] != GLB_MAGIC || h[1] != GLB_VERSION || h[2] > glb->size)
+        goto fail;
+
+    uint64 pos = GLB_HEADER_SIZE;
+    while(pos + GLB_CHUNK_HEADER_SIZE <= h[2]) {
+        uint32 c[2];
+        memcpy(c, glb->data + pos, sizeof(c));
+        pos += GLB_CHUNK_HEADER_SIZE;
+        if (c[0] > h[2] - pos)
+            goto fail;
+
+        // Unknown chunks must be ignored.
+        if (c[1] == GLB_CHUNK_JSON && !json->data)
+            *json = (struct file){glb->data + pos, c[0]};
+        else if (c[1] == GLB_CHUNK_BIN && !bin->data)
+            *bin = (struct file){glb->data + pos, c[0]};
+        pos += align(c[0], 4);
+    }
+    if (!json->data)
+        goto fail;
+    return true;
+
+fail:
+    println("%s is not a valid glb", file_name);
+    file_unmap(glb);
+    return false;
+}
 
-    char *data = allocate(alloc, sizeof(*model) + model->meta.size);
-    memcpy(data, model, sizeof(*model));
-    memcpy(data + sizeof(*model), model->meta.data, model->meta.size);
+// Hash of the parser version, the .gltf and its external buffers. Images are
+// not included, as they are loaded from their uris rather than cached.
+static uint64 gltf_source_hash(gltf *g, const char *file_name)
+{
+    char uri[256];
+    uint64 hash = file_hash(file_name, GLTF_PARSER_VERSION);
+    for(uint i=0; i < g->buffer_count; ++i) {
+        // The BIN chunk of a .glb is hashed with the file.
+        if (!g->buffers[i].uri.len || g->dir.len + g->buffers[i].uri.len + 1 > sizeof(uri))
+            continue;
+        memcpy(uri, g->dir.cstr, g->dir.len);
+        memcpy(uri + g->dir.len, g->buffers[i].uri.cstr, g->buffers[i].uri.len);
+        uri[g->dir.len + g->buffers[i].uri.len] = '\0';
+        if (file_exists(uri))
+            hash = file_hash(uri, hash);
+    }
+    return hash;
+}
 
-    file_write_bin(buf, sizeof(*model) + model->meta.size, data);
+// Write the .sol image of 'model' to memory from 'alloc', returning its size.
+static uint64 gltf_sol_image(gltf *model, const char *file_name, allocator *alloc, char **ret)
+{
+    gltf_sol_header h = {
+        .magic = GLTF_SOL_MAGIC,
+        .version = GLTF_SOL_VERSION,
+        .endian = GLTF_SOL_ENDIAN,
+        .header_size = sizeof(h) + sizeof(*model),
+        .meta_offset = align(sizeof(h) + sizeof(*model), GLTF_SOL_META_ALIGNMENT),
+        .meta_size = model->meta.size,
+        .source_hash = gltf_source_hash(model, file_name),
+    };
+    h.file_size = h.meta_offset + h.meta_size;
+
+    char *data = allocate(alloc, h.file_size);
+    memset(data, 0, h.meta_offset);
+    memcpy(data + sizeof(h), model, sizeof(*model));
+    memcpy(data + h.meta_offset, model->meta.data, model->meta.size);
+
+    struct gltf_sol_store s = {model, data, h.meta_offset};
+    gltf_for_each_pointer(model, gltf_sol_store_pointer, &s);
+
+    // The BIN chunk is not copied, the .glb is mapped again when loading, and
+    // the .cook is set up by whoever mapped it.
+    memset(data + sizeof(h) + offsetof(gltf, bin), 0, sizeof(model->bin));
+    memset(data + sizeof(h) + offsetof(gltf, cook), 0, sizeof(model->cook));
+
+    h.hash = hash_bytes(h.file_size - sizeof(h), data + sizeof(h));
+    memcpy(data, &h, sizeof(h));
+
+    *ret = data;
+    return h.file_size;
 }
 
-void load_gltf(const char *file_name, struct shader_dir *dir, struct shader_config *conf,
-        allocator *temp, allocator *persistent, gltf *g)
+void store_gltf(gltf *model, const char *file_name, allocator *alloc)
 {
+    assert(strlen(file_name) < 150);
+
     char buf[128];
     uint len = strlen(file_name);
     memcpy(buf, file_name, len);
     memcpy(buf + len, PROCESSED_GLTF_FILE_EXTENSION, 5);
 
-    // @Tidy I dont like statics in functions but I cannot think of a
-    // significantly cleaner way other than passing in some arg.
-    static int gltf_source_changed = -1;
-    static bool gltf_source_changed_msg = false;
+    char *data;
+    uint64 size = gltf_sol_image(model, file_name, alloc, &data);
+    file_write_bin(buf, size, data);
+}
 
-    if (gltf_source_changed == -1)
-        gltf_source_changed = ts_after(file_last_modified("src/gltf.c"), file_last_modified("exe"));
+// The BIN chunk of a glb is not in the .sol image, so it is mapped once the
+// image has been accepted. The mapping lives as long as the model.
+static bool gltf_sol_map_bin(const char *file_name, gltf *g)
+{
+    if (!gltf_is_glb(file_name))
+        return true;
+    struct file glb, json, bin;
+    if (!gltf_map_glb(file_name, &glb, &json, &bin))
+        return false;
+    g->bin.size = bin.size;
+    g->bin.data = bin.data;
+    return true;
+}
 
-    if (gltf_source_changed && !gltf_source_changed_msg) {
-        println("gltf.c has changed, parsing files again...");
-        gltf_source_changed_msg = true;
+// Returns false if the .sol image in 'f' was written by a different version or
+// machine, is corrupt, or if the model's sources have changed since, in which
+// case it should be parsed again. 'f' must stay mapped for the life of 'g'.
+// Nothing is mapped, see gltf_sol_map_bin.
+static bool gltf_sol_load(const char *file_name, const char *sol_name, struct file f, gltf *g)
+{
+    gltf_sol_header h;
+    if (f.size < sizeof(h))
+        return false;
+
+    memcpy(&h, f.data, sizeof(h));
+    if (h.magic != GLTF_SOL_MAGIC || h.version != GLTF_SOL_VERSION || h.endian != GLTF_SOL_ENDIAN ||
+        h.header_size != sizeof(h) + sizeof(*g) || h.file_size != f.size ||
+        h.meta_offset % GLTF_SOL_META_ALIGNMENT || h.meta_offset + h.meta_size != f.size)
+    {
+        println("%s was written by a different version, parsing gltf", sol_name);
+        return false;
+    }
+    if (hash_bytes(f.size - sizeof(h), f.data + sizeof(h)) != h.hash) {
+        println("%s is corrupt, parsing gltf", sol_name);
+        return false;
     }
 
-    if (gltf_source_changed || !file_exists(buf)) {
-        if (!file_exists(buf))
-            println("loading model file %s for the first time, parsing gltf", file_name);
-        parse_gltf(file_name, dir, conf, temp, persistent, g);
-        store_gltf(g, file_name, temp); // to create file_name.gltf.sol
-        return;
+    memcpy(g, f.data + sizeof(h), sizeof(*g));
+    gltf_for_each_pointer(g, gltf_sol_load_pointer, f.data);
+
+    // The buffer uris are only known once the model is mapped.
+    if (gltf_source_hash(g, file_name) != h.source_hash) {
+        println("%s has changed, parsing gltf", file_name);
+        return false;
     }
 
-    // @Optimise I do not love this, as it is uses a potentially unnecessary copy,
-    // but I do not want to store pointers to gltf structures, but the structures
-    // themselves, and I do not want fragmented memory.
-    struct file file = file_read_bin_all(buf, temp);
-    memcpy(g, file.data, sizeof(*g));
-    g->meta.data = allocate(persistent, g->meta.size);
-    memcpy(g->meta.data, file.data + sizeof(*g), g->meta.size);
-
-    char *b = ((gltf*)file.data)->meta.data;
-    char *d = g->meta.data;
-
-    g->accessors = ptrinc_or_null(g->accessors, b, d);
-    g->animations = ptrinc_or_null(g->animations, b, d);
-    g->buffers = ptrinc_or_null(g->buffers, b, d);
-    g->buffer_views = ptrinc_or_null(g->buffer_views, b, d);
-    g->cameras = ptrinc_or_null(g->cameras, b, d);
-    g->images = ptrinc_or_null(g->images, b, d);
-    g->materials = ptrinc_or_null(g->materials, b, d);
-    g->meshes = ptrinc_or_null(g->meshes, b, d);
-    g->nodes = ptrinc_or_null(g->nodes, b, d);
-    g->samplers = ptrinc_or_null(g->samplers, b, d);
-    g->scenes = ptrinc_or_null(g->scenes, b, d);
-    g->skins = ptrinc_or_null(g->skins, b, d);
-    g->textures = ptrinc_or_null(g->textures, b, d);
-    g->dir.cstr = ptrinc_or_null(g->dir.cstr, b, d);
+    for(uint i=0; i < g->mesh_count; ++i)
+        log_print_error_if(g->meshes[i].weight_count > GLTF_MORPH_WEIGHT_COUNT,
+                "meshes[%u].weight_count exceeds GLTF_MORPH_WEIGHT_COUNT", i);
+    return true;
+}
 
-    for(uint i=0; i < g->animation_count; ++i) {
-        g->animations[i].targets  = ptrinc_or_null(g->animations[i].targets, b, d);
-        g->animations[i].samplers = ptrinc_or_null(g->animations[i].samplers, b, d);
+static bool gltf_map_sol(const char *file_name, const char *sol_name, gltf *g)
+{
+    struct file f = file_map_private(sol_name);
+    if (gltf_sol_load(file_name, sol_name, f, g) && gltf_sol_map_bin(file_name, g))
+        return true;
+    file_unmap(&f);
+    return false;
+}
+
+// A .cook is written offline by cook_gltf, and holds everything that loading
+// a model would otherwise read from its files:
+//
+//     gltf_cook_header
+//     .sol image          (sol_offset bytes in, page aligned)
+//     buffers             (buffers_offset bytes in, back to back)
+//     gltf_cook_image     (images_offset bytes in, one per image)
+//     image data          (each 16 byte aligned)
+//
+// The .sol image is loaded as a .sol would be, and so is checked against the
+// model's json and buffers. The images are checked by 'image_hash'.
+#define COOKED_GLTF_FILE_EXTENSION ".cook"
+#define GLTF_COOK_MAGIC 0x4b4c4f53 // "SOLK"
+#define GLTF_COOK_VERSION 5 // 5: mips are filtered in linear space
+
+typedef struct {
+    uint32 magic;
+    uint32 version;
+    uint32 endian;
+    uint32 image_count;
+    uint64 hash;       // of everything after the .sol image
+    uint64 image_hash; // gltf_image_hash
+    uint64 sol_offset;
+    uint64 sol_size;
+    uint64 buffers_offset;
+    uint64 buffers_size;
+    uint64 images_offset;
+    uint64 file_size;
+} gltf_cook_header;
+
+// Hash of the image files which a model references.
+static uint64 gltf_image_hash(gltf *g)
+{
+    char uri[256];
+    uint64 hash = GLTF_COOK_VERSION;
+    for(uint i=0; i < g->image_count; ++i) {
+        if (!g->images[i].uri.cstr || g->dir.len + g->images[i].uri.len + 1 > sizeof(uri))
+            continue;
+        memcpy(uri, g->dir.cstr, g->dir.len);
+        memcpy(uri + g->dir.len, g->images[i].uri.cstr, g->images[i].uri.len + 1);
+        if (file_exists(uri))
+            hash = file_hash(uri, hash);
     }
-    for(uint i=0; i < g->buffer_count; ++i) {
-        g->buffers[i].uri.cstr  = ptrinc_or_null(g->buffers[i].uri.cstr, b, d);
+    return hash;
+}
+
+static bool gltf_map_cook(const char *file_name, const char *cook_name, gltf *g)
+{
+    struct file f = file_map_private(cook_name);
+    gltf_cook_header h;
+    if (f.size < sizeof(h))
+        goto fail;
+
+    memcpy(&h, f.data, sizeof(h));
+    if (h.magic != GLTF_COOK_MAGIC || h.version != GLTF_COOK_VERSION || h.endian != GLTF_SOL_ENDIAN ||
+        h.file_size != f.size || h.sol_offset % GLTF_SOL_META_ALIGNMENT ||
+        h.sol_offset + h.sol_size != h.buffers_offset ||
+        h.buffers_offset + h.buffers_size > h.images_offset ||
+        h.images_offset + sizeof(struct gltf_cook_image) * h.image_count > f.size)
+    {
+        println("%s was written by a different version, loading model files", cook_name);
+        goto fail;
     }
-    for(uint i=0; i < g->image_count; ++i) {
-        g->images[i].uri.cstr  = ptrinc_or_null(g->images[i].uri.cstr, b, d);
+    if (hash_bytes(f.size - h.buffers_offset, f.data + h.buffers_offset) != h.hash) {
+        println("%s is corrupt, loading model files", cook_name);
+        goto fail;
     }
-    for(uint i=0; i < g->mesh_count; ++i) {
-        log_print_error_if(g->meshes[i].weight_count > GLTF_MORPH_WEIGHT_COUNT,
-                "meshes[%u].weight_count exceeds GLTF_MORPH_WEIGHT_COUNT");
+    if (!gltf_sol_load(file_name, cook_name, (struct file){f.data + h.sol_offset, h.sol_size}, g))
+        goto fail;
+    if (g->image_count != h.image_count || gltf_image_hash(g) != h.image_hash) {
+        println("%s has changed, loading model files", file_name);
+        goto fail;
+    }
+    if (!gltf_sol_map_bin(file_name, g))
+        goto fail;
 
-        g->meshes[i].primitives = ptrinc_or_null(g->meshes[i].primitives, b, d);
-        for(uint j=0; j < g->meshes[i].primitive_count; ++j) {
-            g->meshes[i].primitives[j].attributes =
-                ptrinc_or_null(g->meshes[i].primitives[j].attributes, b, d);
-            g->meshes[i].primitives[j].morph_targets =
-                ptrinc_or_null(g->meshes[i].primitives[j].morph_targets, b, d);
-            for(uint k=0; k < g->meshes[i].primitives[j].target_count; ++k)
-                g->meshes[i].primitives[j].morph_targets[k].attributes =
-                    ptrinc_or_null(g->meshes[i].primitives[j].morph_targets[k].attributes, b, d);
-        }
-        g->meshes[i].weights = ptrinc_or_null(g->meshes[i].weights, b, d);
+    g->cook.buffers = f.data + h.buffers_offset;
+    g->cook.images = (struct gltf_cook_image*)(f.data + h.images_offset);
+    g->cook.file = f.data;
+    return true;
+
+fail:
+    file_unmap(&f);
+    return false;
+}
+
+bool cook_gltf(const char *file_name, uint flags, thread_pool *pool, allocator *temp, allocator *persistent)
+{
+    gltf g;
+    if (!parse_gltf(file_name, NULL, NULL, pool, temp, persistent, &g))
+        return false;
+
+    // The buffers are processed before anything is laid out, as quantizing
+    // changes both their lengths and the .sol image.
+    uint64 buffers_size = 0;
+    for(uint i=0; i < g.buffer_count; ++i)
+        buffers_size += g.buffers[i].byte_length;
+    char *buffers = allocate(temp, buffers_size);
+    char **to = sallocate(temp, *to, g.buffer_count);
+    uint64 offset = 0;
+    for(uint i=0; i < g.buffer_count; ++i) {
+        to[i] = buffers + offset;
+        offset += g.buffers[i].byte_length;
     }
-    for(uint i=0; i < g->node_count; ++i) {
-        g->nodes[i].children = ptrinc_or_null(g->nodes[i].children, b, d);
-        g->nodes[i].weights  = ptrinc_or_null(g->nodes[i].weights, b, d);
+    gltf_read_buffers(&g, to, pool, temp);
+    gltf_optimize_meshes(&g, to, temp);
+    gltf_build_clusters(&g, to, persistent, temp);
+    if (flags & GLTF_COOK_QUANTIZE_BIT)
+        gltf_quantize_meshes(&g, to, temp);
+
+    char *sol;
+    gltf_cook_header h = {
+        .magic = GLTF_COOK_MAGIC,
+        .version = GLTF_COOK_VERSION,
+        .endian = GLTF_SOL_ENDIAN,
+        .image_count = g.image_count,
+        .image_hash = gltf_image_hash(&g),
+        .sol_offset = align(sizeof(h), GLTF_SOL_META_ALIGNMENT),
+        .sol_size = gltf_sol_image(&g, file_name, temp, &sol),
+    };
+    h.buffers_offset = h.sol_offset + h.sol_size;
+    for(uint i=0; i < g.buffer_count; ++i)
+        h.buffers_size += g.buffers[i].byte_length;
+    h.images_offset = align(h.buffers_offset + h.buffers_size, 16);
+
+    struct image *images = sallocate(temp, *images, g.image_count);
+    struct gltf_cook_image *cooked = sallocate(temp, *cooked, g.image_count);
+    gltf_load_images(&g, images, pool, temp);
+
+    h.file_size = align(h.images_offset + sizeof(*cooked) * g.image_count, 16);
+    for(uint i=0; i < g.image_count; ++i) {
+        cooked[i] = (struct gltf_cook_image) {
+            .x = images[i].x,
+            .y = images[i].y,
+            .miplevels = images[i].miplevels,
+            .offset = h.file_size,
+            .size = image_mip_chain_size(images[i].x, images[i].y, images[i].miplevels),
+        };
+        h.file_size = align(h.file_size + cooked[i].size, 16);
     }
-    for(uint i=0; i < g->scene_count; ++i) {
-        g->scenes[i].name.cstr = ptrinc_or_null(g->scenes[i].name.cstr, b, d);
-        g->scenes[i].nodes = ptrinc_or_null(g->scenes[i].nodes, b, d);
+
+    char *data = allocate(temp, h.file_size);
+    memset(data, 0, h.file_size);
+    memcpy(data + h.sol_offset, sol, h.sol_size);
+
+    offset = h.buffers_offset;
+    for(uint i=0; i < g.buffer_count; ++i) {
+        memcpy(data + offset, to[i], g.buffers[i].byte_length);
+        offset += g.buffers[i].byte_length;
     }
-    for(uint i=0; i < g->skin_count; ++i) {
-        g->skins[i].joints = ptrinc_or_null(g->skins[i].joints, b, d);
+
+    memcpy(data + h.images_offset, cooked, sizeof(*cooked) * g.image_count);
+    for(uint i=0; i < g.image_count; ++i) {
+        // Every texture is VK_FORMAT_R8G8B8A8_SRGB (see gpu_create_texture).
+        image_generate_mips(&images[i], (uchar*)data + cooked[i].offset, true);
+        free_image(&images[i]);
+    }
+
+    h.hash = hash_bytes(h.file_size - h.buffers_offset, data + h.buffers_offset);
+    memcpy(data, &h, sizeof(h));
+
+    char buf[256];
+    uint len = strlen(file_name);
+    assert(len + sizeof(COOKED_GLTF_FILE_EXTENSION) <= sizeof(buf));
+    memcpy(buf, file_name, len);
+    memcpy(buf + len, COOKED_GLTF_FILE_EXTENSION, sizeof(COOKED_GLTF_FILE_EXTENSION));
+    file_write_bin(buf, h.file_size, data);
+
+    println("cooked %s: %u buffers, %u images, %u bytes", buf, g.buffer_count, g.image_count, h.file_size);
+    return true;
+}
+
+bool load_gltf(const char *file_name, struct shader_dir *dir, struct shader_config *conf,
+        thread_pool *pool, allocator *temp, allocator *persistent, gltf *g)
+{
+    char buf[128];
+    uint len = strlen(file_name);
+    memcpy(buf, file_name, len);
+    memcpy(buf + len, PROCESSED_GLTF_FILE_EXTENSION, 5);
+
+    // The mapping lives as long as the model, as meta does when it comes from
+    // 'persistent'.
+    char cook[128];
+    memcpy(cook, file_name, len);
+    memcpy(cook + len, COOKED_GLTF_FILE_EXTENSION, sizeof(COOKED_GLTF_FILE_EXTENSION));
+    if (file_exists(cook) && gltf_map_cook(file_name, cook, g))
+        return true;
+
+    if (file_exists(buf)) {
+        if (gltf_map_sol(file_name, buf, g))
+            return true;
+    } else {
+        println("loading model file %s for the first time, parsing gltf", file_name);
     }
+
+    // Clusters are only built by the cooker, as they need every buffer in
+    // memory at once, which 'temp' cannot be relied on to hold.
+    if (!parse_gltf(file_name, dir, conf, pool, temp, persistent, g))
+        return false;
+
+    store_gltf(g, file_name, temp); // to create file_name.gltf.sol
+    return true;
 }
 
 #define GLTF_PROPERTY_COUNT 13
@@ -203,49 +609,835 @@ static struct gltf_attr_data gltf_attr_data(gltf *g, uint mesh, uint prim, gltf_
     return r;
 }
 
-static struct gltf_required_size gltf_required_size(json *j, allocator *temp, uint *indices);
-static size_t gltf_required_size_accessors(json *j, uint *index);
-static size_t gltf_required_size_animations(json *j, uint *index, allocator *temp, uint **anim_target_counts);
-static size_t gltf_required_size_buffers(json *j, uint *index);
-static size_t gltf_required_size_buffer_views(json *j, uint *index);
-static size_t gltf_required_size_cameras(json *j, uint *index);
-static size_t gltf_required_size_images(json *j, uint *index);
-static size_t gltf_required_size_materials(json *j, uint *index);
-static size_t gltf_required_size_meshes(json *j, uint *index, struct gltf_required_size *extra_sz);
-static size_t gltf_required_size_nodes(json *j, uint *index);
-static size_t gltf_required_size_samplers(json *j, uint *index);
-static size_t gltf_required_size_scenes(json *j, uint *index);
-static size_t gltf_required_size_skins(json *j, uint *index);
-static size_t gltf_required_size_textures(json *j, uint *index);
-static void gltf_parse_accessors(uint index, json *j, uint extra_attrs, allocator *alloc, gltf *g);
-static void gltf_parse_animations(uint index, json *j, allocator *alloc, uint *anim_target_counts, gltf *g);
-static uint gltf_parse_animation_targets(uint count, json_object *channel_objs, gltf_animation_target *targets);
-static void gltf_parse_animation_samplers(uint count, json_object *sampler_objs, gltf_animation_sampler *samplers);
-static void gltf_parse_buffers(uint index, json *j, allocator *alloc, gltf *g);
-static void gltf_parse_buffer_views(uint index, json *j, bool extra_attrs, allocator *alloc, gltf *g);
-static void gltf_parse_cameras(uint index, json *j, allocator *alloc, gltf *g);
-static void gltf_camera_parse_orthographic(json_object *json_orthographic, gltf_camera_orthographic *orthographic);
-static void gltf_camera_parse_perspective(json_object *json_perspective, gltf_camera_perspective *perspective);
-static void gltf_parse_images(uint index, json *j, allocator *alloc, gltf *g);
-static void gltf_parse_materials(uint index, json *j, allocator *alloc, gltf *g);
-static void gltf_parse_meshes(uint index, json *j, struct gltf_extra_attrs *extra_attrs, uint *extra_attr_count, allocator *alloc, gltf *g);
-static uint gltf_mesh_parse_primitives(json_array *j_prim_array, struct gltf_extra_attrs *extra_attrs, allocator *alloc, gltf_mesh *mesh);
-static uint gltf_mesh_parse_primitive_attributes(json_object *j_attribs, struct gltf_extra_attrs *extra_attrs, gltf_mesh_primitive_attribute *attribs);
-static void gltf_parse_nodes(uint index, json *j, allocator *alloc, gltf *g);
-static void gltf_parse_samplers(uint index, json *j, allocator *alloc, gltf *g);
-static void gltf_parse_scenes(uint index, json *j, allocator *alloc, gltf *g);
-static void gltf_parse_skins(uint index, json *j, allocator *alloc, gltf *g);
-static void gltf_parse_textures(uint index, json *j, allocator *alloc, gltf *g);
-
-void parse_gltf(const char *file_name, struct shader_dir *dir, struct shader_config *conf,
-        allocator *temp, allocator *persistent, gltf *g)
-{
-    struct file f = file_read_char_all(file_name, temp);
+static char* gltf_file_path(gltf *g, const char *uri, uint len, allocator *alloc)
+{
+    char *ret = allocate(alloc, g->dir.len + len + 1);
+    memcpy(ret, g->dir.cstr, g->dir.len);
+    memcpy(ret + g->dir.len, uri, len + 1);
+    return ret;
+}
+
+void gltf_read_buffers(gltf *model, char **to, thread_pool *pool, allocator *temp)
+{
+    struct file_read *reads = sallocate(temp, *reads, model->buffer_count);
+    uint cnt = 0;
+    for(uint i=0; i < model->buffer_count; ++i) {
+        if (!to[i] || model->cook.buffers || !model->buffers[i].uri.len || !model->buffers[i].byte_length)
+            continue;
+        reads[cnt++] = (struct file_read) {
+            .path = gltf_file_path(model, model->buffers[i].uri.cstr, model->buffers[i].uri.len, temp),
+            .size = model->buffers[i].byte_length,
+            .to = to[i],
+        };
+    }
+
+    struct file_read_batch batch;
+    file_read_batch_begin(&batch, cnt, reads, pool);
+
+    // The BIN chunk or the .cook is copied while the external buffers are in
+    // flight.
+    for(uint i=0; i < model->buffer_count; ++i) {
+        if (to[i] && (model->cook.buffers || !model->buffers[i].uri.len))
+            gltf_read_buffer(model, i, to[i]);
+    }
+
+    bool ok = file_read_batch_end(&batch);
+    log_print_error_if(!ok, "failed to read buffers for model in %s", model->dir.cstr);
+}
+
+// The file which image 'i' is read from, or NULL for an image in the BIN chunk
+// or in the .cook. Image files are read whole, images in an external buffer
+// from their view of the buffer's file.
+static char* gltf_image_file(gltf *model, uint i, allocator *alloc, uint64 *offset, uint64 *size)
+{
+    if (model->cook.images)
+        return NULL;
+    if (model->images[i].uri.cstr) {
+        char *path = gltf_file_path(model, model->images[i].uri.cstr, model->images[i].uri.len, alloc);
+        *offset = 0;
+        *size = file_size(path);
+        return path;
+    }
+    gltf_buffer_view *view = &model->buffer_views[model->images[i].buffer_view];
+    gltf_buffer *buf = &model->buffers[view->buffer];
+    if (!buf->uri.len)
+        return NULL;
+    *offset = view->byte_offset;
+    *size = view->byte_length;
+    return gltf_file_path(model, buf->uri.cstr, buf->uri.len, alloc);
+}
+
+void gltf_load_images(gltf *model, struct image *images, thread_pool *pool, allocator *temp)
+{
+    uint64 mark = allocator_used(temp);
+
+    // Files are stat'd to size the destinations before any read is issued.
+    // Max_u32 marks an image which is not read through a batch: one in the BIN
+    // chunk or in the .cook, or one larger than GLTF_IMAGE_BATCH_SIZE.
+    struct file_read *reads = sallocate(temp, *reads, model->image_count);
+    uint *read_i = sallocate(temp, *read_i, model->image_count);
+    uint cnt = 0;
+    uint64 offset, size;
+    for(uint i=0; i < model->image_count; ++i) {
+        char *path = gltf_image_file(model, i, temp, &offset, &size);
+        if (!path || size > GLTF_IMAGE_BATCH_SIZE) {
+            read_i[i] = Max_u32;
+            continue;
+        }
+        reads[cnt] = (struct file_read) {
+            .path = path,
+            .offset = offset,
+            .size = size,
+        };
+        read_i[i] = cnt++;
+    }
+
+    // Each batch's destinations are freed once its images are decoded, so at
+    // most GLTF_IMAGE_BATCH_SIZE bytes are in 'temp' at once.
+    struct file_read_batch batch;
+    uint r0 = 0;
+    uint i = 0;
+    while(i < model->image_count) {
+        uint64 batch_mark = allocator_used(temp);
+        uint64 bytes = 0;
+        uint r1 = r0;
+        for(; r1 < cnt && bytes + reads[r1].size <= GLTF_IMAGE_BATCH_SIZE; ++r1) {
+            reads[r1].to = allocate(temp, reads[r1].size);
+            bytes += reads[r1].size;
+        }
+        file_read_batch_begin(&batch, r1 - r0, reads + r0, pool);
+
+        for(; i < model->image_count && (read_i[i] == Max_u32 || read_i[i] < r1); ++i) {
+            if (read_i[i] != Max_u32) {
+                struct file_read *r = &reads[read_i[i]];
+                bool ok = file_read_wait(&batch, read_i[i] - r0);
+                log_print_error_if(!ok, "failed to read image %s", r->path);
+                images[i] = load_image_memory(r->to, r->size);
+                continue;
+            }
+            char *path = gltf_image_file(model, i, temp, &offset, &size);
+            if (!path) {
+                images[i] = gltf_load_image(model, i);
+                continue;
+            }
+            struct file f = file_map_private(path);
+            if (f.size < offset + size) {
+                log_print_error("image %u is outside of %s", i, path);
+                images[i] = (struct image){};
+            } else {
+                images[i] = load_image_memory((uchar*)f.data + offset, size);
+            }
+            file_unmap(&f);
+        }
+
+        file_read_batch_end(&batch);
+        allocator_reset_linear_to(temp, batch_mark);
+        r0 = r1;
+    }
+
+    allocator_reset_linear_to(temp, mark);
+}
+
+static VkFormat gltf_accessor_flags_to_vkformat(uint flags, uint *byte_stride);
+
+// Where an accessor's elements are, 'size' bytes every 'stride'.
+static char* gltf_accessor_data(gltf *g, uint accessor, char **buffers, uint *stride, uint *size)
+{
+    gltf_accessor *a = &g->accessors[accessor];
+    gltf_buffer_view *v = &g->buffer_views[a->buffer_view];
+    gltf_accessor_flags_to_vkformat(a->flags, size);
+    *stride = v->byte_stride ? v->byte_stride : a->byte_stride;
+    return buffers[v->buffer] + v->byte_offset + a->byte_offset;
+}
+
+struct gltf_accessor_range {
+    uint   buffer;
+    uint   owner; // primitive, in mesh order, or Max_u32 if no primitive uses it
+    uint64 begin;
+    uint64 end;
+};
+
+static int gltf_accessor_range_cmp(const void *a, const void *b)
+{
+    const struct gltf_accessor_range *x = a;
+    const struct gltf_accessor_range *y = b;
+    if (x->buffer != y->buffer)
+        return x->buffer < y->buffer ? -1 : 1;
+    return x->begin < y->begin ? -1 : x->begin > y->begin;
+}
+
+static inline void gltf_push_accessor_range(gltf *g, uint accessor, uint owner,
+                                            struct gltf_accessor_range *ranges, uint *count)
+{
+    gltf_accessor *a = &g->accessors[accessor];
+    if (a->buffer_view == Max_u32 || !a->count)
+        return;
+    gltf_buffer_view *v = &g->buffer_views[a->buffer_view];
+    uint size;
+    gltf_accessor_flags_to_vkformat(a->flags, &size);
+    uint64 begin = v->byte_offset + a->byte_offset;
+    uint64 stride = v->byte_stride ? v->byte_stride : a->byte_stride;
+    ranges[(*count)++] = (struct gltf_accessor_range) {
+        .buffer = v->buffer,
+        .owner = owner,
+        .begin = begin,
+        .end = begin + stride * (a->count - 1) + size,
+    };
+}
+
+// Vertices can only be renumbered if the indices and every attribute, morph
+// targets included, are used by the primitive alone. Exporters commonly pack
+// many primitives' attributes into one buffer view, so this looks at the
+// bytes each accessor covers rather than at views or accessor indices.
+static uint64* gltf_renumberable_primitives(gltf *g, uint prim_count, allocator *temp)
+{
+    uint cap = g->accessor_count;
+    for(uint m=0; m < g->mesh_count; ++m)
+        for(uint p=0; p < g->meshes[m].primitive_count; ++p) {
+            gltf_mesh_primitive *prim = &g->meshes[m].primitives[p];
+            cap += 1 + prim->attribute_count;
+            for(uint t=0; t < prim->target_count; ++t)
+                cap += prim->morph_targets[t].attribute_count;
+        }
+
+    struct gltf_accessor_range *ranges = sallocate(temp, *ranges, cap);
+    uint64 *used = new_bitset(g->accessor_count, temp);
+    uint64 *ret = new_bitset(prim_count, temp);
+    uint count = 0;
+
+    uint pi = 0;
+    for(uint m=0; m < g->mesh_count; ++m)
+        for(uint p=0; p < g->meshes[m].primitive_count; ++p, ++pi) {
+            gltf_mesh_primitive *prim = &g->meshes[m].primitives[p];
+            bool ok = prim->topology == GLTF_MESH_PRIMITIVE_TRIANGLE_LIST && prim->indices != Max_u32;
+
+            if (prim->indices != Max_u32)
+                gltf_push_accessor_range(g, prim->indices, pi, ranges, &count);
+            for(uint i=0; i < prim->attribute_count; ++i)
+                gltf_push_accessor_range(g, prim->attributes[i].accessor, pi, ranges, &count);
+            for(uint t=0; t < prim->target_count; ++t)
+                for(uint i=0; i < prim->morph_targets[t].attribute_count; ++i)
+                    gltf_push_accessor_range(g, prim->morph_targets[t].attributes[i].accessor, pi, ranges, &count);
+
+            for(uint i=0; i < prim->attribute_count; ++i) {
+                gltf_accessor *a = &g->accessors[prim->attributes[i].accessor];
+                ok = ok && a->buffer_view != Max_u32 && !(a->flags & GLTF_ACCESSOR_SPARSE_BIT);
+                bitset_set(used, prim->attributes[i].accessor);
+            }
+            for(uint t=0; t < prim->target_count; ++t)
+                for(uint i=0; i < prim->morph_targets[t].attribute_count; ++i) {
+                    gltf_accessor *a = &g->accessors[prim->morph_targets[t].attributes[i].accessor];
+                    ok = ok && a->buffer_view != Max_u32 && !(a->flags & GLTF_ACCESSOR_SPARSE_BIT);
+                    bitset_set(used, prim->morph_targets[t].attributes[i].accessor);
+                }
+            if (prim->indices != Max_u32)
+                bitset_set(used, prim->indices);
+
+            bitset_set_if(ret, pi, ok);
+        }
+    for(uint i=0; i < g->accessor_count; ++i)
+        if (!bitset_test(used, i))
+            gltf_push_accessor_range(g, i, Max_u32, ranges, &count);
+
+    // Overlapping runs of ranges with more than one owner disqualify their
+    // primitives.
+    qsort(ranges, count, sizeof(*ranges), gltf_accessor_range_cmp);
+    for(uint i=0; i < count;) {
+        uint j = i + 1;
+        uint64 end = ranges[i].end;
+        bool shared = false;
+        for(; j < count && ranges[j].buffer == ranges[i].buffer && ranges[j].begin < end; ++j) {
+            shared |= ranges[j].owner != ranges[i].owner;
+            end = ranges[j].end > end ? ranges[j].end : end;
+        }
+        for(; shared && i < j; ++i)
+            if (ranges[i].owner != Max_u32)
+                bitset_clear(ret, ranges[i].owner);
+        i = j;
+    }
+    return ret;
+}
+
+static void gltf_widen_indices(uint flags, const char *from, uint count, uint *to)
+{
+    if (flags & GLTF_ACCESSOR_COMPONENT_TYPE_UNSIGNED_INT_BIT)
+        memcpy(to, from, sizeof(*to) * count);
+    else if (flags & GLTF_ACCESSOR_COMPONENT_TYPE_UNSIGNED_SHORT_BIT)
+        for(uint i=0; i < count; ++i)
+            to[i] = ((const uint16*)from)[i];
+    else
+        for(uint i=0; i < count; ++i)
+            to[i] = ((const uint8*)from)[i];
+}
+
+static void gltf_narrow_indices(uint flags, const uint *from, uint count, char *to)
+{
+    if (flags & GLTF_ACCESSOR_COMPONENT_TYPE_UNSIGNED_INT_BIT)
+        memcpy(to, from, sizeof(*from) * count);
+    else if (flags & GLTF_ACCESSOR_COMPONENT_TYPE_UNSIGNED_SHORT_BIT)
+        for(uint i=0; i < count; ++i)
+            ((uint16*)to)[i] = from[i];
+    else
+        for(uint i=0; i < count; ++i)
+            ((uint8*)to)[i] = from[i];
+}
+
+void gltf_optimize_meshes(gltf *model, char **buffers, allocator *temp)
+{
+    uint prim_count = 0;
+    for(uint m=0; m < model->mesh_count; ++m)
+        prim_count += model->meshes[m].primitive_count;
+
+    uint64 alloc_pos = allocator_used(temp);
+    uint64 *renumberable = gltf_renumberable_primitives(model, prim_count, temp);
+    uint64 prim_pos = allocator_used(temp);
+
+    uint pi = 0;
+    for(uint m=0; m < model->mesh_count; ++m)
+        for(uint p=0; p < model->meshes[m].primitive_count; ++p, ++pi) {
+            gltf_mesh_primitive *prim = &model->meshes[m].primitives[p];
+            if (prim->topology != GLTF_MESH_PRIMITIVE_TRIANGLE_LIST || prim->indices == Max_u32 ||
+                model->accessors[prim->indices].buffer_view == Max_u32 ||
+                (model->accessors[prim->indices].flags & GLTF_ACCESSOR_SPARSE_BIT))
+                continue;
+
+            uint index_stride, index_size;
+            uint flags = model->accessors[prim->indices].flags;
+            uint ic = model->accessors[prim->indices].count;
+            char *index_data = gltf_accessor_data(model, prim->indices, buffers, &index_stride, &index_size);
+
+            uint pos = prim->attributes[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_POSITION].accessor;
+            uint pos_stride, pos_size;
+            char *positions = gltf_accessor_data(model, pos, buffers, &pos_stride, &pos_size);
+            uint vc = model->accessors[pos].count;
+
+            uint *indices = sallocate(temp, *indices, ic);
+            gltf_widen_indices(flags, index_data, ic, indices);
+
+            #if GLTF_PRINT_MESH_STATS
+            struct mesh_cache_stats before = mesh_cache_stats(ic, indices, vc, temp);
+            float fetch_before = mesh_fetch_stats(ic, indices, vc, pos_size, temp);
+            #endif
+
+            mesh_optimize_vertex_cache(ic, indices, vc, temp);
+            if ((model->accessors[pos].flags & (GLTF_ACCESSOR_COMPONENT_TYPE_BITS | GLTF_ACCESSOR_TYPE_BITS)) ==
+                (GLTF_ACCESSOR_COMPONENT_TYPE_FLOAT_BIT | GLTF_ACCESSOR_TYPE_VEC3_BIT))
+                mesh_optimize_overdraw(ic, indices, vc, pos_stride, (float*)positions, MESH_OVERDRAW_THRESHOLD, temp);
+
+            if (bitset_test(renumberable, pi)) {
+                uint *remap = sallocate(temp, *remap, vc);
+                mesh_optimize_vertex_fetch(ic, indices, vc, remap);
+
+                // An accessor listed twice must only be moved once.
+                uint64 *moved = new_bitset(model->accessor_count, temp);
+                uint stride, size;
+                for(uint i=0; i < prim->attribute_count; ++i) {
+                    uint a = prim->attributes[i].accessor;
+                    if (bitset_test(moved, a))
+                        continue;
+                    bitset_set(moved, a);
+                    char *data = gltf_accessor_data(model, a, buffers, &stride, &size);
+                    mesh_remap_vertices(vc, remap, stride, size, data, temp);
+                }
+                for(uint t=0; t < prim->target_count; ++t)
+                    for(uint i=0; i < prim->morph_targets[t].attribute_count; ++i) {
+                        uint a = prim->morph_targets[t].attributes[i].accessor;
+                        if (bitset_test(moved, a))
+                            continue;
+                        bitset_set(moved, a);
+                        char *data = gltf_accessor_data(model, a, buffers, &stride, &size);
+                        mesh_remap_vertices(vc, remap, stride, size, data, temp);
+                    }
+            }
+            gltf_narrow_indices(flags, indices, ic, index_data);
+
+            #if GLTF_PRINT_MESH_STATS
+            struct mesh_cache_stats after = mesh_cache_stats(ic, indices, vc, temp);
+            float fetch_after = mesh_fetch_stats(ic, indices, vc, pos_size, temp);
+            println("mesh %u primitive %u: %u triangles, acmr %f -> %f, atvr %f -> %f, position overfetch %f -> %f%s",
+                    m, p, ic / 3, before.acmr, after.acmr, before.atvr, after.atvr, fetch_before, fetch_after,
+                    bitset_test(renumberable, pi) ? "" : " (vertices shared, not renumbered)");
+            #endif
+
+            allocator_reset_linear_to(temp, prim_pos);
+        }
+    allocator_reset_linear_to(temp, alloc_pos);
+}
+
+struct gltf_rebase {
+    char   *from;
+    uint64  size;
+    char   *to;
+};
+
+static void gltf_rebase_pointer(void **ptr, void *arg)
+{
+    struct gltf_rebase *r = arg;
+    char *p = *ptr;
+    if (p >= r->from && p <= r->from + r->size)
+        *ptr = r->to + (p - r->from);
+}
+
+// Make room for 'size' more bytes at the end of meta, moving it and every
+// pointer into it. Returns the new bytes, 16 byte aligned.
+static void* gltf_grow_meta(gltf *g, uint size, allocator *alloc)
+{
+    uint64 offset = align(g->meta.size, 16);
+    char *from = g->meta.data;
+    char *to = allocate(alloc, offset + size);
+    memcpy(to, from, g->meta.size);
+
+    struct gltf_rebase r = {from, g->meta.size, to};
+    gltf_for_each_pointer(g, gltf_rebase_pointer, &r);
+    deallocate(alloc, from);
+
+    g->meta.size = offset + size;
+    return to + offset;
+}
+
+void gltf_build_clusters(gltf *model, char **buffers, allocator *persistent, allocator *temp)
+{
+    uint64 alloc_pos = allocator_used(temp);
+
+    uint prim_count = 0;
+    uint bound = 0;
+    for(uint m=0; m < model->mesh_count; ++m)
+        for(uint p=0; p < model->meshes[m].primitive_count; ++p) {
+            gltf_mesh_primitive *prim = &model->meshes[m].primitives[p];
+            uint pos = prim->attributes[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_POSITION].accessor;
+            bound += mesh_cluster_bound(prim->indices != Max_u32 ? model->accessors[prim->indices].count :
+                                                                   model->accessors[pos].count);
+            prim_count++;
+        }
+    struct mesh_cluster *clusters = sallocate(temp, *clusters, bound);
+    uint *counts = sallocate(temp, *counts, prim_count);
+    uint64 prim_pos = allocator_used(temp);
+
+    uint total = 0;
+    uint pi = 0;
+    for(uint m=0; m < model->mesh_count; ++m)
+        for(uint p=0; p < model->meshes[m].primitive_count; ++p, ++pi) {
+            gltf_mesh_primitive *prim = &model->meshes[m].primitives[p];
+            uint pos = prim->attributes[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_POSITION].accessor;
+            gltf_accessor *a = &model->accessors[pos];
+            counts[pi] = 0;
+            if (prim->topology != GLTF_MESH_PRIMITIVE_TRIANGLE_LIST || a->buffer_view == Max_u32 ||
+                (a->flags & (GLTF_ACCESSOR_COMPONENT_TYPE_BITS | GLTF_ACCESSOR_TYPE_BITS | GLTF_ACCESSOR_SPARSE_BIT)) !=
+                (GLTF_ACCESSOR_COMPONENT_TYPE_FLOAT_BIT | GLTF_ACCESSOR_TYPE_VEC3_BIT))
+                continue;
+            if (prim->indices != Max_u32 && (model->accessors[prim->indices].buffer_view == Max_u32 ||
+                                             (model->accessors[prim->indices].flags & GLTF_ACCESSOR_SPARSE_BIT)))
+                continue;
+
+            uint pos_stride, pos_size;
+            char *positions = gltf_accessor_data(model, pos, buffers, &pos_stride, &pos_size);
+
+            uint ic = a->count;
+            uint *indices;
+            if (prim->indices != Max_u32) {
+                uint index_stride, index_size;
+                char *index_data = gltf_accessor_data(model, prim->indices, buffers, &index_stride, &index_size);
+                ic = model->accessors[prim->indices].count;
+                indices = sallocate(temp, *indices, ic);
+                gltf_widen_indices(model->accessors[prim->indices].flags, index_data, ic, indices);
+            } else {
+                indices = sallocate(temp, *indices, ic);
+                for(uint i=0; i < ic; ++i)
+                    indices[i] = i;
+            }
+            counts[pi] = mesh_build_clusters(ic, indices, a->count, pos_stride, (float*)positions,
+                                             clusters + total, temp);
+            total += counts[pi];
+            allocator_reset_linear_to(temp, prim_pos);
+        }
+
+    struct mesh_cluster *to = total ? gltf_grow_meta(model, sizeof(*to) * total, persistent) : NULL;
+    pi = 0;
+    for(uint m=0; m < model->mesh_count; ++m)
+        for(uint p=0; p < model->meshes[m].primitive_count; ++p, ++pi) {
+            gltf_mesh_primitive *prim = &model->meshes[m].primitives[p];
+            prim->cluster_count = counts[pi];
+            prim->clusters = counts[pi] ? to : NULL;
+            memcpy(to, clusters, sizeof(*to) * counts[pi]);
+            to += counts[pi];
+            clusters += counts[pi];
+        }
+    allocator_reset_linear_to(temp, alloc_pos);
+}
+
+// What gltf_quantize_meshes may store an accessor as. An accessor which is
+// read as more than one thing, or by anything else, is left alone.
+enum {
+    GLTF_QUANTIZE_UNUSED,
+    GLTF_QUANTIZE_POSITION,
+    GLTF_QUANTIZE_NORMAL,
+    GLTF_QUANTIZE_TANGENT,
+    GLTF_QUANTIZE_TEXCOORD,
+    GLTF_QUANTIZE_WEIGHTS,
+    GLTF_QUANTIZE_SKIP,
+};
+
+static inline void gltf_quantize_role(uint8 *roles, uint accessor, uint role)
+{
+    roles[accessor] = roles[accessor] == GLTF_QUANTIZE_UNUSED || roles[accessor] == role ? role : GLTF_QUANTIZE_SKIP;
+}
+
+static inline uint gltf_quantize_attribute_role(gltf_mesh_primitive_attribute_type type)
+{
+    switch(type) {
+    case GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_POSITION:
+        return GLTF_QUANTIZE_POSITION;
+    case GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_NORMAL:
+        return GLTF_QUANTIZE_NORMAL;
+    case GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_TANGENT:
+        return GLTF_QUANTIZE_TANGENT;
+    case GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_TEXCOORD:
+        return GLTF_QUANTIZE_TEXCOORD;
+    case GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_WEIGHTS:
+        return GLTF_QUANTIZE_WEIGHTS;
+    default:
+        return GLTF_QUANTIZE_SKIP;
+    }
+}
+
+static int gltf_view_offset_cmp(const void *a, const void *b)
+{
+    const gltf_buffer_view *x = a;
+    const gltf_buffer_view *y = b;
+    if (x->buffer != y->buffer)
+        return x->buffer < y->buffer ? -1 : 1;
+    return x->byte_offset < y->byte_offset ? -1 : x->byte_offset > y->byte_offset;
+}
+
+// Views sorted by buffer and then offset, and for each buffer whether any of
+// its views overlap, in which case their bytes cannot be moved or rewritten.
+static uint* gltf_sorted_views(gltf *g, uint64 *overlapping, allocator *temp)
+{
+    gltf_buffer_view *views = sallocate(temp, *views, g->buffer_view_count);
+    uint *ret = sallocate(temp, *ret, g->buffer_view_count);
+    for(uint i=0; i < g->buffer_view_count; ++i) {
+        views[i] = g->buffer_views[i];
+        views[i].flags = i; // index
+    }
+    qsort(views, g->buffer_view_count, sizeof(*views), gltf_view_offset_cmp);
+    for(uint i=0; i < g->buffer_view_count; ++i) {
+        ret[i] = views[i].flags;
+        if (i && views[i].buffer == views[i-1].buffer &&
+            views[i].byte_offset < views[i-1].byte_offset + views[i-1].byte_length)
+            bitset_set(overlapping, views[i].buffer);
+    }
+    return ret;
+}
+
+// Quantize into 'q', trying 8 bits before 16 where 'try_8' is set. Returns the
+// accessor flags to store it with, or zero if neither is within 'budget'.
+static uint gltf_quantize_norm(uint count, uint stride, const float *data, uint in_count, uint out_count,
+                               bool is_signed, bool try_8, float budget, void *q)
+{
+    static const float zero[4] = {};
+    uint type = out_count == 2 ? GLTF_ACCESSOR_TYPE_VEC2_BIT : GLTF_ACCESSOR_TYPE_VEC4_BIT;
+    for(uint bits = try_8 ? 8 : 16; bits <= 16; bits += 8) {
+        float err = is_signed ?
+            mesh_quantize_snorm(count, stride, data, in_count, out_count, bits, q) :
+            mesh_quantize_unorm(count, stride, data, in_count, out_count, bits, zero, 1, q);
+        if (err > budget)
+            continue;
+        if (bits == 8)
+            return type | (is_signed ? GLTF_ACCESSOR_COMPONENT_TYPE_BYTE_BIT : GLTF_ACCESSOR_COMPONENT_TYPE_UNSIGNED_BYTE_BIT);
+        return type | (is_signed ? GLTF_ACCESSOR_COMPONENT_TYPE_SHORT_BIT : GLTF_ACCESSOR_COMPONENT_TYPE_UNSIGNED_SHORT_BIT);
+    }
+    return 0;
+}
+
+// Replace an accessor's elements with 'q', packed back to back at the start
+// of its view, which it has to itself.
+static void gltf_store_quantized(gltf *g, uint accessor, uint flags, const void *q, char **buffers)
+{
+    gltf_accessor *a = &g->accessors[accessor];
+    gltf_buffer_view *v = &g->buffer_views[a->buffer_view];
+    a->flags = (a->flags & ~(GLTF_ACCESSOR_COMPONENT_TYPE_BITS | GLTF_ACCESSOR_TYPE_BITS)) |
+               flags | GLTF_ACCESSOR_NORMALIZED_BIT;
+    a->vkformat = gltf_accessor_flags_to_vkformat(a->flags, &a->byte_stride);
+    memcpy(buffers[v->buffer] + v->byte_offset + a->byte_offset, q, (uint64)a->byte_stride * a->count);
+    v->byte_length = a->byte_offset + (uint64)a->byte_stride * a->count;
+    v->byte_stride = v->byte_stride ? a->byte_stride : 0;
+}
+
+void gltf_quantize_meshes(gltf *model, char **buffers, allocator *temp)
+{
+    uint64 alloc_pos = allocator_used(temp);
+
+    // Quantized data is written over the start of the floats, so a view must
+    // hold nothing but the one accessor.
+    uint64 *overlapping = new_bitset(model->buffer_count, temp);
+    uint *sorted = gltf_sorted_views(model, overlapping, temp);
+    uint *view_users = sallocate(temp, *view_users, model->buffer_view_count);
+    memset(view_users, 0, sizeof(*view_users) * model->buffer_view_count);
+    for(uint i=0; i < model->accessor_count; ++i) {
+        gltf_accessor *a = &model->accessors[i];
+        if (a->buffer_view != Max_u32)
+            view_users[a->buffer_view]++;
+        if (a->flags & GLTF_ACCESSOR_SPARSE_BIT) {
+            view_users[a->sparse.indices.buffer_view] += 2;
+            view_users[a->sparse.values.buffer_view] += 2;
+        }
+    }
+    for(uint i=0; i < model->image_count; ++i)
+        if (!model->images[i].uri.cstr)
+            view_users[model->images[i].buffer_view] += 2;
+
+    uint8 *roles = sallocate(temp, *roles, model->accessor_count);
+    uint *position_mesh = sallocate(temp, *position_mesh, model->accessor_count);
+    memset(roles, GLTF_QUANTIZE_UNUSED, sizeof(*roles) * model->accessor_count);
+    memset(position_mesh, 0xff, sizeof(*position_mesh) * model->accessor_count);
+
+    for(uint i=0; i < model->animation_count; ++i)
+        for(uint j=0; j < model->animations[i].sampler_count; ++j) {
+            gltf_quantize_role(roles, model->animations[i].samplers[j].input, GLTF_QUANTIZE_SKIP);
+            gltf_quantize_role(roles, model->animations[i].samplers[j].output, GLTF_QUANTIZE_SKIP);
+        }
+    for(uint i=0; i < model->skin_count; ++i)
+        if (model->skins[i].inverse_bind_matrices != Max_u32)
+            gltf_quantize_role(roles, model->skins[i].inverse_bind_matrices, GLTF_QUANTIZE_SKIP);
+
+    for(uint m=0; m < model->mesh_count; ++m)
+        for(uint p=0; p < model->meshes[m].primitive_count; ++p) {
+            gltf_mesh_primitive *prim = &model->meshes[m].primitives[p];
+            if (prim->indices != Max_u32)
+                gltf_quantize_role(roles, prim->indices, GLTF_QUANTIZE_SKIP);
+
+            // Morph targets are added to the attributes as floats.
+            for(uint t=0; t < prim->target_count; ++t)
+                for(uint i=0; i < prim->morph_targets[t].attribute_count; ++i)
+                    gltf_quantize_role(roles, prim->morph_targets[t].attributes[i].accessor, GLTF_QUANTIZE_SKIP);
+
+            for(uint i=0; i < prim->attribute_count; ++i) {
+                uint a = prim->attributes[i].accessor;
+                uint role = prim->target_count ? GLTF_QUANTIZE_SKIP : gltf_quantize_attribute_role(prim->attributes[i].type);
+                if (role == GLTF_QUANTIZE_POSITION) {
+                    role = position_mesh[a] == Max_u32 || position_mesh[a] == m ? role : GLTF_QUANTIZE_SKIP;
+                    position_mesh[a] = m;
+                }
+                gltf_quantize_role(roles, a, role);
+            }
+        }
+
+    // The types which each role is quantized from.
+    const uint role_flags[] = {
+        [GLTF_QUANTIZE_POSITION] = GLTF_ACCESSOR_COMPONENT_TYPE_FLOAT_BIT | GLTF_ACCESSOR_TYPE_VEC3_BIT,
+        [GLTF_QUANTIZE_NORMAL]   = GLTF_ACCESSOR_COMPONENT_TYPE_FLOAT_BIT | GLTF_ACCESSOR_TYPE_VEC3_BIT,
+        [GLTF_QUANTIZE_TANGENT]  = GLTF_ACCESSOR_COMPONENT_TYPE_FLOAT_BIT | GLTF_ACCESSOR_TYPE_VEC4_BIT,
+        [GLTF_QUANTIZE_TEXCOORD] = GLTF_ACCESSOR_COMPONENT_TYPE_FLOAT_BIT | GLTF_ACCESSOR_TYPE_VEC2_BIT,
+        [GLTF_QUANTIZE_WEIGHTS]  = GLTF_ACCESSOR_COMPONENT_TYPE_FLOAT_BIT | GLTF_ACCESSOR_TYPE_VEC4_BIT,
+    };
+    for(uint i=0; i < model->accessor_count; ++i) {
+        gltf_accessor *a = &model->accessors[i];
+        if (roles[i] == GLTF_QUANTIZE_UNUSED || roles[i] == GLTF_QUANTIZE_SKIP)
+            continue;
+        if (a->buffer_view == Max_u32 || view_users[a->buffer_view] != 1 || !a->count ||
+            bitset_test(overlapping, model->buffer_views[a->buffer_view].buffer) ||
+            (a->flags & (GLTF_ACCESSOR_COMPONENT_TYPE_BITS | GLTF_ACCESSOR_TYPE_BITS |
+                         GLTF_ACCESSOR_NORMALIZED_BIT | GLTF_ACCESSOR_SPARSE_BIT)) != role_flags[roles[i]])
+            roles[i] = GLTF_QUANTIZE_SKIP;
+    }
+
+    #if GLTF_PRINT_MESH_STATS
+    uint64 before = 0;
+    for(uint i=0; i < model->buffer_count; ++i)
+        before += model->buffers[i].byte_length;
+    #endif
+    uint quantized = 0;
+
+    // Positions share their mesh's bounds, and a uniform scale, so that one
+    // transform maps them all back without bending the normals.
+    for(uint m=0; m < model->mesh_count; ++m) {
+        gltf_mesh *mesh = &model->meshes[m];
+        bool ok = !mesh->joint_count;
+        float min[3] = {Max_f32, Max_f32, Max_f32};
+        float max[3] = {-Max_f32, -Max_f32, -Max_f32};
+        for(uint p=0; p < mesh->primitive_count; ++p) {
+            gltf_mesh_primitive *prim = &mesh->primitives[p];
+            uint a = prim->attributes[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_POSITION].accessor;
+            for(uint i=0; i < prim->attribute_count; ++i)
+                ok = ok && prim->attributes[i].type != GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_JOINTS;
+            ok = ok && roles[a] == GLTF_QUANTIZE_POSITION;
+            if (!ok)
+                break;
+
+            uint stride, size;
+            float lo[3], hi[3];
+            char *data = gltf_accessor_data(model, a, buffers, &stride, &size);
+            mesh_position_bounds(model->accessors[a].count, stride, (float*)data, lo, hi);
+            for(uint c=0; c < 3; ++c) {
+                min[c] = lo[c] < min[c] ? lo[c] : min[c];
+                max[c] = hi[c] > max[c] ? hi[c] : max[c];
+            }
+        }
+        float scale = 0;
+        for(uint c=0; c < 3; ++c)
+            scale = max[c] - min[c] > scale ? max[c] - min[c] : scale;
+        if (!ok || scale == 0)
+            continue;
+
+        uint p;
+        uint64 prim_pos = allocator_used(temp);
+        uint16 **q = sallocate(temp, *q, mesh->primitive_count);
+        for(p=0; p < mesh->primitive_count; ++p) {
+            uint a = mesh->primitives[p].attributes[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_POSITION].accessor;
+            uint stride, size;
+            char *data = gltf_accessor_data(model, a, buffers, &stride, &size);
+            q[p] = sallocate(temp, **q, model->accessors[a].count * 4);
+            if (mesh_quantize_unorm(model->accessors[a].count, stride, (float*)data, 3, 4, 16,
+                                    min, scale, q[p]) > GLTF_QUANTIZE_POSITION_ERROR)
+                break;
+        }
+        // An accessor listed by more than one primitive must only be stored
+        // once, as the second store would quantize the first.
+        for(uint i=0; p == mesh->primitive_count && i < mesh->primitive_count; ++i) {
+            uint a = mesh->primitives[i].attributes[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_POSITION].accessor;
+            if (roles[a] != GLTF_QUANTIZE_POSITION)
+                continue;
+            gltf_store_quantized(model, a, GLTF_ACCESSOR_COMPONENT_TYPE_UNSIGNED_SHORT_BIT | GLTF_ACCESSOR_TYPE_VEC4_BIT,
+                                 q[i], buffers);
+            roles[a] = GLTF_QUANTIZE_SKIP;
+            quantized++;
+        }
+        if (p == mesh->primitive_count) {
+            mesh->position_scale = scale;
+            memcpy(mesh->position_offset, min, sizeof(min));
+        }
+        allocator_reset_linear_to(temp, prim_pos);
+    }
+
+    for(uint i=0; i < model->accessor_count; ++i) {
+        gltf_accessor *a = &model->accessors[i];
+        if (roles[i] == GLTF_QUANTIZE_UNUSED || roles[i] == GLTF_QUANTIZE_SKIP || roles[i] == GLTF_QUANTIZE_POSITION)
+            continue;
+
+        uint stride, size;
+        float *data = (float*)gltf_accessor_data(model, i, buffers, &stride, &size);
+        uint64 acc_pos = allocator_used(temp);
+        void *q = allocate(temp, (uint64)a->count * 8);
+        uint flags = 0;
+        switch(roles[i]) {
+        case GLTF_QUANTIZE_NORMAL:
+            flags = gltf_quantize_norm(a->count, stride, data, 3, 4, true, true, GLTF_QUANTIZE_NORMAL_ERROR, q);
+            break;
+        case GLTF_QUANTIZE_TANGENT:
+            flags = gltf_quantize_norm(a->count, stride, data, 4, 4, true, true, GLTF_QUANTIZE_NORMAL_ERROR, q);
+            break;
+        case GLTF_QUANTIZE_TEXCOORD:
+            flags = gltf_quantize_norm(a->count, stride, data, 2, 2, false, false, GLTF_QUANTIZE_TEXCOORD_ERROR, q);
+            break;
+        case GLTF_QUANTIZE_WEIGHTS:
+            flags = gltf_quantize_norm(a->count, stride, data, 4, 4, false, true, GLTF_QUANTIZE_WEIGHT_ERROR, q);
+            break;
+        default:
+            break;
+        }
+        if (flags) {
+            gltf_store_quantized(model, i, flags, q, buffers);
+            quantized++;
+        }
+        allocator_reset_linear_to(temp, acc_pos);
+    }
+
+    // Pack the views down, leaving buffers with overlapping views as they
+    // are. Each view keeps its offset modulo 16, and so whatever alignment
+    // it had, and never moves up over a view which has yet to move.
+    for(uint i=0; i < model->buffer_view_count;) {
+        uint b = model->buffer_views[sorted[i]].buffer;
+        uint64 end = 0;
+        for(; i < model->buffer_view_count && model->buffer_views[sorted[i]].buffer == b; ++i) {
+            gltf_buffer_view *v = &model->buffer_views[sorted[i]];
+            if (bitset_test(overlapping, b))
+                continue;
+            end += (v->byte_offset - end) & 15;
+            memmove(buffers[b] + end, buffers[b] + v->byte_offset, v->byte_length);
+            v->byte_offset = end;
+            end += v->byte_length;
+        }
+        if (!bitset_test(overlapping, b))
+            model->buffers[b].byte_length = end;
+    }
+
+    #if GLTF_PRINT_MESH_STATS
+    uint64 after = 0;
+    for(uint i=0; i < model->buffer_count; ++i)
+        after += model->buffers[i].byte_length;
+    println("quantized %u accessors, buffers %u -> %u bytes", quantized, before, after);
+    #endif
+
+    allocator_reset_linear_to(temp, alloc_pos);
+}
+
+static struct gltf_required_size gltf_required_size(json_cursor root, allocator *temp, json_cursor *props);
+static size_t gltf_required_size_accessors(json_cursor root, json_cursor *prop);
+static size_t gltf_required_size_animations(json_cursor root, json_cursor *prop, allocator *temp, uint **anim_target_counts);
+static size_t gltf_required_size_buffers(json_cursor root, json_cursor *prop);
+static size_t gltf_required_size_buffer_views(json_cursor root, json_cursor *prop);
+static size_t gltf_required_size_cameras(json_cursor root, json_cursor *prop);
+static size_t gltf_required_size_images(json_cursor root, json_cursor *prop);
+static size_t gltf_required_size_materials(json_cursor root, json_cursor *prop);
+static size_t gltf_required_size_meshes(json_cursor root, json_cursor *prop, struct gltf_required_size *extra_sz);
+static size_t gltf_required_size_nodes(json_cursor root, json_cursor *prop);
+static size_t gltf_required_size_samplers(json_cursor root, json_cursor *prop);
+static size_t gltf_required_size_scenes(json_cursor root, json_cursor *prop);
+static size_t gltf_required_size_skins(json_cursor root, json_cursor *prop);
+static size_t gltf_required_size_textures(json_cursor root, json_cursor *prop);
+static void gltf_parse_accessors(json_cursor j_accessors, uint extra_attrs, allocator *alloc, gltf *g);
+static void gltf_parse_animations(json_cursor j_animations, allocator *alloc, allocator *temp, uint *anim_target_counts, gltf *g);
+static uint gltf_parse_animation_targets(json_cursor j_channels, allocator *temp, gltf_animation_target *targets);
+static void gltf_parse_animation_samplers(json_cursor j_samplers, gltf_animation_sampler *samplers);
+static void gltf_parse_buffers(json_cursor j_buffers, const char *extra_buffer_uri, allocator *alloc, gltf *g);
+static void gltf_parse_buffer_views(json_cursor j_buffer_views, bool extra_attrs, allocator *alloc, gltf *g);
+static void gltf_parse_cameras(json_cursor j_cameras, allocator *alloc, gltf *g);
+static void gltf_camera_parse_orthographic(json_cursor json_camera, gltf_camera_orthographic *orthographic);
+static void gltf_camera_parse_perspective(json_cursor json_camera, gltf_camera_perspective *perspective);
+static void gltf_parse_images(json_cursor j_images, allocator *alloc, gltf *g);
+static void gltf_parse_materials(json_cursor j_materials, allocator *alloc, gltf *g);
+static void gltf_parse_meshes(json_cursor j_meshes, struct gltf_extra_attrs *extra_attrs, uint *extra_attr_count, allocator *alloc, gltf *g);
+static uint gltf_mesh_parse_primitives(json_cursor j_prims, struct gltf_extra_attrs *extra_attrs, allocator *alloc, gltf_mesh *mesh);
+static uint gltf_mesh_parse_primitive_attributes(json_cursor j_attribs, struct gltf_extra_attrs *extra_attrs, gltf_mesh_primitive_attribute *attribs);
+static void gltf_parse_nodes(json_cursor j_nodes, allocator *alloc, gltf *g);
+static void gltf_parse_samplers(json_cursor j_samplers, allocator *alloc, gltf *g);
+static void gltf_parse_scenes(json_cursor root, json_cursor j_scenes, allocator *alloc, gltf *g);
+static void gltf_parse_skins(json_cursor j_skins, allocator *alloc, gltf *g);
+static void gltf_parse_textures(json_cursor j_textures, allocator *alloc, gltf *g);
+
+bool parse_gltf(const char *file_name, struct shader_dir *dir, struct shader_config *conf,
+        thread_pool *pool, allocator *temp, allocator *persistent, gltf *g)
+{
+    bool is_glb = gltf_is_glb(file_name);
+    struct file f, glb, bin = {};
+    if (is_glb) {
+        if (!gltf_map_glb(file_name, &glb, &f, &bin))
+            return false;
+    } else {
+        f = file_read_char_all(file_name, temp);
+    }
+
+    // Reject a corrupt file before anything is allocated for it.
+    json_error err = json_validate(f.data, f.size);
+    if (err.msg) {
+        println("%s:%u:%u: invalid json, %s", file_name, err.line, err.column, err.msg);
+        if (is_glb)
+            file_unmap(&glb);
+        return false;
+    }
+
     struct allocation json_allocation;
-    json j = parse_json(&f, temp, &json_allocation);
+    json_tape tape = parse_json_tape_parallel(&f, pool, temp, &json_allocation);
+    json_cursor root = json_tape_root(&tape);
+    if (json_cursor_type(root) != JSON_TYPE_OBJECT) {
+        println("%s: the top level json value is not an object", file_name);
+        if (is_glb)
+            file_unmap(&glb);
+        return false;
+    }
 
-    uint indices[GLTF_PROPERTY_COUNT];
-    struct gltf_required_size req_size = gltf_required_size(&j, temp, indices);
+    json_cursor props[GLTF_PROPERTY_COUNT];
+    struct gltf_required_size req_size = gltf_required_size(root, temp, props);
 
     // Ik this may allocate more than necessary because each gltf_extra_attrs
     // stores both normal and tangent info. I allocate +1 still to ensure that
@@ -254,6 +1446,19 @@ void parse_gltf(const char *file_name, struct shader_dir *dir, struct shader_con
     struct gltf_extra_attrs *extra_attrs = sallocate(temp, *extra_attrs, req_size.extra_mesh_attrs + 1);
     memset(extra_attrs, 0, sizeof(*extra_attrs) * req_size.extra_mesh_attrs);
 
+    // Generated attributes cannot be appended to the BIN chunk of a .glb, so
+    // they get a buffer of their own next to it.
+    char extra_buffer_uri[GLTF_MAX_URI_LEN];
+    bool extra_buffer = is_glb && req_size.extra_mesh_attrs;
+    if (extra_buffer) {
+        uint dir_len = file_dir_name(file_name, extra_buffer_uri);
+        uint len = strlen(file_name) - dir_len;
+        assert(len + sizeof(".attrs") <= GLTF_MAX_URI_LEN);
+        memcpy(extra_buffer_uri, file_name + dir_len, len);
+        memcpy(extra_buffer_uri + len, ".attrs", sizeof(".attrs"));
+        req_size.size += align(sizeof(gltf_buffer), ALLOCATOR_ALIGNMENT) + GLTF_MAX_URI_LEN;
+    }
+
     req_size.size = align(req_size.size, getpagesize());
     g->meta.size = req_size.size;
     g->meta.data = allocate(persistent, g->meta.size);
@@ -263,34 +1468,39 @@ void parse_gltf(const char *file_name, struct shader_dir *dir, struct shader_con
     g->dir.cstr = allocate(&gltf_alloc, strlen(file_name));
     g->dir.len = file_dir_name(file_name, (char*)g->dir.cstr);
 
+    // The mapping is never unmapped, it lives as long as the model.
+    g->bin.size = bin.size;
+    g->bin.data = bin.data;
+    memset(&g->cook, 0, sizeof(g->cook));
+
     // counts the number of primitives which require extra attributes, not the
     // total number of new attributes.
     uint eac = 0;
 
-    gltf_parse_accessors(indices[GLTF_PROPERTY_INDEX_ACCESSORS], &j, req_size.extra_mesh_attrs, &gltf_alloc, g);
-    gltf_parse_animations(indices[GLTF_PROPERTY_INDEX_ANIMATIONS], &j, &gltf_alloc, req_size.anim_target_counts, g);
-    gltf_parse_buffers(indices[GLTF_PROPERTY_INDEX_BUFFERS], &j, &gltf_alloc, g);
-    gltf_parse_buffer_views(indices[GLTF_PROPERTY_INDEX_BUFFER_VIEWS], &j, req_size.extra_mesh_attrs > 0, &gltf_alloc, g);
-    gltf_parse_cameras(indices[GLTF_PROPERTY_INDEX_CAMERAS], &j, &gltf_alloc, g);
-    gltf_parse_images(indices[GLTF_PROPERTY_INDEX_IMAGES], &j, &gltf_alloc, g);
-    gltf_parse_materials(indices[GLTF_PROPERTY_INDEX_MATERIALS], &j, &gltf_alloc, g);
-    gltf_parse_meshes(indices[GLTF_PROPERTY_INDEX_MESHES], &j, extra_attrs, &eac, &gltf_alloc, g);
-    gltf_parse_samplers(indices[GLTF_PROPERTY_INDEX_SAMPLERS], &j, &gltf_alloc, g);
-    gltf_parse_scenes(indices[GLTF_PROPERTY_INDEX_SCENES], &j, &gltf_alloc, g);
-    gltf_parse_skins(indices[GLTF_PROPERTY_INDEX_SKINS], &j, &gltf_alloc, g);
-    gltf_parse_textures(indices[GLTF_PROPERTY_INDEX_TEXTURES], &j, &gltf_alloc, g);
+    gltf_parse_accessors(props[GLTF_PROPERTY_INDEX_ACCESSORS], req_size.extra_mesh_attrs, &gltf_alloc, g);
+    gltf_parse_animations(props[GLTF_PROPERTY_INDEX_ANIMATIONS], &gltf_alloc, temp, req_size.anim_target_counts, g);
+    gltf_parse_buffers(props[GLTF_PROPERTY_INDEX_BUFFERS], extra_buffer ? extra_buffer_uri : NULL, &gltf_alloc, g);
+    gltf_parse_buffer_views(props[GLTF_PROPERTY_INDEX_BUFFER_VIEWS], req_size.extra_mesh_attrs > 0, &gltf_alloc, g);
+    gltf_parse_cameras(props[GLTF_PROPERTY_INDEX_CAMERAS], &gltf_alloc, g);
+    gltf_parse_images(props[GLTF_PROPERTY_INDEX_IMAGES], &gltf_alloc, g);
+    gltf_parse_materials(props[GLTF_PROPERTY_INDEX_MATERIALS], &gltf_alloc, g);
+    gltf_parse_meshes(props[GLTF_PROPERTY_INDEX_MESHES], extra_attrs, &eac, &gltf_alloc, g);
+    gltf_parse_samplers(props[GLTF_PROPERTY_INDEX_SAMPLERS], &gltf_alloc, g);
+    gltf_parse_scenes(root, props[GLTF_PROPERTY_INDEX_SCENES], &gltf_alloc, g);
+    gltf_parse_skins(props[GLTF_PROPERTY_INDEX_SKINS], &gltf_alloc, g);
+    gltf_parse_textures(props[GLTF_PROPERTY_INDEX_TEXTURES], &gltf_alloc, g);
 
     // must happen after skins and meshes, as mesh.joint_count is filled in here.
-    gltf_parse_nodes(indices[GLTF_PROPERTY_INDEX_NODES], &j, &gltf_alloc, g);
+    gltf_parse_nodes(props[GLTF_PROPERTY_INDEX_NODES], &gltf_alloc, g);
 
 #if !TEST // test.gltf uses a bogus file which would not make sense to run this on.
-    assert(g->mesh_count < 32);
-    uint instance_counts[32] = {};
-    uint64 skin_mask;
+    uint *instance_counts = sallocate(temp, *instance_counts, g->mesh_count);
+    uint64 *skin_mask = new_bitset(g->skin_count, temp);
+    smemset(instance_counts, 0, *instance_counts, g->mesh_count);
     for(uint i=0; i < g->scene_count; ++i)
         for(uint j=0; j < g->scenes[i].node_count; ++j)
             gltf_count_mesh_instances(g->nodes, g->scenes[i].nodes[j],
-                                      instance_counts, &skin_mask);
+                                      instance_counts, skin_mask);
     for(uint i=0; i < g->mesh_count; ++i) {
         g->meshes[i].max_instance_count = instance_counts[i];
         log_print_error_if(instance_counts[i] > SHADER_MAX_MESH_INSTANCE_COUNT,
@@ -299,7 +1509,7 @@ void parse_gltf(const char *file_name, struct shader_dir *dir, struct shader_con
 #endif
 
     if (!eac)
-        return;
+        return true;
 
     uint bv = g->buffer_view_count;
     uint ac = g->accessor_count;
@@ -312,7 +1522,7 @@ void parse_gltf(const char *file_name, struct shader_dir *dir, struct shader_con
         // GPU does large gathers anyway, idk what kind of performance impact
         // this would really have.
         g->buffer_views[bv].flags = GLTF_BUFFER_VIEW_VERTEX_BUFFER_BIT;
-        g->buffer_views[bv].buffer = 0; // @Note Idk if there is a better idea.
+        g->buffer_views[bv].buffer = extra_buffer ? g->buffer_count - 1 : 0; // @Note Idk if there is a better idea.
         g->buffer_views[bv].byte_stride = 0;
         g->buffer_views[bv].byte_offset =
             align(g->buffers[g->buffer_views[bv].buffer].byte_length, 16);
@@ -341,8 +1551,14 @@ void parse_gltf(const char *file_name, struct shader_dir *dir, struct shader_con
 
         tn_data = (vector*)(bufs[0] + tn_ofs);
 
-        for(uint i=0; i < g->buffer_count; ++i)
-            gltf_read_buffer(g, i, bufs[i]);
+        // The BIN chunk is used where it is mapped. The extra buffer is
+        // empty, and may not exist yet, so it is skipped by its length.
+        char *to[carrlen(bufs)];
+        for(uint i=0; i < g->buffer_count; ++i) {
+            to[i] = g->buffers[i].uri.len ? bufs[i] : NULL;
+            bufs[i] = to[i] ? bufs[i] : g->bin.data;
+        }
+        gltf_read_buffers(g, to, pool, temp);
     }
 
     uint bc = 0;
@@ -350,13 +1566,16 @@ void parse_gltf(const char *file_name, struct shader_dir *dir, struct shader_con
         uint m = extra_attrs[i].mesh;
         uint p = extra_attrs[i].prim;
 
-        // @Unimplemented @Todo
-        log_print_error_if(g->meshes[m].primitives[p].indices == Max_u32,
-                "@Unimplemented I do not have non-indexed tang/norm attribute generation functions yet lol");
-
-        struct gltf_index_data index = gltf_index_data(g, m, p);
         struct gltf_attr_data vert = gltf_attr_data(g, m, p, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_POSITION);
 
+        struct triangle_indices tris = {.count = vert.count, .size = 4};
+        if (g->meshes[m].primitives[p].indices != Max_u32) {
+            struct gltf_index_data index = gltf_index_data(g, m, p);
+            tris.count = index.count;
+            tris.size = index.type_u16 ? 2 : 4;
+            tris.data = bufs[index.buffer] + index.offset;
+        }
+
         if (extra_attrs[i].norm) {
             g->accessors[ac].flags = GLTF_ACCESSOR_COMPONENT_TYPE_FLOAT_BIT|GLTF_ACCESSOR_TYPE_VEC3_BIT;
             g->accessors[ac].vkformat = VK_FORMAT_R32G32B32_SFLOAT;
@@ -368,12 +1587,9 @@ void parse_gltf(const char *file_name, struct shader_dir *dir, struct shader_con
 
             vector *normals = tn_data + (bc>>4);
 
-            if (index.type_u16)
-                calc_vertex_normals16(index.count, (uint16*)(bufs[index.buffer] + index.offset),
-                                      vert.count, vert.stride, (float*)(bufs[vert.buffer] + vert.offset), normals);
-            else
-                calc_vertex_normals(index.count, (uint*)(bufs[index.buffer] + index.offset),
-                                    vert.count, vert.stride, (float*)(bufs[vert.buffer] + vert.offset), normals);
+            if (!calc_vertex_normals(&tris, vert.count, vert.stride, (float*)(bufs[vert.buffer] + vert.offset),
+                                     pool, temp, normals))
+                memset(normals, 0, sizeof(*normals) * vert.count);
 
             g->meshes[m].primitives[p].attribute_count++;
             g->meshes[m].primitives[p].attributes[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_NORMAL].accessor = ac;
@@ -394,18 +1610,12 @@ void parse_gltf(const char *file_name, struct shader_dir *dir, struct shader_con
 
             vector *tangents = tn_data + (bc>>4);
 
-            if (index.type_u16)
-                calc_vertex_tangents16(index.count, (uint16*)(bufs[index.buffer] + index.offset),
-                                      vert.count, vert.stride, (float*)(bufs[vert.buffer] + vert.offset),
-                                      norm.stride == 4, norm.stride, (float*)(bufs[norm.buffer] + norm.offset),
-                                      texcoord.stride, (float*)(bufs[texcoord.buffer] + texcoord.offset),
-                                      temp, tangents);
-            else
-                calc_vertex_tangents(index.count, (uint*)(bufs[index.buffer] + index.offset),
-                                      vert.count, vert.stride, (float*)(bufs[vert.buffer] + vert.offset),
-                                      norm.stride == 4, norm.stride, (float*)(bufs[norm.buffer] + norm.offset),
+            // glTF specifies MikkTSpace tangents where they are missing.
+            if (!calc_vertex_tangents(&tris, vert.count, vert.stride, (float*)(bufs[vert.buffer] + vert.offset),
+                                      norm.stride, (float*)(bufs[norm.buffer] + norm.offset),
                                       texcoord.stride, (float*)(bufs[texcoord.buffer] + texcoord.offset),
-                                      temp, tangents);
+                                      CALC_TANGENTS_MIKKTSPACE_BIT, pool, temp, tangents))
+                memset(tangents, 0, sizeof(*tangents) * vert.count);
 
             g->meshes[m].primitives[p].attribute_count++;
             g->meshes[m].primitives[p].attributes[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_TANGENT].accessor = ac;
@@ -423,25 +1633,38 @@ void parse_gltf(const char *file_name, struct shader_dir *dir, struct shader_con
     file_close(fd);
 
     allocator_reset_linear_to(temp, alloc_pos);
+    return true;
+}
+
+// The elem count of an array which may be undefined.
+static inline uint gltf_array_len(json_cursor arr)
+{
+    return json_cursor_valid(arr) ? json_cursor_len(arr) : 0;
+}
+
+// The value of a number which may be undefined, else 'def'.
+static inline double gltf_num_or(json_cursor num, double def)
+{
+    return json_cursor_valid(num) ? json_cursor_num(num) : def;
 }
 
-static struct gltf_required_size gltf_required_size(json *j, allocator *temp, uint *indices)
+static struct gltf_required_size gltf_required_size(json_cursor root, allocator *temp, json_cursor *props)
 {
     struct gltf_required_size ret = {};
 
-    ret.size += gltf_required_size_accessors(j, &indices[GLTF_PROPERTY_INDEX_ACCESSORS]);
-    ret.size += gltf_required_size_animations(j, &indices[GLTF_PROPERTY_INDEX_ANIMATIONS], temp, &ret.anim_target_counts);
-    ret.size += gltf_required_size_buffers(j, &indices[GLTF_PROPERTY_INDEX_BUFFERS]);
-    ret.size += gltf_required_size_buffer_views(j, &indices[GLTF_PROPERTY_INDEX_BUFFER_VIEWS]);
-    ret.size += gltf_required_size_cameras(j, &indices[GLTF_PROPERTY_INDEX_CAMERAS]);
-    ret.size += gltf_required_size_images(j, &indices[GLTF_PROPERTY_INDEX_IMAGES]);
-    ret.size += gltf_required_size_materials(j, &indices[GLTF_PROPERTY_INDEX_MATERIALS]);
-    ret.size += gltf_required_size_meshes(j, &indices[GLTF_PROPERTY_INDEX_MESHES], &ret);
-    ret.size += gltf_required_size_nodes(j, &indices[GLTF_PROPERTY_INDEX_NODES]);
-    ret.size += gltf_required_size_samplers(j, &indices[GLTF_PROPERTY_INDEX_SAMPLERS]);
-    ret.size += gltf_required_size_scenes(j, &indices[GLTF_PROPERTY_INDEX_SCENES]);
-    ret.size += gltf_required_size_skins(j, &indices[GLTF_PROPERTY_INDEX_SKINS]);
-    ret.size += gltf_required_size_textures(j, &indices[GLTF_PROPERTY_INDEX_TEXTURES]);
+    ret.size += gltf_required_size_accessors(root, &props[GLTF_PROPERTY_INDEX_ACCESSORS]);
+    ret.size += gltf_required_size_animations(root, &props[GLTF_PROPERTY_INDEX_ANIMATIONS], temp, &ret.anim_target_counts);
+    ret.size += gltf_required_size_buffers(root, &props[GLTF_PROPERTY_INDEX_BUFFERS]);
+    ret.size += gltf_required_size_buffer_views(root, &props[GLTF_PROPERTY_INDEX_BUFFER_VIEWS]);
+    ret.size += gltf_required_size_cameras(root, &props[GLTF_PROPERTY_INDEX_CAMERAS]);
+    ret.size += gltf_required_size_images(root, &props[GLTF_PROPERTY_INDEX_IMAGES]);
+    ret.size += gltf_required_size_materials(root, &props[GLTF_PROPERTY_INDEX_MATERIALS]);
+    ret.size += gltf_required_size_meshes(root, &props[GLTF_PROPERTY_INDEX_MESHES], &ret);
+    ret.size += gltf_required_size_nodes(root, &props[GLTF_PROPERTY_INDEX_NODES]);
+    ret.size += gltf_required_size_samplers(root, &props[GLTF_PROPERTY_INDEX_SAMPLERS]);
+    ret.size += gltf_required_size_scenes(root, &props[GLTF_PROPERTY_INDEX_SCENES]);
+    ret.size += gltf_required_size_skins(root, &props[GLTF_PROPERTY_INDEX_SKINS]);
+    ret.size += gltf_required_size_textures(root, &props[GLTF_PROPERTY_INDEX_TEXTURES]);
 
     ret.size += sizeof(gltf_accessor)                 *  ret.extra_mesh_attrs +
                 sizeof(gltf_mesh_primitive_attribute) *  ret.extra_mesh_attrs +
@@ -450,51 +1673,55 @@ static struct gltf_required_size gltf_required_size(json *j, allocator *temp, ui
     return ret;
 }
 
-static size_t gltf_required_size_accessors(json *j, uint *index)
+static size_t gltf_required_size_accessors(json_cursor root, json_cursor *prop)
 {
-    uint tmp = json_find_key(&j->obj, "accessors");
-    uint ki = tmp & max64_if_true(tmp != Max_u32);
-    uint cnt = j->obj.values[ki].arr.len & max64_if_true(tmp != Max_u32);
-    *index = tmp;
+    *prop = json_cursor_find_key_lit(root, "accessors");
+    uint cnt = gltf_array_len(*prop);
     return cnt * align(sizeof(gltf_accessor), ALLOCATOR_ALIGNMENT);
 }
 
-static size_t gltf_required_size_animations(json *j, uint *index, allocator *temp, uint **anim_target_counts)
+static size_t gltf_required_size_animations(json_cursor root, json_cursor *prop, allocator *temp, uint **anim_target_counts)
 {
-    uint tmp = json_find_key(&j->obj, "animations");
-    uint ki = tmp & max64_if_true(tmp != Max_u32);
-    json_object *animations = j->obj.values[ki].arr.objs;
-    uint cnt = j->obj.values[ki].arr.len & max64_if_true(tmp != Max_u32);
+    uint node_cnt = gltf_array_len(json_cursor_find_key_lit(root, "nodes"));
+    uint64 *node_mask = new_bitset(node_cnt, temp);
+
+    *prop = json_cursor_find_key_lit(root, "animations");
+    uint cnt = gltf_array_len(*prop);
 
     uint *target_counts = sallocate(temp, *target_counts, cnt);
 
-    *index = tmp;
+    json_cursor animation, channels, channel, target, c;
     uint target_cnt = 0;
     uint sampler_cnt = 0;
     uint channel_cnt;
     for(uint i = 0; i < cnt; ++i) {
-        ki = json_find_key(&animations[i], "channels");
-        log_print_error_if(ki == Max_u32, "animations.channels must be defined");
-        channel_cnt = animations[i].values[ki].arr.len;
+        animation = i ? json_cursor_next(animation) : json_cursor_child(*prop);
 
-        uint64 node_mask[GLTF_U64_NODE_MASK] = {};
-        uint64 one = 1;
-        for(uint j=0; j < channel_cnt; ++j) {
-            tmp = json_find_key(&animations[i].values[ki].arr.objs[j], "target");
-            log_print_error_if(tmp == Max_u32, "animation.channel.target must be defined");
-            uint node = json_find_key(&animations[i].values[ki].arr.objs[j].values[tmp].obj, "node");
-            log_print_error_if(tmp == Max_u32, "animation.channel.target.node must be defined, this parser does not support this extension");
+        channels = json_cursor_find_key_lit(animation, "channels");
+        log_print_error_if(!json_cursor_valid(channels), "animations.channels must be defined");
+        channel_cnt = json_cursor_len(channels);
 
-            node = (uint)animations[i].values[ki].arr.objs[j].values[tmp].obj.values[node].num;
-            node_mask[node>>6] |= one << (node & 63);
+        for(uint j=0; j < channel_cnt; ++j) {
+            channel = j ? json_cursor_next(channel) : json_cursor_child(channels);
+            target = json_cursor_find_key_lit(channel, "target");
+            log_print_error_if(!json_cursor_valid(target), "animation.channel.target must be defined");
+            c = json_cursor_find_key_lit(target, "node");
+            log_print_error_if(!json_cursor_valid(c), "animation.channel.target.node must be defined, this parser does not support this extension");
+
+            uint node = (uint)json_cursor_num(c);
+            // Targets outside of the nodes array are not deduplicated, which
+            // can only over count, this is just for sizing the allocation.
+            bool in_range = node < node_cnt;
+            target_cnt += !in_range;
+            bitset_set_if(node_mask, node & maxif(in_range), in_range);
         }
-        for(uint j=0; j < c_array_len(node_mask); ++j)
-            target_cnt += popcnt(node_mask[j]);
+        target_cnt += bitset_count(node_mask, node_cnt);
+        bitset_zero(node_mask, node_cnt);
         target_counts[i] = target_cnt;
 
-        ki = json_find_key(&animations[i], "samplers");
-        log_print_error_if(ki == Max_u32, "animations.samplers must be defined");
-        sampler_cnt += animations[i].values[ki].arr.len;
+        c = json_cursor_find_key_lit(animation, "samplers");
+        log_print_error_if(!json_cursor_valid(c), "animations.samplers must be defined");
+        sampler_cnt += json_cursor_len(c);
     }
     *anim_target_counts = target_counts;
     size_t ret = 0;
@@ -504,61 +1731,47 @@ static size_t gltf_required_size_animations(json *j, uint *index, allocator *tem
     return ret;
 }
 
-static size_t gltf_required_size_buffers(json *j, uint *index)
+static size_t gltf_required_size_buffers(json_cursor root, json_cursor *prop)
 {
-    uint tmp = json_find_key(&j->obj, "buffers");
-    uint ki = tmp & max64_if_true(tmp != Max_u32);
-    uint cnt = j->obj.values[ki].arr.len & max64_if_true(tmp != Max_u32);
-    *index = tmp;
+    *prop = json_cursor_find_key_lit(root, "buffers");
+    uint cnt = gltf_array_len(*prop);
     return cnt * align(sizeof(gltf_buffer), ALLOCATOR_ALIGNMENT) + GLTF_MAX_URI_LEN * cnt;
 }
 
-static size_t gltf_required_size_buffer_views(json *j, uint *index)
+static size_t gltf_required_size_buffer_views(json_cursor root, json_cursor *prop)
 {
-    uint tmp = json_find_key(&j->obj, "bufferViews");
-    uint ki = tmp & max64_if_true(tmp != Max_u32);
-    uint cnt = j->obj.values[ki].arr.len & max64_if_true(tmp != Max_u32);
-    *index = tmp;
+    *prop = json_cursor_find_key_lit(root, "bufferViews");
+    uint cnt = gltf_array_len(*prop);
     return cnt * align(sizeof(gltf_buffer_view), ALLOCATOR_ALIGNMENT);
 }
 
-static size_t gltf_required_size_cameras(json *j, uint *index)
+static size_t gltf_required_size_cameras(json_cursor root, json_cursor *prop)
 {
-    uint tmp = json_find_key(&j->obj, "cameras");
-    uint ki = tmp & max64_if_true(tmp != Max_u32);
-    uint cnt = j->obj.values[ki].arr.len & max64_if_true(tmp != Max_u32);
-    *index = tmp;
+    *prop = json_cursor_find_key_lit(root, "cameras");
+    uint cnt = gltf_array_len(*prop);
     return cnt * align(sizeof(gltf_camera), ALLOCATOR_ALIGNMENT);
 }
 
-static size_t gltf_required_size_images(json *j, uint *index)
+static size_t gltf_required_size_images(json_cursor root, json_cursor *prop)
 {
-    uint tmp = json_find_key(&j->obj, "images");
-    uint ki = tmp & max64_if_true(tmp != Max_u32);
-    uint cnt = j->obj.values[ki].arr.len & max64_if_true(tmp != Max_u32);
-    *index = tmp;
+    *prop = json_cursor_find_key_lit(root, "images");
+    uint cnt = gltf_array_len(*prop);
     return cnt * align(sizeof(gltf_image), ALLOCATOR_ALIGNMENT) + cnt * GLTF_MAX_URI_LEN;
 }
 
-static size_t gltf_required_size_materials(json *j, uint *index)
+static size_t gltf_required_size_materials(json_cursor root, json_cursor *prop)
 {
-    uint tmp = json_find_key(&j->obj, "materials");
-    uint ki = tmp & max64_if_true(tmp != Max_u32);
-    uint cnt = j->obj.values[ki].arr.len & max64_if_true(tmp != Max_u32);
-    *index = tmp;
+    *prop = json_cursor_find_key_lit(root, "materials");
+    uint cnt = gltf_array_len(*prop);
     return cnt * align(sizeof(gltf_material), ALLOCATOR_ALIGNMENT);
 }
 
-static size_t gltf_required_size_meshes(json *j, uint *index, struct gltf_required_size *extra_info)
+static size_t gltf_required_size_meshes(json_cursor root, json_cursor *prop, struct gltf_required_size *extra_info)
 {
-    uint tmp = json_find_key(&j->obj, "meshes");
-    uint ki = tmp & max64_if_true(tmp != Max_u32);
-    uint cnt = j->obj.values[ki].arr.len & max64_if_true(tmp != Max_u32);
-    *index = tmp;
+    *prop = json_cursor_find_key_lit(root, "meshes");
+    uint cnt = gltf_array_len(*prop);
 
-    json_object *j_meshes = j->obj.values[ki].arr.objs;
-    json_object *j_prims;
-    json_object *j_targets;
+    json_cursor j_mesh, j_prims, j_prim, j_attribs, j_targets, j_target;
     uint weight_cnt;
     uint prim_cnt = 0;
     uint attrib_cnt = 0;
@@ -570,32 +1783,31 @@ static size_t gltf_required_size_meshes(json *j, uint *index, struct gltf_requir
 
     uint i0,i1,i2;
     for(i0=0;i0<cnt;++i0) {
-        ki = json_find_key(&j_meshes[i0],"primitives");
-        log_print_error_if(ki == Max_u32,"mesh.primitives must be defined");
-        j_prims = j_meshes[i0].values[ki].arr.objs;
-        prim_cnt = j_meshes[i0].values[ki].arr.len;
+        j_mesh = i0 ? json_cursor_next(j_mesh) : json_cursor_child(*prop);
+        j_prims = json_cursor_find_key_lit(j_mesh, "primitives");
+        log_print_error_if(!json_cursor_valid(j_prims),"mesh.primitives must be defined");
+        prim_cnt = json_cursor_len(j_prims);
         total_prim_cnt += prim_cnt;
         for(i1=0;i1<prim_cnt;++i1) {
-            ki = json_find_key(&j_prims[i1],"attributes");
-            log_print_error_if(ki == Max_u32,"mesh.primitives.attributes must be defined");
-            attrib_cnt = j_prims[i1].values[ki].obj.key_count;
+            j_prim = i1 ? json_cursor_next(j_prim) : json_cursor_child(j_prims);
+            j_attribs = json_cursor_find_key_lit(j_prim, "attributes");
+            log_print_error_if(!json_cursor_valid(j_attribs),"mesh.primitives.attributes must be defined");
+            attrib_cnt = json_cursor_len(j_attribs);
             total_attrib_cnt += attrib_cnt;
 
-            extra_info->extra_mesh_attrs += json_find_key(&j_prims[i1].values[ki].obj,"TANGENT") == Max_u32;
-            extra_info->extra_mesh_attrs += json_find_key(&j_prims[i1].values[ki].obj,"NORMAL") == Max_u32;
+            extra_info->extra_mesh_attrs += !json_cursor_valid(json_cursor_find_key_lit(j_attribs, "TANGENT"));
+            extra_info->extra_mesh_attrs += !json_cursor_valid(json_cursor_find_key_lit(j_attribs, "NORMAL"));
 
-            tmp = json_find_key(&j_prims[i1],"targets");
-            ki = tmp & max32_if_true(tmp != Max_u32);
-            j_targets = j_prims[i1].values[ki].arr.objs;
-            target_cnt = j_prims[i1].values[ki].arr.len & max32_if_true(tmp != Max_u32);
+            j_targets = json_cursor_find_key_lit(j_prim, "targets");
+            target_cnt = gltf_array_len(j_targets);
             total_target_cnt += target_cnt;
-            for(i2=0;i2<target_cnt;++i2)
-                total_attrib_cnt += j_targets[i2].key_count;
+            for(i2=0;i2<target_cnt;++i2) {
+                j_target = i2 ? json_cursor_next(j_target) : json_cursor_child(j_targets);
+                total_attrib_cnt += json_cursor_len(j_target);
+            }
         }
 
-        tmp = json_find_key(&j_meshes[i0],"weights");
-        ki = tmp & max32_if_true(tmp != Max_u32);
-        weight_cnt = j_meshes[i0].values[ki].arr.len & max32_if_true(tmp != Max_u32);
+        weight_cnt = gltf_array_len(json_cursor_find_key_lit(j_mesh, "weights"));
         weights_size += alloc_align(sizeof(float) * weight_cnt); // I do not want to align each float.
     }
 
@@ -608,79 +1820,66 @@ static size_t gltf_required_size_meshes(json *j, uint *index, struct gltf_requir
         weights_size;
 }
 
-static size_t gltf_required_size_nodes(json *j, uint *index)
+static size_t gltf_required_size_nodes(json_cursor root, json_cursor *prop)
 {
-    uint tmp = json_find_key(&j->obj, "nodes");
-    uint ki = tmp & max64_if_true(tmp != Max_u32);
-    uint cnt = j->obj.values[ki].arr.len & max64_if_true(tmp != Max_u32);
-    *index = tmp;
+    *prop = json_cursor_find_key_lit(root, "nodes");
+    uint cnt = gltf_array_len(*prop);
 
-    json_object *nodes = j->obj.values[ki].arr.objs;
+    json_cursor node;
     uint csz = 0;
     uint wsz = 0;
     uint i;
     for(i = 0; i < cnt; ++i) {
-        ki = json_find_key(&nodes[i], "children");
-        csz += ki != Max_u32 ? alloc_align(sizeof(uint) * nodes[i].values[ki].arr.len) : 0;
-        ki = json_find_key(&nodes[i], "weights");
-        wsz += ki != Max_u32 ? alloc_align(sizeof(uint) * nodes[i].values[ki].arr.len) : 0;
+        node = i ? json_cursor_next(node) : json_cursor_child(*prop);
+        csz += alloc_align(sizeof(uint) * gltf_array_len(json_cursor_find_key_lit(node, "children")));
+        wsz += alloc_align(sizeof(uint) * gltf_array_len(json_cursor_find_key_lit(node, "weights")));
     }
     return cnt * align(sizeof(gltf_node), ALLOCATOR_ALIGNMENT) + csz + wsz;
 }
 
-static size_t gltf_required_size_samplers(json *j, uint *index)
+static size_t gltf_required_size_samplers(json_cursor root, json_cursor *prop)
 {
-    uint tmp = json_find_key(&j->obj, "samplers");
-    uint ki = tmp & max64_if_true(tmp != Max_u32);
-    uint cnt = j->obj.values[ki].arr.len & max64_if_true(tmp != Max_u32);
-    *index = tmp;
+    *prop = json_cursor_find_key_lit(root, "samplers");
+    uint cnt = gltf_array_len(*prop);
     return cnt * align(sizeof(gltf_sampler), ALLOCATOR_ALIGNMENT);
 }
 
-static size_t gltf_required_size_scenes(json *j, uint *index)
+static size_t gltf_required_size_scenes(json_cursor root, json_cursor *prop)
 {
-    uint tmp = json_find_key(&j->obj, "scenes");
-    uint ki = tmp & max64_if_true(tmp != Max_u32);
-    uint cnt = j->obj.values[ki].arr.len & max64_if_true(tmp != Max_u32);
-    *index = tmp;
+    *prop = json_cursor_find_key_lit(root, "scenes");
+    uint cnt = gltf_array_len(*prop);
 
-    json_object *scenes = j->obj.values[ki].arr.objs;
+    json_cursor scene;
     uint sz = 0;
     uint i;
     for(i=0;i<cnt;++i) {
-        ki = json_find_key(&scenes[i], "nodes");
-        tmp = ki != Max_u32 ? scenes[i].values[ki].arr.len : 0;
-        sz += alloc_align(sizeof(uint) * tmp);
-
-        ki = json_find_key(&scenes[i], "name");
-        sz += GLTF_MAX_URI_LEN & max32_if_true(ki != Max_u32);
+        scene = i ? json_cursor_next(scene) : json_cursor_child(*prop);
+        sz += alloc_align(sizeof(uint) * gltf_array_len(json_cursor_find_key_lit(scene, "nodes")));
+        sz += GLTF_MAX_URI_LEN & max32_if_true(json_cursor_valid(json_cursor_find_key_lit(scene, "name")));
     }
     return cnt * align(sizeof(gltf_sampler), ALLOCATOR_ALIGNMENT) + sz;
 }
 
-static size_t gltf_required_size_skins(json *j, uint *index)
+static size_t gltf_required_size_skins(json_cursor root, json_cursor *prop)
 {
-    uint tmp = json_find_key(&j->obj, "skins");
-    uint ki = tmp & max64_if_true(tmp != Max_u32);
-    uint cnt = j->obj.values[ki].arr.len & max64_if_true(tmp != Max_u32);
-    *index = tmp;
+    *prop = json_cursor_find_key_lit(root, "skins");
+    uint cnt = gltf_array_len(*prop);
 
-    json_object *skins = j->obj.values[ki].arr.objs;
+    json_cursor skin, joints;
     uint sz = 0;
     uint i;
     for(i=0;i<cnt;++i) {
-        ki = json_find_key(&skins[i], "joints");
-        log_print_error_if(ki == Max_u32, "skin.joints must be defined");
-        sz += alloc_align(sizeof(uint) * skins[i].values[ki].arr.len);
+        skin = i ? json_cursor_next(skin) : json_cursor_child(*prop);
+        joints = json_cursor_find_key_lit(skin, "joints");
+        log_print_error_if(!json_cursor_valid(joints), "skin.joints must be defined");
+        sz += alloc_align(sizeof(uint) * json_cursor_len(joints));
     }
     return cnt * sizeof(gltf_skin) + sz;
 }
-static size_t gltf_required_size_textures(json *j, uint *index)
+static size_t gltf_required_size_textures(json_cursor root, json_cursor *prop)
 {
-    uint tmp = json_find_key(&j->obj, "textures");
-    uint ki = tmp & max64_if_true(tmp != Max_u32);
-    uint cnt = j->obj.values[ki].arr.len & max64_if_true(tmp != Max_u32);
-    *index = tmp;
+    *prop = json_cursor_find_key_lit(root, "textures");
+    uint cnt = gltf_array_len(*prop);
     return alloc_align(cnt * sizeof(gltf_texture));
 }
 
@@ -884,98 +2083,81 @@ static VkFormat gltf_accessor_flags_to_vkformat(uint flags, uint *byte_stride)
     }
 }
 
-static void gltf_parse_accessors(uint index, json *j, uint extra_attrs, allocator *alloc, gltf *g)
+static void gltf_parse_accessors(json_cursor j_accessors, uint extra_attrs, allocator *alloc, gltf *g)
 {
-    uint tmp = index;
-    tmp = max64_if_false(tmp == Max_u32);
-    index &= tmp;
-    json_array *json_accessor_array = &j->obj.values[index].arr;
-    json_object *accessor_obj, *sparse_obj, *tmp_obj;
-
-    uint cnt = json_accessor_array->len & tmp;
+    uint cnt = gltf_array_len(j_accessors);
     g->accessor_count = cnt;
     g->accessors = sallocate(alloc, *g->accessors, cnt + extra_attrs);
     gltf_accessor *accessor;
-    uint i, ki, tmp_cnt;
+    json_cursor accessor_obj, sparse_obj, tmp_obj, c;
+    uint i, tmp, tmp_cnt;
     for(i = 0; i < cnt; ++i) {
-        accessor_obj = &json_accessor_array->objs[i];
+        accessor_obj = i ? json_cursor_next(accessor_obj) : json_cursor_child(j_accessors);
         accessor = &g->accessors[i];
         accessor->flags = 0x0;
 
-        // I think I can remove the ternaries because some keys are required, therefore it
-        // must be safe to deref at zero. I do this in the later properties, e.g animations.
-        ki = json_find_key(accessor_obj, "bufferView");
-        accessor->buffer_view = ki == Max_u32 ? ki : accessor_obj->values[ki].num;
-        ki = json_find_key(accessor_obj, "byteOffset");
-        accessor->byte_offset = ki == Max_u32 ? 0 : accessor_obj->values[ki].num;
+        accessor->buffer_view = gltf_num_or(json_cursor_find_key_lit(accessor_obj, "bufferView"), Max_u32);
+        accessor->byte_offset = gltf_num_or(json_cursor_find_key_lit(accessor_obj, "byteOffset"), 0);
 
-        ki = json_find_key(accessor_obj, "componentType");
-        log_print_error_if(ki == Max_u32, "accessor.componentType must be defined");
-        accessor->flags |= gltf_accessor_component_type_to_flags(accessor_obj->values[ki].num);
+        c = json_cursor_find_key_lit(accessor_obj, "componentType");
+        log_print_error_if(!json_cursor_valid(c), "accessor.componentType must be defined");
+        accessor->flags |= gltf_accessor_component_type_to_flags(json_cursor_num(c));
 
-        ki = json_find_key(accessor_obj, "normalized");
-        accessor->flags |= ki == Max_u32 ? 0 : GLTF_ACCESSOR_NORMALIZED_BIT & max32_if_true(accessor_obj->values[ki].boolean);
+        c = json_cursor_find_key_lit(accessor_obj, "normalized");
+        accessor->flags |= json_cursor_valid(c) ? GLTF_ACCESSOR_NORMALIZED_BIT & max32_if_true(json_cursor_bool(c)) : 0;
 
-        ki = json_find_key(accessor_obj, "count");
-        log_print_error_if(ki == Max_u32, "accessor.count must be defined");
-        accessor->count = accessor_obj->values[ki].num;
+        c = json_cursor_find_key_lit(accessor_obj, "count");
+        log_print_error_if(!json_cursor_valid(c), "accessor.count must be defined");
+        accessor->count = json_cursor_num(c);
 
-        ki = json_find_key(accessor_obj, "type");
-        log_print_error_if(ki == Max_u32, "accessor.type must be defined");
-        accessor->flags |= gltf_accessor_type_to_flags(accessor_obj->values[ki].str);
+        c = json_cursor_find_key_lit(accessor_obj, "type");
+        log_print_error_if(!json_cursor_valid(c), "accessor.type must be defined");
+        accessor->flags |= gltf_accessor_type_to_flags(json_cursor_str(c));
 
         accessor->vkformat = gltf_accessor_flags_to_vkformat(accessor->flags, &accessor->byte_stride);
 
-        ki = json_find_key(accessor_obj, "max");
-        if (ki != Max_u32) {
+        c = json_cursor_find_key_lit(accessor_obj, "max");
+        if (json_cursor_valid(c)) {
             accessor->flags |= GLTF_ACCESSOR_MINMAX_BIT;
 
-            // Cannot just memcpy, as the json_nums are stored as doubles not floats.
-            tmp_cnt = accessor_obj->values[ki].arr.len;
-            for(tmp = 0; tmp < tmp_cnt; ++tmp)
-                accessor->max_min.max[tmp] = accessor_obj->values[ki].arr.nums[tmp];
+            tmp_cnt = json_array_as_f32(c, accessor->max_min.max, carrlen(accessor->max_min.max));
+            log_print_error_if(tmp_cnt == Max_u32, "accessors[%u].max must be at most 16 numbers", i);
 
-            ki = json_find_key(accessor_obj, "min");
-            log_print_error_if(ki == Max_u32, "if accessors.max is defined, accessors.min must also be defined");
-            for(tmp = 0; tmp < tmp_cnt; ++tmp)
-                accessor->max_min.min[tmp] = accessor_obj->values[ki].arr.nums[tmp];
+            c = json_cursor_find_key_lit(accessor_obj, "min");
+            log_print_error_if(!json_cursor_valid(c), "if accessors.max is defined, accessors.min must also be defined");
+            tmp = json_array_as_f32(c, accessor->max_min.min, carrlen(accessor->max_min.min));
+            log_print_error_if(tmp != tmp_cnt, "accessors[%u].min must be as long as accessors.max", i);
         }
 
-        ki = json_find_key(accessor_obj, "sparse");
-        if (ki != Max_u32) {
+        sparse_obj = json_cursor_find_key_lit(accessor_obj, "sparse");
+        if (json_cursor_valid(sparse_obj)) {
             accessor->flags |= GLTF_ACCESSOR_SPARSE_BIT;
 
-            sparse_obj = &accessor_obj->values[ki].obj;
-
-            ki = json_find_key(sparse_obj, "count");
-            log_print_error_if(ki == Max_u32, "accessor.sparse.count must be defined");
-            accessor->sparse.count = sparse_obj->values[ki].num;
+            c = json_cursor_find_key_lit(sparse_obj, "count");
+            log_print_error_if(!json_cursor_valid(c), "accessor.sparse.count must be defined");
+            accessor->sparse.count = json_cursor_num(c);
 
-            ki = json_find_key(sparse_obj, "indices");
-            log_print_error_if(ki == Max_u32, "accessor.sparse.indices must be defined");
-            tmp_obj = &sparse_obj->values[ki].obj;
+            tmp_obj = json_cursor_find_key_lit(sparse_obj, "indices");
+            log_print_error_if(!json_cursor_valid(tmp_obj), "accessor.sparse.indices must be defined");
 
-            ki = json_find_key(tmp_obj, "bufferView");
-            log_print_error_if(ki == Max_u32, "accessor.sparse.indices.bufferView must be defined");
-            accessor->sparse.indices.buffer_view = tmp_obj->values[ki].num;
+            c = json_cursor_find_key_lit(tmp_obj, "bufferView");
+            log_print_error_if(!json_cursor_valid(c), "accessor.sparse.indices.bufferView must be defined");
+            accessor->sparse.indices.buffer_view = json_cursor_num(c);
 
-            ki = json_find_key(tmp_obj, "byteOffset");
-            accessor->sparse.indices.byte_offset = ki == Max_u32 ? 0 : tmp_obj->values[ki].num;
+            accessor->sparse.indices.byte_offset = gltf_num_or(json_cursor_find_key_lit(tmp_obj, "byteOffset"), 0);
 
-            ki = json_find_key(tmp_obj, "componentType");
-            log_print_error_if(ki == Max_u32, "accessor.sparse.indices.componentType must be defined");
-            accessor->sparse.indices.component_type = gltf_accessor_component_type_to_flags(tmp_obj->values[ki].num);
+            c = json_cursor_find_key_lit(tmp_obj, "componentType");
+            log_print_error_if(!json_cursor_valid(c), "accessor.sparse.indices.componentType must be defined");
+            accessor->sparse.indices.component_type = gltf_accessor_component_type_to_flags(json_cursor_num(c));
 
-            ki = json_find_key(sparse_obj, "values");
-            log_print_error_if(ki == Max_u32, "accessor.sparse.values must be defined");
-            tmp_obj = &sparse_obj->values[ki].obj;
+            tmp_obj = json_cursor_find_key_lit(sparse_obj, "values");
+            log_print_error_if(!json_cursor_valid(tmp_obj), "accessor.sparse.values must be defined");
 
-            ki = json_find_key(tmp_obj, "bufferView");
-            log_print_error_if(ki == Max_u32, "accessor.sparse.values.bufferView must be defined");
-            accessor->sparse.values.buffer_view = tmp_obj->values[ki].num;
+            c = json_cursor_find_key_lit(tmp_obj, "bufferView");
+            log_print_error_if(!json_cursor_valid(c), "accessor.sparse.values.bufferView must be defined");
+            accessor->sparse.values.buffer_view = json_cursor_num(c);
 
-            ki = json_find_key(tmp_obj, "byteOffset");
-            accessor->sparse.values.byte_offset = ki == Max_u32 ? 0 : tmp_obj->values[ki].num;
+            accessor->sparse.values.byte_offset = gltf_num_or(json_cursor_find_key_lit(tmp_obj, "byteOffset"), 0);
         }
     }
 }
@@ -994,46 +2176,53 @@ static inline gltf_animation_path_bits gltf_animation_translate_target_path(stri
     return Max_u32;
 }
 
-#define GLTF_ANIMATION_TARGET_MASK 2
-static uint gltf_parse_animation_targets(uint count, json_object *channel_objs, gltf_animation_target *targets)
+static uint gltf_parse_animation_targets(json_cursor j_channels, allocator *temp, gltf_animation_target *targets)
 {
-    assert(count < (GLTF_ANIMATION_TARGET_MASK << 6) && "Below mask too small"); // This probably could be one u64
-    uint64 mask[GLTF_ANIMATION_TARGET_MASK] = {};
-    uint64 one = 1;
+    uint count = json_cursor_len(j_channels);
+    uint64 *mask = new_bitset(count, temp);
+
+    // Channels are compared pairwise, so find each one's target once.
+    json_cursor *channel_objs = sallocate(temp, *channel_objs, count);
+    json_cursor *target_objs = sallocate(temp, *target_objs, count);
+    uint i, j, node;
+    for(i = 0; i < count; ++i) {
+        channel_objs[i] = i ? json_cursor_next(channel_objs[i-1]) : json_cursor_child(j_channels);
+        target_objs[i] = json_cursor_find_key_lit(channel_objs[i], "target");
+        log_print_error_if(!json_cursor_valid(target_objs[i]), "animations.channels.target must be defined");
+    }
+
+    json_cursor c;
     uint tc = 0;
-    uint i, j, ki0, ki1, tmp, node;
     for(i = 0; i < count; ++i) {
-        if (mask[i>>6] & (one << (i & 63)))
+        if (bitset_test(mask, i))
             continue;
 
         targets[tc].path_mask = 0;
         memset(targets[tc].samplers, 0xff, sizeof(targets[tc].samplers));
         for(j = i; j < count; ++j) {
-            if (mask[j>>6] & (one << (j & 63)))
+            if (bitset_test(mask, j))
                 continue;
 
-            ki0 = json_find_key(&channel_objs[j], "target");
-            log_print_error_if(ki0 == Max_u32, "animations.channels.target must be defined");
+            c = json_cursor_find_key_lit(target_objs[j], "node");
+            log_print_error_if(!json_cursor_valid(c), "animations.channels.target.node must be defined, this parser does not support this extension yet.");
 
-            tmp = json_find_key(&channel_objs[j].values[ki0].obj, "node");
-            ki1 = tmp & max64_if_true(tmp != Max_u32);
-            log_print_error_if(ki1 == Max_u32, "animations.channels.target.node must be defined, this parser does not support this extension yet.");
-
-            if ((uint)channel_objs[j].values[ki0].obj.values[ki1].num != targets[tc].node && j != i)
+            node = (uint)json_cursor_num(c);
+            if (node != targets[tc].node && j != i)
                 continue;
 
-            mask[j>>6] |= one << (j & 63);
+            bitset_set(mask, j);
 
-            targets[tc].node = (uint)channel_objs[j].values[ki0].obj.values[ki1].num;
+            targets[tc].node = node;
 
-            ki1 = json_find_key(&channel_objs[j].values[ki0].obj, "path");
-            log_print_error_if(ki1 == Max_u32, "animations.channels.target.path must be defined");
-            uint path = gltf_animation_translate_target_path(&channel_objs[j].values[ki0].obj.values[ki1].str);
+            c = json_cursor_find_key_lit(target_objs[j], "path");
+            log_print_error_if(!json_cursor_valid(c), "animations.channels.target.path must be defined");
+            json_string path_str = json_cursor_str(c);
+            uint path = gltf_animation_translate_target_path(&path_str);
             targets[tc].path_mask |= path;
 
-            ki0 = json_find_key(&channel_objs[j], "sampler");
-            log_print_error_if(ki0 == Max_u32, "animations.channels.sampler must be defined");
-            targets[tc].samplers[ctz(path)] = (uint16)channel_objs[j].values[ki0].num;
+            c = json_cursor_find_key_lit(channel_objs[j], "sampler");
+            log_print_error_if(!json_cursor_valid(c), "animations.channels.sampler must be defined");
+            targets[tc].samplers[ctz(path)] = (uint16)json_cursor_num(c);
         }
         tc++;
     }
@@ -1058,83 +2247,90 @@ static inline gltf_animation_interpolation gltf_animation_translate_interpolatio
     return Max_u32;
 }
 
-static void gltf_parse_animation_samplers(uint count, json_object *sampler_objs, gltf_animation_sampler *samplers)
+static void gltf_parse_animation_samplers(json_cursor j_samplers, gltf_animation_sampler *samplers)
 {
-    uint i, ki, tmp;
-    uint64 ptr;
+    uint count = json_cursor_len(j_samplers);
+    json_cursor sampler_obj, c;
+    json_string str;
+    uint i;
     for(i = 0; i < count; ++i) {
-        ki = json_find_key(&sampler_objs[i], "input");
-        log_print_error_if(ki == Max_u32, "animations.samplers.input must be defined");
-        samplers[i].input = sampler_objs[i].values[ki].num;
+        sampler_obj = i ? json_cursor_next(sampler_obj) : json_cursor_child(j_samplers);
+
+        c = json_cursor_find_key_lit(sampler_obj, "input");
+        log_print_error_if(!json_cursor_valid(c), "animations.samplers.input must be defined");
+        samplers[i].input = json_cursor_num(c);
 
-        tmp = json_find_key(&sampler_objs[i], "interpolation");
-        ki = tmp & max64_if_true(tmp != Max_u32);
-        ptr = ((uint64)(&sampler_objs[i].values[ki].str)) & max64_if_true(tmp != Max_u32);
-        samplers[i].interpolation = gltf_animation_translate_interpolation((string*)ptr);
+        c = json_cursor_find_key_lit(sampler_obj, "interpolation");
+        str = json_cursor_valid(c) ? json_cursor_str(c) : (json_string){NULL, 0};
+        samplers[i].interpolation = gltf_animation_translate_interpolation(json_cursor_valid(c) ? &str : NULL);
 
-        ki = json_find_key(&sampler_objs[i], "output");
-        log_print_error_if(ki == Max_u32, "animations.samplers.output must be defined");
-        samplers[i].output = sampler_objs[i].values[ki].num;
+        c = json_cursor_find_key_lit(sampler_obj, "output");
+        log_print_error_if(!json_cursor_valid(c), "animations.samplers.output must be defined");
+        samplers[i].output = json_cursor_num(c);
     }
 }
 
-static void gltf_parse_animations(uint index, json *j, allocator *alloc, uint *anim_target_counts, gltf *g)
+static void gltf_parse_animations(json_cursor j_animations, allocator *alloc, allocator *temp, uint *anim_target_counts, gltf *g)
 {
-    uint tmp = index;
-    tmp = max64_if_false(tmp == Max_u32);
-    index &= tmp;
-    json_object *json_animations = j->obj.values[index].arr.objs;
-
-    uint cnt = j->obj.values[index].arr.len & tmp;
+    uint cnt = gltf_array_len(j_animations);
     g->animation_count = cnt;
     g->animations = sallocate(alloc, *g->animations, cnt);
     gltf_animation *animations = g->animations;
-    uint i, ki;
+    json_cursor animation_obj, c;
+    uint i;
     for(i = 0; i < cnt; ++i) {
-        ki = json_find_key(&json_animations[i], "channels");
-        log_print_error_if(ki == Max_u32, "animations.channels must be defined");
+        animation_obj = i ? json_cursor_next(animation_obj) : json_cursor_child(j_animations);
+
+        c = json_cursor_find_key_lit(animation_obj, "channels");
+        log_print_error_if(!json_cursor_valid(c), "animations.channels must be defined");
 
-        tmp = json_animations[i].values[ki].arr.len;
         animations[i].targets = sallocate(alloc, *animations->targets, anim_target_counts[i]);
-        animations[i].target_count = gltf_parse_animation_targets(tmp, json_animations[i].values[ki].arr.objs, animations[i].targets);
+        animations[i].target_count = gltf_parse_animation_targets(c, temp, animations[i].targets);
 
-        ki = json_find_key(&json_animations[i], "samplers");
-        log_print_error_if(ki == Max_u32, "animations.samplers must be defined");
+        c = json_cursor_find_key_lit(animation_obj, "samplers");
+        log_print_error_if(!json_cursor_valid(c), "animations.samplers must be defined");
 
-        tmp = json_animations[i].values[ki].arr.len;
-        animations[i].sampler_count = tmp;
-        animations[i].samplers = sallocate(alloc, *animations->samplers, tmp);
-        gltf_parse_animation_samplers(tmp, json_animations[i].values[ki].arr.objs, animations[i].samplers);
+        animations[i].sampler_count = json_cursor_len(c);
+        animations[i].samplers = sallocate(alloc, *animations->samplers, animations[i].sampler_count);
+        gltf_parse_animation_samplers(c, animations[i].samplers);
     }
 }
 
-static void gltf_parse_buffers(uint index, json *j, allocator *alloc, gltf *g)
+static void gltf_parse_buffers(json_cursor j_buffers, const char *extra_buffer_uri, allocator *alloc, gltf *g)
 {
-    uint tmp = index;
-    tmp = max64_if_false(tmp == Max_u32);
-    index &= tmp;
-    json_object *json_buffers = j->obj.values[index].arr.objs;
-
-    uint cnt = j->obj.values[index].arr.len & tmp;
-    g->buffer_count = cnt;
-    g->buffers = sallocate(alloc, *g->buffers, cnt);
+    uint cnt = gltf_array_len(j_buffers);
+    g->buffer_count = cnt + (extra_buffer_uri != NULL);
+    g->buffers = sallocate(alloc, *g->buffers, g->buffer_count);
     gltf_buffer *buffers = g->buffers;
-    uint i, ki;
+    json_cursor buffer_obj, c;
+    json_string uri;
+    uint i;
     char *ptr;
     for(i = 0; i < cnt; ++i) {
-        ki = json_find_key(&json_buffers[i], "byteLength");
-        log_print_error_if(ki == Max_u32, "buffer.byteLength must be defined");
-        buffers[i].byte_length = json_buffers[i].values[ki].num;
+        buffer_obj = i ? json_cursor_next(buffer_obj) : json_cursor_child(j_buffers);
+
+        c = json_cursor_find_key_lit(buffer_obj, "byteLength");
+        log_print_error_if(!json_cursor_valid(c), "buffer.byteLength must be defined");
+        buffers[i].byte_length = json_cursor_num(c);
 
         // always allocate at least one byte, even if uri is undefined, and null terminate.
-        tmp = json_find_key(&json_buffers[i], "uri");
-        ki = tmp & max64_if_true(tmp != Max_u32);
-        buffers[i].uri.len = json_buffers[i].values[ki].str.len & max64_if_true(tmp != Max_u32);
-        assert(buffers[i].uri.len < GLTF_MAX_URI_LEN); // must be '<' for null temination
+        c = json_cursor_find_key_lit(buffer_obj, "uri");
+        uri = json_cursor_valid(c) ? json_cursor_str(c) : (json_string){"", 0};
+        assert(uri.len < GLTF_MAX_URI_LEN); // must be '<' for null temination
         ptr = allocate(alloc, GLTF_MAX_URI_LEN);
-        memcpy(ptr, json_buffers[i].values[ki].str.cstr, buffers[i].uri.len);
+        buffers[i].uri.len = json_string_unescape_to(uri, ptr);
         ptr[buffers[i].uri.len] = '\0';
         buffers[i].uri.cstr = ptr;
+
+        log_print_error_if(!buffers[i].uri.len && buffers[i].byte_length > g->bin.size,
+                "buffers[%u] has no uri and is larger than the glb BIN chunk", i);
+    }
+    if (extra_buffer_uri) {
+        ptr = allocate(alloc, GLTF_MAX_URI_LEN);
+        buffers[cnt].byte_length = 0;
+        buffers[cnt].uri.len = strlen(extra_buffer_uri);
+        memcpy(ptr, extra_buffer_uri, buffers[cnt].uri.len + 1);
+        buffers[cnt].uri.cstr = ptr;
     }
 }
 
@@ -1155,114 +2351,97 @@ static inline gltf_buffer_view_flag_bits gltf_buffer_view_translate_target(uint
     }
 }
 
-static void gltf_parse_buffer_views(uint index, json *j, bool extra_attrs, allocator *alloc, gltf *g)
+static void gltf_parse_buffer_views(json_cursor j_buffer_views, bool extra_attrs, allocator *alloc, gltf *g)
 {
-    uint tmp = index;
-    tmp = max64_if_false(tmp == Max_u32);
-    index &= tmp;
-    json_object *json_buffer_views = j->obj.values[index].arr.objs;
-
-    uint cnt = j->obj.values[index].arr.len & tmp;
+    uint cnt = gltf_array_len(j_buffer_views);
     g->buffer_view_count = cnt;
     g->buffer_views = sallocate(alloc, *g->buffer_views, cnt + extra_attrs);
     gltf_buffer_view *buffer_views = g->buffer_views;
-    uint i, ki;
+    json_cursor buffer_view_obj, c;
+    uint i;
     for(i = 0; i < cnt; ++i) {
+        buffer_view_obj = i ? json_cursor_next(buffer_view_obj) : json_cursor_child(j_buffer_views);
         buffer_views[i].flags = 0x0;
 
-        ki = json_find_key(&json_buffer_views[i], "buffer");
-        log_print_error_if(ki == Max_u32, "bufferView.buffer must be defined");
-        buffer_views[i].buffer = json_buffer_views[i].values[ki].num;
+        c = json_cursor_find_key_lit(buffer_view_obj, "buffer");
+        log_print_error_if(!json_cursor_valid(c), "bufferView.buffer must be defined");
+        buffer_views[i].buffer = json_cursor_num(c);
 
-        tmp = json_find_key(&json_buffer_views[i], "byteOffset");
-        ki = tmp & max64_if_true(tmp != Max_u32);
-        buffer_views[i].byte_offset = (uint64)json_buffer_views[i].values[ki].num & max64_if_true(tmp != Max_u32);
+        buffer_views[i].byte_offset = gltf_num_or(json_cursor_find_key_lit(buffer_view_obj, "byteOffset"), 0);
 
-        ki = json_find_key(&json_buffer_views[i], "byteLength");
-        log_print_error_if(ki == Max_u32, "bufferView.byteLength must be defined");
-        buffer_views[i].byte_length = json_buffer_views[i].values[ki].num;
+        c = json_cursor_find_key_lit(buffer_view_obj, "byteLength");
+        log_print_error_if(!json_cursor_valid(c), "bufferView.byteLength must be defined");
+        buffer_views[i].byte_length = json_cursor_num(c);
 
-        tmp = json_find_key(&json_buffer_views[i], "byteStride");
-        ki = tmp & max64_if_true(tmp != Max_u32);
-        buffer_views[i].byte_stride = (uint64)json_buffer_views[i].values[ki].num & max64_if_true(tmp != Max_u32);
+        buffer_views[i].byte_stride = gltf_num_or(json_cursor_find_key_lit(buffer_view_obj, "byteStride"), 0);
 
-        tmp = json_find_key(&json_buffer_views[i], "target");
-        ki = tmp & max64_if_true(tmp != Max_u32);
-        buffer_views[i].flags |= gltf_buffer_view_translate_target((uint64)json_buffer_views[i].values[ki].num & max64_if_true(tmp != Max_u32));
+        c = json_cursor_find_key_lit(buffer_view_obj, "target");
+        buffer_views[i].flags |= gltf_buffer_view_translate_target(gltf_num_or(c, GLTF_BUFFER_VIEW_TARGET_UNDEFINED));
     }
 }
 
-static void gltf_camera_parse_orthographic(json_object *json_camera, gltf_camera_orthographic *orthographic)
+static void gltf_camera_parse_orthographic(json_cursor json_camera, gltf_camera_orthographic *orthographic)
 {
-    uint ki = json_find_key(json_camera, "orthographic");
-    log_print_error_if(ki == Max_u32, "if camera.type == orthographic, camera.orthographic must be defined");
-    json_object *json_orthographic = &json_camera->values[ki].obj;
+    json_cursor json_orthographic = json_cursor_find_key_lit(json_camera, "orthographic");
+    log_print_error_if(!json_cursor_valid(json_orthographic), "if camera.type == orthographic, camera.orthographic must be defined");
 
-    ki = json_find_key(json_orthographic, "xmag");
-    log_print_error_if(ki == Max_u32, "camera.orthographic.xmag must be defined");
-    orthographic->xmag = json_orthographic->values[ki].num;
+    json_cursor c = json_cursor_find_key_lit(json_orthographic, "xmag");
+    log_print_error_if(!json_cursor_valid(c), "camera.orthographic.xmag must be defined");
+    orthographic->xmag = json_cursor_num(c);
 
-    ki = json_find_key(json_orthographic, "ymag");
-    log_print_error_if(ki == Max_u32, "camera.orthographic.ymag must be defined");
-    orthographic->ymag = json_orthographic->values[ki].num;
+    c = json_cursor_find_key_lit(json_orthographic, "ymag");
+    log_print_error_if(!json_cursor_valid(c), "camera.orthographic.ymag must be defined");
+    orthographic->ymag = json_cursor_num(c);
 
-    ki = json_find_key(json_orthographic, "zfar");
-    log_print_error_if(ki == Max_u32, "camera.orthographic.zfar must be defined");
-    orthographic->zfar = json_orthographic->values[ki].num;
+    c = json_cursor_find_key_lit(json_orthographic, "zfar");
+    log_print_error_if(!json_cursor_valid(c), "camera.orthographic.zfar must be defined");
+    orthographic->zfar = json_cursor_num(c);
 
-    ki = json_find_key(json_orthographic, "znear");
-    log_print_error_if(ki == Max_u32, "camera.orthographic.znear must be defined");
-    orthographic->znear = json_orthographic->values[ki].num;
+    c = json_cursor_find_key_lit(json_orthographic, "znear");
+    log_print_error_if(!json_cursor_valid(c), "camera.orthographic.znear must be defined");
+    orthographic->znear = json_cursor_num(c);
 }
 
-static void gltf_camera_parse_perspective(json_object *json_camera, gltf_camera_perspective *perspective)
+static void gltf_camera_parse_perspective(json_cursor json_camera, gltf_camera_perspective *perspective)
 {
-    uint ki = json_find_key(json_camera, "perspective");
-    log_print_error_if(ki == Max_u32, "if camera.type == perspective, camera.perspective must be defined");
-    json_object *json_perspective = &json_camera->values[ki].obj;
+    json_cursor json_perspective = json_cursor_find_key_lit(json_camera, "perspective");
+    log_print_error_if(!json_cursor_valid(json_perspective), "if camera.type == perspective, camera.perspective must be defined");
 
-    uint tmp = json_find_key(json_perspective, "aspectRatio");
-    ki = tmp & max32_if_true(tmp != Max_u32);
-    perspective->aspect_ratio = tmp == Max_u32 ? Max_f32 : json_perspective->values[ki].num;
+    perspective->aspect_ratio = gltf_num_or(json_cursor_find_key_lit(json_perspective, "aspectRatio"), Max_f32);
 
-    ki = json_find_key(json_perspective, "yfov");
-    log_print_error_if(ki == Max_u32, "camera.perspective.yfov must be defined");
-    perspective->yfov = json_perspective->values[ki].num;
+    json_cursor c = json_cursor_find_key_lit(json_perspective, "yfov");
+    log_print_error_if(!json_cursor_valid(c), "camera.perspective.yfov must be defined");
+    perspective->yfov = json_cursor_num(c);
 
-    tmp = json_find_key(json_perspective, "zfar");
-    ki = tmp & max32_if_true(tmp != Max_u32);
-    perspective->zfar = tmp == Max_u32 ? Max_f32 : json_perspective->values[ki].num;
+    perspective->zfar = gltf_num_or(json_cursor_find_key_lit(json_perspective, "zfar"), Max_f32);
 
-    ki = json_find_key(json_perspective, "znear");
-    log_print_error_if(ki == Max_u32, "camera.perspective.znear must be defined");
-    perspective->znear = json_perspective->values[ki].num;
+    c = json_cursor_find_key_lit(json_perspective, "znear");
+    log_print_error_if(!json_cursor_valid(c), "camera.perspective.znear must be defined");
+    perspective->znear = json_cursor_num(c);
 }
 
 #define GLTF_CAMERA_TYPE_LEN_ORTHOGRAPHIC 12
 #define GLTF_CAMERA_TYPE_LEN_PERSPECTIVE 11
 
-static void gltf_parse_cameras(uint index, json *j, allocator *alloc, gltf *g)
+static void gltf_parse_cameras(json_cursor j_cameras, allocator *alloc, gltf *g)
 {
-    uint tmp = index;
-    tmp = max64_if_false(tmp == Max_u32);
-    index &= tmp;
-    json_object *json_cameras = j->obj.values[index].arr.objs;
-
-    uint cnt = j->obj.values[index].arr.len & tmp;
+    uint cnt = gltf_array_len(j_cameras);
     g->camera_count = cnt;
     g->cameras = sallocate(alloc, *g->cameras, cnt);
     gltf_camera *cameras = g->cameras;
-    uint i, ki;
+    json_cursor camera_obj, c;
+    uint i;
     for(i = 0; i < cnt; ++i) {
+        camera_obj = i ? json_cursor_next(camera_obj) : json_cursor_child(j_cameras);
         cameras[i].flags = 0x0;
-        ki = json_find_key(&json_cameras[i], "type");
-        log_print_error_if(ki == Max_u32, "camera.type must be defined");
-        if (memcmp("orthographic", json_cameras[i].values[ki].str.cstr, GLTF_CAMERA_TYPE_LEN_ORTHOGRAPHIC) == 0) {
+        c = json_cursor_find_key_lit(camera_obj, "type");
+        log_print_error_if(!json_cursor_valid(c), "camera.type must be defined");
+        if (memcmp("orthographic", json_cursor_str(c).cstr, GLTF_CAMERA_TYPE_LEN_ORTHOGRAPHIC) == 0) {
             cameras[i].flags |= GLTF_CAMERA_ORTHOGRAPHIC_BIT;
-            gltf_camera_parse_orthographic(&json_cameras[i], &cameras[i].orthographic);
-        } else if (memcmp("perspective", json_cameras[i].values[ki].str.cstr, GLTF_CAMERA_TYPE_LEN_PERSPECTIVE) == 0) {
+            gltf_camera_parse_orthographic(camera_obj, &cameras[i].orthographic);
+        } else if (memcmp("perspective", json_cursor_str(c).cstr, GLTF_CAMERA_TYPE_LEN_PERSPECTIVE) == 0) {
             cameras[i].flags |= GLTF_CAMERA_PERSPECTIVE_BIT;
-            gltf_camera_parse_perspective(&json_cameras[i], &cameras[i].perspective);
+            gltf_camera_parse_perspective(camera_obj, &cameras[i].perspective);
         } else {
             log_print_error("camera.type must be one of 'orthographic' or 'perspective' but is neither.");
         }
@@ -1281,118 +2460,109 @@ static inline gltf_image_flag_bits gltf_image_translate_mime_type(string *str) {
     return 0x0;
 }
 
-static void gltf_parse_images(uint index, json *j, allocator *alloc, gltf *g)
+static void gltf_parse_images(json_cursor j_images, allocator *alloc, gltf *g)
 {
-    uint tmp = index;
-    tmp = max64_if_false(tmp == Max_u32);
-    index &= tmp;
-    json_object *json_images = j->obj.values[index].arr.objs;
-
-    uint cnt = j->obj.values[index].arr.len & tmp;
+    uint cnt = gltf_array_len(j_images);
     g->image_count = cnt;
     g->images = sallocate(alloc, *g->images, cnt);
     gltf_image *images = g->images;
-    uint i, ki;
+    json_cursor image_obj, c;
+    json_string str;
+    uint i;
     char *ptr;
     for(i = 0; i < cnt; ++i) {
+        image_obj = i ? json_cursor_next(image_obj) : json_cursor_child(j_images);
         images[i].flags = 0x0;
-        ki = json_find_key(&json_images[i], "uri");
-        if (ki != Max_u32) {
-            assert(json_images[i].values[ki].str.len < GLTF_MAX_URI_LEN);
+        c = json_cursor_find_key_lit(image_obj, "uri");
+        if (json_cursor_valid(c)) {
+            assert(json_cursor_len(c) < GLTF_MAX_URI_LEN);
             ptr = allocate(alloc, GLTF_MAX_URI_LEN);
-            memcpy(ptr, json_images[i].values[ki].str.cstr, json_images[i].values[ki].str.len);
-            ptr[json_images[i].values[ki].str.len] = '\0';
-            images[i].uri.len = json_images[i].values[ki].str.len;
+            images[i].uri.len = json_string_unescape_to(json_cursor_str(c), ptr);
+            ptr[images[i].uri.len] = '\0';
             images[i].uri.cstr = ptr;
         } else {
             images[i].uri = (string){NULL, 0};
         }
-        ki = json_find_key(&json_images[i], "mimeType");
-        images[i].flags |= ki != Max_u32 ? gltf_image_translate_mime_type(&json_images[i].values[ki].str) : 0x0;
-        ki = json_find_key(&json_images[i], "bufferView");
-        images[i].buffer_view = ki != Max_u32 ? json_images[i].values[ki].num : Max_u32;
+        c = json_cursor_find_key_lit(image_obj, "mimeType");
+        if (json_cursor_valid(c)) {
+            str = json_cursor_str(c);
+            images[i].flags |= gltf_image_translate_mime_type(&str);
+        }
+        images[i].buffer_view = gltf_num_or(json_cursor_find_key_lit(image_obj, "bufferView"), Max_u32);
     }
 }
 
-static void gltf_material_parse_pbr(json_object *j_pbr, gltf_material *mat)
+static void gltf_material_parse_pbr(json_cursor j_pbr, gltf_material *mat)
 {
-    uint ki0, ki1;
-    ki0 = json_find_key(j_pbr, "baseColorFactor");
+    json_cursor c0, c1;
+    c0 = json_cursor_find_key_lit(j_pbr, "baseColorFactor");
     mat->uniforms.base_color_factor[0] = 1;
     mat->uniforms.base_color_factor[1] = 1;
     mat->uniforms.base_color_factor[2] = 1;
     mat->uniforms.base_color_factor[3] = 1;
-    for(uint i = 0; i < 4 * (ki0 != Max_u32); ++i)
-        mat->uniforms.base_color_factor[i] = j_pbr->values[ki0].arr.nums[i];
+    if (json_cursor_valid(c0))
+        log_print_error_if(json_array_as_f32(c0, mat->uniforms.base_color_factor, 4) != 4,
+                "pbrMetallicRoughness.baseColorFactor must be 4 numbers");
 
-    ki0 = json_find_key(j_pbr, "metallicFactor");
-    mat->uniforms.metallic_factor = ki0 == Max_u32 ? 1 : j_pbr->values[ki0].num;
-    ki0 = json_find_key(j_pbr, "roughnessFactor");
-    mat->uniforms.roughness_factor = ki0 == Max_u32 ? 1 : j_pbr->values[ki0].num;
+    mat->uniforms.metallic_factor = gltf_num_or(json_cursor_find_key_lit(j_pbr, "metallicFactor"), 1);
+    mat->uniforms.roughness_factor = gltf_num_or(json_cursor_find_key_lit(j_pbr, "roughnessFactor"), 1);
 
-    ki0 = json_find_key(j_pbr, "baseColorTexture");
-    if (ki0 != Max_u32) {
+    c0 = json_cursor_find_key_lit(j_pbr, "baseColorTexture");
+    if (json_cursor_valid(c0)) {
         mat->flags |= GLTF_MATERIAL_BASE_COLOR_TEXTURE_BIT;
 
-        ki1 = json_find_key(&j_pbr->values[ki0].obj, "index");
-        log_print_error_if(ki1 == Max_u32, "material.pbrMetallicRoughness.baseColorTexture.index must be defined");
-        mat->base_color.texture = j_pbr->values[ki0].obj.values[ki1].num;
-        ki1 = json_find_key(&j_pbr->values[ki0].obj, "texCoord");
-        mat->base_color.texcoord = ki1 != Max_u32 ? j_pbr->values[ki0].obj.values[ki1].num : 0;
+        c1 = json_cursor_find_key_lit(c0, "index");
+        log_print_error_if(!json_cursor_valid(c1), "material.pbrMetallicRoughness.baseColorTexture.index must be defined");
+        mat->base_color.texture = json_cursor_num(c1);
+        mat->base_color.texcoord = gltf_num_or(json_cursor_find_key_lit(c0, "texCoord"), 0);
     }
 
-    ki0 = json_find_key(j_pbr, "metallicRoughnessTexture");
-    if (ki0 != Max_u32) {
+    c0 = json_cursor_find_key_lit(j_pbr, "metallicRoughnessTexture");
+    if (json_cursor_valid(c0)) {
         mat->flags |= GLTF_MATERIAL_METALLIC_ROUGHNESS_TEXTURE_BIT;
 
-        ki1 = json_find_key(&j_pbr->values[ki0].obj, "index");
-        log_print_error_if(ki1 == Max_u32, "material.pbrMetallicRoughness.metallicRoughnessTexture.index must be defined");
-        mat->metallic_roughness.texture = j_pbr->values[ki0].obj.values[ki1].num;
-        ki1 = json_find_key(&j_pbr->values[ki0].obj, "texCoord");
-        mat->metallic_roughness.texcoord = ki1 != Max_u32 ? j_pbr->values[ki0].obj.values[ki1].num : 0;
+        c1 = json_cursor_find_key_lit(c0, "index");
+        log_print_error_if(!json_cursor_valid(c1), "material.pbrMetallicRoughness.metallicRoughnessTexture.index must be defined");
+        mat->metallic_roughness.texture = json_cursor_num(c1);
+        mat->metallic_roughness.texcoord = gltf_num_or(json_cursor_find_key_lit(c0, "texCoord"), 0);
     }
 }
 
-static void gltf_material_parse_normal(json_object *j_norm, gltf_material *mat)
+static void gltf_material_parse_normal(json_cursor j_norm, gltf_material *mat)
 {
     mat->flags |= GLTF_MATERIAL_NORMAL_TEXTURE_BIT;
 
-    uint ki0 = json_find_key(j_norm, "scale");
-    mat->uniforms.normal_scale = ki0 == Max_u32 ? 1 : j_norm->values[ki0].num;
+    mat->uniforms.normal_scale = gltf_num_or(json_cursor_find_key_lit(j_norm, "scale"), 1);
 
-    ki0 = json_find_key(j_norm, "index");
-    log_print_error_if(ki0 == Max_u32, "material.normalTexture.index must be defined");
-    mat->normal.texture = j_norm->values[ki0].num;
+    json_cursor c0 = json_cursor_find_key_lit(j_norm, "index");
+    log_print_error_if(!json_cursor_valid(c0), "material.normalTexture.index must be defined");
+    mat->normal.texture = json_cursor_num(c0);
 
-    ki0 = json_find_key(j_norm, "texCoord");
-    mat->normal.texcoord = ki0 != Max_u32 ? j_norm->values[ki0].num : 0;
+    mat->normal.texcoord = gltf_num_or(json_cursor_find_key_lit(j_norm, "texCoord"), 0);
 }
 
-static void gltf_material_parse_occlusion(json_object *j_occl, gltf_material *mat)
+static void gltf_material_parse_occlusion(json_cursor j_occl, gltf_material *mat)
 {
     mat->flags |= GLTF_MATERIAL_OCCLUSION_TEXTURE_BIT;
 
-    uint ki0 = json_find_key(j_occl, "strength");
-    mat->uniforms.occlusion_strength = ki0 == Max_u32 ? 1 : j_occl->values[ki0].num;
+    mat->uniforms.occlusion_strength = gltf_num_or(json_cursor_find_key_lit(j_occl, "strength"), 1);
 
-    ki0 = json_find_key(j_occl, "index");
-    log_print_error_if(ki0 == Max_u32, "material.occlusionTexture.index must be defined");
-    mat->occlusion.texture = j_occl->values[ki0].num;
+    json_cursor c0 = json_cursor_find_key_lit(j_occl, "index");
+    log_print_error_if(!json_cursor_valid(c0), "material.occlusionTexture.index must be defined");
+    mat->occlusion.texture = json_cursor_num(c0);
 
-    ki0 = json_find_key(j_occl, "texCoord");
-    mat->occlusion.texcoord = ki0 != Max_u32 ? j_occl->values[ki0].num : 0;
+    mat->occlusion.texcoord = gltf_num_or(json_cursor_find_key_lit(j_occl, "texCoord"), 0);
 }
 
-static void gltf_material_parse_emissive(json_object *j_emi, gltf_material *mat)
+static void gltf_material_parse_emissive(json_cursor j_emi, gltf_material *mat)
 {
     mat->flags |= GLTF_MATERIAL_NORMAL_TEXTURE_BIT;
 
-    uint ki0 = json_find_key(j_emi, "index");
-    log_print_error_if(ki0 == Max_u32, "material.emissiveTexture.index must be defined");
-    mat->emissive.texture = j_emi->values[ki0].num;
+    json_cursor c0 = json_cursor_find_key_lit(j_emi, "index");
+    log_print_error_if(!json_cursor_valid(c0), "material.emissiveTexture.index must be defined");
+    mat->emissive.texture = json_cursor_num(c0);
 
-    ki0 = json_find_key(j_emi, "texCoord");
-    mat->emissive.texcoord = ki0 != Max_u32 ? j_emi->values[ki0].num : 0;
+    mat->emissive.texcoord = gltf_num_or(json_cursor_find_key_lit(j_emi, "texCoord"), 0);
 }
 
 #define GLTF_MATERIAL_ALPHA_MODE_LEN_OPAQUE 6
@@ -1410,25 +2580,24 @@ static inline gltf_material_flag_bits gltf_material_translate_alpha_mode(string
     return 0x0;
 }
 
-static void gltf_parse_materials(uint index, json *j, allocator *alloc, gltf *g)
+static void gltf_parse_materials(json_cursor j_materials, allocator *alloc, gltf *g)
 {
     log_print_error_if(SHADER_MATERIAL_UBO_SIZE != sizeof(gltf_material_uniforms),
             "These sizes must match for the sake of simpler copy code");
 
-    uint tmp = index;
-    tmp = max64_if_false(tmp == Max_u32);
-    index &= tmp;
-    json_object *json_materials = j->obj.values[index].arr.objs;
-
-    uint cnt = j->obj.values[index].arr.len & tmp;
+    uint cnt = gltf_array_len(j_materials);
     g->material_count = cnt;
     g->materials = sallocate(alloc, *g->materials, cnt);
     gltf_material *materials = g->materials;
-    uint i, ki;
+    json_cursor material_obj, c;
+    json_string str;
+    uint i;
     for(i = 0; i < cnt; ++i) {
-        ki = json_find_key(&json_materials[i], "pbrMetallicRoughness");
-        if (ki != Max_u32) {
-            gltf_material_parse_pbr(&json_materials[i].values[ki].obj, &materials[i]);
+        material_obj = i ? json_cursor_next(material_obj) : json_cursor_child(j_materials);
+
+        c = json_cursor_find_key_lit(material_obj, "pbrMetallicRoughness");
+        if (json_cursor_valid(c)) {
+            gltf_material_parse_pbr(c, &materials[i]);
         } else {
             materials[i].uniforms.base_color_factor[0] = 1;
             materials[i].uniforms.base_color_factor[1] = 1;
@@ -1438,35 +2607,40 @@ static void gltf_parse_materials(uint index, json *j, allocator *alloc, gltf *g)
             materials[i].uniforms.roughness_factor = 1;
         }
 
-        ki = json_find_key(&json_materials[i], "normalTexture");
-        if (ki != Max_u32)
-            gltf_material_parse_normal(&json_materials[i].values[ki].obj, &materials[i]);
+        c = json_cursor_find_key_lit(material_obj, "normalTexture");
+        if (json_cursor_valid(c))
+            gltf_material_parse_normal(c, &materials[i]);
         else
             materials[i].uniforms.normal_scale = 1;
 
-        ki = json_find_key(&json_materials[i], "occlusionTexture");
-        if (ki != Max_u32)
-            gltf_material_parse_occlusion(&json_materials[i].values[ki].obj, &materials[i]);
+        c = json_cursor_find_key_lit(material_obj, "occlusionTexture");
+        if (json_cursor_valid(c))
+            gltf_material_parse_occlusion(c, &materials[i]);
         else
             materials[i].uniforms.occlusion_strength = 1;
 
-        ki = json_find_key(&json_materials[i], "emissiveTexture");
-        if (ki != Max_u32)
-            gltf_material_parse_emissive(&json_materials[i].values[ki].obj, &materials[i]);
+        c = json_cursor_find_key_lit(material_obj, "emissiveTexture");
+        if (json_cursor_valid(c))
+            gltf_material_parse_emissive(c, &materials[i]);
 
-        ki = json_find_key(&json_materials[i], "emissiveFactor");
+        c = json_cursor_find_key_lit(material_obj, "emissiveFactor");
         materials[i].uniforms.emissive_factor[0] = 0;
         materials[i].uniforms.emissive_factor[1] = 0;
         materials[i].uniforms.emissive_factor[2] = 0;
-        for(tmp = 0; tmp < 3 * (ki != Max_u32); ++tmp)
-            materials[i].uniforms.emissive_factor[tmp] = json_materials[i].values[ki].arr.nums[tmp];
-
-        ki = json_find_key(&json_materials[i], "alphaMode");
-        materials[i].flags |= ki != Max_u32 ? gltf_material_translate_alpha_mode(&json_materials[i].values[ki].str) : GLTF_MATERIAL_ALPHA_MODE_OPAQUE_BIT;
-        ki = json_find_key(&json_materials[i], "alphaCutoff");
-        materials[i].uniforms.alpha_cutoff = ki != Max_u32 ? json_materials[i].values[ki].num : 0.5;
-        ki = json_find_key(&json_materials[i], "doubleSided");
-        materials[i].flags |= ki != Max_u32 ? GLTF_MATERIAL_DOUBLE_SIDED_BIT & max32_if_true(json_materials[i].values[ki].boolean) : 0;
+        if (json_cursor_valid(c))
+            log_print_error_if(json_array_as_f32(c, materials[i].uniforms.emissive_factor, 3) != 3,
+                    "materials[%u].emissiveFactor must be 3 numbers", i);
+
+        c = json_cursor_find_key_lit(material_obj, "alphaMode");
+        if (json_cursor_valid(c)) {
+            str = json_cursor_str(c);
+            materials[i].flags |= gltf_material_translate_alpha_mode(&str);
+        } else {
+            materials[i].flags |= GLTF_MATERIAL_ALPHA_MODE_OPAQUE_BIT;
+        }
+        materials[i].uniforms.alpha_cutoff = gltf_num_or(json_cursor_find_key_lit(material_obj, "alphaCutoff"), 0.5);
+        c = json_cursor_find_key_lit(material_obj, "doubleSided");
+        materials[i].flags |= json_cursor_valid(c) ? GLTF_MATERIAL_DOUBLE_SIDED_BIT & max32_if_true(json_cursor_bool(c)) : 0;
     }
 }
 
@@ -1520,27 +2694,35 @@ static inline bool gltf_single_attr(uint i)
            i == GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_TANGENT;
 }
 
-static uint gltf_mesh_parse_primitive_attributes(json_object *j_attribs, struct gltf_extra_attrs *extra_attrs, gltf_mesh_primitive_attribute *attribs)
+static uint gltf_mesh_parse_primitive_attributes(json_cursor j_attribs, struct gltf_extra_attrs *extra_attrs, gltf_mesh_primitive_attribute *attribs)
 {
-    assert(j_attribs->key_count < 32);
+    uint key_count = json_cursor_len(j_attribs);
+    assert(key_count < 32);
+    json_string keys[32];
+    json_cursor values[32];
     uint attr_m[7];
     memset(attr_m,0,sizeof(attr_m));
     uint i;
-    for(i=0;i<j_attribs->key_count;++i) {
+    for(i=0;i<key_count;++i) {
+        values[i] = i ? json_cursor_next(values[i-1]) : json_cursor_child(j_attribs);
+        keys[i] = json_cursor_str(values[i]);
+        values[i] = json_cursor_value(values[i]);
+    }
+    for(i=0;i<key_count;++i) {
         attr_m[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_POSITION] |= (1<<i) &
-            max_if(memcmp(j_attribs->keys[i].cstr, "POSITION", GLTF_MESH_PRIMITIVE_ATTRIBUTE_KEY_LEN_POSITION) == 0);
+            max_if(memcmp(keys[i].cstr, "POSITION", GLTF_MESH_PRIMITIVE_ATTRIBUTE_KEY_LEN_POSITION) == 0);
         attr_m[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_JOINTS] |= (1<<i) &
-            max_if(memcmp(j_attribs->keys[i].cstr, "JOINTS", GLTF_MESH_PRIMITIVE_ATTRIBUTE_KEY_LEN_JOINTS) == 0);
+            max_if(memcmp(keys[i].cstr, "JOINTS", GLTF_MESH_PRIMITIVE_ATTRIBUTE_KEY_LEN_JOINTS) == 0);
         attr_m[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_WEIGHTS] |= (1<<i) &
-            max_if(memcmp(j_attribs->keys[i].cstr, "WEIGHTS", GLTF_MESH_PRIMITIVE_ATTRIBUTE_KEY_LEN_WEIGHTS) == 0);
+            max_if(memcmp(keys[i].cstr, "WEIGHTS", GLTF_MESH_PRIMITIVE_ATTRIBUTE_KEY_LEN_WEIGHTS) == 0);
         attr_m[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_NORMAL] |= (1<<i) &
-            max_if(memcmp(j_attribs->keys[i].cstr, "NORMAL", GLTF_MESH_PRIMITIVE_ATTRIBUTE_KEY_LEN_NORMAL) == 0);
+            max_if(memcmp(keys[i].cstr, "NORMAL", GLTF_MESH_PRIMITIVE_ATTRIBUTE_KEY_LEN_NORMAL) == 0);
         attr_m[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_TANGENT] |= (1<<i) &
-            max_if(memcmp(j_attribs->keys[i].cstr, "TANGENT", GLTF_MESH_PRIMITIVE_ATTRIBUTE_KEY_LEN_TANGENT) == 0);
+            max_if(memcmp(keys[i].cstr, "TANGENT", GLTF_MESH_PRIMITIVE_ATTRIBUTE_KEY_LEN_TANGENT) == 0);
         attr_m[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_TEXCOORD] |= (1<<i) &
-            max_if(memcmp(j_attribs->keys[i].cstr, "TEXCOORD", GLTF_MESH_PRIMITIVE_ATTRIBUTE_KEY_LEN_TEXCOORD) == 0);
+            max_if(memcmp(keys[i].cstr, "TEXCOORD", GLTF_MESH_PRIMITIVE_ATTRIBUTE_KEY_LEN_TEXCOORD) == 0);
         attr_m[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_COLOR] |= (1<<i) &
-            max_if(memcmp(j_attribs->keys[i].cstr, "COLOR",GLTF_MESH_PRIMITIVE_ATTRIBUTE_KEY_LEN_COLOR) == 0);
+            max_if(memcmp(keys[i].cstr, "COLOR",GLTF_MESH_PRIMITIVE_ATTRIBUTE_KEY_LEN_COLOR) == 0);
     }
 
     extra_attrs->norm = !attr_m[GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_NORMAL] &&
@@ -1564,10 +2746,10 @@ static uint gltf_mesh_parse_primitive_attributes(json_object *j_attribs, struct
             tz = ctz(attr_m[i]);
             attr_m[i] &= ~(1<<tz);
 
-            idx = ((j_attribs->keys[tz].cstr[ATTR_KEY_LENS[i]+1] - '0') & max_if(!gltf_single_attr(i))) + cnt;
+            idx = ((keys[tz].cstr[ATTR_KEY_LENS[i]+1] - '0') & max_if(!gltf_single_attr(i))) + cnt;
             attribs[idx].type = i;
-            attribs[idx].n = (j_attribs->keys[tz].cstr[ATTR_KEY_LENS[i]+1] - '0') | max_if(gltf_single_attr(i));
-            attribs[idx].accessor = j_attribs->values[tz].num;
+            attribs[idx].n = (keys[tz].cstr[ATTR_KEY_LENS[i]+1] - '0') | max_if(gltf_single_attr(i));
+            attribs[idx].accessor = json_cursor_num(values[tz]);
 
             // sections in shader.c rely on this assert
             assert((attribs[idx].n <= 7 || attribs[idx].n == Max_u32));
@@ -1577,69 +2759,63 @@ static uint gltf_mesh_parse_primitive_attributes(json_object *j_attribs, struct
     return extra_attr_cnt;
 }
 
-static uint gltf_mesh_parse_primitives(json_array *j_prim_array, struct gltf_extra_attrs *extra_attrs, allocator *alloc, gltf_mesh *mesh)
+static uint gltf_mesh_parse_primitives(json_cursor j_prims, struct gltf_extra_attrs *extra_attrs, allocator *alloc, gltf_mesh *mesh)
 {
-    json_object *j_prims = j_prim_array->objs;
-    json_object *j_attribs;
-    uint cnt = j_prim_array->len;
+    json_cursor j_prim, j_attribs, j_targets, c;
+    uint cnt = json_cursor_len(j_prims);
     mesh->primitive_count = cnt;
     mesh->primitives = sallocate(alloc, *mesh->primitives, cnt);
     gltf_mesh_primitive *prims = mesh->primitives;
     uint extra_attr_cnt = 0;
-    uint i,j,ki,tmp,cnt2;
+    uint i,j,tmp,cnt2;
     for(i = 0; i < cnt; ++i) {
-        ki = json_find_key(&j_prims[i], "attributes");
-        log_print_error_if(ki == Max_u32, "mesh.primitives.attributes must be defined");
+        j_prim = i ? json_cursor_next(j_prim) : json_cursor_child(j_prims);
+
+        j_attribs = json_cursor_find_key_lit(j_prim, "attributes");
+        log_print_error_if(!json_cursor_valid(j_attribs), "mesh.primitives.attributes must be defined");
 
-        prims[i].attribute_count = j_prims[i].values[ki].obj.key_count;
+        prims[i].attribute_count = json_cursor_len(j_attribs);
         prims[i].attributes = sallocate(alloc, *prims[i].attributes,
                 prims[i].attribute_count +
-                (json_find_key(&j_prims[i].values[ki].obj, "NORMAL") == Max_u32) +
-                (json_find_key(&j_prims[i].values[ki].obj, "TANGENT") == Max_u32));
+                !json_cursor_valid(json_cursor_find_key_lit(j_attribs, "NORMAL")) +
+                !json_cursor_valid(json_cursor_find_key_lit(j_attribs, "TANGENT")));
 
-        tmp = gltf_mesh_parse_primitive_attributes(&j_prims[i].values[ki].obj, extra_attrs + extra_attr_cnt, prims[i].attributes);
+        tmp = gltf_mesh_parse_primitive_attributes(j_attribs, extra_attrs + extra_attr_cnt, prims[i].attributes);
         extra_attrs[extra_attr_cnt].prim = i; // this out of bounds write is fine, I am allocating +1
         extra_attr_cnt += tmp;
 
-        tmp = json_find_key(&j_prims[i], "indices");
-        ki = tmp & max32_if_true(tmp != Max_u32);
-        prims[i].indices = (uint64)j_prims[i].values[ki].num | max64_if_true(tmp == Max_u32);
+        prims[i].indices = gltf_num_or(json_cursor_find_key_lit(j_prim, "indices"), Max_u32);
 
-        tmp = json_find_key(&j_prims[i], "material");
-        mesh->primitives_without_material_count += tmp == Max_u32;
-        ki = tmp & max32_if_true(tmp != Max_u32);
-        prims[i].material = (uint64)j_prims[i].values[ki].num | max64_if_true(tmp == Max_u32);
+        c = json_cursor_find_key_lit(j_prim, "material");
+        mesh->primitives_without_material_count += !json_cursor_valid(c);
+        prims[i].material = gltf_num_or(c, Max_u32);
 
-        tmp = json_find_key(&j_prims[i], "mode");
-        ki = tmp & max32_if_true(tmp != Max_u32);
+        c = json_cursor_find_key_lit(j_prim, "mode");
         prims[i].topology =
-            gltf_mesh_primitive_translate_mode((uint64)j_prims[i].values[ki].num | max64_if_true(tmp == Max_u32));
+            gltf_mesh_primitive_translate_mode(json_cursor_valid(c) ? (uint64)json_cursor_num(c) : Max_u64);
+
+        // Clusters need the buffers (see gltf_build_clusters).
+        prims[i].cluster_count = 0;
+        prims[i].clusters = NULL;
 
-        tmp = json_find_key(&j_prims[i], "targets");
-        ki = tmp & max32_if_true(tmp != Max_u32);
-        cnt2 = j_prims[i].values[ki].arr.len & max32_if_true(tmp != Max_u32);
+        j_targets = json_cursor_find_key_lit(j_prim, "targets");
+        cnt2 = gltf_array_len(j_targets);
         prims[i].target_count = cnt2;
         prims[i].morph_targets = sallocate(alloc, *prims->morph_targets, cnt2);
         for(j = 0; j < cnt2; ++j) {
-            j_attribs = &j_prims[i].values[ki].arr.objs[j];
-            prims[i].morph_targets[j].attribute_count = j_attribs->key_count;
+            j_attribs = j ? json_cursor_next(j_attribs) : json_cursor_child(j_targets);
+            prims[i].morph_targets[j].attribute_count = json_cursor_len(j_attribs);
             prims[i].morph_targets[j].attributes =
-                sallocate(alloc, *prims[i].morph_targets[j].attributes, j_attribs->key_count);
+                sallocate(alloc, *prims[i].morph_targets[j].attributes, prims[i].morph_targets[j].attribute_count);
             gltf_mesh_parse_primitive_attributes(j_attribs, extra_attrs + extra_attr_cnt, prims[i].morph_targets[j].attributes);
         }
     }
     return extra_attr_cnt;
 }
 
-static void gltf_parse_meshes(uint index, json *j, struct gltf_extra_attrs *extra_attrs, uint *extra_attr_count, allocator *alloc, gltf *g)
+static void gltf_parse_meshes(json_cursor j_meshes, struct gltf_extra_attrs *extra_attrs, uint *extra_attr_count, allocator *alloc, gltf *g)
 {
-    uint tmp = index;
-    tmp = max64_if_false(tmp == Max_u32);
-    index &= tmp;
-    json_object *json_meshes = j->obj.values[index].arr.objs;
-
-    uint cnt = j->obj.values[index].arr.len & tmp;
-    assert(cnt <= GLTF_MAX_MESH_COUNT);
+    uint cnt = gltf_array_len(j_meshes);
 
     g->mesh_count = cnt;
     g->meshes = sallocate(alloc, *g->meshes, cnt);
@@ -1647,54 +2823,46 @@ static void gltf_parse_meshes(uint index, json *j, struct gltf_extra_attrs *extr
 
     uint eac = 0;
 
-    uint i, ki;
+    json_cursor mesh_obj, c;
+    uint i, tmp;
     for(i = 0; i < cnt; ++i) {
+        mesh_obj = i ? json_cursor_next(mesh_obj) : json_cursor_child(j_meshes);
         meshes[i].joint_count = 0;
         meshes[i].primitives_without_material_count = 0;
+        meshes[i].position_scale = 0;
+        memset(meshes[i].position_offset, 0, sizeof(meshes[i].position_offset));
 
-        ki = json_find_key(&json_meshes[i], "primitives");
-        log_print_error_if(ki == Max_u32, "mesh.primitives must be defined");
-        tmp = eac + gltf_mesh_parse_primitives(&json_meshes[i].values[ki].arr, extra_attrs + eac, alloc, &meshes[i]);
+        c = json_cursor_find_key_lit(mesh_obj, "primitives");
+        log_print_error_if(!json_cursor_valid(c), "mesh.primitives must be defined");
+        tmp = eac + gltf_mesh_parse_primitives(c, extra_attrs + eac, alloc, &meshes[i]);
         for(; eac < tmp; ++eac)
             extra_attrs[eac].mesh = i; // this out of bounds write is fine, I am allocating +1
 
-        tmp = json_find_key(&json_meshes[i], "weights");
-        ki = tmp & max32_if_true(tmp != Max_u32);
-        meshes[i].weight_count = json_meshes[i].values[ki].arr.len & max32_if_true(tmp != Max_u32);
+        c = json_cursor_find_key_lit(mesh_obj, "weights");
+        meshes[i].weight_count = gltf_array_len(c);
         meshes[i].weights = sallocate(alloc, *meshes[i].weights, meshes[i].weight_count);
 
         log_print_error_if(meshes[i].weight_count > GLTF_MORPH_WEIGHT_COUNT, "meshes[%u].weight_count exceeds GLTF_MORPH_WEIGHT_COUNT");
-        for(tmp = 0; tmp < meshes[i].weight_count; ++tmp)
-            meshes[i].weights[tmp] = json_meshes[i].values[ki].arr.nums[tmp];
+        if (meshes[i].weight_count)
+            log_print_error_if(json_array_as_f32(c, meshes[i].weights, meshes[i].weight_count) == Max_u32,
+                    "meshes[%u].weights must be numbers", i);
     }
     *extra_attr_count = eac;
 }
 
-static void gltf_parse_nodes(uint index, json *j, allocator *alloc, gltf *g)
+static void gltf_parse_nodes(json_cursor j_nodes, allocator *alloc, gltf *g)
 {
-    uint tmp = index;
-    tmp = max64_if_false(tmp == Max_u32);
-    index &= tmp;
-    json_object *j_nodes = j->obj.values[index].arr.objs;
-
-    uint cnt = j->obj.values[index].arr.len & tmp;
-    assert(cnt <=  GLTF_MAX_NODE_COUNT);
-    assert(cnt <  (GLTF_U64_NODE_MASK<<6));
+    uint cnt = gltf_array_len(j_nodes);
 
     g->node_count = cnt;
     g->nodes = sallocate(alloc, *g->nodes, cnt);
     gltf_node *nodes = g->nodes;
 
-    uint64 mn[GLTF_MAX_NODE_COUNT>>6]; // meshed node masks
-    uint16 ic[GLTF_MAX_MESH_COUNT]; // mesh instance counts
-    memset(mn, 0, sizeof(mn));
-    memset(ic, 0, sizeof(ic));
-
-    float *mat4;
-    uint64 one = 1;
-
-    uint i,ki,mat,trs;
+    json_cursor node_obj, c;
+    float m[16];
+    uint i,tmp,mat,trs;
     for(i=0; i < cnt; ++i) {
+        node_obj = i ? json_cursor_next(node_obj) : json_cursor_child(j_nodes);
         mat = 0;
         trs = 0;
         bool t = 0;
@@ -1703,49 +2871,32 @@ static void gltf_parse_nodes(uint index, json *j, allocator *alloc, gltf *g)
 
         nodes[i].flags = 0;
 
-        ki = json_find_key(&j_nodes[i], "camera");
-        nodes[i].camera = ki != Max_u32 ? j_nodes[i].values[ki].num : Max_u32;
+        nodes[i].camera = gltf_num_or(json_cursor_find_key_lit(node_obj, "camera"), Max_u32);
 
-        ki = json_find_key(&j_nodes[i], "children");
+        c = json_cursor_find_key_lit(node_obj, "children");
         nodes[i].child_count = 0;
-        if (ki != Max_u32) {
-            nodes[i].child_count = j_nodes[i].values[ki].arr.len;
+        nodes[i].children = NULL;
+        if (json_cursor_valid(c)) {
+            nodes[i].child_count = json_cursor_len(c);
             nodes[i].children = sallocate(alloc, *nodes[i].children, nodes[i].child_count);
-            for(tmp=0;tmp<nodes[i].child_count;++tmp)
-                nodes[i].children[tmp] = j_nodes[i].values[ki].arr.nums[tmp];
+            log_print_error_if(json_array_as_u32(c, nodes[i].children, nodes[i].child_count) == Max_u32,
+                    "nodes[%u].children must be node indices", i);
         }
 
-        ki = json_find_key(&j_nodes[i], "skin");
-        nodes[i].skin = ki != Max_u32 ? j_nodes[i].values[ki].num : Max_u32;
+        nodes[i].skin = gltf_num_or(json_cursor_find_key_lit(node_obj, "skin"), Max_u32);
 
-        // @Note json.nums are stored as doubles.
-        ki = json_find_key(&j_nodes[i], "matrix");
-        if (ki != Max_u32) {
+        // gltf matrices are column major.
+        c = json_cursor_find_key_lit(node_obj, "matrix");
+        if (json_cursor_valid(c)) {
             mat = true;
-            nodes[i].mat.m[0]  = j_nodes[i].values[ki].arr.nums[0];
-            nodes[i].mat.m[1]  = j_nodes[i].values[ki].arr.nums[4];
-            nodes[i].mat.m[2]  = j_nodes[i].values[ki].arr.nums[8];
-            nodes[i].mat.m[3]  = j_nodes[i].values[ki].arr.nums[12];
-            nodes[i].mat.m[4]  = j_nodes[i].values[ki].arr.nums[1];
-            nodes[i].mat.m[5]  = j_nodes[i].values[ki].arr.nums[5];
-            nodes[i].mat.m[6]  = j_nodes[i].values[ki].arr.nums[9];
-            nodes[i].mat.m[7]  = j_nodes[i].values[ki].arr.nums[13];
-            nodes[i].mat.m[8]  = j_nodes[i].values[ki].arr.nums[2];
-            nodes[i].mat.m[9]  = j_nodes[i].values[ki].arr.nums[6];
-            nodes[i].mat.m[10] = j_nodes[i].values[ki].arr.nums[10];
-            nodes[i].mat.m[11] = j_nodes[i].values[ki].arr.nums[14];
-            nodes[i].mat.m[12] = j_nodes[i].values[ki].arr.nums[3];
-            nodes[i].mat.m[13] = j_nodes[i].values[ki].arr.nums[7];
-            nodes[i].mat.m[14] = j_nodes[i].values[ki].arr.nums[11];
-            nodes[i].mat.m[15] = j_nodes[i].values[ki].arr.nums[15];
+            log_print_error_if(json_array_as_f32(c, m, 16) != 16, "nodes[%u].matrix must be 16 numbers", i);
+            for(tmp=0;tmp<16;++tmp)
+                nodes[i].mat.m[(tmp & 3) * 4 + (tmp >> 2)] = m[tmp];
         }
 
-        ki = json_find_key(&j_nodes[i], "mesh");
-        if (ki != Max_u32) {
-            nodes[i].mesh = j_nodes[i].values[ki].num;
-
-            ic[nodes[i].mesh]++;
-            mn[nodes[i].mesh>>6] |= one << (nodes[i].mesh & 63);
+        c = json_cursor_find_key_lit(node_obj, "mesh");
+        if (json_cursor_valid(c)) {
+            nodes[i].mesh = json_cursor_num(c);
 
             if (nodes[i].skin != Max_u32)
                 g->meshes[nodes[i].mesh].joint_count = g->skins[nodes[i].skin].joint_count;
@@ -1753,47 +2904,46 @@ static void gltf_parse_nodes(uint index, json *j, allocator *alloc, gltf *g)
             nodes[i].mesh = Max_u32;
         }
 
-        ki = json_find_key(&j_nodes[i], "rotation");
-        if (ki != Max_u32) {
+        c = json_cursor_find_key_lit(node_obj, "rotation");
+        if (json_cursor_valid(c)) {
             log_print_error_if(mat, "either node.matrix or node.trs can be defined, not both.");
             trs = 1;
             r = 1;
-            nodes[i].trs.r.x = j_nodes[i].values[ki].arr.nums[0];
-            nodes[i].trs.r.y = j_nodes[i].values[ki].arr.nums[1];
-            nodes[i].trs.r.z = j_nodes[i].values[ki].arr.nums[2];
-            nodes[i].trs.r.w = j_nodes[i].values[ki].arr.nums[3];
+            log_print_error_if(json_array_as_f32(c, (float*)&nodes[i].trs.r, 4) != 4,
+                    "nodes[%u].rotation must be 4 numbers", i);
         }
-        ki = json_find_key(&j_nodes[i], "scale");
-        if (ki != Max_u32) {
+        c = json_cursor_find_key_lit(node_obj, "scale");
+        if (json_cursor_valid(c)) {
             log_print_error_if(mat, "either node.matrix or node.trs can be defined, not both.");
             trs = 1;
             s = 1;
-            nodes[i].trs.s.x = j_nodes[i].values[ki].arr.nums[0];
-            nodes[i].trs.s.y = j_nodes[i].values[ki].arr.nums[1];
-            nodes[i].trs.s.z = j_nodes[i].values[ki].arr.nums[2];
+            log_print_error_if(json_array_as_f32(c, (float*)&nodes[i].trs.s, 3) != 3,
+                    "nodes[%u].scale must be 3 numbers", i);
         }
-        ki = json_find_key(&j_nodes[i], "translation");
-        if (ki != Max_u32) {
+        c = json_cursor_find_key_lit(node_obj, "translation");
+        if (json_cursor_valid(c)) {
             log_print_error_if(mat, "either node.matrix or node.trs can be defined, not both.");
             trs = 1;
             t = 1;
-            nodes[i].trs.t.x = j_nodes[i].values[ki].arr.nums[0];
-            nodes[i].trs.t.y = j_nodes[i].values[ki].arr.nums[1];
-            nodes[i].trs.t.z = j_nodes[i].values[ki].arr.nums[2];
+            log_print_error_if(json_array_as_f32(c, (float*)&nodes[i].trs.t, 3) != 3,
+                    "nodes[%u].translation must be 3 numbers", i);
         }
 
         nodes[i].flags |= GLTF_NODE_MATRIX_BIT & max_if(mat);
         nodes[i].flags |= GLTF_NODE_TRS_BIT & max_if(trs);
 
-        ki = json_find_key(&j_nodes[i], "weights");
-        if (ki != Max_u32) {
-            nodes[i].weight_count = j_nodes[i].values[ki].arr.len;
+        c = json_cursor_find_key_lit(node_obj, "weights");
+        if (json_cursor_valid(c)) {
+            nodes[i].weight_count = json_cursor_len(c);
             nodes[i].weights = sallocate(alloc, *nodes[i].weights, nodes[i].weight_count);
-            for(tmp=0;tmp<nodes[i].weight_count;++tmp)
-                nodes[i].weights[tmp] = j_nodes[i].values[ki].arr.nums[tmp];
+            log_print_error_if(json_array_as_f32(c, nodes[i].weights, nodes[i].weight_count) == Max_u32,
+                    "nodes[%u].weights must be numbers", i);
         } else if (nodes[i].mesh != Max_u32 && g->meshes[nodes[i].mesh].weight_count) {
             nodes[i].weight_count = g->meshes[nodes[i].mesh].weight_count;
             nodes[i].weights = g->meshes[nodes[i].mesh].weights;
+        } else {
+            nodes[i].weight_count = 0;
+            nodes[i].weights = NULL;
         }
 
         vector vt = {0,0,0};
@@ -1857,130 +3007,116 @@ inline static gltf_sampler_address_mode gltf_sampler_translate_wrap(uint opt) {
     }
 }
 
-static void gltf_parse_samplers(uint index, json *j, allocator *alloc, gltf *g)
+static void gltf_parse_samplers(json_cursor j_samplers, allocator *alloc, gltf *g)
 {
-    uint tmp = index;
-    tmp = max64_if_false(tmp == Max_u32);
-    index &= tmp;
-    json_object *j_samplers = j->obj.values[index].arr.objs;
-
-    uint cnt = j->obj.values[index].arr.len & tmp;
+    uint cnt = gltf_array_len(j_samplers);
     g->sampler_count = cnt;
     g->samplers = sallocate(alloc, *g->samplers, cnt);
     gltf_sampler *samplers = g->samplers;
     gltf_sampler_mipmap_mode dummy;
-    uint i,ki;
+    json_cursor sampler_obj, c;
+    uint i;
     for(i=0; i < cnt;++i) {
-        ki = json_find_key(j_samplers, "magFilter");
-        if (ki != Max_u32)
-            gltf_sampler_translate_filter_mipmap(j_samplers[i].values[ki].num, false, &samplers[i].mag_filter, &dummy);
+        sampler_obj = i ? json_cursor_next(sampler_obj) : json_cursor_child(j_samplers);
+
+        c = json_cursor_find_key_lit(sampler_obj, "magFilter");
+        if (json_cursor_valid(c))
+            gltf_sampler_translate_filter_mipmap(json_cursor_num(c), false, &samplers[i].mag_filter, &dummy);
         else
             samplers[i].mag_filter = GLTF_SAMPLER_FILTER_NEAREST;
 
-        ki = json_find_key(j_samplers, "minFilter");
-        if (ki != Max_u32) {
-            gltf_sampler_translate_filter_mipmap(j_samplers[i].values[ki].num, true, &samplers[i].min_filter, &samplers[i].mipmap_mode);
+        c = json_cursor_find_key_lit(sampler_obj, "minFilter");
+        if (json_cursor_valid(c)) {
+            gltf_sampler_translate_filter_mipmap(json_cursor_num(c), true, &samplers[i].min_filter, &samplers[i].mipmap_mode);
         } else {
             samplers[i].min_filter = GLTF_SAMPLER_FILTER_NEAREST;
             samplers[i].mipmap_mode = GLTF_SAMPLER_MIPMAP_MODE_NEAREST;
         }
 
-        ki = json_find_key(j_samplers, "wrapS");
-        samplers[i].wrap_u = ki != Max_u32 ? gltf_sampler_translate_wrap(j_samplers[i].values[ki].num) : GLTF_SAMPLER_ADDRESS_MODE_REPEAT;
-        ki = json_find_key(j_samplers, "wrapT");
-        samplers[i].wrap_v = ki != Max_u32 ? gltf_sampler_translate_wrap(j_samplers[i].values[ki].num) : GLTF_SAMPLER_ADDRESS_MODE_REPEAT;
+        c = json_cursor_find_key_lit(sampler_obj, "wrapS");
+        samplers[i].wrap_u = json_cursor_valid(c) ? gltf_sampler_translate_wrap(json_cursor_num(c)) : GLTF_SAMPLER_ADDRESS_MODE_REPEAT;
+        c = json_cursor_find_key_lit(sampler_obj, "wrapT");
+        samplers[i].wrap_v = json_cursor_valid(c) ? gltf_sampler_translate_wrap(json_cursor_num(c)) : GLTF_SAMPLER_ADDRESS_MODE_REPEAT;
     }
 }
 
-static void gltf_parse_scenes(uint index, json *j, allocator *alloc, gltf *g)
+static void gltf_parse_scenes(json_cursor root, json_cursor j_scenes, allocator *alloc, gltf *g)
 {
-    uint tmp = index;
-    tmp = max64_if_false(tmp == Max_u32);
-    index &= tmp;
-    json_object *j_scenes = j->obj.values[index].arr.objs;
-
-    uint cnt = j->obj.values[index].arr.len & tmp;
+    uint cnt = gltf_array_len(j_scenes);
     g->scene_count = cnt;
     g->scenes = sallocate(alloc, *g->scenes, cnt);
     gltf_scene *scenes = g->scenes;
 
-    uint ki = json_find_key(&j->obj, "scene");
-    g->scene = ki != Max_u32 ? j->obj.values[ki].num : Max_u32;
+    g->scene = gltf_num_or(json_cursor_find_key_lit(root, "scene"), Max_u32);
 
-    uint i,tmp2;
+    json_cursor scene_obj, c;
+    uint i;
     char *ptr;
     for(i=0; i < cnt; ++i) {
-        ki = json_find_key(&j_scenes[i], "nodes");
-        if (ki != Max_u32) {
-            scenes[i].node_count = j_scenes[i].values[ki].arr.len;
+        scene_obj = i ? json_cursor_next(scene_obj) : json_cursor_child(j_scenes);
+
+        c = json_cursor_find_key_lit(scene_obj, "nodes");
+        if (json_cursor_valid(c)) {
+            scenes[i].node_count = json_cursor_len(c);
             scenes[i].nodes = sallocate(alloc, *scenes->nodes, scenes[i].node_count);
-            for(tmp2=0;tmp2<scenes[i].node_count;++tmp2)
-                scenes[i].nodes[tmp2] = j_scenes[i].values[ki].arr.nums[tmp2];
+            log_print_error_if(json_array_as_u32(c, scenes[i].nodes, scenes[i].node_count) == Max_u32,
+                    "scenes[%u].nodes must be node indices", i);
+        } else {
+            scenes[i].node_count = 0;
+            scenes[i].nodes = NULL;
         }
 
-        ki = json_find_key(&j_scenes[i], "name");
-        if (ki != Max_u32) {
-            tmp = j_scenes[i].values[ki].str.len;
+        c = json_cursor_find_key_lit(scene_obj, "name");
+        if (json_cursor_valid(c)) {
+            assert(json_cursor_len(c) < GLTF_MAX_URI_LEN);
             ptr = allocate(alloc, GLTF_MAX_URI_LEN);
-            memcpy(ptr, j_scenes[i].values[ki].str.cstr, tmp);
             scenes[i].name.cstr = ptr;
-            scenes[i].name.len = tmp;
+            scenes[i].name.len = json_string_unescape_to(json_cursor_str(c), ptr);
+        } else {
+            scenes[i].name = (string){NULL, 0};
         }
     }
 }
 
-static void gltf_parse_skins(uint index, json *j, allocator *alloc, gltf *g)
+static void gltf_parse_skins(json_cursor j_skins, allocator *alloc, gltf *g)
 {
-    uint tmp = index;
-    tmp = max64_if_false(tmp == Max_u32);
-    index &= tmp;
-    json_object *j_skins = j->obj.values[index].arr.objs;
-
-    uint cnt = j->obj.values[index].arr.len & tmp;
+    uint cnt = gltf_array_len(j_skins);
     g->skin_count = cnt;
     g->skins = sallocate(alloc, *g->skins, cnt);
     gltf_skin *skins = g->skins;
 
-    assert(g->skin_count < (GLTF_U64_SKIN_MASK<<6));
-
-    uint i,ki,i2;
+    json_cursor skin_obj, c;
+    uint i;
     for(i=0; i < cnt; ++i) {
-        ki = json_find_key(&j_skins[i], "joints");
-        log_print_error_if(ki == Max_u32, "skin.joints must be defined");
-        skins[i].joint_count = j_skins[i].values[ki].arr.len;
+        skin_obj = i ? json_cursor_next(skin_obj) : json_cursor_child(j_skins);
+
+        c = json_cursor_find_key_lit(skin_obj, "joints");
+        log_print_error_if(!json_cursor_valid(c), "skin.joints must be defined");
+        skins[i].joint_count = json_cursor_len(c);
         skins[i].joints = sallocate(alloc, *skins->joints, skins[i].joint_count);
         log_print_error_if(skins[i].joint_count > GLTF_JOINT_COUNT,
                 "vertex shader supports %i joint, model uses %u", GLTF_JOINT_COUNT, skins[i].joint_count);
-        for(i2=0; i2 < skins[i].joint_count; ++i2)
-            skins[i].joints[i2] = j_skins[i].values[ki].arr.nums[i2];
+        log_print_error_if(json_array_as_u32(c, skins[i].joints, skins[i].joint_count) == Max_u32,
+                "skins[%u].joints must be node indices", i);
 
-        tmp = json_find_key(&j_skins[i], "inverseBindMatrices");
-        ki = tmp & max32_if_true(tmp != Max_u32);
-        skins[i].inverse_bind_matrices = (uint64)j_skins[i].values[ki].num | max64_if_true(tmp == Max_u32);
-        tmp = json_find_key(&j_skins[i], "skeleton");
-        ki = tmp & max32_if_true(tmp != Max_u32);
-        skins[i].skeleton = (uint64)j_skins[i].values[ki].num | max64_if_true(tmp == Max_u32);
+        skins[i].inverse_bind_matrices = gltf_num_or(json_cursor_find_key_lit(skin_obj, "inverseBindMatrices"), Max_u32);
+        skins[i].skeleton = gltf_num_or(json_cursor_find_key_lit(skin_obj, "skeleton"), Max_u32);
     }
 }
 
-static void gltf_parse_textures(uint index, json *j, allocator *alloc, gltf *g)
+static void gltf_parse_textures(json_cursor j_textures, allocator *alloc, gltf *g)
 {
-    uint tmp = index;
-    tmp = max64_if_false(tmp == Max_u32);
-    index &= tmp;
-    json_object *j_textures = j->obj.values[index].arr.objs;
-
-    uint cnt = j->obj.values[index].arr.len & tmp;
+    uint cnt = gltf_array_len(j_textures);
     g->texture_count = cnt;
     g->textures = sallocate(alloc, *g->textures, cnt);
     gltf_texture *textures = g->textures;
 
-    uint i,ki;
+    json_cursor texture_obj;
+    uint i;
     for(i=0; i < cnt; ++i) {
-        ki = json_find_key(&j_textures[i], "sampler");
-        textures[i].sampler = ki != Max_u32 ? j_textures[i].values[ki].num : Max_u32;
-        ki = json_find_key(&j_textures[i], "source");
-        textures[i].source = ki != Max_u32 ? j_textures[i].values[ki].num : Max_u32;
+        texture_obj = i ? json_cursor_next(texture_obj) : json_cursor_child(j_textures);
+        textures[i].sampler = gltf_num_or(json_cursor_find_key_lit(texture_obj, "sampler"), Max_u32);
+        textures[i].source = gltf_num_or(json_cursor_find_key_lit(texture_obj, "source"), Max_u32);
     }
 }
 
@@ -1998,11 +3134,18 @@ static void test_gltf_samplers(test_suite *suite, gltf *g);
 static void test_gltf_scenes(test_suite *suite, gltf *g);
 static void test_gltf_skins(test_suite *suite, gltf *g);
 static void test_gltf_textures(test_suite *suite, gltf *g);
+static void test_gltf_sol(test_suite *suite, gltf *g);
+static void test_gltf_source_hash(test_suite *suite, gltf *g);
+static void test_gltf_glb(test_suite *suite);
+static void test_gltf_cook(test_suite *suite);
 
 void test_gltf(test_suite *suite)
 {
-    struct allocation mem_used;
-    gltf g = parse_gltf("test_gltf.gltf", NULL, NULL, suite->alloc, suite->alloc, &mem_used);
+    gltf g;
+    if (!parse_gltf("test/test_gltf.gltf", NULL, NULL, NULL, suite->alloc, suite->alloc, &g)) {
+        log_print_error("failed to parse test/test_gltf.gltf");
+        return;
+    }
 
     assert(g.accessor_count == 4 && "Incorrect Accessor Count");
     test_gltf_accessors(suite, &g);
@@ -2031,7 +3174,290 @@ void test_gltf(test_suite *suite)
     assert(g.texture_count == 4 && "Incorrect Texture Count");
     test_gltf_textures(suite, &g);
 
-    deallocate(suite->alloc, mem_used.data);
+    test_gltf_sol(suite, &g);
+    test_gltf_source_hash(suite, &g);
+    test_gltf_glb(suite);
+    test_gltf_cook(suite);
+
+    deallocate(suite->alloc, g.meta.data);
+}
+
+// The .sol image of a model is written with every pointer as an offset, so
+// two models hold the same arrays exactly when their images are equal.
+static bool test_gltf_same_image(gltf *a, gltf *b, allocator *alloc)
+{
+    char *image_a, *image_b;
+    uint64 size_a = gltf_sol_image(a, "test/test_gltf.gltf", alloc, &image_a);
+    uint64 size_b = gltf_sol_image(b, "test/test_gltf.gltf", alloc, &image_b);
+    return size_a == size_b && !memcmp(image_a, image_b, size_a);
+}
+
+// Every array of 'g' is at the same place in meta and has the same length in
+// 'm', which was mapped from g's .sol.
+#define TEST_GLTF_SOL_ARRAY(name, array, count) \
+    TEST_EQ(name, m->count, g->count, false); \
+    TEST_EQ(name, (char*)m->array - (char*)m->meta.data, (char*)g->array - (char*)g->meta.data, false)
+
+static void test_gltf_sol_arrays(test_suite *suite, gltf *g, gltf *m, allocator *temp)
+{
+    TEST_EQ("sol.meta.size", m->meta.size, g->meta.size, false);
+    TEST_GLTF_SOL_ARRAY("sol.accessors", accessors, accessor_count);
+    TEST_GLTF_SOL_ARRAY("sol.animations", animations, animation_count);
+    TEST_GLTF_SOL_ARRAY("sol.buffers", buffers, buffer_count);
+    TEST_GLTF_SOL_ARRAY("sol.buffer_views", buffer_views, buffer_view_count);
+    TEST_GLTF_SOL_ARRAY("sol.cameras", cameras, camera_count);
+    TEST_GLTF_SOL_ARRAY("sol.images", images, image_count);
+    TEST_GLTF_SOL_ARRAY("sol.materials", materials, material_count);
+    TEST_GLTF_SOL_ARRAY("sol.meshes", meshes, mesh_count);
+    TEST_GLTF_SOL_ARRAY("sol.nodes", nodes, node_count);
+    TEST_GLTF_SOL_ARRAY("sol.samplers", samplers, sampler_count);
+    TEST_GLTF_SOL_ARRAY("sol.scenes", scenes, scene_count);
+    TEST_GLTF_SOL_ARRAY("sol.skins", skins, skin_count);
+    TEST_GLTF_SOL_ARRAY("sol.textures", textures, texture_count);
+    TEST_EQ("sol.dir", m->dir.len, g->dir.len, false);
+    TEST_EQ("sol.dir", memcmp(m->dir.cstr, g->dir.cstr, g->dir.len), 0, false);
+    TEST_EQ("sol.image", test_gltf_same_image(g, m, temp), true, false);
+}
+
+#undef TEST_GLTF_SOL_ARRAY
+
+static void test_gltf_sol(test_suite *suite, gltf *g)
+{
+    BEGIN_TEST_MODULE("gltf_sol", false, false);
+
+    const char *file_name = "test/test_gltf.gltf";
+    const char *sol_name = "test/test_gltf.gltf.sol";
+    allocator temp = new_linear_allocator(1 << 20, NULL);
+    store_gltf(g, file_name, &temp);
+
+    gltf m;
+    struct file f = file_map_private(sol_name);
+    bool mapped = gltf_sol_load(file_name, sol_name, f, &m);
+    TEST_EQ("sol.load", mapped, true, false);
+    if (mapped) {
+        test_gltf_sol_arrays(suite, g, &m, &temp);
+        // The mapped model is checked as the parsed one is.
+        TEST_EQ("sol.accessors[3].count", m.accessors[3].count, g->accessors[3].count, false);
+        TEST_EQ("sol.meshes[1].primitives[1].attributes[5].accessor",
+                m.meshes[1].primitives[1].attributes[5].accessor, 13, false);
+        TEST_EQ("sol.nodes[2].children[3]", m.nodes[2].children[3], 4, false);
+    }
+    file_unmap(&f);
+
+    // A flipped bit anywhere after the header is caught by the hash.
+    struct file sol = file_read_all(sol_name, &temp);
+    sol.data[sol.size - 1] ^= 1;
+    file_write_bin(sol_name, sol.size, sol.data);
+    f = file_map_private(sol_name);
+    TEST_EQ("sol.corrupt", gltf_sol_load(file_name, sol_name, f, &m), false, false);
+    file_unmap(&f);
+
+    // So is a file written by a different version.
+    sol.data[sol.size - 1] ^= 1;
+    sol.data[offsetof(gltf_sol_header, version)] ^= 1;
+    file_write_bin(sol_name, sol.size, sol.data);
+    f = file_map_private(sol_name);
+    TEST_EQ("sol.version", gltf_sol_load(file_name, sol_name, f, &m), false, false);
+    file_unmap(&f);
+
+    remove(sol_name);
+    free_allocator(&temp);
+
+    END_TEST_MODULE();
+}
+
+static bool test_gltf_sol_is_current(const char *file_name, const char *sol_name)
+{
+    gltf m;
+    struct file f = file_map_private(sol_name);
+    bool current = gltf_sol_load(file_name, sol_name, f, &m);
+    file_unmap(&f);
+    return current;
+}
+
+// The .sol is keyed on the contents of the .gltf rather than on when it was
+// written, so it is tested against a copy which can be touched.
+static void test_gltf_source_hash(test_suite *suite, gltf *g)
+{
+    BEGIN_TEST_MODULE("gltf_source_hash", false, false);
+
+    const char *file_name = "test/test_gltf_touched.gltf";
+    const char *sol_name = "test/test_gltf_touched.gltf.sol";
+    allocator temp = new_linear_allocator(1 << 20, NULL);
+    struct file src = file_read_all("test/test_gltf.gltf", &temp);
+    file_write_bin(file_name, src.size, src.data);
+    store_gltf(g, file_name, &temp);
+    TEST_EQ("source_hash.stored", test_gltf_sol_is_current(file_name, sol_name), true, false);
+
+    // Writing the same bytes again is newer but unchanged.
+    file_write_bin(file_name, src.size, src.data);
+    TEST_EQ("source_hash.rewritten", test_gltf_sol_is_current(file_name, sol_name), true, false);
+
+    // Whitespace leaves the json the same, but not the file.
+    file_append_char(file_name, 1, " ");
+    TEST_EQ("source_hash.touched", test_gltf_sol_is_current(file_name, sol_name), false, false);
+
+    // Loading parses the touched file and replaces its .sol, which is then
+    // current.
+    gltf m;
+    bool loaded = load_gltf(file_name, NULL, NULL, NULL, &temp, suite->alloc, &m);
+    TEST_EQ("source_hash.load", loaded, true, false);
+    if (loaded) {
+        TEST_EQ("source_hash.load.node_count", m.node_count, g->node_count, false);
+        TEST_EQ("source_hash.reloaded", test_gltf_sol_is_current(file_name, sol_name), true, false);
+        deallocate(suite->alloc, m.meta.data);
+    }
+
+    remove(sol_name);
+    remove(file_name);
+    free_allocator(&temp);
+
+    END_TEST_MODULE();
+}
+
+// The mapping of a .glb which 'g' was loaded from, given its own mapping of
+// the same file.
+static struct file test_gltf_glb_mapping(gltf *g, struct file glb, struct file bin)
+{
+    return (struct file){g->bin.data - (bin.data - glb.data), glb.size};
+}
+
+// test/test_glb.glb: one triangle in the xy plane with normals along z,
+// tangents along x and 16 bit indices, all in the BIN chunk. Nothing is
+// missing, so no buffer is added for generated attributes.
+static void test_gltf_glb(test_suite *suite)
+{
+    BEGIN_TEST_MODULE("gltf_glb", false, false);
+
+    const char *file_name = "test/test_glb.glb";
+    const char *sol_name = "test/test_glb.glb.sol";
+    allocator temp = new_linear_allocator(1 << 20, NULL);
+    struct file glb, json, bin;
+    bool valid = gltf_map_glb(file_name, &glb, &json, &bin);
+    TEST_EQ("glb.valid", valid, true, false);
+    TEST_EQ("glb.bin.size", bin.size, 128, false);
+
+    gltf g;
+    bool parsed = valid && parse_gltf(file_name, NULL, NULL, NULL, &temp, suite->alloc, &g);
+    TEST_EQ("glb.parse", parsed, true, false);
+    if (!parsed) {
+        file_unmap(&glb);
+        free_allocator(&temp);
+        END_TEST_MODULE();
+        return;
+    }
+
+    TEST_EQ("glb.mesh_count", g.mesh_count, 1, false);
+    TEST_EQ("glb.accessor_count", g.accessor_count, 4, false);
+    TEST_EQ("glb.buffer_view_count", g.buffer_view_count, 4, false);
+    TEST_EQ("glb.buffer_count", g.buffer_count, 1, false);
+    TEST_EQ("glb.buffers[0].uri", g.buffers[0].uri.len, 0, false);
+    TEST_EQ("glb.buffers[0].byte_length", g.buffers[0].byte_length, 128, false);
+    TEST_EQ("glb.meshes[0].primitives[0].attribute_count", g.meshes[0].primitives[0].attribute_count, 3, false);
+    TEST_EQ("glb.meshes[0].primitives[0].indices", g.meshes[0].primitives[0].indices, 3, false);
+
+    // The BIN chunk is used where it lies in the mapping.
+    TEST_EQ("glb.bin", g.bin.size, bin.size, false);
+    TEST_EQ("glb.bin", memcmp(g.bin.data, bin.data, bin.size), 0, false);
+
+    char *buffer = allocate(&temp, g.buffers[0].byte_length);
+    gltf_read_buffers(&g, &buffer, NULL, &temp);
+    float *positions = (float*)(buffer + g.buffer_views[g.accessors[0].buffer_view].byte_offset);
+    float *normals = (float*)(buffer + g.buffer_views[g.accessors[1].buffer_view].byte_offset);
+    float *tangents = (float*)(buffer + g.buffer_views[g.accessors[2].buffer_view].byte_offset);
+    uint16 *indices = (uint16*)(buffer + g.buffer_views[g.accessors[3].buffer_view].byte_offset);
+    TEST_FEQ("glb.positions[1].x", positions[3], 1, false);
+    TEST_FEQ("glb.positions[2].y", positions[7], 1, false);
+    TEST_FEQ("glb.normals[2].z", normals[8], 1, false);
+    TEST_FEQ("glb.tangents[2].x", tangents[8], 1, false);
+    TEST_EQ("glb.indices[2]", indices[2], 2, false);
+
+    // The .sol leaves the BIN chunk out, and maps the .glb again to find it.
+    store_gltf(&g, file_name, &temp);
+    gltf m;
+    struct file f = file_map_private(sol_name);
+    bool mapped = gltf_sol_load(file_name, sol_name, f, &m) && gltf_sol_map_bin(file_name, &m);
+    TEST_EQ("glb.sol", mapped, true, false);
+    if (mapped) {
+        TEST_EQ("glb.sol.buffers[0].uri", m.buffers[0].uri.len, 0, false);
+        TEST_EQ("glb.sol.bin", m.bin.size, bin.size, false);
+        TEST_EQ("glb.sol.bin", memcmp(m.bin.data, bin.data, bin.size), 0, false);
+        struct file mapping = test_gltf_glb_mapping(&m, glb, bin);
+        file_unmap(&mapping);
+    }
+    file_unmap(&f);
+    remove(sol_name);
+
+    // A .glb which is cut short is rejected.
+    const char *short_name = "test/test_glb_short.glb";
+    file_write_bin(short_name, glb.size / 2, glb.data);
+    gltf s;
+    TEST_EQ("glb.short", parse_gltf(short_name, NULL, NULL, NULL, &temp, suite->alloc, &s), false, false);
+    remove(short_name);
+
+    struct file mapping = test_gltf_glb_mapping(&g, glb, bin);
+    file_unmap(&mapping);
+    file_unmap(&glb);
+    deallocate(suite->alloc, g.meta.data);
+    free_allocator(&temp);
+
+    END_TEST_MODULE();
+}
+
+// test/test_glb.glb is cooked and loaded back. Its one triangle is already in
+// the order which optimizing would give it, so the cooked buffer is the BIN
+// chunk unchanged.
+static void test_gltf_cook(test_suite *suite)
+{
+    BEGIN_TEST_MODULE("gltf_cook", false, false);
+
+    const char *file_name = "test/test_glb.glb";
+    const char *cook_name = "test/test_glb.glb.cook";
+    allocator temp = new_linear_allocator(1 << 20, NULL);
+    allocator persistent = new_linear_allocator(1 << 20, NULL);
+    struct file glb, json, bin;
+    gltf_map_glb(file_name, &glb, &json, &bin);
+
+    bool cooked = cook_gltf(file_name, 0x0, NULL, &temp, &persistent);
+    TEST_EQ("cook", cooked, true, false);
+
+    // load_gltf takes the .cook over parsing, so it writes no .sol.
+    gltf g;
+    bool loaded = cooked && load_gltf(file_name, NULL, NULL, NULL, &temp, &persistent, &g);
+    TEST_EQ("cook.load", loaded, true, false);
+    if (loaded) {
+        TEST_EQ("cook.load.sol", file_exists("test/test_glb.glb.sol"), false, false);
+        TEST_EQ("cook.load.cook", g.cook.buffers != NULL, true, false);
+        TEST_EQ("cook.load.mesh_count", g.mesh_count, 1, false);
+        TEST_EQ("cook.load.accessor_count", g.accessor_count, 4, false);
+        TEST_EQ("cook.load.buffers[0].byte_length", g.buffers[0].byte_length, bin.size, false);
+        TEST_EQ("cook.load.clusters", g.meshes[0].primitives[0].cluster_count, 1, false);
+
+        // Buffers are read from the .cook rather than from the BIN chunk.
+        char *buffer = allocate(&temp, g.buffers[0].byte_length);
+        gltf_read_buffers(&g, &buffer, NULL, &temp);
+        TEST_EQ("cook.load.buffers[0]", memcmp(buffer, bin.data, bin.size), 0, false);
+
+        struct file f = {g.cook.file, file_size(cook_name)};
+        struct file mapping = test_gltf_glb_mapping(&g, glb, bin);
+        file_unmap(&mapping);
+        file_unmap(&f);
+    }
+
+    // A .cook whose buffers have changed is caught by its hash.
+    if (cooked) {
+        struct file cook = file_read_all(cook_name, &temp);
+        cook.data[cook.size - 1] ^= 1;
+        file_write_bin(cook_name, cook.size, cook.data);
+        TEST_EQ("cook.corrupt", gltf_map_cook(file_name, cook_name, &g), false, false);
+    }
+
+    remove(cook_name);
+    file_unmap(&glb);
+    free_allocator(&persistent);
+    free_allocator(&temp);
+
+    END_TEST_MODULE();
 }
 
 static void test_gltf_accessors(test_suite *suite, gltf *g)
@@ -2483,30 +3909,32 @@ static void test_gltf_meshes(test_suite *suite, gltf *g)
     TEST_EQ("mesh[1].primitives[1]", prim->topology, 3, false);
     TEST_EQ("mesh[1].primitives[1]", prim->attribute_count, 6, false);
     TEST_EQ("mesh[1].primitives[1]", prim->target_count, 2, false);
-    attr = &prim->attributes[1];
-    TEST_EQ("mesh[1].primitives[1].attributes[0]", attr->n, Max_u32, false);
-    TEST_EQ("mesh[1].primitives[1].attributes[0]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_NORMAL, false);
-    TEST_EQ("mesh[1].primitives[1].attributes[0]", attr->accessor, 13, false);
+    // Attributes are laid out by type, in the order of the type enum, and then
+    // by set, so joints and weights come before the normal.
     attr = &prim->attributes[0];
-    TEST_EQ("mesh[1].primitives[1].attributes[1]", attr->n, Max_u32, false);
-    TEST_EQ("mesh[1].primitives[1].attributes[1]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_POSITION, false);
-    TEST_EQ("mesh[1].primitives[1].attributes[1]", attr->accessor, 12, false);
+    TEST_EQ("mesh[1].primitives[1].attributes[0]", attr->n, Max_u32, false);
+    TEST_EQ("mesh[1].primitives[1].attributes[0]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_POSITION, false);
+    TEST_EQ("mesh[1].primitives[1].attributes[0]", attr->accessor, 12, false);
+    attr = &prim->attributes[1];
+    TEST_EQ("mesh[1].primitives[1].attributes[1]", attr->n, 0, false);
+    TEST_EQ("mesh[1].primitives[1].attributes[1]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_JOINTS, false);
+    TEST_EQ("mesh[1].primitives[1].attributes[1]", attr->accessor, 14, false);
     attr = &prim->attributes[2];
-    TEST_EQ("mesh[1].primitives[1].attributes[2]", attr->n, 0, false);
+    TEST_EQ("mesh[1].primitives[1].attributes[2]", attr->n, 1, false);
     TEST_EQ("mesh[1].primitives[1].attributes[2]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_JOINTS, false);
     TEST_EQ("mesh[1].primitives[1].attributes[2]", attr->accessor, 14, false);
-    attr = &prim->attributes[4];
+    attr = &prim->attributes[3];
     TEST_EQ("mesh[1].primitives[1].attributes[3]", attr->n, 0, false);
     TEST_EQ("mesh[1].primitives[1].attributes[3]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_WEIGHTS, false);
     TEST_EQ("mesh[1].primitives[1].attributes[3]", attr->accessor, 15, false);
-    attr = &prim->attributes[3];
+    attr = &prim->attributes[4];
     TEST_EQ("mesh[1].primitives[1].attributes[4]", attr->n, 1, false);
-    TEST_EQ("mesh[1].primitives[1].attributes[4]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_JOINTS, false);
-    TEST_EQ("mesh[1].primitives[1].attributes[4]", attr->accessor, 14, false);
+    TEST_EQ("mesh[1].primitives[1].attributes[4]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_WEIGHTS, false);
+    TEST_EQ("mesh[1].primitives[1].attributes[4]", attr->accessor, 15, false);
     attr = &prim->attributes[5];
-    TEST_EQ("mesh[1].primitives[1].attributes[5]", attr->n, 1, false);
-    TEST_EQ("mesh[1].primitives[1].attributes[5]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_WEIGHTS, false);
-    TEST_EQ("mesh[1].primitives[1].attributes[5]", attr->accessor, 15, false);
+    TEST_EQ("mesh[1].primitives[1].attributes[5]", attr->n, Max_u32, false);
+    TEST_EQ("mesh[1].primitives[1].attributes[5]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_NORMAL, false);
+    TEST_EQ("mesh[1].primitives[1].attributes[5]", attr->accessor, 13, false);
 
     target = &prim->morph_targets[0];
     TEST_EQ("mesh[1].primitives[1].targets[0].attribute_count", target->attribute_count, 3, false);
@@ -2568,17 +3996,17 @@ static void test_gltf_meshes(test_suite *suite, gltf *g)
     target = &prim->morph_targets[0];
     TEST_EQ("mesh[0].primitives[2].targets[0].attribute_count", target->attribute_count, 3, false);
     attr = &target->attributes[0];
-    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[0]", attr->n, Max_u32, false);
-    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[0]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_NORMAL, false);
-    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[0]", attr->accessor, 3, false);
+    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[0]", attr->n, 0, false);
+    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[0]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_JOINTS, false);
+    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[0]", attr->accessor, 2, false);
     attr = &target->attributes[1];
     TEST_EQ("mesh[1].primitives[2].targets[0].attributes[1]", attr->n, 0, false);
-    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[1]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_JOINTS, false);
-    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[1]", attr->accessor, 2, false);
+    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[1]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_WEIGHTS, false);
+    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[1]", attr->accessor, 4, false);
     attr = &target->attributes[2];
-    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[2]", attr->n, 0, false);
-    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[2]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_WEIGHTS, false);
-    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[2]", attr->accessor, 4, false);
+    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[2]", attr->n, Max_u32, false);
+    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[2]", attr->type, GLTF_MESH_PRIMITIVE_ATTRIBUTE_TYPE_NORMAL, false);
+    TEST_EQ("mesh[1].primitives[2].targets[0].attributes[2]", attr->accessor, 3, false);
 
     target = &prim->morph_targets[1];
     TEST_EQ("mesh[1].primitives[2].targets[1]", target->attribute_count, 3, false);
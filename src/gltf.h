@@ -8,22 +8,12 @@
 #include "math.h"
 #include "test.h"
 #include "string.h"
+#include "thread.h"
+#include "bitset.h"
+#include "mesh.h"
 
 #include "gltf_limits.h"
 
-inline static bool gltf_is_node_mask_zero(uint64 node_mask[GLTF_U64_NODE_MASK])
-{
-    bool b = false;
-    for(uint i=0; i < GLTF_U64_NODE_MASK; ++i)
-        b = node_mask[i] || b;
-    return !b;
-}
-
-inline static bool gltf_is_skin_mask_zero(uint64 skin_mask)
-{
-    return !skin_mask;
-}
-
 typedef enum {
     GLTF_ACCESSOR_COMPONENT_TYPE_BYTE_BIT           = 0x0001,
     GLTF_ACCESSOR_COMPONENT_TYPE_UNSIGNED_BYTE_BIT  = 0x0002,
@@ -289,8 +279,10 @@ typedef struct {
     uint material;
     uint attribute_count;
     uint target_count;
+    uint cluster_count;
     gltf_mesh_primitive_attribute *attributes;
     gltf_mesh_primitive_morph_target *morph_targets;
+    struct mesh_cluster *clusters; // of triangle lists, in model space, only if cooked (see gltf_build_clusters)
     gltf_mesh_primitive_topology topology;
 } gltf_mesh_primitive;
 
@@ -300,6 +292,14 @@ typedef struct {
     uint primitive_count;
     uint primitives_without_material_count;
     uint weight_count;
+
+    // Set by gltf_quantize_meshes when the mesh's positions are stored as
+    // unsigned normalized shorts, which the mesh's transform must map back:
+    // position = position_offset + position_scale * stored. Zero when the
+    // positions are floats.
+    float position_scale;
+    float position_offset[3];
+
     gltf_mesh_primitive *primitives;
     float *weights;
 } gltf_mesh;
@@ -366,6 +366,17 @@ typedef struct {
     uint source;
 } gltf_texture;
 
+// An image in a .cook, decoded to rgba: level zero and then each mip level,
+// 'size' bytes in all, starting 'offset' bytes into the file.
+struct gltf_cook_image {
+    uint32 x;
+    uint32 y;
+    uint32 miplevels;
+    uint32 pad;
+    uint64 offset;
+    uint64 size;
+};
+
 typedef struct {
     uint scene;
     uint accessor_count;
@@ -402,8 +413,25 @@ typedef struct {
         void *data;
     } meta;
 
+    // The BIN chunk when the model is a .glb, which stays mapped for the life
+    // of the model. Buffers without a uri are read from it in place.
+    struct {
+        uint64  size;
+        char   *data;
+    } bin;
+
+    // Set when the model was loaded from a .cook (see cook_gltf), which stays
+    // mapped for the life of the model. Every buffer and image is read from
+    // it in place rather than from the model's files.
+    struct {
+        char                   *buffers; // back to back in buffer order
+        struct gltf_cook_image *images;
+        char                   *file;    // base of the image offsets
+    } cook;
+
 } gltf;
 
+// 'skin_mask' is a bitset of skin_count bits.
 static inline void
 gltf_count_mesh_instances(gltf_node *nodes, uint node, uint *instance_counts, uint64 *skin_mask)
 {
@@ -411,8 +439,7 @@ gltf_count_mesh_instances(gltf_node *nodes, uint node, uint *instance_counts, ui
     uint skin = nodes[node].skin != Max_u32 ? nodes[node].skin : 0;
 
     instance_counts[mesh] += nodes[node].mesh != Max_u32;
-    *skin_mask |= (1 << skin) & maxif(nodes[node].skin != Max_u32);
-    assert(skin < 64);
+    bitset_set_if(skin_mask, skin, nodes[node].skin != Max_u32);
 
     for(uint i=0; i < nodes[node].child_count; ++i)
         gltf_count_mesh_instances(nodes, nodes[node].children[i], instance_counts, skin_mask);
@@ -420,6 +447,21 @@ gltf_count_mesh_instances(gltf_node *nodes, uint node, uint *instance_counts, ui
 
 static inline struct image gltf_load_image(gltf *model, uint image_i)
 {
+    if (model->cook.images) {
+        struct gltf_cook_image *img = &model->cook.images[image_i];
+        return load_image_mip_chain((uchar*)model->cook.file + img->offset, img->x, img->y, img->miplevels);
+    }
+    if (!model->images[image_i].uri.cstr) {
+        // Images in an external buffer are read by gltf_load_images.
+        gltf_buffer_view *view = &model->buffer_views[model->images[image_i].buffer_view];
+        if (model->buffers[view->buffer].uri.len || !model->bin.data ||
+            view->byte_offset + view->byte_length > model->bin.size)
+        {
+            log_print_error("images[%u] is not in the BIN chunk", image_i);
+            return (struct image){};
+        }
+        return load_image_memory((uchar*)model->bin.data + view->byte_offset, view->byte_length);
+    }
     char uri[256];
     memcpy(uri, model->dir.cstr, model->dir.len);
     memcpy(uri + model->dir.len, model->images[image_i].uri.cstr,
@@ -433,23 +475,97 @@ static inline int gltf_open_buffer_w(gltf *g, uint buf_i)
     memcpy(buf, g->dir.cstr, g->dir.len);
     memcpy(buf + g->dir.len, g->buffers[buf_i].uri.cstr,
                              g->buffers[buf_i].uri.len + 1);
-    return file_open(buf, WRITE);
+    return file_open(buf, WRITE|CREATE);
 }
 
 static inline void gltf_read_buffer(gltf *model, uint buf_i, char *to)
 {
+    if (model->cook.buffers) {
+        uint64 offset = 0;
+        for(uint i=0; i < buf_i; ++i)
+            offset += model->buffers[i].byte_length;
+        memcpy(to, model->cook.buffers + offset, model->buffers[buf_i].byte_length);
+        return;
+    }
+    if (!model->buffers[buf_i].uri.len) {
+        assert(model->bin.size >= model->buffers[buf_i].byte_length);
+        memcpy(to, model->bin.data, model->buffers[buf_i].byte_length);
+        return;
+    }
     char uri[256];
     memcpy(uri, model->dir.cstr, model->dir.len);
     memcpy(uri + model->dir.len, model->buffers[buf_i].uri.cstr, model->buffers[buf_i].uri.len + 1);
     file_open_read(uri, 0, model->buffers[buf_i].byte_length, to);
 }
 
+// Read every buffer 'i' for which to[i] is not NULL, and load every image,
+// issuing all of the file reads at once on 'pool', which may be NULL. Images
+// are decoded on the calling thread as their reads complete, so decoding
+// overlaps with the reads which are still in flight. Buffers and images in a
+// glb's BIN chunk are copied or decoded from the mapping, and images in an
+// external buffer are read from the buffer's file. Image reads are issued in
+// batches of at most GLTF_IMAGE_BATCH_SIZE bytes of 'temp', which are freed as
+// each batch is decoded, and a larger image is decoded from a mapping.
+#define GLTF_IMAGE_BATCH_SIZE (2 << 20)
+void gltf_read_buffers(gltf *model, char **to, thread_pool *pool, allocator *temp);
+void gltf_load_images(gltf *model, struct image *images, thread_pool *pool, allocator *temp);
+
+// Reorder each indexed triangle list primitive's triangles for the vertex
+// cache and then for overdraw, and renumber its vertices in the order the new
+// indices use them, rewriting the buffers in 'buffers' (as filled in by
+// gltf_read_buffers) in place. Vertices are only renumbered where nothing else
+// shares the primitive's vertex data. The cooker always does this; loading
+// does when GLTF_OPTIMIZE_MESHES_ON_LOAD is set, which is off as it works on
+// the mapped upload memory, and so leaves the clusters which were built from
+// the original order behind.
+#define GLTF_OPTIMIZE_MESHES_ON_LOAD 0
+#define GLTF_PRINT_MESH_STATS 1
+void gltf_optimize_meshes(gltf *model, char **buffers, allocator *temp);
+
+// Store float vertex attributes as normalized integers, in place in 'buffers'
+// as for gltf_optimize_meshes, then pack each buffer's views back to back so
+// that the freed bytes are not uploaded. Positions become 16 bits relative to
+// their mesh's bounds (see gltf_mesh.position_scale), normals, tangents and
+// weights 8 or 16 bit, and texcoords 16 bits while they are within 0..1. The
+// vertex fetch decodes all of these, so shaders are unchanged. An attribute
+// stays as floats if it would be off by more than its GLTF_QUANTIZE_*_ERROR,
+// or if its view holds anything else, its primitive has morph targets, or for
+// positions, its mesh is skinned. The cooker does this when asked to.
+#define GLTF_QUANTIZE_POSITION_ERROR 0.0005f // in model units
+#define GLTF_QUANTIZE_NORMAL_ERROR   0.005f  // per component, so 8 bits fit
+#define GLTF_QUANTIZE_TEXCOORD_ERROR 0.0001f
+#define GLTF_QUANTIZE_WEIGHT_ERROR   0.0001f
+void gltf_quantize_meshes(gltf *model, char **buffers, allocator *temp);
+
+// Split each triangle list primitive into clusters (see mesh_build_clusters)
+// using the indices and float positions in 'buffers', as filled in by
+// gltf_read_buffers, and store them in meta, which is reallocated from
+// 'persistent' to make room. Indices must already be in their final order.
+// Only the cooker does this, after optimizing the model, so a model loaded
+// from its .gltf or .sol has no clusters. Non-indexed primitives are clustered
+// by vertex order.
+void gltf_build_clusters(gltf *model, char **buffers, allocator *persistent, allocator *temp);
+
 struct shader_dir; // @Review I do want to reimplement these better...
 struct shader_config;
-void parse_gltf(const char *file_name, struct shader_dir *dir, struct shader_config *conf, allocator *temp, allocator *persistent, gltf *ret);
-void load_gltf(const char *file_name, struct shader_dir *dir, struct shader_config *conf, allocator *temp, allocator *persistent, gltf *g);
+// The json is parsed to a tape (see parse_json_tape). 'pool' is used to read
+// the buffers and generate missing attributes, and may be NULL.
+// Return false if the file is not valid json, after printing where the error is.
+bool parse_gltf(const char *file_name, struct shader_dir *dir, struct shader_config *conf, thread_pool *pool, allocator *temp, allocator *persistent, gltf *ret);
+bool load_gltf(const char *file_name, struct shader_dir *dir, struct shader_config *conf, thread_pool *pool, allocator *temp, allocator *persistent, gltf *g);
 void store_gltf(gltf *model, const char *file_name, allocator *alloc);
 
+enum {
+    GLTF_COOK_QUANTIZE_BIT = 0x01, // gltf_quantize_meshes
+};
+
+// Parse a model and write file_name.cook, holding the processed model, every
+// buffer including generated attributes, and every image decoded with its mip
+// chain. load_gltf prefers a .cook while it matches the model's sources, so
+// the model's files are then never read or decoded. Return false if the model
+// could not be parsed.
+bool cook_gltf(const char *file_name, uint flags, thread_pool *pool, allocator *temp, allocator *persistent);
+
 #if TEST
 void test_gltf(test_suite *suite);
 #endif
@@ -1,13 +1,10 @@
 #ifndef GLTF_LIMITS_H_
 #define GLTF_LIMITS_H_
 
+// Sizes of the arrays in the vertex shader's transforms ubo. Node, mesh and
+// skin counts are not limited.
 #define GLTF_JOINT_COUNT 24
 #define GLTF_MORPH_WEIGHT_COUNT 8
-#define GLTF_MAX_NODE_COUNT 128
-#define GLTF_MAX_MESH_COUNT 32
-#define GLTF_U64_NODE_MASK 2
-#define GLTF_U64_SKIN_MASK 1
-#define GLTF_U64_MESH_MASK 1
 
 // current max number of textures that can exist on a gltf 2.0 material, not a cap
 #define GLTF_MAX_MATERIAL_TEXTURE_COUNT 5
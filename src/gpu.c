@@ -1836,6 +1836,27 @@ void gpu_upload_descriptor_buffer(struct gpu *gpu, uint count, VkBufferCopy *reg
 
 #define GPU_MAX_IMAGES_PER_UPLOAD 32
 
+// Copy level zero, or every level of a mip chain (packed as image_generate_mips
+// writes it), from the transfer buffer at 'offset'.
+static void gpu_copy_buffer_to_texture(struct gpu *gpu, VkCommandBuffer cmd, struct gpu_texture *tex, size_t offset)
+{
+    VkBufferImageCopy region = {};
+    uint levels = tex->image.mip_chain ? tex->image.miplevels : 1;
+    uint x = tex->image.x;
+    uint y = tex->image.y;
+    for(uint i = 0; i < levels; ++i) {
+        region.bufferOffset = offset;
+        region.imageSubresource = (VkImageSubresourceLayers){VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1};
+        region.imageExtent = (VkExtent3D){x, y, 1};
+        vk_cmd_copy_buffer_to_image(cmd, gpu->mem.transfer_buffer.buf,
+                tex->vkimage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                &region);
+        offset += (uint64)x * y * 4;
+        x = x > 1 ? x >> 1 : 1;
+        y = y > 1 ? y >> 1 : 1;
+    }
+}
+
 static void gpu_upload_images(
     struct gpu       *gpu,
     uint              count,
@@ -1908,17 +1929,10 @@ static void gpu_upload_images(
     dep.imageMemoryBarrierCount = count;
     dep.pImageMemoryBarriers = barrs0;
 
-    VkBufferImageCopy region = {};
-    region.imageSubresource = (VkImageSubresourceLayers){VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
-
     if (gpu->flags & GPU_DISCRETE_TRANSFER_BIT) {
         vk_cmd_pipeline_barrier2(transfer, &dep);
         for(i = 0; i < count; ++i) {
-            region.bufferOffset = offsets[i];
-            region.imageExtent = (VkExtent3D){images[i].image.x, images[i].image.y, 1};
-            vk_cmd_copy_buffer_to_image(transfer, gpu->mem.transfer_buffer.buf,
-                    images[i].vkimage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-                    &region);
+            gpu_copy_buffer_to_texture(gpu, transfer, &images[i], offsets[i]);
         }
         dep.pImageMemoryBarriers = barrs1;
         vk_cmd_pipeline_barrier2(transfer, &dep);
@@ -1928,11 +1942,7 @@ static void gpu_upload_images(
     } else {
         vk_cmd_pipeline_barrier2(graphics, &dep);
         for(i = 0; i < count; ++i) {
-            region.bufferOffset = offsets[i];
-            region.imageExtent = (VkExtent3D){images[i].image.x, images[i].image.y, 1};
-            vk_cmd_copy_buffer_to_image(graphics, gpu->mem.transfer_buffer.buf,
-                    images[i].vkimage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-                    &region);
+            gpu_copy_buffer_to_texture(gpu, graphics, &images[i], offsets[i]);
         }
     }
 }
@@ -2012,17 +2022,10 @@ void gpu_upload_images_with_base_offset(
     dep.imageMemoryBarrierCount = count;
     dep.pImageMemoryBarriers = barrs0;
 
-    VkBufferImageCopy region = {};
-    region.imageSubresource = (VkImageSubresourceLayers){VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
-
     if (gpu->flags & GPU_DISCRETE_TRANSFER_BIT) {
         vk_cmd_pipeline_barrier2(transfer, &dep);
         for(i = 0; i < count; ++i) {
-            region.bufferOffset = base_offset + offsets[i];
-            region.imageExtent = (VkExtent3D){images[i].image.x, images[i].image.y, 1};
-            vk_cmd_copy_buffer_to_image(transfer, gpu->mem.transfer_buffer.buf,
-                    images[i].vkimage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-                    &region);
+            gpu_copy_buffer_to_texture(gpu, transfer, &images[i], base_offset + offsets[i]);
         }
         dep.pImageMemoryBarriers = barrs1;
         vk_cmd_pipeline_barrier2(transfer, &dep);
@@ -2032,11 +2035,7 @@ void gpu_upload_images_with_base_offset(
     } else {
         vk_cmd_pipeline_barrier2(graphics, &dep);
         for(i = 0; i < count; ++i) {
-            region.bufferOffset = base_offset + offsets[i];
-            region.imageExtent = (VkExtent3D){images[i].image.x, images[i].image.y, 1};
-            vk_cmd_copy_buffer_to_image(graphics, gpu->mem.transfer_buffer.buf,
-                    images[i].vkimage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-                    &region);
+            gpu_copy_buffer_to_texture(gpu, graphics, &images[i], base_offset + offsets[i]);
         }
     }
 }
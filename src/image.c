@@ -10,6 +10,109 @@ struct image load_image(const char *uri) {
     return img;
 }
 
+struct image load_image_memory(const uchar *data, uint size) {
+    struct image img;
+    int n;
+    img.data = stbi_load_from_memory(data, size, &img.x, &img.y, &n, STBI_rgb_alpha);
+    log_print_error_if(!img.data, "failed to load image from memory");
+    img.miplevels = calc_mips(img.x, img.y);
+    return img;
+}
+
+struct image load_image_mip_chain(const uchar *chain, int x, int y, uint miplevels) {
+    struct image img = {.x = x, .y = y, .miplevels = miplevels, .mip_chain = true};
+    img.data = STBI_MALLOC(image_data_size(&img));
+    log_print_error_if(!img.data, "failed to allocate %ix%i image", x, y);
+    memcpy(img.data, chain, image_data_size(&img));
+    return img;
+}
+
+uint64 image_mip_chain_size(int x, int y, uint miplevels) {
+    uint64 size = 0;
+    for(uint i = 0; i < miplevels; ++i) {
+        size += (uint64)x * y * 4;
+        x = x > 1 ? x >> 1 : 1;
+        y = y > 1 ? y >> 1 : 1;
+    }
+    return size;
+}
+
+// The source texels of texel 'i' of a level filtered from 'n' texels, and
+// their weights. Returns the tap count.
+static inline uint image_mip_taps(int n, int i, int *taps, float *weights) {
+    if (n == 1) {
+        taps[0] = 0;
+        weights[0] = 1;
+        return 1;
+    }
+    if (!(n & 1)) {
+        taps[0] = i << 1;
+        taps[1] = (i << 1) + 1;
+        weights[0] = weights[1] = 0.5f;
+        return 2;
+    }
+    int m = n >> 1;
+    taps[0] = i << 1;
+    taps[1] = (i << 1) + 1;
+    taps[2] = (i << 1) + 2;
+    weights[0] = (float)(m - i) / n;
+    weights[1] = (float)m / n;
+    weights[2] = (float)(i + 1) / n;
+    return 3;
+}
+
+static inline float image_srgb_to_linear(float c) {
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static inline float image_linear_to_srgb(float c) {
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1 / 2.4f) - 0.055f;
+}
+
+void image_generate_mips(struct image *img, uchar *to, bool srgb) {
+    int x = img->x;
+    int y = img->y;
+    memcpy(to, img->data, image_size(img));
+
+    float decode[256];
+    for(uint i = 0; i < 256; ++i)
+        decode[i] = srgb ? image_srgb_to_linear(i / 255.0f) : i / 255.0f;
+
+    const uchar *src = to;
+    uchar *dst = to + image_size(img);
+    int rt[3], ct[3];
+    float rw[3], cw[3];
+    for(uint i = 1; i < img->miplevels; ++i) {
+        int dx = x > 1 ? x >> 1 : 1;
+        int dy = y > 1 ? y >> 1 : 1;
+        for(int r = 0; r < dy; ++r) {
+            uint rn = image_mip_taps(y, r, rt, rw);
+            for(int c = 0; c < dx; ++c) {
+                uint cn = image_mip_taps(x, c, ct, cw);
+                float sum[4] = {0};
+                for(uint j = 0; j < rn; ++j) {
+                    for(uint l = 0; l < cn; ++l) {
+                        const uchar *t = src + (rt[j] * x + ct[l]) * 4;
+                        float w = rw[j] * cw[l];
+                        sum[0] += decode[t[0]] * w;
+                        sum[1] += decode[t[1]] * w;
+                        sum[2] += decode[t[2]] * w;
+                        sum[3] += t[3] / 255.0f * w;
+                    }
+                }
+                uchar *o = dst + (r * dx + c) * 4;
+                for(uint k = 0; k < 3; ++k)
+                    o[k] = (uchar)((srgb ? image_linear_to_srgb(sum[k]) : sum[k]) * 255 + 0.5f);
+                o[3] = (uchar)(sum[3] * 255 + 0.5f);
+            }
+        }
+        src = dst;
+        dst += (uint64)dx * dy * 4;
+        x = dx;
+        y = dy;
+    }
+}
+
 void free_image(struct image *img) {
     stbi_image_free(img->data);
     memset(img, 0, sizeof(*img));
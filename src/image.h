@@ -10,6 +10,7 @@ struct image {
     int x,y;
     uchar *data;
     uint miplevels;
+    bool mip_chain; // 'data' holds every mip level, see image_generate_mips
 };
 
 static inline uint32 calc_mips(uint32 x, uint32 y) {
@@ -17,6 +18,19 @@ static inline uint32 calc_mips(uint32 x, uint32 y) {
 }
 
 struct image load_image(const char *uri);
+struct image load_image_memory(const uchar *data, uint size);
+// Copy a mip chain as written by image_generate_mips, such that free_image can
+// be called on the result.
+struct image load_image_mip_chain(const uchar *chain, int x, int y, uint miplevels);
+
+// Size of level zero followed by every mip level, each rgba and tightly packed.
+uint64 image_mip_chain_size(int x, int y, uint miplevels);
+// Write level zero and then each mip level to 'to', each level a box filter of
+// the one before it. An odd dimension of 2n+1 texels is filtered to n with
+// three weighted taps, so that every source texel contributes. If 'srgb', the
+// colour channels are averaged in linear space, as a blit of an sRGB image
+// would; alpha is always linear.
+void image_generate_mips(struct image *img, uchar *to, bool srgb);
 
 void free_image(struct image *img);
 
@@ -24,4 +38,9 @@ static inline size_t image_size(struct image *image) {
     return image->x * image->y * 4;
 }
 
+// Bytes in 'data': level zero, or the whole mip chain.
+static inline size_t image_data_size(struct image *image) {
+    return image->mip_chain ? image_mip_chain_size(image->x, image->y, image->miplevels) : image_size(image);
+}
+
 #endif // include guard
@@ -1,4 +1,6 @@
 #include "json.h"
+#include "dict.h"
+#include "file.h"
 
 typedef enum {
     JSON_RESULT_SUCCESS = 0,
@@ -7,19 +9,16 @@ typedef enum {
     JSON_RESULT_INVALID,
 } json_result;
 
-typedef json (*json_parse_fn)(const char *, uint32 *, allocator *);
-
-static json json_parse_object(const char *data, uint32 *offset, allocator *alloc);
-static json json_parse_array(const char *data, uint32 *offset, allocator *alloc);
-static json json_parse_string(const char *data, uint32 *offset, allocator *alloc);
 static json json_parse_number(const char *data, uint32 *offset, allocator *alloc);
 static json json_parse_bool(const char *data, uint32 *offset, allocator *alloc);
 static json json_parse_null(const char *data, uint32 *offset, allocator *alloc);
-static uint32 json_object_count_keys(const char *data);
-static json_parse_fn json_array_get_elem_info(const char *data, json_array *arr, allocator *alloc);
-static json_result json_parser_find_key(const char *data, uint32 *pos);
-static json_result json_skip_over_key_and_value(const char *data, uint32 *pos);
-static json_result json_skip_to_equivalent_depth(const char *data, uint32 *pos, char open, char close);
+inline static void json_fill_array_elem(json_array *to, json *from, uint i);
+static json_result json_index_count_elems(const char *data, json_index *idx);
+static json json_index_parse_value(const char *data, json_index *idx, uint32 *k, uint32 pos, allocator *alloc);
+static json json_index_parse_object(const char *data, json_index *idx, uint32 *k, allocator *alloc);
+static json json_index_parse_array(const char *data, json_index *idx, uint32 *k, allocator *alloc);
+static size_t json_index_tree_size(const char *data, json_index *idx);
+static void* json_allocate_tree(allocator *alloc, uint64 mark, json_index *idx, size_t size);
 
 static void print_json_with_depth(json *j, int depth);
 static void json_print_object(json_object *a, int depth);
@@ -50,20 +49,27 @@ static inline json_type json_get_type(const char *data)
 }
 
 static inline json_result json_validate_null(const char *data) {
-    return strcmp(data, "null") ? JSON_RESULT_INVALID : JSON_RESULT_SUCCESS;
+    return memcmp(data, "null", 4) ? JSON_RESULT_INVALID : JSON_RESULT_SUCCESS;
 }
 
 static inline json_result json_validate_bool(const char *data) {
     return memcmp(data, "true", 4) && memcmp(data, "false", 5) ? JSON_RESULT_INVALID : JSON_RESULT_SUCCESS;
 }
 
-static inline json_result json_validate_number(const char *data) {
-    uint32 len = simd_ascii_double_len(data);
+// 'len' is the length of a number scanned by ascii_scan_number, zero if the
+// scan failed.
+static inline json_result json_validate_number(const char *data, uint32 len) {
+    if (!len) {
+        log_print_error("Invalid number syntax");
+        return JSON_RESULT_INVALID;
+    }
     switch(data[len]) {
     case '}':
     case ']':
     case ' ':
     case '\n':
+    case '\r':
+    case '\t':
     case ',':
         return JSON_RESULT_SUCCESS;
     default:
@@ -72,36 +78,51 @@ static inline json_result json_validate_number(const char *data) {
     }
 }
 
-static inline json_result json_skip_over_string(const char *data, uint32 *pos) {
+// Index of the first '"' or '\\' in data[pos..size), or size if there is neither.
+static inline uint32 json_find_quote_or_escape(const char *data, uint32 pos, uint32 size)
+{
+    __m128i a;
+    __m128i q = _mm_set1_epi8('"');
+    __m128i b = _mm_set1_epi8('\\');
+    uint16 m;
+    for(; pos + 16 <= size; pos += 16) {
+        a = _mm_loadu_si128((__m128i*)(data + pos));
+        m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(a, q), _mm_cmpeq_epi8(a, b)));
+        if (m)
+            return pos + ctz16(m);
+    }
+    for(; pos < size; ++pos)
+        if (data[pos] == '"' || data[pos] == '\\')
+            return pos;
+    return size;
+}
+
+// data[*pos] == opening quote; leaves *pos one past the closing quote.
+static inline json_result json_skip_over_string(const char *data, uint32 size, uint32 *pos) {
     *pos += 1;
     while(1) {
-        *pos += simd_find_char(data + *pos, '"');
-        if (data[*pos] == '\\') {
-            *pos += 1;
-            continue;
-        } else {
+        *pos = json_find_quote_or_escape(data, *pos, size);
+        if (*pos >= size) {
+            log_print_error("Unterminated string");
+            return JSON_RESULT_INVALID;
+        }
+        if (data[*pos] == '"') {
             *pos += 1;
-            break;
+            return JSON_RESULT_SUCCESS;
         }
+        *pos += 2; // the backslash and the char it escapes
     }
-    return JSON_RESULT_SUCCESS;
 }
 
 static inline json_result json_skip_over_number(const char *data, uint32 *pos) {
-    json_result ret = json_validate_number(data + *pos);
+    struct ascii_number num;
+    uint32 len = ascii_scan_number(data + *pos, &num);
+    json_result ret = json_validate_number(data + *pos, len);
     log_print_error_if(ret != JSON_RESULT_SUCCESS, "Failed to validate number - char index %u", *pos);
-    *pos += simd_ascii_double_len(data + *pos);
+    *pos += len;
     return ret;
 }
 
-static inline json_result json_skip_over_object(const char *data, uint32 *pos) {
-    return json_skip_to_equivalent_depth(data, pos, '{', '}');
-}
-
-static inline json_result json_skip_over_array(const char *data, uint32 *pos) {
-    return json_skip_to_equivalent_depth(data, pos, '[', ']');
-}
-
 static inline json_result json_skip_over_bool(const char *data, uint32 *pos) {
     json_result ret = json_validate_bool(data + *pos);
     log_print_error_if(ret != JSON_RESULT_SUCCESS, "Failed to validate bool - char index %u", *pos);
@@ -112,525 +133,3690 @@ static inline json_result json_skip_over_bool(const char *data, uint32 *pos) {
 static inline json_result json_skip_over_null(const char *data, uint32 *pos) {
     json_result ret = json_validate_null(data + *pos);
     log_print_error_if(ret != JSON_RESULT_SUCCESS, "Failed to validate null - char index %u", *pos);
-    pos += 4;
-    return ret;
-}
-
-static inline uint32 json_skip_to_value(const char *data) {
-    uint32 ret = simd_find_char(data, ':');
-    ret++;
-    ret += simd_skip_over_whitespace(data + ret);
+    *pos += 4;
     return ret;
 }
 
-// file size * 2 seems large enough to hold the C translation -- nvm, had to increase it 28 Jul 2024
-#define JSON_ALLOCATION_SIZE_MULTIPLIER 4
-
+// The tree is allocated once the index has been built and the containers
+// counted, when its exact size is known, and *mem_used is exactly that size
+// (or ALLOCATOR_ALIGNMENT for a document with no elems, so that it can always
+// be deallocated).
 json parse_json(struct file *f, allocator *alloc, struct allocation *mem_used)
 {
-    size_t size = JSON_ALLOCATION_SIZE_MULTIPLIER * f->size;
-    void *buf = allocate(alloc, size);
-    allocator json_alloc = new_linear_allocator(size, buf);
-
-    if (mem_used)
-        *mem_used = (struct allocation){buf, size};
+    // The index is only needed while the tree is built.
+    uint64 mark = alloc->flags & ALLOCATOR_LINEAR_BIT ? alloc->linear.used : 0;
+    json_index idx = json_build_index(f->data, f->size, alloc);
 
-    uint32 pos = 0;
-    json ret;
-    ret.type = json_get_type(f->data);
-    switch(ret.type) {
+    uint32 pos = simd_skip_over_whitespace(f->data);
+    bool ok = false;
+    switch(json_get_type(f->data + pos)) {
     case JSON_TYPE_OBJECT:
-        ret = json_parse_object(f->data, &pos, &json_alloc);
-        return ret;
     case JSON_TYPE_ARRAY:
-        ret = json_parse_array(f->data, &pos, &json_alloc);
-        return ret;
+        ok = json_index_count_elems(f->data, &idx) == JSON_RESULT_SUCCESS;
+        break;
     case JSON_TYPE_STRING:
         log_print_error("String is an invalid top level item");
-        return (json){};
+        break;
     case JSON_TYPE_NUMBER:
         log_print_error("Number is an invalid top level item");
-        return (json){};
+        break;
     case JSON_TYPE_BOOL:
         log_print_error("Bool is an invalid top level item");
-        return (json){};
+        break;
     case JSON_TYPE_NULL:
         log_print_error("Null is an invalid top level item");
-        return (json){};
+        break;
     default:
         log_print_error("Failed to determine type of top level item");
-        return (json){};
+        break;
+    }
+
+    size_t size = ok ? json_index_tree_size(f->data, &idx) : 0;
+    size_t cap = size ? size : ALLOCATOR_ALIGNMENT;
+    void *buf = json_allocate_tree(alloc, mark, &idx, cap);
+    allocator json_alloc = new_linear_allocator(cap, buf);
+
+    if (mem_used)
+        *mem_used = (struct allocation){buf, cap};
+
+    uint32 k = 0;
+    json ret = (json){};
+    if (ok) {
+        ret = json_index_parse_value(f->data, &idx, &k, pos, &json_alloc);
+        assert((ret.type == JSON_TYPE_INVALID || json_alloc.linear.used == alloc_align(size)) &&
+               "json tree size is not exact");
+    }
+
+    if (alloc->flags & ALLOCATOR_LINEAR_BIT) {
+        allocator_reset_linear_to(alloc, mark + alloc_align(cap));
+    } else {
+        if (idx.aux)
+            deallocate(alloc, idx.aux);
+        deallocate(alloc, idx.pos);
     }
+    return ret;
 }
 
-void print_json(json *j)
+// Stage 1: classify a 64 byte block into bitmasks, bit i for data[i].
+// '[' | 0x20 == '{' and ']' | 0x20 == '}', so two compares cover the brackets.
+static inline void json_classify_block(const char *data, uint64 *quote, uint64 *bslash, uint64 *op)
 {
-    print_json_with_depth(j, 1);
-    println("");
+    uint64 q = 0, b = 0, o = 0;
+#ifdef __AVX2__
+    __m256i a, c;
+    for(uint i = 0; i < 2; ++i) {
+        a = _mm256_loadu_si256((__m256i*)(data + i * 32));
+        c = _mm256_or_si256(a, _mm256_set1_epi8(0x20));
+        q |= (uint64)(uint32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, _mm256_set1_epi8('"'))) << (i * 32);
+        b |= (uint64)(uint32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, _mm256_set1_epi8('\\'))) << (i * 32);
+        c = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('{')),
+                                            _mm256_cmpeq_epi8(c, _mm256_set1_epi8('}'))),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(a, _mm256_set1_epi8(':')),
+                                            _mm256_cmpeq_epi8(a, _mm256_set1_epi8(','))));
+        o |= (uint64)(uint32)_mm256_movemask_epi8(c) << (i * 32);
+    }
+#else
+    __m128i a, c;
+    for(uint i = 0; i < 4; ++i) {
+        a = _mm_loadu_si128((__m128i*)(data + i * 16));
+        c = _mm_or_si128(a, _mm_set1_epi8(0x20));
+        q |= (uint64)(uint16)_mm_movemask_epi8(_mm_cmpeq_epi8(a, _mm_set1_epi8('"'))) << (i * 16);
+        b |= (uint64)(uint16)_mm_movemask_epi8(_mm_cmpeq_epi8(a, _mm_set1_epi8('\\'))) << (i * 16);
+        c = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('{')),
+                                      _mm_cmpeq_epi8(c, _mm_set1_epi8('}'))),
+                         _mm_or_si128(_mm_cmpeq_epi8(a, _mm_set1_epi8(':')),
+                                      _mm_cmpeq_epi8(a, _mm_set1_epi8(','))));
+        o |= (uint64)(uint16)_mm_movemask_epi8(c) << (i * 16);
+    }
+#endif
+    *quote = q;
+    *bslash = b;
+    *op = o;
 }
 
-static json json_parse_object(const char *data, uint32 *offset, allocator *alloc)
+// Mask of chars preceded by an odd length run of backslashes. Runs starting on
+// an even bit that have odd length end on an odd bit, so adding the run starts
+// to the runs carries out of the run at exactly the chars that are escaped.
+// 'carry' is set if the block ends on an unfinished escape.
+static inline uint64 json_find_escaped(uint64 bslash, uint64 *carry)
 {
-    uint32 pos = *offset + (data[*offset] == '{');
-    json ret;
-    ret.type = JSON_TYPE_OBJECT;
-    ret.obj.key_count = json_object_count_keys(data + pos);
-    if (ret.obj.key_count == Max_u32)
-        goto fail;
+    const uint64 even_bits = 0x5555555555555555;
+    bslash &= ~*carry;
+    uint64 follows_escape = bslash << 1 | *carry;
+    uint64 odd_starts = bslash & ~even_bits & ~follows_escape;
+    uint64 even_carries;
+    *carry = __builtin_add_overflow(odd_starts, bslash, &even_carries);
+    uint64 invert = even_carries << 1;
+    return (even_bits ^ invert) & follows_escape;
+}
 
-    ret.obj.values = sallocate(alloc, *ret.obj.values, ret.obj.key_count);
-    ret.obj.keys = sallocate(alloc, *ret.obj.keys, ret.obj.key_count);
+// Bit i is set if an odd number of bits at or below i are set.
+static inline uint64 json_prefix_xor(uint64 x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
 
-    uint32 tmp;
-    for(uint32 i = 0; i < ret.obj.key_count; ++i) {
-        json_parser_find_key(data, &pos);
-        ret.obj.keys[i].cstr = data + pos + 1;
-        tmp = pos;
-        json_skip_over_string(data, &pos);
-        ret.obj.keys[i].len = pos - tmp - 2;
-        pos += json_skip_to_value(data + pos);
-        ret.obj.values[i].type = json_get_type(data + pos);
-        switch(ret.obj.values[i].type) {
-        case JSON_TYPE_STRING:
-            ret.obj.values[i] = json_parse_string(data, &pos, NULL);
-            if (ret.obj.values[i].type == JSON_TYPE_INVALID) {
-                log_print_error("Got invalid string while parsing object value - char index %u", pos);
-                goto fail;
+// Stage 1 state carried between blocks.
+struct json_index_scan {
+    uint64 escape_carry;
+    uint64 string_carry; // all ones if the previous block ended inside a string
+};
+
+// Extra stage 1 results for json_validate, so that it never has to look at
+// string contents unless the document has escapes. They cover every block
+// scanned so far, which is all that a string ending in the current block needs.
+struct json_index_check {
+    bool escapes; // any '\\' so far
+    uint32 control; // offset of the first control char inside a string, or Max_u32
+};
+
+// Mask of the structural chars in the 64 byte block at data + i, bit j for
+// data[i + j]: both quotes of every string, and brackets, ':' and ',' outside
+// of strings. The last block is padded with whitespace.
+static inline uint64 json_index_scan_block(const char *data, size_t size, size_t i,
+                                           struct json_index_scan *scan, struct json_index_check *check)
+{
+    uint64 quote, bslash, op, in_string, control;
+    char tail[64];
+    const char *block = data + i;
+    __m128i a;
+    if (size - i < 64) {
+        memset(tail, ' ', sizeof(tail));
+        memcpy(tail, block, size - i);
+        block = tail;
+    }
+    json_classify_block(block, &quote, &bslash, &op);
+    quote &= ~json_find_escaped(bslash, &scan->escape_carry);
+
+    // Set from an opening quote up to but excluding its closing quote.
+    in_string = json_prefix_xor(quote) ^ scan->string_carry;
+    scan->string_carry = (uint64)((int64)in_string >> 63);
+
+    if (check) {
+        check->escapes |= bslash != 0;
+        control = 0;
+        for(uint j = 0; j < 4; ++j) {
+            a = _mm_loadu_si128((__m128i*)(block + j * 16));
+            control |= (uint64)(uint16)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_max_epu8(a, _mm_set1_epi8(0x1f)), _mm_set1_epi8(0x1f))) << (j * 16);
+        }
+        control &= in_string;
+        if (control && check->control == Max_u32)
+            check->control = i + ctz64(control);
+    }
+    return (op & ~in_string) | quote;
+}
+
+json_index json_build_index(const char *data, size_t size, allocator *alloc)
+{
+    json_index ret;
+    ret.count = 0;
+    ret.pos = sallocate(alloc, *ret.pos, size + 1);
+
+    struct json_index_scan scan = {};
+    uint64 bits;
+    for(size_t i = 0; i < size; i += 64) {
+        bits = json_index_scan_block(data, size, i, &scan, NULL);
+        while(bits) {
+            ret.pos[ret.count++] = i + ctz64(bits);
+            bits &= bits - 1;
+        }
+    }
+    if (scan.string_carry) {
+        log_print_error("Unterminated string at end of json");
+        ret.count = 0;
+    }
+    ret.aux = sallocate(alloc, *ret.aux, ret.count);
+    return ret;
+}
+
+static inline uint32 json_index_offset(json_index *idx, uint32 k) {
+    return k < idx->count ? idx->pos[k] : Max_u32;
+}
+
+static inline char json_index_char(const char *data, json_index *idx, uint32 k) {
+    return k < idx->count ? data[idx->pos[k]] : 0;
+}
+
+// Store the elem/key count of every container at its opening bracket: the
+// number of ',' at its depth, plus one if it is non-empty.
+static json_result json_index_count_elems(const char *data, json_index *idx)
+{
+    uint32 stack[JSON_MAX_DEPTH];
+    uint32 depth = 0;
+    uint32 k, pos;
+    char c;
+    for(k = 0; k < idx->count; ++k) {
+        pos = idx->pos[k];
+        c = data[pos];
+        switch(c) {
+        case '{':
+        case '[':
+            if (depth == JSON_MAX_DEPTH) {
+                log_print_error("Exceeded max json depth %u - char index %u", JSON_MAX_DEPTH, pos);
+                return JSON_RESULT_INVALID;
             }
+            stack[depth++] = k;
+            pos += 1;
+            pos += simd_skip_over_whitespace(data + pos);
+            idx->aux[k] = data[pos] != c + 2; // '{' + 2 == '}', '[' + 2 == ']'
             break;
-        case JSON_TYPE_NUMBER:
-            ret.obj.values[i] = json_parse_number(data, &pos, NULL);
-            if (ret.obj.values[i].type == JSON_TYPE_INVALID) {
-                log_print_error("Got invalid object while parsing object value - char index %u", pos);
-                goto fail;
+        case '}':
+        case ']':
+            if (depth == 0 || data[idx->pos[stack[depth - 1]]] != c - 2) {
+                log_print_error("Found unmatched '%c' - char index %u", c, pos);
+                return JSON_RESULT_INVALID;
             }
+            depth--;
             break;
-        case JSON_TYPE_OBJECT:
-            ret.obj.values[i] = json_parse_object(data, &pos, alloc);
-            if (ret.obj.values[i].type == JSON_TYPE_INVALID) {
-                log_print_error("Got invalid object while parsing object value - char index %u", pos);
-                goto fail;
+        case ',':
+            if (depth == 0) {
+                log_print_error("Found ',' outside of a container - char index %u", pos);
+                return JSON_RESULT_INVALID;
             }
+            idx->aux[stack[depth - 1]]++;
             break;
-        case JSON_TYPE_ARRAY:
-            ret.obj.values[i] = json_parse_array(data, &pos, alloc);
-            if (ret.obj.values[i].type == JSON_TYPE_INVALID) {
-                log_print_error("Got invalid array while parsing object value - char index %u", pos);
-                goto fail;
-            }
+        case '"':
+            k++; // closing quote
             break;
-        case JSON_TYPE_BOOL:
-            ret.obj.values[i] = json_parse_bool(data, &pos, NULL);
-            if (ret.obj.values[i].type == JSON_TYPE_INVALID) {
-                log_print_error("Got invalid bool while parsing object value - char index %u", pos);
-                goto fail;
-            }
+        default:
             break;
-        case JSON_TYPE_NULL:
-            ret.obj.values[i] = json_parse_null(data, &pos, NULL);
-            if (ret.obj.values[i].type == JSON_TYPE_INVALID) {
-                log_print_error("Got invalid null while parsing object value - char index %u", pos);
+        }
+    }
+    if (depth) {
+        log_print_error("Found %u unclosed containers at end of json", depth);
+        return JSON_RESULT_INVALID;
+    }
+    return JSON_RESULT_SUCCESS;
+}
+
+// Same 7/8ths max load as dict.c, so every probe sequence reaches an empty slot.
+static inline uint32 json_object_hash_cap(uint32 key_count)
+{
+    if (key_count < JSON_OBJECT_HASH_MIN_KEYS)
+        return 0;
+    uint32 cap = 16;
+    while(cap / 8 * 7 < key_count)
+        cap <<= 1;
+    return cap;
+}
+
+static inline size_t json_object_hash_size(uint32 hash_cap) {
+    return hash_cap + hash_cap * sizeof(uint32);
+}
+
+static inline uint8* json_object_hash_tags(json_object *obj) {
+    return (uint8*)(obj->values + obj->key_count);
+}
+
+static inline uint32* json_object_hash_slots(json_object *obj) {
+    return (uint32*)(json_object_hash_tags(obj) + obj->hash_cap);
+}
+
+static inline uint8 json_object_hash_tag(uint64 hash) {
+    return 0x80 | (hash >> 57);
+}
+
+// Keys are inserted in order, and the first free slot in a group is always
+// taken, so with duplicate keys the first is found, as with a linear search.
+static void json_object_build_hash(json_object *obj)
+{
+    uint8 *tags = json_object_hash_tags(obj);
+    uint32 *slots = json_object_hash_slots(obj);
+    memset(tags, 0, obj->hash_cap);
+
+    uint64 hash;
+    uint32 g, s;
+    uint16 mask;
+    for(uint32 i = 0; i < obj->key_count; ++i) {
+        hash = hash_bytes(obj->keys[i].len, (void*)obj->keys[i].cstr);
+        g = hash & (obj->hash_cap - 1) & ~15;
+        while(1) {
+            mask = ~_mm_movemask_epi8(_mm_loadu_si128((__m128i*)(tags + g)));
+            if (mask) {
+                s = g + ctz16(mask);
+                tags[s] = json_object_hash_tag(hash);
+                slots[s] = i;
+                break;
+            }
+            g = (g + 16) & (obj->hash_cap - 1);
+        }
+    }
+}
+
+uint json_object_find_key_hashed(json_object *obj, const char *key, uint32 len)
+{
+    uint8 *tags = json_object_hash_tags(obj);
+    uint32 *slots = json_object_hash_slots(obj);
+
+    uint64 hash = hash_bytes(len, (void*)key);
+    uint32 g = hash & (obj->hash_cap - 1) & ~15;
+    __m128i tag = _mm_set1_epi8(json_object_hash_tag(hash));
+    __m128i a;
+    uint16 mask;
+    uint32 i;
+    while(1) {
+        a = _mm_loadu_si128((__m128i*)(tags + g));
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, tag));
+        while(mask) {
+            i = slots[g + ctz16(mask)];
+            if (obj->keys[i].len == len && memcmp(key, obj->keys[i].cstr, len) == 0)
+                return i;
+            mask &= mask - 1;
+        }
+        if ((uint16)_mm_movemask_epi8(a) != 0xffff)
+            return Max_u32;
+        g = (g + 16) & (obj->hash_cap - 1);
+    }
+}
+
+// Stage 2: every value that is not a scalar starts at idx->pos[*k]; scalars
+// have no index entry and are found after the preceding ':', ',' or '['.
+static json json_index_parse_value(const char *data, json_index *idx, uint32 *k, uint32 pos, allocator *alloc)
+{
+    json ret;
+    ret.type = json_get_type(data + pos);
+    switch(ret.type) {
+    case JSON_TYPE_STRING:
+    case JSON_TYPE_OBJECT:
+    case JSON_TYPE_ARRAY:
+        if (*k >= idx->count || idx->pos[*k] != pos) {
+            log_print_error("Unexpected '%c' - char index %u", data[pos], pos);
+            return (json){};
+        }
+        break;
+    default:
+        break;
+    }
+    switch(ret.type) {
+    case JSON_TYPE_STRING:
+        ret.str.cstr = data + pos + 1;
+        ret.str.len = idx->pos[*k + 1] - pos - 1;
+        *k += 2;
+        return ret;
+    case JSON_TYPE_OBJECT:
+        return json_index_parse_object(data, idx, k, alloc);
+    case JSON_TYPE_ARRAY:
+        return json_index_parse_array(data, idx, k, alloc);
+    case JSON_TYPE_NUMBER:
+        ret = json_parse_number(data, &pos, NULL);
+        break;
+    case JSON_TYPE_BOOL:
+        ret = json_parse_bool(data, &pos, NULL);
+        break;
+    case JSON_TYPE_NULL:
+        ret = json_parse_null(data, &pos, NULL);
+        break;
+    default:
+        log_print_error("Got unrecognisable type parsing value - char index %u", pos);
+        return (json){};
+    }
+    // The elem counts only see the ',' in a container, so a scalar must be
+    // followed by the next index entry, else '[1 2]' would be an array of one.
+    if (ret.type != JSON_TYPE_INVALID) {
+        pos += simd_skip_over_whitespace(data + pos);
+        if (pos != json_index_offset(idx, *k)) {
+            log_print_error("Expected ',' or end of container following value - char index %u", pos);
+            return (json){};
+        }
+    }
+    return ret;
+}
+
+static json json_index_parse_object(const char *data, json_index *idx, uint32 *k, allocator *alloc)
+{
+    json ret;
+    ret.type = JSON_TYPE_OBJECT;
+    ret.obj.key_count = idx->aux[*k];
+    ret.obj.hash_cap = json_object_hash_cap(ret.obj.key_count);
+    ret.obj.values = allocate(alloc, sizeof(*ret.obj.values) * ret.obj.key_count +
+                                     json_object_hash_size(ret.obj.hash_cap));
+    ret.obj.keys = sallocate(alloc, *ret.obj.keys, ret.obj.key_count);
+    *k += 1;
+
+    uint32 pos;
+    for(uint32 i = 0; i < ret.obj.key_count; ++i) {
+        if (i) {
+            if (json_index_char(data, idx, *k) != ',') {
+                log_print_error("Expected ',' between object members - char index %u", json_index_offset(idx, *k));
                 goto fail;
             }
-            break;
-        default:
-            log_print_error("Got unrecognisable type parsing object value - char index %u", pos);
+            *k += 1;
+        }
+        if (json_index_char(data, idx, *k) != '"' || json_index_char(data, idx, *k + 2) != ':') {
+            log_print_error("Expected key followed by ':' - char index %u", json_index_offset(idx, *k));
             goto fail;
         }
+        ret.obj.keys[i].cstr = data + idx->pos[*k] + 1;
+        ret.obj.keys[i].len = idx->pos[*k + 1] - idx->pos[*k] - 1;
+
+        pos = idx->pos[*k + 2] + 1;
+        pos += simd_skip_over_whitespace(data + pos);
+        *k += 3;
+
+        ret.obj.values[i] = json_index_parse_value(data, idx, k, pos, alloc);
+        if (ret.obj.values[i].type == JSON_TYPE_INVALID) {
+            log_print_error("Got invalid object value - char index %u", pos);
+            goto fail;
+        }
+    }
+    if (json_index_char(data, idx, *k) != '}') {
+        log_print_error("Expected '}' at end of object - char index %u", json_index_offset(idx, *k));
+        goto fail;
     }
-    pos += simd_find_char(data + pos, '}');
-    *offset = pos + 1;
+    *k += 1;
+
+    if (ret.obj.hash_cap)
+        json_object_build_hash(&ret.obj);
     return ret;
 
 fail:
-    log_print_error("Failed to parse object, Location - ");
-    print_count_chars(data + pos, 100);
-    println("\n");
     return (json){};
 }
 
-inline static void json_fill_array_elem(json_array *to, json *from, uint i) {
-    switch(from->type) {
+static inline void json_array_allocate_elems(json_array *arr, allocator *alloc)
+{
+    switch(arr->elem_type) {
     case JSON_TYPE_STRING:
-        to->strs[i] = from->str;
+        arr->strs = sallocate(alloc, *arr->strs, arr->len);
         break;
     case JSON_TYPE_NUMBER:
-        to->nums[i] = from->num;
+        arr->nums = sallocate(alloc, *arr->nums, arr->len);
         break;
     case JSON_TYPE_OBJECT:
-        to->objs[i] = from->obj;
+        arr->objs = sallocate(alloc, *arr->objs, arr->len);
         break;
     case JSON_TYPE_ARRAY:
-        to->arrs[i] = from->arr;
+        arr->arrs = sallocate(alloc, *arr->arrs, arr->len);
         break;
     case JSON_TYPE_BOOL:
-        to->booleans[i] = from->boolean;
+        arr->booleans = sallocate(alloc, *arr->booleans, arr->len);
         break;
     case JSON_TYPE_NULL:
-        to->nulls[i] = from->null;
+        arr->nulls = sallocate(alloc, *arr->nulls, arr->len);
         break;
     default:
-        log_print_error("Invalid type while filling array elem");
+        break;
     }
 }
 
-static json json_parse_array(const char *data, uint32 *offset, allocator *alloc)
+static json json_index_parse_array(const char *data, json_index *idx, uint32 *k, allocator *alloc)
 {
-    uint32 pos = *offset + (data[*offset] == '[');
     json ret;
     ret.type = JSON_TYPE_ARRAY;
-    json_parse_fn parse_fn = json_array_get_elem_info(data + pos, &ret.arr, alloc);
-    if (ret.arr.len == Max_u32) {
-        log_print_error("Failed to find array len - char index %u", pos);
-        goto fail;
-    }
-    uint32 i;
+    ret.arr.len = idx->aux[*k];
+
+    uint32 pos = idx->pos[*k] + 1;
+    pos += simd_skip_over_whitespace(data + pos);
+    ret.arr.elem_type = json_get_type(data + pos);
+    json_array_allocate_elems(&ret.arr, alloc);
+    *k += 1;
+
     json tmp;
-    for(i = 0; i < ret.arr.len; ++i) {
-        pos += simd_skip_over_whitespace(data + pos);
-        tmp = parse_fn(data, &pos, alloc);
+    for(uint32 i = 0; i < ret.arr.len; ++i) {
+        if (i) {
+            if (json_index_char(data, idx, *k) != ',') {
+                log_print_error("Expected ',' between array elems - char index %u", json_index_offset(idx, *k));
+                goto fail;
+            }
+            pos = idx->pos[*k] + 1;
+            pos += simd_skip_over_whitespace(data + pos);
+            *k += 1;
+        }
+        tmp = json_index_parse_value(data, idx, k, pos, alloc);
+        if (tmp.type != ret.arr.elem_type) {
+            log_print_error("Got invalid array elem or elem of mismatched type - char index %u", pos);
+            goto fail;
+        }
         json_fill_array_elem(&ret.arr, &tmp, i);
-        pos += simd_skip_over_whitespace(data + pos);
-        pos += data[pos] == ',';
-        pos += simd_skip_over_whitespace(data + pos);
     }
-    assert(data[pos] == ']');
-    *offset = pos + 1;
+    if (json_index_char(data, idx, *k) != ']') {
+        log_print_error("Expected ']' at end of array - char index %u", json_index_offset(idx, *k));
+        goto fail;
+    }
+    *k += 1;
     return ret;
 
 fail:
-    log_print_error("Failed to parse array - char index %u", pos);
     return (json){};
 }
 
-static json json_parse_string(const char *data, uint32 *offset, allocator *alloc)
+// Bytes that json_index_parse_value allocates for the container at idx->pos[k]
+// itself, not counting its children.
+static size_t json_index_container_size(const char *data, json_index *idx, uint32 k)
 {
-    assert(data[*offset] == '"');
-    uint32 pos = *offset;
-    json_skip_over_string(data, &pos);
-    json ret;
-    ret.type = JSON_TYPE_STRING;
-    ret.str.cstr = data + *offset + 1;
-    ret.str.len = pos - *offset - 2;
-    *offset = pos;
-    return ret;
-}
+    uint32 n = idx->aux[k];
+    uint32 pos = idx->pos[k];
+    if (data[pos] == '{')
+        return alloc_align(sizeof(json) * n + json_object_hash_size(json_object_hash_cap(n))) +
+               alloc_align(sizeof(json_string) * n);
 
-static json json_parse_number(const char *data, uint32 *offset, allocator *alloc)
-{
-    assert(data[*offset] == '-' || (data[*offset] >= '0' && data[*offset] <= '9'));
-    if (json_validate_number(data + *offset) != JSON_RESULT_SUCCESS) {
-        log_print_error("Failed to validate number - char index %u", *offset);
-        return (json){};
+    pos += 1;
+    pos += simd_skip_over_whitespace(data + pos);
+    switch(json_get_type(data + pos)) {
+    case JSON_TYPE_STRING:
+        return alloc_align(sizeof(json_string) * n);
+    case JSON_TYPE_NUMBER:
+        return alloc_align(sizeof(json_number) * n);
+    case JSON_TYPE_OBJECT:
+        return alloc_align(sizeof(json_object) * n);
+    case JSON_TYPE_ARRAY:
+        return alloc_align(sizeof(json_array) * n);
+    case JSON_TYPE_BOOL:
+        return alloc_align(sizeof(json_bool) * n);
+    case JSON_TYPE_NULL:
+        return alloc_align(sizeof(json_null) * n);
+    default:
+        return 0;
     }
-    json ret;
-    ret.type = JSON_TYPE_NUMBER;
-    ret.num = ascii_to_double(data + *offset);
-    *offset += simd_ascii_double_len(data + *offset);
-    return ret;
 }
 
-static json json_parse_bool(const char *data, uint32 *offset, allocator *alloc)
+// Bytes that json_index_parse_value allocates for the whole tree: one walk of
+// the index after json_index_count_elems, summing each container.
+static size_t json_index_tree_size(const char *data, json_index *idx)
 {
-    assert(data[*offset] == 't' || data[*offset] == 'f');
-    if (json_validate_bool(data + *offset) != JSON_RESULT_SUCCESS) {
-        log_print_error("Failed to validate bool - char index %u", *offset);
-        return (json){};
+    size_t size = 0;
+    char c;
+    for(uint32 k = 0; k < idx->count; ++k) {
+        c = data[idx->pos[k]];
+        if (c == '{' || c == '[')
+            size += json_index_container_size(data, idx, k);
+        else if (c == '"')
+            k++; // closing quote
     }
-    json ret;
-    ret.type = JSON_TYPE_BOOL;
-    ret.boolean = data[*offset] == 't' ? true : false;
-    *offset += 4 + (!ret.boolean);
-    return ret;
+    return size;
 }
 
-static json json_parse_null(const char *data, uint32 *offset, allocator *alloc)
+// A linear allocator can only be reset from the top, and the index is above
+// 'mark', so the tree takes the index's place at 'mark' and the entries in
+// use are moved up above it. Then resetting to the end of the tree frees the
+// index as before. aux is moved first, as its new place is clear of the old
+// entries in pos.
+static void* json_allocate_tree(allocator *alloc, uint64 mark, json_index *idx, size_t size)
 {
-    assert(data[*offset] == 'n');
-    if (json_validate_null(data + *offset) != JSON_RESULT_SUCCESS) {
-        log_print_error("Failed to validate null - char index %u", *offset);
-        return (json){};
-    }
-    json ret;
-    ret.type = JSON_TYPE_NULL;
-    ret.null = 0;
-    *offset += 4;
-    return ret;
+    if (!(alloc->flags & ALLOCATOR_LINEAR_BIT))
+        return allocate(alloc, size);
+
+    size_t tree = alloc_align(size);
+    size_t entries = alloc_align(sizeof(uint32) * idx->count);
+    uint64 end = mark + tree + entries * 2;
+    if (end > alloc->linear.used)
+        allocate(alloc, end - alloc->linear.used);
+
+    uint8 *base = alloc->linear.mem + mark;
+    uint32 *pos = (uint32*)(base + tree);
+    uint32 *aux = (uint32*)(base + tree + entries);
+    memmove(aux, idx->aux, sizeof(uint32) * idx->count);
+    memmove(pos, idx->pos, sizeof(uint32) * idx->count);
+    idx->pos = pos;
+    idx->aux = aux;
+    return base;
 }
 
-static uint32 json_object_count_keys(const char *data)
-{
-    uint32 ret = 0;
-    uint32 pos = data[0] == '{';
-    while(1) {
-        switch(json_parser_find_key(data, &pos)) {
-        case JSON_RESULT_KEY:
-            ret++;
-            if (json_skip_over_key_and_value(data, &pos) != JSON_RESULT_SUCCESS)
-                return Max_u32;
-            else
-                continue;
-        case JSON_RESULT_END:
-            return ret;
-        default:
-            log_print_error("Failed to find key or find closing '}' - char index %u", pos);
+// Parallel stage 2: each array value of the top level object is cut into
+// ranges of elems of roughly JSON_PARALLEL_RANGE_SIZE bytes. The exact size
+// of each range's subtree is known from the index, so every range gets its own
+// slice of the output allocation up front, and the ranges can be built in any
+// order on any thread without copying anything afterwards.
+#define JSON_PARALLEL_RANGE_SIZE (64 * 1024)
+#define JSON_PARALLEL_MIN_SIZE (2 * JSON_PARALLEL_RANGE_SIZE)
+
+struct json_parallel_array {
+    uint32 k_open;
+    uint32 k_close;
+    json_array arr;
+};
+
+struct json_parallel_range {
+    json_array *arr;
+    uint32 k; // index entry of the first elem, or of the following ',' if it is a scalar
+    uint32 pos; // char index of the first elem
+    uint32 first;
+    uint32 count;
+    size_t size;
+    void *mem;
+};
+
+// Tape mode: a range is written straight to its place in the tape, as the
+// token count of every range is known from the plan.
+struct json_tape_range {
+    uint32 pos; // char index of the first elem
+    uint32 count;
+    uint32 tokens;
+    uint32 base; // tape index of the first elem
+    bool32 last; // followed by the array's ']' rather than a ','
+};
+
+struct json_tape_array {
+    uint32 open; // char index of the '['
+    uint32 close; // char index of the ']'
+    uint32 len;
+    uint32 range;
+};
+
+struct json_parallel_work {
+    const char *data;
+    json_index *idx;
+    json_tape *tape; // NULL unless building a tape
+    struct json_parallel_range *ranges;
+    struct json_tape_range *tape_ranges;
+    uint32 range_count;
+    uint32 next;
+    uint32 done;
+    uint32 exited;
+    bool32 failed;
+};
+
+static bool json_parallel_parse_range(const char *data, json_index *idx, struct json_parallel_range *r)
+{
+    allocator alloc = new_linear_allocator(r->size, r->mem);
+    uint32 k = r->k;
+    uint32 pos = r->pos;
+    json tmp;
+    for(uint32 i = 0; i < r->count; ++i) {
+        if (i) {
+            if (json_index_char(data, idx, k) != ',') {
+                log_print_error("Expected ',' between array elems - char index %u", json_index_offset(idx, k));
+                return false;
+            }
+            pos = idx->pos[k] + 1;
+            pos += simd_skip_over_whitespace(data + pos);
+            k += 1;
+        }
+        tmp = json_index_parse_value(data, idx, &k, pos, &alloc);
+        if (tmp.type != r->arr->elem_type) {
+            log_print_error("Got invalid array elem or elem of mismatched type - char index %u", pos);
+            return false;
+        }
+        json_fill_array_elem(r->arr, &tmp, r->first + i);
+    }
+    assert(alloc.linear.used == r->size && "json parallel range size is not exact");
+    return true;
+}
+
+static bool json_tape_parse_range(const char *data, json_tape *tape, struct json_tape_range *r);
+
+// Ranges are claimed from a shared counter rather than given out one per work
+// item, so the calling thread makes progress even if the pool is busy.
+static void json_parallel_parse_ranges(struct json_parallel_work *w)
+{
+    uint32 i;
+    bool ok;
+    while((i = atomic_add(&w->next, 1)) < w->range_count) {
+        ok = w->tape ? json_tape_parse_range(w->data, w->tape, &w->tape_ranges[i]) :
+                       json_parallel_parse_range(w->data, w->idx, &w->ranges[i]);
+        if (!ok)
+            signal_thread_true(&w->failed);
+        atomic_add(&w->done, 1);
+    }
+}
+
+static void* json_parallel_parse_ranges_tf(struct thread_work_arg *arg)
+{
+    struct json_parallel_work *w = arg->arg;
+    json_parallel_parse_ranges(w);
+    atomic_add(&w->exited, 1);
+    return NULL;
+}
+
+// Walk the top level object, recording each array value and cutting it into
+// ranges at the ',' between elems. Returns the number of arrays.
+static uint32 json_parallel_plan(const char *data, json_index *idx, struct json_parallel_array *arrays,
+                                 struct json_parallel_range *ranges, uint32 *range_count)
+{
+    struct json_parallel_array *a = NULL;
+    struct json_parallel_range *r = NULL;
+    uint32 array_count = 0;
+    uint32 rc = 0;
+    uint32 depth = 0;
+    uint32 elem = 0;
+    uint32 pos;
+    char c;
+    for(uint32 k = 1; k < idx->count; ++k) {
+        pos = idx->pos[k];
+        c = data[pos];
+        switch(c) {
+        case '{':
+        case '[':
+            if (depth == 0 && c == '[') {
+                a = &arrays[array_count++];
+                a->k_open = k;
+                a->arr.len = idx->aux[k];
+                pos += 1;
+                pos += simd_skip_over_whitespace(data + pos);
+                a->arr.elem_type = json_get_type(data + pos);
+                r = &ranges[rc];
+                *r = (struct json_parallel_range) {.arr = &a->arr, .k = k + 1, .pos = pos};
+                rc += a->arr.len > 0;
+                elem = 0;
+            } else if (a) {
+                r->size += json_index_container_size(data, idx, k);
+            }
+            depth++;
+            break;
+        case '}':
+        case ']':
+            depth--;
+            if (depth == 0 && a) {
+                a->k_close = k;
+                r->count = a->arr.len - r->first;
+                a = NULL;
+            }
+            break;
+        case ',':
+            if (depth != 1 || !a)
+                break;
+            elem++;
+            if (pos - r->pos < JSON_PARALLEL_RANGE_SIZE)
+                break;
+            r->count = elem - r->first;
+            r = &ranges[rc++];
+            pos += 1;
+            pos += simd_skip_over_whitespace(data + pos);
+            *r = (struct json_parallel_range) {.arr = &a->arr, .k = k + 1, .pos = pos, .first = elem};
+            break;
+        case '"':
+            k++;
+            break;
+        default:
+            break;
+        }
+    }
+    *range_count = rc;
+    return array_count;
+}
+
+// Share the ranges between the pool and the calling thread, and return once
+// every range is done and no work item still references 'w'.
+static void json_parallel_run(struct json_parallel_work *w, thread_pool *pool)
+{
+    uint32 i;
+    uint32 submitted = 0;
+    if (pool && w->range_count > 1) {
+        struct thread_work work[THREAD_COUNT];
+        uint32 work_count = w->range_count - 1 < THREAD_COUNT ? w->range_count - 1 : THREAD_COUNT;
+        for(i = 0; i < work_count; ++i) {
+            work[i].fn = cast_work_fn(json_parallel_parse_ranges_tf);
+            work[i].arg = cast_work_arg(w);
+        }
+        submitted = thread_add_work_high(pool, work_count, work);
+    }
+    json_parallel_parse_ranges(w);
+
+    // Work items may still be queued behind other work, and they reference the
+    // index and the plan, which the caller frees.
+    uint32 done, exited;
+    while(1) {
+        atomic_load(&w->done, &done);
+        atomic_load(&w->exited, &exited);
+        if (done == w->range_count && exited == submitted)
+            break;
+        _mm_pause();
+    }
+}
+
+// As json_index_parse_object for the top level object, but taking the array
+// values from the parallel plan.
+static json json_parallel_parse_top_level(const char *data, json_index *idx, struct json_parallel_array *arrays, allocator *alloc)
+{
+    json ret;
+    ret.type = JSON_TYPE_OBJECT;
+    ret.obj.key_count = idx->aux[0];
+    ret.obj.hash_cap = json_object_hash_cap(ret.obj.key_count);
+    ret.obj.values = allocate(alloc, sizeof(*ret.obj.values) * ret.obj.key_count +
+                                     json_object_hash_size(ret.obj.hash_cap));
+    ret.obj.keys = sallocate(alloc, *ret.obj.keys, ret.obj.key_count);
+
+    uint32 k = 1;
+    uint32 pos;
+    for(uint32 i = 0; i < ret.obj.key_count; ++i) {
+        if (i) {
+            if (json_index_char(data, idx, k) != ',') {
+                log_print_error("Expected ',' between object members - char index %u", json_index_offset(idx, k));
+                goto fail;
+            }
+            k += 1;
+        }
+        if (json_index_char(data, idx, k) != '"' || json_index_char(data, idx, k + 2) != ':') {
+            log_print_error("Expected key followed by ':' - char index %u", json_index_offset(idx, k));
+            goto fail;
+        }
+        ret.obj.keys[i].cstr = data + idx->pos[k] + 1;
+        ret.obj.keys[i].len = idx->pos[k + 1] - idx->pos[k] - 1;
+
+        pos = idx->pos[k + 2] + 1;
+        pos += simd_skip_over_whitespace(data + pos);
+        k += 3;
+
+        if (k < idx->count && idx->pos[k] == pos && arrays->k_open == k) {
+            if (json_index_char(data, idx, arrays->k_close) != ']') {
+                log_print_error("Expected ']' at end of array - char index %u", json_index_offset(idx, arrays->k_close));
+                goto fail;
+            }
+            ret.obj.values[i].type = JSON_TYPE_ARRAY;
+            ret.obj.values[i].arr = arrays->arr;
+            k = arrays->k_close + 1;
+            arrays++;
+            continue;
+        }
+        ret.obj.values[i] = json_index_parse_value(data, idx, &k, pos, alloc);
+        if (ret.obj.values[i].type == JSON_TYPE_INVALID) {
+            log_print_error("Got invalid object value - char index %u", pos);
+            goto fail;
+        }
+    }
+    if (json_index_char(data, idx, k) != '}') {
+        log_print_error("Expected '}' at end of object - char index %u", json_index_offset(idx, k));
+        goto fail;
+    }
+
+    if (ret.obj.hash_cap)
+        json_object_build_hash(&ret.obj);
+    return ret;
+
+fail:
+    return (json){};
+}
+
+json parse_json_parallel(struct file *f, thread_pool *pool, allocator *alloc, struct allocation *mem_used)
+{
+    uint32 pos = simd_skip_over_whitespace(f->data);
+    if (f->size < JSON_PARALLEL_MIN_SIZE || f->data[pos] != '{')
+        return parse_json(f, alloc, mem_used);
+
+    uint64 mark = alloc->flags & ALLOCATOR_LINEAR_BIT ? alloc->linear.used : 0;
+    json_index idx = json_build_index(f->data, f->size, alloc);
+
+    // Sized and allocated as in parse_json, before the plan is allocated.
+    bool ok = json_index_count_elems(f->data, &idx) == JSON_RESULT_SUCCESS;
+    size_t size = ok ? json_index_tree_size(f->data, &idx) : 0;
+    size_t cap = size ? size : ALLOCATOR_ALIGNMENT;
+    void *buf = json_allocate_tree(alloc, mark, &idx, cap);
+    allocator json_alloc = new_linear_allocator(cap, buf);
+
+    if (mem_used)
+        *mem_used = (struct allocation){buf, cap};
+
+    json ret = (json){};
+    struct json_parallel_array *arrays = NULL;
+    struct json_parallel_range *ranges = NULL;
+    struct json_parallel_work w = {};
+    uint32 i, array_count;
+
+    if (!ok)
+        goto free_index;
+
+    // Every range but the first in an array starts after a ',' which is at
+    // least JSON_PARALLEL_RANGE_SIZE bytes on from the last.
+    arrays = sallocate(alloc, *arrays, idx.aux[0] + 1);
+    ranges = sallocate(alloc, *ranges, idx.aux[0] + f->size / JSON_PARALLEL_RANGE_SIZE + 1);
+    array_count = json_parallel_plan(f->data, &idx, arrays, ranges, &w.range_count);
+    arrays[array_count].k_open = Max_u32;
+
+    for(i = 0; i < array_count; ++i)
+        json_array_allocate_elems(&arrays[i].arr, &json_alloc);
+    for(i = 0; i < w.range_count; ++i)
+        ranges[i].mem = allocate(&json_alloc, ranges[i].size);
+
+    w.data = f->data;
+    w.idx = &idx;
+    w.ranges = ranges;
+    json_parallel_run(&w, pool);
+
+    if (!w.failed) {
+        ret = json_parallel_parse_top_level(f->data, &idx, arrays, &json_alloc);
+        assert((ret.type == JSON_TYPE_INVALID || json_alloc.linear.used == alloc_align(size)) &&
+               "json tree size is not exact");
+    }
+
+free_index:
+    if (alloc->flags & ALLOCATOR_LINEAR_BIT) {
+        allocator_reset_linear_to(alloc, mark + alloc_align(cap));
+    } else {
+        if (ranges) {
+            deallocate(alloc, ranges);
+            deallocate(alloc, arrays);
+        }
+        if (idx.aux)
+            deallocate(alloc, idx.aux);
+        deallocate(alloc, idx.pos);
+    }
+    return ret;
+}
+
+static inline uint32 json_hex4(const char *data)
+{
+    uint32 ret = 0;
+    char c;
+    for(uint32 i = 0; i < 4; ++i) {
+        c = data[i];
+        if (c >= '0' && c <= '9')
+            ret = (ret << 4) | (c - '0');
+        else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+            ret = (ret << 4) | ((c | 0x20) - 'a' + 10);
+        else
             return Max_u32;
+    }
+    return ret;
+}
+
+// Validation: the structural index gives every token that is not a scalar, so
+// the grammar is checked by walking the index, and the bytes between tokens
+// only need to be whitespace, or a scalar where a value is expected. The index
+// is walked a 64 byte block at a time as stage 1 produces it, so nothing is
+// allocated. Nothing is logged; the first error is returned.
+enum {
+    JSON_VALIDATE_STATE_VALUE,        // after ':', or ',' in an array
+    JSON_VALIDATE_STATE_VALUE_OR_END, // after '['
+    JSON_VALIDATE_STATE_KEY,          // after ',' in an object
+    JSON_VALIDATE_STATE_KEY_OR_END,   // after '{'
+    JSON_VALIDATE_STATE_COLON,        // after a key
+    JSON_VALIDATE_STATE_NEXT,         // after a value
+};
+
+static inline bool json_is_whitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Index of the first non whitespace byte in data[pos..end), or end.
+static inline uint32 json_skip_whitespace(const char *data, uint32 pos, uint32 end)
+{
+    if (pos < end && !json_is_whitespace(data[pos]))
+        return pos;
+    __m128i a;
+    uint16 m;
+    for(; pos + 16 <= end; pos += 16) {
+        a = _mm_loadu_si128((__m128i*)(data + pos));
+        m = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(a, _mm_set1_epi8(' ')),
+                                                        _mm_cmpeq_epi8(a, _mm_set1_epi8('\n'))),
+                                           _mm_or_si128(_mm_cmpeq_epi8(a, _mm_set1_epi8('\r')),
+                                                        _mm_cmpeq_epi8(a, _mm_set1_epi8('\t')))));
+        if (m != 0xffff)
+            return pos + ctz16(~m);
+    }
+    for(; pos < end && json_is_whitespace(data[pos]); ++pos);
+    return pos;
+}
+
+// Only the escapes in the spec are allowed. Control chars have already been
+// found by stage 1.
+static const char* json_validate_string(const char *data, uint32 begin, uint32 end, uint32 *err)
+{
+    uint32 pos = begin;
+    while(1) {
+        pos = json_find_quote_or_escape(data, pos, end);
+        if (pos == end)
+            return NULL;
+        *err = pos;
+        switch(data[pos + 1]) {
+        case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+            pos += 2;
+            break;
+        case 'u':
+            if (pos + 6 > end || json_hex4(data + pos + 2) == Max_u32)
+                return "Invalid \\u escape in string";
+            pos += 6;
+            break;
+        default:
+            return "Invalid escape in string";
         }
     }
 }
-static json_parse_fn json_array_get_elem_info(const char *data, json_array *arr, allocator *alloc)
+
+// 'end' is one past the last non whitespace byte; scalars are always followed
+// by a structural char, so the scans cannot run off the end.
+static const char* json_validate_scalar(const char *data, uint32 begin, uint32 end)
 {
-    uint32 pos = data[0] == '[';
-    pos += simd_skip_over_whitespace(data + pos);
-    json_result (*skip_fn)(const char *, uint32 *);
-    json_parse_fn parse_fn;
-    json_type type = json_get_type(data + pos);
-    void **elems;
-    uint elem_size;
-    switch(type) {
-    case JSON_TYPE_STRING:
-        skip_fn = json_skip_over_string;
-        parse_fn = json_parse_string;
-        arr->elem_type = JSON_TYPE_STRING;
-        elems = (void**)&arr->strs;
-        elem_size = sizeof(*arr->strs);
-        break;
-    case JSON_TYPE_NUMBER:
-        skip_fn = json_skip_over_number;
-        parse_fn = json_parse_number;
-        arr->elem_type = JSON_TYPE_NUMBER;
-        elems = (void**)&arr->nums;
-        elem_size = sizeof(*arr->nums);
+    uint32 len = end - begin;
+    switch(data[begin]) {
+    case 't':
+        return len == 4 && memcmp(data + begin, "true", 4) == 0 ? NULL : "Invalid literal";
+    case 'f':
+        return len == 5 && memcmp(data + begin, "false", 5) == 0 ? NULL : "Invalid literal";
+    case 'n':
+        return len == 4 && memcmp(data + begin, "null", 4) == 0 ? NULL : "Invalid literal";
+    default:
+    {
+        struct ascii_number num;
+        return ascii_scan_number(data + begin, &num) == len ? NULL : "Invalid number";
+    }
+    }
+}
+
+static inline void json_error_position(const char *data, json_error *err)
+{
+    __m128i nl = _mm_set1_epi8('\n');
+    uint64 pos = 0, line_begin = 0;
+    uint32 lines = 0;
+    uint16 m;
+    for(; pos + 16 <= err->offset; pos += 16) {
+        m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i*)(data + pos)), nl));
+        if (m) {
+            lines += popcnt16(m);
+            line_begin = pos + 16 - clz16(m);
+        }
+    }
+    for(; pos < err->offset; ++pos)
+        if (data[pos] == '\n') {
+            lines++;
+            line_begin = pos + 1;
+        }
+    err->line = lines + 1;
+    err->column = err->offset - line_begin + 1;
+}
+
+struct json_validator {
+    uint64 containers[JSON_MAX_DEPTH / 64]; // bit set if the container is an object
+    uint32 depth;
+    uint32 state;
+    uint32 prev; // one past the last token
+    uint32 open; // opening quote of a string whose closing quote is still to come, or Max_u32
+    uint32 err;
+    const char *msg;
+};
+
+// Check the structural char at 'pos' and the bytes since the last one, or
+// with pos == size, the bytes since the last one. Return false on an error.
+static bool json_validate_token(struct json_validator *v, const char *data, uint32 size, uint32 pos,
+                                struct json_index_check *check)
+{
+    uint32 end;
+    char c;
+    if (v->open != Max_u32) {
+        if (pos == size) {
+            v->err = v->open;
+            v->msg = "Unterminated string";
+            return false;
+        }
+        end = pos;
+        v->err = v->open;
+        v->prev = end + 1;
+        if (check->control < end) {
+            v->err = check->control;
+            v->msg = "Unescaped control character in string";
+            return false;
+        }
+        if (check->escapes && (v->msg = json_validate_string(data, v->open + 1, end, &v->err)))
+            return false;
+        v->open = Max_u32;
+        if (v->state == JSON_VALIDATE_STATE_KEY || v->state == JSON_VALIDATE_STATE_KEY_OR_END) {
+            v->state = JSON_VALIDATE_STATE_COLON;
+        } else if (v->state == JSON_VALIDATE_STATE_VALUE || v->state == JSON_VALIDATE_STATE_VALUE_OR_END) {
+            if (v->depth == 0) {
+                v->msg = "Top level item must be an object or array";
+                return false;
+            }
+            v->state = JSON_VALIDATE_STATE_NEXT;
+        } else {
+            v->msg = "Unexpected string";
+            return false;
+        }
+        return true;
+    }
+
+    // bytes since the last token
+    v->prev = json_skip_whitespace(data, v->prev, pos);
+    if (v->prev < pos) {
+        v->err = v->prev;
+        if (pos == size && v->depth)
+            return true; // reported as unclosed by the caller
+        if ((v->state != JSON_VALIDATE_STATE_VALUE && v->state != JSON_VALIDATE_STATE_VALUE_OR_END) || pos == size) {
+            v->msg = "Unexpected character";
+            return false;
+        }
+        if (v->depth == 0) {
+            v->msg = "Top level item must be an object or array";
+            return false;
+        }
+        for(end = pos; json_is_whitespace(data[end - 1]); --end);
+        if ((v->msg = json_validate_scalar(data, v->prev, end)))
+            return false;
+        v->state = JSON_VALIDATE_STATE_NEXT;
+    }
+    if (pos == size)
+        return true;
+
+    v->err = pos;
+    c = data[pos];
+    v->prev = pos + 1;
+    switch(c) {
+    case '"':
+        v->open = pos;
         break;
-    case JSON_TYPE_OBJECT:
-        skip_fn = json_skip_over_object;
-        parse_fn = json_parse_object;
-        arr->elem_type = JSON_TYPE_OBJECT;
-        elems = (void**)&arr->objs;
-        elem_size = sizeof(*arr->objs);
+    case '{':
+    case '[':
+        if (v->state != JSON_VALIDATE_STATE_VALUE && v->state != JSON_VALIDATE_STATE_VALUE_OR_END) {
+            v->msg = "Unexpected container";
+            return false;
+        }
+        if (v->depth == JSON_MAX_DEPTH) {
+            v->msg = "Exceeded max json depth";
+            return false;
+        }
+        if (c == '{')
+            v->containers[v->depth >> 6] |= 1ull << (v->depth & 63);
+        else
+            v->containers[v->depth >> 6] &= ~(1ull << (v->depth & 63));
+        v->depth++;
+        v->state = c == '{' ? JSON_VALIDATE_STATE_KEY_OR_END : JSON_VALIDATE_STATE_VALUE_OR_END;
         break;
-    case JSON_TYPE_ARRAY:
-        skip_fn = json_skip_over_array;
-        parse_fn = json_parse_array;
-        arr->elem_type = JSON_TYPE_ARRAY;
-        elems = (void**)&arr->arrs;
-        elem_size = sizeof(*arr->arrs);
+    case '}':
+    case ']':
+        if (v->depth == 0 ||
+            (bool)(v->containers[(v->depth - 1) >> 6] & (1ull << ((v->depth - 1) & 63))) != (c == '}')) {
+            v->msg = "Unmatched closing bracket";
+            return false;
+        }
+        if (v->state != JSON_VALIDATE_STATE_NEXT &&
+            v->state != (c == '}' ? JSON_VALIDATE_STATE_KEY_OR_END : JSON_VALIDATE_STATE_VALUE_OR_END)) {
+            v->msg = c == '}' ? "Expected value before '}'" : "Expected value before ']'";
+            return false;
+        }
+        v->depth--;
+        v->state = JSON_VALIDATE_STATE_NEXT;
         break;
-    case JSON_TYPE_BOOL:
-        skip_fn = json_skip_over_bool;
-        parse_fn = json_parse_bool;
-        arr->elem_type = JSON_TYPE_BOOL;
-        elems = (void**)&arr->booleans;
-        elem_size = sizeof(*arr->booleans);
+    case ':':
+        if (v->state != JSON_VALIDATE_STATE_COLON) {
+            v->msg = "Unexpected ':'";
+            return false;
+        }
+        v->state = JSON_VALIDATE_STATE_VALUE;
         break;
-    case JSON_TYPE_NULL:
-        skip_fn = json_skip_over_null;
-        parse_fn = json_parse_null;
-        arr->elem_type = JSON_TYPE_NULL;
-        elems = (void**)&arr->nulls;
-        elem_size = sizeof(*arr->nulls);
+    case ',':
+        if (v->state != JSON_VALIDATE_STATE_NEXT || v->depth == 0) {
+            v->msg = "Unexpected ','";
+            return false;
+        }
+        v->state = v->containers[(v->depth - 1) >> 6] & (1ull << ((v->depth - 1) & 63)) ?
+                   JSON_VALIDATE_STATE_KEY : JSON_VALIDATE_STATE_VALUE;
         break;
     default:
-        log_print_error("Got invalid element type while counting array elems - char index %u", pos);
-        arr->len = Max_u32;
-        return NULL;
+        break;
     }
-    uint32 i;
-    for(i = 0; data[pos] != ']'; ++i) {
-        if (skip_fn(data, &pos) != JSON_RESULT_SUCCESS) {
-            log_print_error("Failed to skip element %u in array", i);
-            arr->len = Max_u32;
-            return NULL;
+    return true;
+}
+
+json_error json_validate(const char *data, size_t size)
+{
+    json_error ret = {};
+    if (size >= Max_u32) {
+        ret.msg = "Json larger than 4GB";
+        return ret;
+    }
+
+    struct json_index_scan scan = {};
+    struct json_index_check check = {.control = Max_u32};
+    struct json_validator v = {.state = JSON_VALIDATE_STATE_VALUE, .open = Max_u32};
+    uint64 bits;
+    for(size_t i = 0; i < size; i += 64) {
+        bits = json_index_scan_block(data, size, i, &scan, &check);
+        while(bits) {
+            if (!json_validate_token(&v, data, size, i + ctz64(bits), &check))
+                goto fail;
+            bits &= bits - 1;
         }
-        pos += simd_skip_over_whitespace(data + pos);
-        pos += data[pos] == ',';
-        pos += simd_skip_over_whitespace(data + pos);
     }
-    arr->len = i;
-    *elems = allocate(alloc, elem_size * arr->len);
-    return parse_fn;
+    if (!json_validate_token(&v, data, size, size, &check))
+        goto fail;
+
+    v.err = size;
+    if (v.depth)
+        v.msg = "Unclosed container at end of json";
+    else if (v.state != JSON_VALIDATE_STATE_NEXT)
+        v.msg = "Empty json";
+
+fail:
+    if (v.msg) {
+        ret.msg = v.msg;
+        ret.offset = v.err;
+        json_error_position(data, &ret);
+    }
+    return ret;
 }
 
-static json_result json_parser_find_key(const char *data, uint32 *pos)
+// Upper bound on the number of tokens in a document: every key is followed by
+// a ':' and counts once for itself and once for its value; every array elem
+// bar the first is preceded by a ','; plus one for the first elem of each array
+// and one for the root. Chars inside strings only make the bound looser.
+static uint32 json_tape_token_bound(const char *data, size_t size)
 {
-    *pos += simd_skip_over_whitespace(data + *pos);
-    if (data[*pos] == ',') {
-        *pos += 1;
-        *pos += simd_skip_over_whitespace(data + *pos);
+    __m128i a;
+    __m128i b = _mm_set1_epi8(':');
+    __m128i c = _mm_set1_epi8(',');
+    __m128i d = _mm_set1_epi8('[');
+    uint32 colons = 0;
+    uint32 other = 0;
+    size_t i;
+    for(i = 0; i + 16 <= size; i += 16) {
+        a = _mm_loadu_si128((__m128i*)(data + i));
+        colons += pop_count16(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+        other += pop_count16(_mm_movemask_epi8(_mm_cmpeq_epi8(a, c)) |
+                             _mm_movemask_epi8(_mm_cmpeq_epi8(a, d)));
     }
-    if (data[*pos] == '"')
-        if (data[((int)*pos) - 1] == '\\') {
-            log_print_error("Found escaped '\"' outside of a key - char index %u", *pos);
-            return JSON_RESULT_INVALID;
-        } else {
-            return JSON_RESULT_KEY;
-        }
-    else if (data[*pos])
-        return JSON_RESULT_END;
-    else
+    for(; i < size; ++i) {
+        colons += data[i] == ':';
+        other += data[i] == ',' || data[i] == '[';
+    }
+    return colons * 2 + other + 1;
+}
+
+static json_result json_tape_parse_value(const char *data, uint32 *pos, json_tape *tape);
+
+json_tape parse_json_tape(struct file *f, allocator *alloc, struct allocation *mem_used)
+{
+    json_tape ret;
+    ret.count = 0;
+    ret.cap = json_tape_token_bound(f->data, f->size);
+    ret.tokens = sallocate(alloc, *ret.tokens, ret.cap);
+    ret.data = f->data;
+    ret.size = f->size;
+
+    if (mem_used)
+        *mem_used = (struct allocation){ret.tokens, sizeof(*ret.tokens) * ret.cap};
+
+    uint32 pos = simd_skip_over_whitespace(f->data);
+    json_type type = json_get_type(f->data + pos);
+    if (type != JSON_TYPE_OBJECT && type != JSON_TYPE_ARRAY) {
+        log_print_error("Top level item must be an object or array");
+        ret.count = 0;
+        return ret;
+    }
+    if (json_tape_parse_value(f->data, &pos, &ret) != JSON_RESULT_SUCCESS) {
+        log_print_error("Failed to parse json tape - char index %u", pos);
+        ret.count = 0;
+    }
+    return ret;
+}
+
+static json_result json_tape_parse_string(const char *data, uint32 *pos, json_tape *tape)
+{
+    if (data[*pos] != '"') {
+        log_print_error("Expected '\"', found '%c' - char index %u", data[*pos], *pos);
+        return JSON_RESULT_INVALID;
+    }
+    if (tape->count >= tape->cap) {
+        log_print_error("json tape overflowed its bound - char index %u", *pos);
+        return JSON_RESULT_INVALID;
+    }
+    json_token *tok = &tape->tokens[tape->count++];
+    tok->type = JSON_TYPE_STRING;
+    tok->offset = *pos + 1;
+    if (json_skip_over_string(data, tape->size, pos) != JSON_RESULT_SUCCESS)
         return JSON_RESULT_INVALID;
+    tok->len = *pos - tok->offset - 1;
+    tok->next = tape->count;
+    return JSON_RESULT_SUCCESS;
 }
 
-static json_result json_skip_over_key_and_value(const char *data, uint32 *pos)
+// After an elem, consume a ',' which must be followed by another elem, or stop
+// at 'close'. json_tape_token_bound counts the ',', so anything else would let
+// the tape outgrow it.
+static json_result json_tape_parse_separator(const char *data, uint32 *pos, char close)
 {
-    json_skip_over_string(data, pos);
     *pos += simd_skip_over_whitespace(data + *pos);
-    if (data[*pos] != ':') {
-        log_print_error("Found '%c' in place of ':' when skipping key - char index %u", data[*pos], *pos);
+    if (data[*pos] == close)
+        return JSON_RESULT_SUCCESS;
+    if (data[*pos] != ',') {
+        log_print_error("Found '%c' in place of ',' or '%c' - char index %u", data[*pos], close, *pos);
         return JSON_RESULT_INVALID;
-    } else {
-        *pos += 1;
     }
+    *pos += 1;
     *pos += simd_skip_over_whitespace(data + *pos);
-    switch(json_get_type(data + *pos)) {
-    case JSON_TYPE_STRING:
-        return json_skip_over_string(data, pos);
+    if (data[*pos] == close) {
+        log_print_error("Found '%c' after ',' - char index %u", close, *pos);
+        return JSON_RESULT_INVALID;
+    }
+    return JSON_RESULT_SUCCESS;
+}
+
+static json_result json_tape_parse_value(const char *data, uint32 *pos, json_tape *tape)
+{
+    if (tape->count >= tape->cap) {
+        log_print_error("json tape overflowed its bound - char index %u", *pos);
+        return JSON_RESULT_INVALID;
+    }
+    uint32 i = tape->count;
+    json_type type = json_get_type(data + *pos);
+    if (type == JSON_TYPE_STRING)
+        return json_tape_parse_string(data, pos, tape);
+
+    tape->count++;
+    tape->tokens[i].type = type;
+    tape->tokens[i].offset = *pos;
+    tape->tokens[i].len = 0;
+
+    json_result res = JSON_RESULT_SUCCESS;
+    uint32 cnt = 0;
+    switch(type) {
     case JSON_TYPE_NUMBER:
-        return json_skip_over_number(data, pos);
-    case JSON_TYPE_OBJECT:
-        return json_skip_over_object(data, pos);
-    case JSON_TYPE_ARRAY:
-        return json_skip_over_array(data, pos);
+        res = json_skip_over_number(data, pos);
+        tape->tokens[i].len = *pos - tape->tokens[i].offset;
+        break;
     case JSON_TYPE_BOOL:
-        return json_skip_over_bool(data, pos);
+        res = json_skip_over_bool(data, pos);
+        break;
     case JSON_TYPE_NULL:
-        return json_skip_over_null(data, pos);
+        res = json_skip_over_null(data, pos);
+        break;
+    case JSON_TYPE_OBJECT:
+        *pos += 1;
+        *pos += simd_skip_over_whitespace(data + *pos);
+        while(data[*pos] != '}') {
+            res = json_tape_parse_string(data, pos, tape);
+            if (res != JSON_RESULT_SUCCESS)
+                break;
+            *pos += simd_skip_over_whitespace(data + *pos);
+            if (data[*pos] != ':') {
+                log_print_error("Found '%c' in place of ':' - char index %u", data[*pos], *pos);
+                res = JSON_RESULT_INVALID;
+                break;
+            }
+            *pos += 1;
+            *pos += simd_skip_over_whitespace(data + *pos);
+            res = json_tape_parse_value(data, pos, tape);
+            if (res != JSON_RESULT_SUCCESS)
+                break;
+            cnt++;
+            res = json_tape_parse_separator(data, pos, '}');
+            if (res != JSON_RESULT_SUCCESS)
+                break;
+        }
+        *pos += 1;
+        break;
+    case JSON_TYPE_ARRAY:
+        *pos += 1;
+        *pos += simd_skip_over_whitespace(data + *pos);
+        while(data[*pos] != ']') {
+            res = json_tape_parse_value(data, pos, tape);
+            if (res != JSON_RESULT_SUCCESS)
+                break;
+            cnt++;
+            res = json_tape_parse_separator(data, pos, ']');
+            if (res != JSON_RESULT_SUCCESS)
+                break;
+        }
+        *pos += 1;
+        break;
     default:
-        return JSON_RESULT_INVALID;
+        log_print_error("Got unrecognisable type parsing tape value - char index %u", *pos);
+        res = JSON_RESULT_INVALID;
+        break;
     }
+    tape->tokens[i].len |= cnt;
+    tape->tokens[i].next = tape->count;
+    return res;
+}
+
+// Tape mode has no use for the structural index beyond planning, and at four
+// bytes per structural char it would dwarf the tape, so the plan is made from
+// stage 1 directly. Only top level arrays of at least JSON_PARALLEL_RANGE_SIZE
+// bytes are cut into ranges, which bounds the plan by the file size; smaller
+// ones are parsed with the rest of the top level.
+struct json_tape_plan {
+    struct json_tape_array *arrays;
+    struct json_tape_range *ranges;
+    uint32 array_count;
+    uint32 range_count;
+    uint32 tokens;
+};
+
+static inline uint32 json_tape_plan_range_cap(size_t size) {
+    return size / JSON_PARALLEL_RANGE_SIZE * 2 + 2;
 }
 
-static json_result json_skip_to_equivalent_depth(const char *data, uint32 *pos, char open, char close)
+static inline uint32 json_tape_plan_array_cap(size_t size) {
+    return size / JSON_PARALLEL_RANGE_SIZE + 1;
+}
+
+static inline size_t json_tape_plan_size(size_t size) {
+    return sizeof(struct json_tape_range) * json_tape_plan_range_cap(size) +
+           sizeof(struct json_tape_array) * json_tape_plan_array_cap(size);
+}
+
+// Every container adds one token per elem and two per member (the key and its
+// value), counted as in json_index_count_elems as one per ',' plus one if it is
+// non-empty. Returns false if the brackets do not add up, in which case the
+// serial parser is left to report the error.
+static bool json_tape_plan(const char *data, size_t size, struct json_tape_plan *plan)
 {
-    *pos += data[*pos] == open;
-    *pos += simd_skip_over_whitespace(data + *pos);
-    int32 stack = 1;
-    uint32 i, j, pc0, pc1, tz0, tz1;
-    uint16 m0, m1;
-    for(i = 0; true; i += 16) {
-        m0 = simd_match_char(data + *pos + i, open);
-        m1 = simd_match_char(data + *pos + i, close);
-        pc0 = pop_count16(m0);
-        pc1 = pop_count16(m1);
-        for(j = 0; j < pc0 + pc1; ++j) {
-            tz0 = ctz16(m0) | max32_if_false(m0);
-            tz1 = ctz16(m1) | max32_if_false(m1);
-            stack += tz0 < tz1;
-            stack -= tz0 > tz1;
-            if (stack == 0) {
-                *pos += i + tz1 + 1;
-                assert(data[*pos-1] == close);
-                return JSON_RESULT_SUCCESS;
-            } else if (stack < 0) {
-                log_print_error("Too many '%c' relative to '%c' while skipping object - char index %u", close, open, *pos + i);
-                return JSON_RESULT_INVALID;
+    char stack[JSON_MAX_DEPTH];
+    struct json_index_scan scan = {};
+    struct json_tape_array *a = NULL;
+    struct json_tape_range *r = NULL;
+    uint32 depth = 0;
+    uint32 roots = 0;
+    uint32 pos, next, t;
+    uint64 bits;
+    char c;
+
+    plan->array_count = 0;
+    plan->range_count = 0;
+    plan->tokens = 1;
+    for(size_t i = 0; i < size; i += 64) {
+        bits = json_index_scan_block(data, size, i, &scan, NULL);
+        while(bits) {
+            pos = i + ctz64(bits);
+            bits &= bits - 1;
+            c = data[pos];
+            switch(c) {
+            case '{':
+            case '[':
+                if (depth == JSON_MAX_DEPTH || (depth == 0 && roots++))
+                    return false;
+                stack[depth++] = c;
+                next = pos + 1;
+                next += simd_skip_over_whitespace(data + next);
+                t = (data[next] != c + 2) << (c == '{');
+                plan->tokens += t;
+                if (depth == 2 && c == '[') {
+                    a = &plan->arrays[plan->array_count++];
+                    *a = (struct json_tape_array) {.open = pos, .len = t, .range = plan->range_count};
+                    r = &plan->ranges[plan->range_count++];
+                    *r = (struct json_tape_range) {.pos = next, .count = t, .tokens = t};
+                } else if (a) {
+                    r->tokens += t;
+                }
+                break;
+            case '}':
+            case ']':
+                if (depth == 0 || stack[depth - 1] != c - 2)
+                    return false;
+                depth--;
+                if (depth != 1 || !a)
+                    break;
+                a->close = pos;
+                r->last = true;
+                if (pos - a->open < JSON_PARALLEL_RANGE_SIZE) {
+                    plan->range_count = a->range;
+                    plan->array_count--;
+                }
+                a = NULL;
+                break;
+            case ',':
+                if (depth == 0)
+                    return false;
+                t = 1 + (stack[depth - 1] == '{');
+                plan->tokens += t;
+                if (!a)
+                    break;
+                if (depth == 2) {
+                    a->len++;
+                    if (pos - r->pos >= JSON_PARALLEL_RANGE_SIZE) {
+                        next = pos + 1;
+                        next += simd_skip_over_whitespace(data + next);
+                        r = &plan->ranges[plan->range_count++];
+                        *r = (struct json_tape_range) {.pos = next};
+                    }
+                    r->count++;
+                }
+                r->tokens += t;
+                break;
+            default:
+                break;
             }
-            m0 ^= (tz0 < tz1) << (tz0 & max32_if_true(tz0 < 16));
-            m1 ^= (tz0 > tz1) << (tz1 & max32_if_true(tz1 < 16));
         }
     }
+    return depth == 0 && !scan.string_carry;
+}
+
+// A range is parsed into a copy of the tape whose count starts at the range's
+// base and whose cap ends at its last token.
+static bool json_tape_parse_range(const char *data, json_tape *tape, struct json_tape_range *r)
+{
+    json_tape t = *tape;
+    t.count = r->base;
+    t.cap = r->base + r->tokens;
+    uint32 pos = r->pos;
+    char c;
+    for(uint32 i = 0; i < r->count; ++i) {
+        if (i) {
+            pos += simd_skip_over_whitespace(data + pos);
+            if (data[pos] != ',') {
+                log_print_error("Found '%c' in place of ',' - char index %u", data[pos], pos);
+                return false;
+            }
+            pos += 1;
+            pos += simd_skip_over_whitespace(data + pos);
+        }
+        if (json_tape_parse_value(data, &pos, &t) != JSON_RESULT_SUCCESS)
+            return false;
+    }
+    pos += simd_skip_over_whitespace(data + pos);
+    c = r->last ? ']' : ',';
+    if (data[pos] != c) {
+        log_print_error("Found '%c' in place of '%c' - char index %u", data[pos], c, pos);
+        return false;
+    }
+    if (t.count != t.cap) {
+        log_print_error("json tape range holds %u tokens in place of %u - char index %u",
+                        t.count - r->base, r->tokens, r->pos);
+        return false;
+    }
+    return true;
+}
+
+// As json_tape_parse_value for the top level object, but only reserving the
+// tokens of the arrays in the plan, and giving each of their ranges its base.
+static json_result json_tape_parse_top_level(const char *data, uint32 pos, struct json_tape_plan *plan, json_tape *tape)
+{
+    struct json_tape_array *a = plan->arrays;
+    struct json_tape_array *end = plan->arrays + plan->array_count;
+    struct json_tape_range *r;
+    json_token *arr;
+    json_result res = JSON_RESULT_SUCCESS;
+    uint32 cnt = 0;
+
+    tape->tokens[0].type = JSON_TYPE_OBJECT;
+    tape->tokens[0].offset = pos;
+    tape->count = 1;
+
+    pos += 1;
+    pos += simd_skip_over_whitespace(data + pos);
+    while(data[pos] != '}') {
+        res = json_tape_parse_string(data, &pos, tape);
+        if (res != JSON_RESULT_SUCCESS)
+            break;
+        pos += simd_skip_over_whitespace(data + pos);
+        if (data[pos] != ':') {
+            log_print_error("Found '%c' in place of ':' - char index %u", data[pos], pos);
+            res = JSON_RESULT_INVALID;
+            break;
+        }
+        pos += 1;
+        pos += simd_skip_over_whitespace(data + pos);
+        if (a < end && pos == a->open) {
+            arr = &tape->tokens[tape->count++];
+            arr->type = JSON_TYPE_ARRAY;
+            arr->offset = pos;
+            arr->len = a->len;
+            for(r = &plan->ranges[a->range]; r < plan->ranges + plan->range_count; ++r) {
+                r->base = tape->count;
+                tape->count += r->tokens;
+                if (r->last)
+                    break;
+            }
+            arr->next = tape->count;
+            pos = a->close + 1;
+            a++;
+        } else {
+            res = json_tape_parse_value(data, &pos, tape);
+            if (res != JSON_RESULT_SUCCESS)
+                break;
+        }
+        cnt++;
+        res = json_tape_parse_separator(data, &pos, '}');
+        if (res != JSON_RESULT_SUCCESS)
+            break;
+    }
+    tape->tokens[0].len = cnt;
+    tape->tokens[0].next = tape->count;
+    return res;
+}
+
+json_tape parse_json_tape_parallel(struct file *f, thread_pool *pool, allocator *alloc, struct allocation *mem_used)
+{
+    uint32 pos = simd_skip_over_whitespace(f->data);
+    if (f->size < JSON_PARALLEL_MIN_SIZE || f->data[pos] != '{')
+        return parse_json_tape(f, alloc, mem_used);
+
+    // The plan is only needed while parsing, so once the token count is known
+    // the tokens take its place at 'mark' and it is moved up above them, as
+    // json_allocate_tree does for the index.
+    uint64 mark = alloc->flags & ALLOCATOR_LINEAR_BIT ? alloc->linear.used : 0;
+    size_t plan_size = json_tape_plan_size(f->size);
+    struct json_tape_plan plan;
+    plan.ranges = allocate(alloc, plan_size);
+    plan.arrays = (struct json_tape_array*)(plan.ranges + json_tape_plan_range_cap(f->size));
+
+    if (!json_tape_plan(f->data, f->size, &plan)) {
+        if (alloc->flags & ALLOCATOR_LINEAR_BIT)
+            allocator_reset_linear_to(alloc, mark);
+        else
+            deallocate(alloc, plan.ranges);
+        return parse_json_tape(f, alloc, mem_used);
+    }
+
+    json_tape ret;
+    ret.count = 0;
+    ret.cap = plan.tokens;
+    ret.data = f->data;
+    ret.size = f->size;
+
+    size_t tokens_size = sizeof(*ret.tokens) * ret.cap;
+    if (alloc->flags & ALLOCATOR_LINEAR_BIT) {
+        uint64 end = mark + alloc_align(tokens_size) + plan_size;
+        if (end > alloc->linear.used)
+            allocate(alloc, end - alloc->linear.used);
+        ret.tokens = (json_token*)(alloc->linear.mem + mark);
+        plan.ranges = memmove(alloc->linear.mem + mark + alloc_align(tokens_size), plan.ranges, plan_size);
+        plan.arrays = (struct json_tape_array*)(plan.ranges + json_tape_plan_range_cap(f->size));
+    } else {
+        ret.tokens = allocate(alloc, tokens_size);
+    }
+
+    if (mem_used)
+        *mem_used = (struct allocation){ret.tokens, tokens_size};
+
+    struct json_parallel_work w = {};
+
+    // Ranges need their base, so the top level goes first.
+    if (json_tape_parse_top_level(f->data, pos, &plan, &ret) != JSON_RESULT_SUCCESS || ret.count != ret.cap) {
+        log_print_error("Failed to parse json tape - char index %u", pos);
+        ret.count = 0;
+        goto free_plan;
+    }
+
+    w.data = f->data;
+    w.tape = &ret;
+    w.tape_ranges = plan.ranges;
+    w.range_count = plan.range_count;
+    json_parallel_run(&w, pool);
+
+    if (w.failed)
+        ret.count = 0;
+
+free_plan:
+    if (alloc->flags & ALLOCATOR_LINEAR_BIT)
+        allocator_reset_linear_to(alloc, mark + alloc_align(tokens_size));
+    else
+        deallocate(alloc, plan.ranges);
+    return ret;
+}
+
+enum {
+    JSON_STREAM_STATE_VALUE,        // root, or after ':' or an array ','
+    JSON_STREAM_STATE_VALUE_OR_END, // after '['
+    JSON_STREAM_STATE_KEY,          // after an object ','
+    JSON_STREAM_STATE_KEY_OR_END,   // after '{'
+    JSON_STREAM_STATE_COLON,
+    JSON_STREAM_STATE_COMMA_OR_END,
+    JSON_STREAM_STATE_STRING,
+    JSON_STREAM_STATE_KEY_STRING,
+    JSON_STREAM_STATE_SCALAR,
+    JSON_STREAM_STATE_DONE,
+    JSON_STREAM_STATE_ERROR,
+};
+
+void json_stream_init(json_stream *s)
+{
+    memset(s, 0, sizeof(*s));
+    s->state = JSON_STREAM_STATE_VALUE;
+}
+
+void json_stream_feed(json_stream *s, const char *data, uint32 size)
+{
+    assert(s->pos == s->size && "previous chunk was not fully consumed");
+    s->offset += s->size;
+    s->data = data;
+    s->size = size;
+    s->pos = 0;
+}
+
+bool json_stream_done(json_stream *s)
+{
+    return s->state == JSON_STREAM_STATE_DONE;
+}
+
+static inline bool json_stream_in_object(json_stream *s) {
+    uint32 d = s->depth - 1;
+    return (s->containers[d >> 6] >> (d & 63)) & 1;
+}
+
+static inline bool json_stream_is_whitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Unlike the other parse modes, chunks may end anywhere in a caller's buffer,
+// so the scans here never read past 'size'.
+static inline uint32 json_stream_skip_whitespace(json_stream *s)
+{
+    while(s->pos < s->size && json_stream_is_whitespace(s->data[s->pos]))
+        s->pos++;
+    return s->pos;
+}
+
+static inline json_event json_stream_error(json_stream *s, const char *msg)
+{
+    s->state = JSON_STREAM_STATE_ERROR;
+    s->msg = msg;
+    s->token_offset = s->offset + s->pos;
+    return (json_event){.type = JSON_EVENT_ERROR, .depth = s->depth, .offset = s->token_offset, .msg = msg};
+}
+
+static inline json_event json_stream_event(json_stream *s, json_event_type type, uint64 offset)
+{
+    return (json_event){.type = type, .depth = s->depth, .offset = offset};
+}
+
+static json_event json_stream_begin(json_stream *s, bool object)
+{
+    if (s->depth == JSON_MAX_DEPTH)
+        return json_stream_error(s, "Exceeded max json depth");
+    uint32 d = s->depth++;
+    s->containers[d >> 6] &= ~(1ull << (d & 63));
+    s->containers[d >> 6] |= (uint64)object << (d & 63);
+    s->state = object ? JSON_STREAM_STATE_KEY_OR_END : JSON_STREAM_STATE_VALUE_OR_END;
+    return json_stream_event(s, object ? JSON_EVENT_OBJECT_BEGIN : JSON_EVENT_ARRAY_BEGIN, s->offset + s->pos++);
+}
+
+static json_event json_stream_end(json_stream *s, bool object)
+{
+    if (json_stream_in_object(s) != object)
+        return json_stream_error(s, object ? "Found '}' closing an array" : "Found ']' closing an object");
+    s->depth--;
+    s->state = s->depth ? JSON_STREAM_STATE_COMMA_OR_END : JSON_STREAM_STATE_DONE;
+    return json_stream_event(s, object ? JSON_EVENT_OBJECT_END : JSON_EVENT_ARRAY_END, s->offset + s->pos++);
+}
+
+// Emits the final string or key, or a _PART if the chunk ends first.
+static json_event json_stream_string(json_stream *s)
+{
+    bool key = s->state == JSON_STREAM_STATE_KEY_STRING;
+    uint32 start = s->pos;
+    uint32 pos = start;
+    if (s->escape && pos < s->size) {
+        s->escape = false;
+        pos++;
+    }
+    while(1) {
+        pos = json_find_quote_or_escape(s->data, pos, s->size);
+        if (pos == s->size || s->data[pos] == '"')
+            break;
+        if (pos + 1 == s->size) {
+            s->escape = true;
+            pos = s->size;
+            break;
+        }
+        pos += 2;
+    }
+
+    json_event ev;
+    if (pos == s->size) {
+        if (start == pos)
+            return json_stream_event(s, JSON_EVENT_NONE, s->offset + pos);
+        ev = json_stream_event(s, key ? JSON_EVENT_KEY_PART : JSON_EVENT_STRING_PART, s->offset + start);
+        s->pos = pos;
+    } else {
+        ev = json_stream_event(s, key ? JSON_EVENT_KEY : JSON_EVENT_STRING, s->offset + start);
+        s->pos = pos + 1;
+        s->state = key ? JSON_STREAM_STATE_COLON : JSON_STREAM_STATE_COMMA_OR_END;
+    }
+    ev.str = (json_string){s->data + start, pos - start};
+    return ev;
+}
+
+static json_event json_stream_scalar(json_stream *s)
+{
+    char c;
+    while(s->pos < s->size) {
+        c = s->data[s->pos];
+        if (json_stream_is_whitespace(c) || c == ',' || c == ']' || c == '}')
+            break;
+        if (s->scalar_len == JSON_STREAM_SCALAR_MAX)
+            return json_stream_error(s, "Number or literal is too long");
+        s->scalar[s->scalar_len++] = c;
+        s->pos++;
+    }
+    if (s->pos == s->size)
+        return json_stream_event(s, JSON_EVENT_NONE, s->offset + s->pos);
+    if (!s->scalar_len)
+        return json_stream_error(s, "Expected a value");
+
+    memset(s->scalar + s->scalar_len, 0, 16);
+    s->state = JSON_STREAM_STATE_COMMA_OR_END;
+
+    json_event ev = json_stream_event(s, JSON_EVENT_NUMBER, s->token_offset);
+    switch(s->scalar[0]) {
+    case 't':
+    case 'f':
+        ev.type = JSON_EVENT_BOOL;
+        ev.boolean = s->scalar[0] == 't';
+        if ((s->scalar_len == 4 && !memcmp(s->scalar, "true", 4)) ||
+            (s->scalar_len == 5 && !memcmp(s->scalar, "false", 5)))
+            return ev;
+        break;
+    case 'n':
+        ev.type = JSON_EVENT_NULL;
+        if (s->scalar_len == 4 && !memcmp(s->scalar, "null", 4))
+            return ev;
+        break;
+    default:
+        if (ascii_parse_double(s->scalar, &ev.num) == s->scalar_len)
+            return ev;
+        break;
+    }
+    return json_stream_error(s, "Invalid number or literal");
+}
+
+json_event json_stream_next(json_stream *s)
+{
+    char c;
+    while(1) {
+        switch(s->state) {
+        case JSON_STREAM_STATE_STRING:
+        case JSON_STREAM_STATE_KEY_STRING:
+            return json_stream_string(s);
+        case JSON_STREAM_STATE_SCALAR:
+            return json_stream_scalar(s);
+        case JSON_STREAM_STATE_ERROR:
+            return (json_event){.type = JSON_EVENT_ERROR, .depth = s->depth, .offset = s->token_offset, .msg = s->msg};
+        default:
+            break;
+        }
+
+        if (json_stream_skip_whitespace(s) == s->size)
+            return json_stream_event(s, JSON_EVENT_NONE, s->offset + s->pos);
+        c = s->data[s->pos];
+
+        switch(s->state) {
+        case JSON_STREAM_STATE_VALUE_OR_END:
+            if (c == ']')
+                return json_stream_end(s, false);
+            // fallthrough
+        case JSON_STREAM_STATE_VALUE:
+            switch(c) {
+            case '{':
+                return json_stream_begin(s, true);
+            case '[':
+                return json_stream_begin(s, false);
+            case ',':
+            case ']':
+            case '}':
+                return json_stream_error(s, "Expected a value");
+            default:
+                break;
+            }
+            if (!s->depth)
+                return json_stream_error(s, "Top level item must be an object or array");
+            s->token_offset = s->offset + s->pos;
+            if (c == '"') {
+                s->state = JSON_STREAM_STATE_STRING;
+                s->pos++;
+            } else {
+                s->state = JSON_STREAM_STATE_SCALAR;
+                s->scalar_len = 0;
+            }
+            break;
+        case JSON_STREAM_STATE_KEY_OR_END:
+            if (c == '}')
+                return json_stream_end(s, true);
+            // fallthrough
+        case JSON_STREAM_STATE_KEY:
+            if (c != '"')
+                return json_stream_error(s, "Expected '\"' to begin key");
+            s->token_offset = s->offset + s->pos;
+            s->state = JSON_STREAM_STATE_KEY_STRING;
+            s->pos++;
+            break;
+        case JSON_STREAM_STATE_COLON:
+            if (c != ':')
+                return json_stream_error(s, "Expected ':' following key");
+            s->state = JSON_STREAM_STATE_VALUE;
+            s->pos++;
+            break;
+        case JSON_STREAM_STATE_COMMA_OR_END:
+            if (c == '}' || c == ']')
+                return json_stream_end(s, c == '}');
+            if (c != ',')
+                return json_stream_error(s, "Expected ',' or end of container");
+            s->state = json_stream_in_object(s) ? JSON_STREAM_STATE_KEY : JSON_STREAM_STATE_VALUE;
+            s->pos++;
+            break;
+        case JSON_STREAM_STATE_DONE:
+            return json_stream_error(s, "Found data following the top level item");
+        default:
+            assert(false && "unreachable json stream state");
+            return json_stream_error(s, "Invalid stream state");
+        }
+    }
+}
+
+// Number tokens are leaves, so the elems of a number array are contiguous on
+// the tape up to the first elem that is not a number.
+uint32 json_array_as_f32(json_cursor arr, float *dst, uint32 cap)
+{
+    if (json_cursor_type(arr) != JSON_TYPE_ARRAY || json_cursor_len(arr) > cap)
+        return Max_u32;
+    uint32 cnt = json_cursor_len(arr);
+    json_token *elems = json_cursor_token(arr) + 1;
+    for(uint32 i = 0; i < cnt; ++i) {
+        if (elems[i].type != JSON_TYPE_NUMBER)
+            return Max_u32;
+        ascii_parse_float(arr.tape->data + elems[i].offset, &dst[i]);
+    }
+    return cnt;
+}
+
+uint32 json_array_as_u32(json_cursor arr, uint32 *dst, uint32 cap)
+{
+    if (json_cursor_type(arr) != JSON_TYPE_ARRAY || json_cursor_len(arr) > cap)
+        return Max_u32;
+    uint32 cnt = json_cursor_len(arr);
+    json_token *elems = json_cursor_token(arr) + 1;
+    for(uint32 i = 0; i < cnt; ++i) {
+        if (elems[i].type != JSON_TYPE_NUMBER || !ascii_parse_u32(arr.tape->data + elems[i].offset, &dst[i]))
+            return Max_u32;
+    }
+    return cnt;
+}
+
+static inline uint32 json_utf8_encode(uint32 cp, char *to)
+{
+    if (cp < 0x80) {
+        to[0] = cp;
+        return 1;
+    } else if (cp < 0x800) {
+        to[0] = 0xc0 | (cp >> 6);
+        to[1] = 0x80 | (cp & 0x3f);
+        return 2;
+    } else if (cp < 0x10000) {
+        to[0] = 0xe0 | (cp >> 12);
+        to[1] = 0x80 | ((cp >> 6) & 0x3f);
+        to[2] = 0x80 | (cp & 0x3f);
+        return 3;
+    }
+    to[0] = 0xf0 | (cp >> 18);
+    to[1] = 0x80 | ((cp >> 12) & 0x3f);
+    to[2] = 0x80 | ((cp >> 6) & 0x3f);
+    to[3] = 0x80 | (cp & 0x3f);
+    return 4;
+}
+
+// Runs without escapes are found with json_find_quote_or_escape and copied
+// whole, as there can be no unescaped quotes inside a string.
+uint32 json_string_unescape_to(json_string str, char *to)
+{
+    const char *data = str.cstr;
+    uint32 len = str.len;
+    uint32 pos = 0, n = 0, esc, cp, lo;
+    while(1) {
+        esc = json_find_quote_or_escape(data, pos, len);
+        memcpy(to + n, data + pos, esc - pos);
+        n += esc - pos;
+        if (esc == len)
+            return n;
+        if (esc + 1 == len)
+            goto fail;
+
+        pos = esc + 2;
+        switch(data[esc + 1]) {
+        case '"':  to[n++] = '"';  break;
+        case '\\': to[n++] = '\\'; break;
+        case '/':  to[n++] = '/';  break;
+        case 'b':  to[n++] = '\b'; break;
+        case 'f':  to[n++] = '\f'; break;
+        case 'n':  to[n++] = '\n'; break;
+        case 'r':  to[n++] = '\r'; break;
+        case 't':  to[n++] = '\t'; break;
+        case 'u':
+            if (pos + 4 > len || (cp = json_hex4(data + pos)) == Max_u32)
+                goto fail;
+            pos += 4;
+            if (cp >= 0xdc00 && cp <= 0xdfff)
+                goto fail;
+            if (cp >= 0xd800 && cp <= 0xdbff) {
+                if (pos + 6 > len || data[pos] != '\\' || data[pos + 1] != 'u')
+                    goto fail;
+                lo = json_hex4(data + pos + 2);
+                if (lo < 0xdc00 || lo > 0xdfff)
+                    goto fail;
+                pos += 6;
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+            }
+            n += json_utf8_encode(cp, to + n);
+            break;
+        default:
+            goto fail;
+        }
+    }
+
+fail:
+    log_print_error("Invalid escape at byte %u of json string", esc);
+    return Max_u32;
+}
+
+json_string json_string_unescape(json_string str, allocator *alloc)
+{
+    if (!json_string_has_escapes(str))
+        return str;
+
+    char *to = allocate(alloc, str.len + 1);
+    uint32 len = json_string_unescape_to(str, to);
+    if (len == Max_u32)
+        return (json_string){};
+    to[len] = '\0';
+    return (json_string){.cstr = to, .len = len};
+}
+
+void print_json(json *j)
+{
+    print_json_with_depth(j, 1);
+    println("");
+}
+
+inline static void json_fill_array_elem(json_array *to, json *from, uint i) {
+    switch(from->type) {
+    case JSON_TYPE_STRING:
+        to->strs[i] = from->str;
+        break;
+    case JSON_TYPE_NUMBER:
+        to->nums[i] = from->num;
+        break;
+    case JSON_TYPE_OBJECT:
+        to->objs[i] = from->obj;
+        break;
+    case JSON_TYPE_ARRAY:
+        to->arrs[i] = from->arr;
+        break;
+    case JSON_TYPE_BOOL:
+        to->booleans[i] = from->boolean;
+        break;
+    case JSON_TYPE_NULL:
+        to->nulls[i] = from->null;
+        break;
+    default:
+        log_print_error("Invalid type while filling array elem");
+    }
+}
+
+static json json_parse_number(const char *data, uint32 *offset, allocator *alloc)
+{
+    json ret;
+    ret.type = JSON_TYPE_NUMBER;
+    uint32 len = ascii_parse_double(data + *offset, &ret.num);
+    if (json_validate_number(data + *offset, len) != JSON_RESULT_SUCCESS) {
+        log_print_error("Failed to validate number - char index %u", *offset);
+        return (json){};
+    }
+    *offset += len;
+    return ret;
+}
+
+static json json_parse_bool(const char *data, uint32 *offset, allocator *alloc)
+{
+    assert(data[*offset] == 't' || data[*offset] == 'f');
+    if (json_validate_bool(data + *offset) != JSON_RESULT_SUCCESS) {
+        log_print_error("Failed to validate bool - char index %u", *offset);
+        return (json){};
+    }
+    json ret;
+    ret.type = JSON_TYPE_BOOL;
+    ret.boolean = data[*offset] == 't' ? true : false;
+    *offset += 4 + (!ret.boolean);
+    return ret;
+}
+
+static json json_parse_null(const char *data, uint32 *offset, allocator *alloc)
+{
+    assert(data[*offset] == 'n');
+    if (json_validate_null(data + *offset) != JSON_RESULT_SUCCESS) {
+        log_print_error("Failed to validate null - char index %u", *offset);
+        return (json){};
+    }
+    json ret;
+    ret.type = JSON_TYPE_NULL;
+    ret.null = 0;
+    *offset += 4;
+    return ret;
+}
+
+void print_json_with_depth(json *j, int depth)
+{
+    switch(j->type) {
+    case JSON_TYPE_STRING:
+        json_print_string(&j->str, depth);
+        return;
+    case JSON_TYPE_NUMBER:
+        json_print_number(&j->num, depth);
+        return;
+    case JSON_TYPE_OBJECT:
+        json_print_object(&j->obj, depth);
+        return;
+    case JSON_TYPE_ARRAY:
+        json_print_array(&j->arr, depth);
+        return;
+    case JSON_TYPE_BOOL:
+        json_print_bool(&j->boolean, depth);
+        return;
+    case JSON_TYPE_NULL:
+        json_print_null(&j->null, depth);
+        return;
+    default:
+        println("INVALID");
+        return;
+    }
+}
+
+#define JSON_PRINT_INDENT_BUFFER_SIZE 32
+#define JSON_PRINT_SPACE_COUNT 2
+const char JSON_PRINT_INDENT_BUFFER[JSON_PRINT_INDENT_BUFFER_SIZE] = "                                ";
+#define JSON_PRINT_INDENT(depth) print_count_chars(JSON_PRINT_INDENT_BUFFER, (depth) * JSON_PRINT_SPACE_COUNT)
+
+static void json_print_object(json_object *a, int depth)
+{
+    println("{");
+    for(uint i = 0; i < a->key_count; ++i) {
+        JSON_PRINT_INDENT(depth);
+        print("\"");
+        print_count_chars(a->keys[i].cstr, a->keys[i].len);
+        print("\": ");
+        print_json_with_depth(&a->values[i], depth + 1);
+        println(",");
+    }
+    JSON_PRINT_INDENT(depth - 1);
+    print("}");
+}
+
+static void json_print_array(json_array *a, int depth)
+{
+    println("[");
+    for(uint i = 0; i < a->len; ++i) {
+        JSON_PRINT_INDENT(depth);
+        switch(a->elem_type) {
+        case JSON_TYPE_OBJECT:
+            json_print_object(&a->objs[i], depth + 1);
+            break;
+        case JSON_TYPE_ARRAY:
+            json_print_array(&a->arrs[i], depth + 1);
+            break;
+        case JSON_TYPE_STRING:
+            json_print_string(&a->strs[i], depth + 1);
+            break;
+        case JSON_TYPE_NUMBER:
+            json_print_number(&a->nums[i], depth + 1);
+            break;
+        case JSON_TYPE_BOOL:
+            json_print_bool(&a->booleans[i], depth + 1);
+            break;
+        case JSON_TYPE_NULL:
+            json_print_null(&a->nulls[i], depth + 1);
+            break;
+        default:
+            log_print_error("Cannot print invalid array elem");
+            break;
+        }
+        println(",");
+    }
+    JSON_PRINT_INDENT(depth - 1);
+    print("]");
+}
+
+static void json_print_string(json_string *a, int depth)
+{
+    print("\"");
+    print_count_chars(a->cstr, a->len);
+    print("\"");
+}
+
+static void json_print_number(json_number *a, int depth)
+{
+    print("%f", *a);
+}
+
+static void json_print_bool(json_bool *a, int depth)
+{
+    *a ? print("true") : println("false");
+}
+
+static void json_print_null(json_null *a, int depth)
+{
+    print("NULL");
+}
+
+json_writer json_writer_new(uint32 cap, allocator *alloc, uint32 flags)
+{
+    cap = cap < JSON_WRITER_MIN_CAP ? JSON_WRITER_MIN_CAP : cap;
+    return (json_writer) {
+        .sb = sb_new(cap, allocate(alloc, cap)),
+        .alloc = alloc,
+        .fd = -1,
+        .flags = flags,
+    };
+}
+
+json_writer json_writer_new_fd(int fd, uint64 offset, uint32 cap, char *buf, uint32 flags)
+{
+    assert(cap >= JSON_WRITER_MIN_CAP);
+    return (json_writer) {
+        .sb = sb_new(cap, buf),
+        .fd = fd,
+        .fd_offset = offset,
+        .flags = flags,
+    };
+}
+
+static void json_writer_flush(json_writer *w)
+{
+    if (!w->sb.used)
+        return;
+    if (file_write(w->fd, w->fd_offset, w->sb.used, w->sb.data) != (int64)w->sb.used)
+        w->error = true;
+    w->fd_offset += w->sb.used;
+    w->sb.used = 0;
+}
+
+// Writing to an fd, 'size' must not be more than JSON_WRITER_MIN_CAP.
+static void json_writer_reserve(json_writer *w, uint32 size)
+{
+    if (w->sb.used + size <= w->sb.cap)
+        return;
+    if (!w->alloc) {
+        json_writer_flush(w);
+        return;
+    }
+    uint32 cap = w->sb.cap * 2;
+    cap = cap < w->sb.used + size ? w->sb.used + size : cap;
+    w->sb.data = reallocate_with_old_size(w->alloc, w->sb.data, w->sb.cap, cap);
+    w->sb.cap = cap;
+}
+
+static void json_writer_add(json_writer *w, uint32 size, const char *data)
+{
+    if (w->alloc) {
+        json_writer_reserve(w, size);
+        sb_add(&w->sb, size, data);
+        return;
+    }
+    uint32 n;
+    while(size) {
+        if (w->sb.used == w->sb.cap)
+            json_writer_flush(w);
+        n = w->sb.cap - w->sb.used;
+        n = n < size ? n : size;
+        sb_add(&w->sb, n, data);
+        data += n;
+        size -= n;
+    }
+}
+
+static void json_writer_newline(json_writer *w)
+{
+    uint32 n = w->depth * 2;
+    json_writer_reserve(w, 1);
+    sb_addc(&w->sb, '\n');
+    while(n) {
+        uint32 m = n < JSON_WRITER_MIN_CAP ? n : JSON_WRITER_MIN_CAP;
+        json_writer_reserve(w, m);
+        memset(w->sb.data + w->sb.used, ' ', m);
+        w->sb.used += m;
+        n -= m;
+    }
+}
+
+// Separator and indent before a value or key.
+static void json_writer_begin_value(json_writer *w)
+{
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->need_comma) {
+        if (!w->depth) // second root
+            w->error = true;
+        json_writer_reserve(w, 1);
+        sb_addc(&w->sb, ',');
+    }
+    if ((w->flags & JSON_WRITER_PRETTY) && w->depth)
+        json_writer_newline(w);
+}
+
+// Length of the run of bytes from 'str' which do not need escaping: quotes,
+// backslashes and control chars. Bytes >= 0x80 are passed through, so utf8
+// is written as is.
+static inline uint32 json_escape_scan(const char *str, uint32 len)
+{
+    __m128i a;
+    __m128i q = _mm_set1_epi8('"');
+    __m128i b = _mm_set1_epi8('\\');
+    __m128i c = _mm_set1_epi8(0x1f);
+    uint32 i;
+    uint16 m;
+    for(i = 0; i + 16 <= len; i += 16) {
+        a = _mm_loadu_si128((__m128i*)(str + i));
+        m = _mm_movemask_epi8(_mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(a, q), _mm_cmpeq_epi8(a, b)),
+                _mm_cmpeq_epi8(_mm_max_epu8(a, c), c)));
+        if (m)
+            return i + ctz16(m);
+    }
+    for(; i < len; ++i)
+        if (str[i] == '"' || str[i] == '\\' || (uint8)str[i] <= 0x1f)
+            return i;
+    return len;
+}
+
+static void json_writer_string(json_writer *w, const char *str, uint32 len, bool escape)
+{
+    static const char hex[] = "0123456789abcdef";
+    json_writer_reserve(w, 1);
+    sb_addc(&w->sb, '"');
+    if (!escape) {
+        json_writer_add(w, len, str);
+    } else {
+        uint32 pos = 0;
+        uint32 run;
+        uint8 c;
+        while(pos < len) {
+            run = json_escape_scan(str + pos, len - pos);
+            json_writer_add(w, run, str + pos);
+            pos += run;
+            if (pos == len)
+                break;
+
+            c = str[pos++];
+            json_writer_reserve(w, 6);
+            sb_addc(&w->sb, '\\');
+            switch(c) {
+            case '"':  sb_addc(&w->sb, '"');  break;
+            case '\\': sb_addc(&w->sb, '\\'); break;
+            case '\b': sb_addc(&w->sb, 'b');  break;
+            case '\f': sb_addc(&w->sb, 'f');  break;
+            case '\n': sb_addc(&w->sb, 'n');  break;
+            case '\r': sb_addc(&w->sb, 'r');  break;
+            case '\t': sb_addc(&w->sb, 't');  break;
+            default:
+                sb_add(&w->sb, 3, "u00");
+                sb_addc(&w->sb, hex[c >> 4]);
+                sb_addc(&w->sb, hex[c & 15]);
+                break;
+            }
+        }
+    }
+    json_writer_reserve(w, 1);
+    sb_addc(&w->sb, '"');
+}
+
+static void json_writer_container_begin(json_writer *w, char c)
+{
+    json_writer_begin_value(w);
+    json_writer_reserve(w, 1);
+    sb_addc(&w->sb, c);
+    w->depth++;
+    w->need_comma = false;
+}
+
+static void json_writer_container_end(json_writer *w, char c)
+{
+    if (!w->depth || w->after_key) {
+        w->error = true;
+        return;
+    }
+    w->depth--;
+    if ((w->flags & JSON_WRITER_PRETTY) && w->need_comma) // empty containers stay on one line
+        json_writer_newline(w);
+    json_writer_reserve(w, 1);
+    sb_addc(&w->sb, c);
+    w->need_comma = true;
+}
+
+void json_write_object_begin(json_writer *w)
+{
+    json_writer_container_begin(w, '{');
+}
+
+void json_write_object_end(json_writer *w)
+{
+    json_writer_container_end(w, '}');
+}
+
+void json_write_array_begin(json_writer *w)
+{
+    json_writer_container_begin(w, '[');
+}
+
+void json_write_array_end(json_writer *w)
+{
+    json_writer_container_end(w, ']');
+}
+
+static void json_writer_key(json_writer *w, const char *key, uint32 len, bool escape)
+{
+    if (!w->depth || w->after_key)
+        w->error = true;
+    json_writer_begin_value(w);
+    json_writer_string(w, key, len, escape);
+    json_writer_reserve(w, 2);
+    sb_addc(&w->sb, ':');
+    if (w->flags & JSON_WRITER_PRETTY)
+        sb_addc(&w->sb, ' ');
+    w->after_key = true;
+}
+
+void json_write_key(json_writer *w, const char *key, uint32 len)
+{
+    json_writer_key(w, key, len, true);
+}
+
+void json_write_string(json_writer *w, const char *str, uint32 len)
+{
+    json_writer_begin_value(w);
+    json_writer_string(w, str, len, true);
+    w->need_comma = true;
+}
+
+static void json_writer_literal(json_writer *w, uint32 len, const char *lit)
+{
+    json_writer_begin_value(w);
+    json_writer_add(w, len, lit);
+    w->need_comma = true;
+}
+
+void json_write_int(json_writer *w, int64 num)
+{
+    char buf[24];
+    uint32 len = stbsp_snprintf(buf, sizeof(buf), "%lli", (long long)num);
+    json_writer_literal(w, len, buf);
+}
+
+void json_write_bool(json_writer *w, bool b)
+{
+    if (b)
+        json_writer_literal(w, cstr_arrlen("true"), "true");
+    else
+        json_writer_literal(w, cstr_arrlen("false"), "false");
+}
+
+void json_write_null(json_writer *w)
+{
+    json_writer_literal(w, cstr_arrlen("null"), "null");
+}
+
+// Integral values below 2^53 are written as integers. Others try 15, 16 then
+// 17 significant digits, taking the first which parses back to 'num'; 17
+// always does. Most values from text written by people or by other tools
+// stop at 15.
+void json_write_number(json_writer *w, double num)
+{
+    if (!isfinite(num)) {
+        json_write_null(w);
+        return;
+    }
+    if (num == 0 && signbit(num)) {
+        json_writer_literal(w, 2, "-0");
+        return;
+    }
+    if (fabs(num) < 9007199254740992.0 && num == (double)(int64)num) {
+        json_write_int(w, (int64)num);
+        return;
+    }
+    char buf[48];
+    uint32 len;
+    double d;
+    for(uint32 prec = 15; prec <= 17; ++prec) {
+        memset(buf, 0, sizeof(buf));
+        len = stbsp_snprintf(buf, sizeof(buf), "%.*g", prec, num);
+        if (ascii_parse_double(buf, &d) == len && d == num)
+            break;
+    }
+    json_writer_literal(w, len, buf);
+}
+
+// As json_write_number, but with 6 to 9 digits, so that parsing as a float
+// gives back 'num'.
+void json_write_f32(json_writer *w, float num)
+{
+    if (!isfinite(num)) {
+        json_write_null(w);
+        return;
+    }
+    if (num == 0 && signbit(num)) {
+        json_writer_literal(w, 2, "-0");
+        return;
+    }
+    if (fabsf(num) < 16777216.0f && num == (float)(int32)num) {
+        json_write_int(w, (int32)num);
+        return;
+    }
+    char buf[48];
+    uint32 len;
+    float f;
+    for(uint32 prec = 6; prec <= 9; ++prec) {
+        memset(buf, 0, sizeof(buf));
+        len = stbsp_snprintf(buf, sizeof(buf), "%.*g", prec, (double)num);
+        if (ascii_parse_float(buf, &f) == len && f == num)
+            break;
+    }
+    json_writer_literal(w, len, buf);
+}
+
+static void json_writer_array(json_writer *w, json_array *arr);
+
+static void json_writer_object(json_writer *w, json_object *obj)
+{
+    json_write_object_begin(w);
+    for(uint32 i = 0; i < obj->key_count; ++i) {
+        json_writer_key(w, obj->keys[i].cstr, obj->keys[i].len, false);
+        json_write_json(w, &obj->values[i]);
+    }
+    json_write_object_end(w);
+}
+
+static void json_writer_array(json_writer *w, json_array *arr)
+{
+    json_write_array_begin(w);
+    for(uint32 i = 0; i < arr->len; ++i) {
+        switch(arr->elem_type) {
+        case JSON_TYPE_STRING:
+            json_writer_begin_value(w);
+            json_writer_string(w, arr->strs[i].cstr, arr->strs[i].len, false);
+            w->need_comma = true;
+            break;
+        case JSON_TYPE_NUMBER:
+            json_write_number(w, arr->nums[i]);
+            break;
+        case JSON_TYPE_OBJECT:
+            json_writer_object(w, &arr->objs[i]);
+            break;
+        case JSON_TYPE_ARRAY:
+            json_writer_array(w, &arr->arrs[i]);
+            break;
+        case JSON_TYPE_BOOL:
+            json_write_bool(w, arr->booleans[i]);
+            break;
+        case JSON_TYPE_NULL:
+            json_write_null(w);
+            break;
+        default:
+            w->error = true;
+            break;
+        }
+    }
+    json_write_array_end(w);
 }
 
-void print_json_with_depth(json *j, int depth)
+void json_write_json(json_writer *w, json *j)
 {
     switch(j->type) {
     case JSON_TYPE_STRING:
-        json_print_string(&j->str, depth);
+        json_writer_begin_value(w);
+        json_writer_string(w, j->str.cstr, j->str.len, false);
+        w->need_comma = true;
         return;
     case JSON_TYPE_NUMBER:
-        json_print_number(&j->num, depth);
+        json_write_number(w, j->num);
         return;
     case JSON_TYPE_OBJECT:
-        json_print_object(&j->obj, depth);
+        json_writer_object(w, &j->obj);
         return;
     case JSON_TYPE_ARRAY:
-        json_print_array(&j->arr, depth);
+        json_writer_array(w, &j->arr);
         return;
     case JSON_TYPE_BOOL:
-        json_print_bool(&j->boolean, depth);
+        json_write_bool(w, j->boolean);
         return;
     case JSON_TYPE_NULL:
-        json_print_null(&j->null, depth);
+        json_write_null(w);
         return;
     default:
-        println("INVALID");
+        w->error = true;
         return;
     }
 }
 
-#define JSON_PRINT_INDENT_BUFFER_SIZE 32
-#define JSON_PRINT_SPACE_COUNT 2
-const char JSON_PRINT_INDENT_BUFFER[JSON_PRINT_INDENT_BUFFER_SIZE] = "                                ";
-#define JSON_PRINT_INDENT(depth) print_count_chars(JSON_PRINT_INDENT_BUFFER, (depth) * JSON_PRINT_SPACE_COUNT)
+// A buffered writer is null terminated, without counting it in sb.used.
+bool json_writer_finish(json_writer *w)
+{
+    if (w->depth || w->after_key)
+        w->error = true;
+    if (w->alloc) {
+        json_writer_reserve(w, 1);
+        w->sb.data[w->sb.used] = '\0';
+    } else {
+        json_writer_flush(w);
+    }
+    return !w->error;
+}
 
-static void json_print_object(json_object *a, int depth)
+
+#if TEST
+static void test_json_index(test_suite *suite);
+static void test_json_find_key(test_suite *suite);
+static void test_json_numbers(test_suite *suite);
+static void test_json_tape(test_suite *suite);
+static void test_json_stream(test_suite *suite);
+static void test_json_parallel(test_suite *suite);
+static void test_json_strings(test_suite *suite);
+static void test_json_validate(test_suite *suite);
+static void test_json_writer(test_suite *suite);
+
+void test_json(test_suite *suite)
 {
-    println("{");
-    for(uint i = 0; i < a->key_count; ++i) {
-        JSON_PRINT_INDENT(depth);
-        print("\"");
-        print_count_chars(a->keys[i].cstr, a->keys[i].len);
-        print("\": ");
-        print_json_with_depth(&a->values[i], depth + 1);
-        println(",");
+    test_json_index(suite);
+    test_json_find_key(suite);
+    test_json_numbers(suite);
+    test_json_tape(suite);
+    test_json_stream(suite);
+    test_json_parallel(suite);
+    test_json_strings(suite);
+    test_json_validate(suite);
+    test_json_writer(suite);
+}
+
+static void test_json_index(test_suite *suite)
+{
+    BEGIN_TEST_MODULE("json_index", false, false);
+
+    struct file f = file_read_char_all("test/test_json.json", suite->alloc);
+    struct allocation mem_used;
+    json j = parse_json(&f, suite->alloc, &mem_used);
+
+    TEST_EQ("root.type", j.type, JSON_TYPE_OBJECT, false);
+    TEST_EQ("root.key_count", j.obj.key_count, 2, false);
+
+    json_object *person = &j.obj.values[0].obj;
+    TEST_EQ("person.key_count", person->key_count, 3, false);
+    TEST_EQ("person.name.len", person->values[0].str.len, 4, false);
+    TEST_EQ("person.name", memcmp(person->values[0].str.cstr, "John", 4), 0, false);
+    TEST_FEQ("person.age", person->values[1].num, 20, false);
+
+    json_array *attacks = &j.obj.values[1].obj.values[0].arr;
+    TEST_EQ("attacks.elem_type", attacks->elem_type, JSON_TYPE_OBJECT, false);
+    TEST_EQ("attacks.len", attacks->len, 1, false);
+    TEST_EQ("attacks[0].key_count", attacks->objs[0].key_count, 3, false);
+    TEST_FEQ("attacks[0].lava", attacks->objs[0].values[2].num, 3, false);
+
+    deallocate(suite->alloc, mem_used.data);
+    deallocate(suite->alloc, f.data);
+
+    // Structural chars and escaped quotes inside strings, with a backslash run
+    // straddling the first 64 byte block boundary.
+    char buf[256] = {0};
+    const char *src =
+        "{\"k{[,:\\\"\": \"v]}\\\\\", \"pad\": \"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\\\\\\\\\\\"\\\"\",\n"
+        "  \"arr\": [ [], [1, 2], [true] ], \"empty\": {}, \"n\": null }";
+    memcpy(buf, src, strlen(src));
+    f = (struct file){.data = buf, .size = strlen(src)};
+    j = parse_json(&f, suite->alloc, &mem_used);
+
+    TEST_EQ("esc.type", j.type, JSON_TYPE_OBJECT, false);
+    TEST_EQ("esc.key_count", j.obj.key_count, 5, false);
+    TEST_EQ("esc.key0.len", j.obj.keys[0].len, 7, false);
+    TEST_EQ("esc.val0.len", j.obj.values[0].str.len, 5, false);
+    TEST_EQ("esc.pad.len", j.obj.values[1].str.len, 41, false);
+    TEST_EQ("esc.arr.len", j.obj.values[2].arr.len, 3, false);
+    TEST_EQ("esc.arr[0].len", j.obj.values[2].arr.arrs[0].len, 0, false);
+    TEST_EQ("esc.arr[1].len", j.obj.values[2].arr.arrs[1].len, 2, false);
+    TEST_FEQ("esc.arr[1][1]", j.obj.values[2].arr.arrs[1].nums[1], 2, false);
+    TEST_EQ("esc.arr[2][0]", j.obj.values[2].arr.arrs[2].booleans[0], true, false);
+    TEST_EQ("esc.empty", j.obj.values[3].obj.key_count, 0, false);
+    TEST_EQ("esc.null", j.obj.values[4].type, JSON_TYPE_NULL, false);
+
+    deallocate(suite->alloc, mem_used.data);
+
+    // Many small arrays need ~10x the source size, more than the old fixed
+    // multiple. The tree is allocated exactly, and a linear allocator is left
+    // holding only the tree.
+    uint32 n = 1000;
+    char *many = allocate(suite->alloc, n * 4 + 2);
+    many[0] = '[';
+    for(uint32 i = 0; i < n; ++i)
+        memcpy(many + 1 + i * 4, "[0],", 4);
+    many[n * 4] = ']';
+    f = (struct file){.data = many, .size = n * 4 + 1};
+
+    size_t tree = alloc_align(sizeof(json_array) * n) + alloc_align(sizeof(json_number)) * n;
+    allocator linear = new_linear_allocator(tree + sizeof(uint32) * 8 * f.size, NULL);
+    j = parse_json(&f, &linear, &mem_used);
+    TEST_EQ("many.len", j.arr.len, n, false);
+    TEST_FEQ("many[999][0]", j.arr.arrs[n - 1].nums[0], 0, false);
+    TEST_EQ("many.mem_used", mem_used.size, tree, false);
+    TEST_EQ("many.linear.used", linear.linear.used, tree, false);
+    TEST_EQ("many.linear.data", mem_used.data == linear.linear.mem, true, false);
+    free_allocator(&linear);
+    deallocate(suite->alloc, many);
+
+    // Whitespace may come between a scalar and its separator.
+    memset(buf, 0, sizeof(buf));
+    src = "[[1 , 2\n,3\t], [true ,false]] ";
+    memcpy(buf, src, strlen(src));
+    f = (struct file){.data = buf, .size = strlen(src)};
+    j = parse_json(&f, suite->alloc, &mem_used);
+    TEST_EQ("space.type", j.type, JSON_TYPE_ARRAY, false);
+    TEST_EQ("space[0].len", j.arr.arrs[0].len, 3, false);
+    TEST_EQ("space[1].len", j.arr.arrs[1].len, 2, false);
+    deallocate(suite->alloc, mem_used.data);
+
+#if !LOG_BREAK
+    // Scalars not followed by ',' or the end of their container.
+    const char *missing_separator[] = {
+        "[1 2]", "[true false]", "{\"a\": [1 2 3]}", "{\"a\": 1 2}", "[null null]", "[[1 2]]",
+    };
+    for(uint32 i = 0; i < carrlen(missing_separator); ++i) {
+        memset(buf, 0, sizeof(buf));
+        memcpy(buf, missing_separator[i], strlen(missing_separator[i]));
+        f = (struct file){.data = buf, .size = strlen(missing_separator[i])};
+        j = parse_json(&f, suite->alloc, &mem_used);
+        TEST_EQ("missing_separator.type", j.type, JSON_TYPE_INVALID, false);
+        deallocate(suite->alloc, mem_used.data);
     }
-    JSON_PRINT_INDENT(depth - 1);
-    print("}");
+#endif
+
+    END_TEST_MODULE();
 }
 
-static void json_print_array(json_array *a, int depth)
+static void test_json_find_key(test_suite *suite)
 {
-    println("[");
-    for(uint i = 0; i < a->len; ++i) {
-        JSON_PRINT_INDENT(depth);
-        switch(a->elem_type) {
-        case JSON_TYPE_OBJECT:
-            json_print_object(&a->objs[i], depth + 1);
-            break;
-        case JSON_TYPE_ARRAY:
-            json_print_array(&a->arrs[i], depth + 1);
+    BEGIN_TEST_MODULE("json_find_key", false, false);
+
+    // 'small' is searched linearly, 'big' through its hash index.
+    char buf[512] = {0};
+    const char *src =
+        "{ \"small\": { \"scaleX\": 1, \"scale\": 2, \"sca\": 3 },\n"
+        "  \"big\": { \"k0\": 0, \"k1\": 1, \"k2\": 2, \"k3\": 3, \"k4\": 4, \"k5\": 5, \"k6\": 6,\n"
+        "           \"k7\": 7, \"k8\": 8, \"k9\": 9, \"k10\": 10, \"k11\": 11, \"k12\": 12, \"k13\": 13,\n"
+        "           \"scaleX\": 14, \"scale\": 15, \"k16\": 16, \"scale\": 17 } }";
+    memcpy(buf, src, strlen(src));
+    struct file f = (struct file){.data = buf, .size = strlen(src)};
+    struct allocation mem_used;
+    json j = parse_json(&f, suite->alloc, &mem_used);
+
+    json_object *small = &j.obj.values[json_find_key_lit(&j.obj, "small")].obj;
+    TEST_EQ("small.hash_cap", small->hash_cap, 0, false);
+    TEST_EQ("small.scale", json_find_key_lit(small, "scale"), 1, false);
+    TEST_EQ("small.scaleX", json_find_key(small, "scaleX"), 0, false);
+    TEST_EQ("small.sc", json_find_key_lit(small, "sc"), Max_u32, false);
+
+    json_object *big = &j.obj.values[json_find_key_lit(&j.obj, "big")].obj;
+    TEST_EQ("big.hash_cap", big->hash_cap, 32, false);
+    TEST_EQ("big.scale", json_find_key_lit(big, "scale"), 15, false);
+    TEST_EQ("big.scaleX", json_find_key(big, "scaleX"), 14, false);
+    TEST_EQ("big.k16", json_find_key_lit(big, "k16"), 16, false);
+    TEST_EQ("big.k1", json_find_key_lit(big, "k1"), 1, false);
+    TEST_EQ("big.k", json_find_key_lit(big, "k"), Max_u32, false);
+    TEST_EQ("big.k17", json_find_key_lit(big, "k17"), Max_u32, false);
+
+    uint32 i;
+    char key[8];
+    for(i = 0; i < 14; ++i) {
+        string_format(key, "k%u", i);
+        if (json_find_key(big, key) != i)
             break;
+    }
+    TEST_EQ("big.k0-k13", i, 14, false);
+
+    deallocate(suite->alloc, mem_used.data);
+
+    END_TEST_MODULE();
+}
+
+static void test_json_numbers(test_suite *suite)
+{
+    BEGIN_TEST_MODULE("json_numbers", false, false);
+
+    // Halfway cases, subnormals, 2^53 + 1, more than 19 digits, etc.
+    const char *nums[] = {
+        "0", "-0", "0.1", "1e23", "8.5", "9007199254740993", "7.038531e-26",
+        "2.2250738585072011e-308", "4.9e-324", "1.7976931348623157e308", "1e309",
+        "123456789012345678901234567890", "0.000000000000000000000000012345",
+        "3.4028235e38", "1.00000017881393432617187499", "-65.613616999999977", "1E5",
+    };
+    char buf[64];
+    double d, e;
+    float f, g;
+    uint32 len;
+    for(uint32 i = 0; i < carrlen(nums); ++i) {
+        memset(buf, 0, sizeof(buf));
+        memcpy(buf, nums[i], strlen(nums[i]));
+        len = ascii_parse_double(buf, &d);
+        e = strtod(buf, NULL);
+        TEST_EQ(nums[i], len, strlen(nums[i]), false);
+        TEST_EQ(nums[i], memcmp(&d, &e, sizeof(d)), 0, false);
+        ascii_parse_float(buf, &f);
+        g = strtof(buf, NULL);
+        TEST_EQ(nums[i], memcmp(&f, &g, sizeof(f)), 0, false);
+    }
+    const char *invalid[] = {"01", "-", "1.", ".5", "1e", "1e+", "+1"};
+    for(uint32 i = 0; i < carrlen(invalid); ++i) {
+        memset(buf, 0, sizeof(buf));
+        memcpy(buf, invalid[i], strlen(invalid[i]));
+        TEST_EQ(invalid[i], ascii_parse_double(buf, &d), 0, false);
+    }
+
+    struct {
+        const char *str;
+        uint32 val; // Max_u32 if rejected
+    } u32s[] = {
+        {"0", 0}, {"4294967295", 4294967295}, {"4294967296", Max_u32}, {"-1", Max_u32},
+        {"1e3", 1000}, {"1.5e1", 15}, {"120e-1", 12}, {"0e-400", 0}, {"-0", 0},
+        {"1e-400", Max_u32}, {"1.5", Max_u32}, {"1e10", Max_u32}, {"42949672950e-1", 4294967295},
+        {"1.00000000001e9", Max_u32}, {"1e400", Max_u32},
+    };
+    uint32 u;
+    for(uint32 i = 0; i < carrlen(u32s); ++i) {
+        memset(buf, 0, sizeof(buf));
+        memcpy(buf, u32s[i].str, strlen(u32s[i].str));
+        u = Max_u32;
+        if (!ascii_parse_u32(buf, &u))
+            u = Max_u32;
+        TEST_EQ(u32s[i].str, u, u32s[i].val, false);
+    }
+
+    char doc[256] = {0};
+    const char *src =
+        "{ \"f\": [1, 0.1, -2.5e-3, 3.4028235e38], \"u\": [0, 7, 4294967295, 1e3],\n"
+        "  \"big\": [4294967296], \"frac\": [2.5], \"mixed\": [1, \"a\"] }";
+    memcpy(doc, src, strlen(src));
+    struct file file = (struct file){.data = doc, .size = strlen(src)};
+    struct allocation mem_used;
+    json_tape tape = parse_json_tape(&file, suite->alloc, &mem_used);
+    json_cursor root = json_tape_root(&tape);
+
+    float fs[4];
+    uint32 us[4];
+    TEST_EQ("f32.cnt", json_array_as_f32(json_cursor_find_key_lit(root, "f"), fs, 4), 4, false);
+    TEST_FEQ("f32[1]", fs[1], 0.1f, false);
+    TEST_FEQ("f32[2]", fs[2], -2.5e-3f, false);
+    TEST_EQ("f32[3]", fs[3] == FLT_MAX, true, false);
+    TEST_EQ("f32.cap", json_array_as_f32(json_cursor_find_key_lit(root, "f"), fs, 3), Max_u32, false);
+    TEST_EQ("f32.mixed", json_array_as_f32(json_cursor_find_key_lit(root, "mixed"), fs, 4), Max_u32, false);
+    TEST_EQ("u32.cnt", json_array_as_u32(json_cursor_find_key_lit(root, "u"), us, 4), 4, false);
+    TEST_EQ("u32[2]", us[2], Max_u32, false);
+    TEST_EQ("u32[3]", us[3], 1000, false);
+    TEST_EQ("u32.big", json_array_as_u32(json_cursor_find_key_lit(root, "big"), us, 4), Max_u32, false);
+    TEST_EQ("u32.frac", json_array_as_u32(json_cursor_find_key_lit(root, "frac"), us, 4), Max_u32, false);
+
+    deallocate(suite->alloc, mem_used.data);
+
+    END_TEST_MODULE();
+}
+
+static void test_json_tape(test_suite *suite)
+{
+    BEGIN_TEST_MODULE("json_tape", false, false);
+
+    struct file f = file_read_char_all("test/test_json.json", suite->alloc);
+    struct allocation mem_used;
+    json_tape tape = parse_json_tape(&f, suite->alloc, &mem_used);
+
+    json_cursor root = json_tape_root(&tape);
+    TEST_EQ("root.type", json_cursor_type(root), JSON_TYPE_OBJECT, false);
+    TEST_EQ("root.len", json_cursor_len(root), 2, false);
+
+    json_cursor person = json_cursor_find_key(root, "person");
+    TEST_EQ("person.type", json_cursor_type(person), JSON_TYPE_OBJECT, false);
+    TEST_EQ("person.len", json_cursor_len(person), 3, false);
+
+    json_string name = json_cursor_str(json_cursor_find_key(person, "name"));
+    TEST_EQ("person.name.len", name.len, 4, false);
+    TEST_EQ("person.name", memcmp(name.cstr, "John", 4), 0, false);
+    TEST_FEQ("person.age", json_cursor_num(json_cursor_find_key(person, "age")), 20, false);
+    TEST_FEQ("person.penisLength", json_cursor_num(json_cursor_find_key(person, "penisLength")), 7.231, false);
+    TEST_EQ("person.missing", json_cursor_valid(json_cursor_find_key(person, "nam")), false, false);
+
+    json_cursor monster = json_cursor_next(person);
+    TEST_EQ("monster.type", json_cursor_type(monster), JSON_TYPE_STRING, false);
+    monster = json_cursor_find_key(root, "monster");
+    json_cursor attacks = json_cursor_find_key(monster, "attacks");
+    TEST_EQ("attacks.type", json_cursor_type(attacks), JSON_TYPE_ARRAY, false);
+    TEST_EQ("attacks.len", json_cursor_len(attacks), 1, false);
+
+    json_cursor attack = json_cursor_elem(attacks, 0);
+    TEST_EQ("attacks[0].len", json_cursor_len(attack), 3, false);
+    TEST_FEQ("attacks[0].lava", json_cursor_num(json_cursor_find_key(attack, "lava")), 3, false);
+    TEST_EQ("attacks[1]", json_cursor_valid(json_cursor_elem(attacks, 1)), false, false);
+    TEST_EQ("tape.count", tape.count, 20, false);
+
+    deallocate(suite->alloc, mem_used.data);
+    deallocate(suite->alloc, f.data);
+
+    // Missing and trailing separators are errors rather than extra tokens. These
+    // log, so only run them when logging does not break.
+#if !LOG_BREAK
+    const char *bad[] = {"[1 2 3 4 5 6 7 8]", "{\"a\": 1 \"b\": 2}", "[1, 2,]", "{\"a\": [1,]}"};
+    char doc[32];
+    for(uint32 i = 0; i < carrlen(bad); ++i) {
+        memset(doc, 0, sizeof(doc));
+        memcpy(doc, bad[i], strlen(bad[i]));
+        struct file file = (struct file){.data = doc, .size = strlen(bad[i])};
+        tape = parse_json_tape(&file, suite->alloc, &mem_used);
+        TEST_EQ(bad[i], tape.count, 0, false);
+        deallocate(suite->alloc, mem_used.data);
+    }
+#endif
+
+    END_TEST_MODULE();
+}
+
+// Feed the same document in chunks of different sizes, and check that the
+// events add up to the same tokens as the tape.
+static void test_json_stream(test_suite *suite)
+{
+    BEGIN_TEST_MODULE("json_stream", false, false);
+
+    struct file f = file_read_char_all("test/test_gltf.gltf", suite->alloc);
+    struct allocation mem_used;
+    json_tape tape = parse_json_tape(&f, suite->alloc, &mem_used);
+
+    uint32 tape_str_len = 0;
+    double tape_num_sum = 0;
+    for(uint32 i = 0; i < tape.count; ++i) {
+        if (tape.tokens[i].type == JSON_TYPE_STRING)
+            tape_str_len += tape.tokens[i].len;
+        else if (tape.tokens[i].type == JSON_TYPE_NUMBER)
+            tape_num_sum += json_cursor_num((json_cursor){&tape, i});
+    }
+
+    uint32 chunk_sizes[] = {1, 2, 3, 7, 64, f.size};
+    json_stream stream;
+    json_event ev;
+    uint32 tokens, str_len, size;
+    double num_sum;
+    bool err;
+    for(uint32 i = 0; i < carrlen(chunk_sizes); ++i) {
+        json_stream_init(&stream);
+        tokens = 0;
+        str_len = 0;
+        num_sum = 0;
+        err = false;
+        for(uint32 pos = 0; pos < f.size && !err; pos += size) {
+            size = f.size - pos < chunk_sizes[i] ? f.size - pos : chunk_sizes[i];
+            json_stream_feed(&stream, f.data + pos, size);
+            while((ev = json_stream_next(&stream)).type != JSON_EVENT_NONE) {
+                switch(ev.type) {
+                case JSON_EVENT_KEY_PART:
+                case JSON_EVENT_STRING_PART:
+                    str_len += ev.str.len;
+                    break;
+                case JSON_EVENT_KEY:
+                case JSON_EVENT_STRING:
+                    str_len += ev.str.len;
+                    tokens++;
+                    break;
+                case JSON_EVENT_NUMBER:
+                    num_sum += ev.num;
+                    tokens++;
+                    break;
+                case JSON_EVENT_OBJECT_BEGIN:
+                case JSON_EVENT_ARRAY_BEGIN:
+                case JSON_EVENT_BOOL:
+                case JSON_EVENT_NULL:
+                    tokens++;
+                    break;
+                case JSON_EVENT_ERROR:
+                    err = true;
+                    break;
+                default:
+                    break;
+                }
+                if (err)
+                    break;
+            }
+        }
+        TEST_EQ("stream.error", err, false, false);
+        TEST_EQ("stream.done", json_stream_done(&stream), true, false);
+        TEST_EQ("stream.tokens", tokens, tape.count, false);
+        TEST_EQ("stream.str_len", str_len, tape_str_len, false);
+        TEST_FEQ("stream.num_sum", num_sum, tape_num_sum, false);
+    }
+
+    // Escapes split across chunks.
+    const char *src = "{\"a\\\"b\": [\"\\\\\", -1.5e2, true, null]}";
+    uint32 len = strlen(src);
+    json_stream_init(&stream);
+    str_len = 0;
+    tokens = 0;
+    for(uint32 pos = 0; pos < len; ++pos) {
+        json_stream_feed(&stream, src + pos, 1);
+        while((ev = json_stream_next(&stream)).type != JSON_EVENT_NONE) {
+            tokens++;
+            if (ev.type == JSON_EVENT_KEY || ev.type == JSON_EVENT_KEY_PART ||
+                ev.type == JSON_EVENT_STRING || ev.type == JSON_EVENT_STRING_PART)
+                str_len += ev.str.len;
+            if (ev.type == JSON_EVENT_NUMBER)
+                TEST_FEQ("escape.num", ev.num, -150, false);
+        }
+    }
+    TEST_EQ("escape.done", json_stream_done(&stream), true, false);
+    TEST_EQ("escape.str_len", str_len, 6, false);
+    TEST_EQ("escape.events", tokens, 15, false);
+
+    // Each of these must end in an error event, fed a byte at a time and whole.
+    const char *malformed[] = {
+        "[,1]", "[1,,2]", "[1,]", "[[],]", "{\"a\":[1,]}", "{\"a\":1,}", "{\"a\":}",
+        "{\"a\":,1}", "[1 2]", "[}", "{]", "[tru]", "[1]]",
+    };
+    const char *wellformed[] = {"[]", "[[]]", "{}", "{\"a\":[]}", "[[],[1,{}]]", "[ 1 , 2 ]"};
+    for(uint32 i = 0; i < carrlen(malformed) + carrlen(wellformed); ++i) {
+        bool bad = i < carrlen(malformed);
+        src = bad ? malformed[i] : wellformed[i - carrlen(malformed)];
+        len = strlen(src);
+        for(uint32 chunk = 1; chunk <= len; chunk += len - 1) {
+            json_stream_init(&stream);
+            err = false;
+            for(uint32 pos = 0; pos < len && !err; pos += size) {
+                size = len - pos < chunk ? len - pos : chunk;
+                json_stream_feed(&stream, src + pos, size);
+                while((ev = json_stream_next(&stream)).type != JSON_EVENT_NONE) {
+                    if (ev.type == JSON_EVENT_ERROR) {
+                        TEST_EQ("malformed.msg", ev.msg != NULL, true, false);
+                        err = true;
+                        break;
+                    }
+                }
+            }
+            if (bad) {
+                TEST_EQ("malformed.error", err, true, false);
+                TEST_EQ("malformed.sticky", json_stream_next(&stream).type, JSON_EVENT_ERROR, false);
+            } else {
+                TEST_EQ("wellformed.error", err, false, false);
+                TEST_EQ("wellformed.done", json_stream_done(&stream), true, false);
+            }
+        }
+    }
+
+    deallocate(suite->alloc, mem_used.data);
+    deallocate(suite->alloc, f.data);
+
+    END_TEST_MODULE();
+}
+static bool json_test_equal(json *a, json *b);
+
+static bool json_test_array_equal(json_array *a, json_array *b)
+{
+    if (a->len != b->len || a->elem_type != b->elem_type)
+        return false;
+    json x, y;
+    for(uint32 i = 0; i < a->len; ++i) {
+        x.type = y.type = a->elem_type;
+        switch(a->elem_type) {
         case JSON_TYPE_STRING:
-            json_print_string(&a->strs[i], depth + 1);
+            x.str = a->strs[i]; y.str = b->strs[i];
             break;
         case JSON_TYPE_NUMBER:
-            json_print_number(&a->nums[i], depth + 1);
+            x.num = a->nums[i]; y.num = b->nums[i];
             break;
-        case JSON_TYPE_BOOL:
-            json_print_bool(&a->booleans[i], depth + 1);
+        case JSON_TYPE_OBJECT:
+            x.obj = a->objs[i]; y.obj = b->objs[i];
             break;
-        case JSON_TYPE_NULL:
-            json_print_null(&a->nulls[i], depth + 1);
+        case JSON_TYPE_ARRAY:
+            x.arr = a->arrs[i]; y.arr = b->arrs[i];
+            break;
+        case JSON_TYPE_BOOL:
+            x.boolean = a->booleans[i]; y.boolean = b->booleans[i];
             break;
         default:
-            log_print_error("Cannot print invalid array elem");
             break;
         }
-        println(",");
+        if (!json_test_equal(&x, &y))
+            return false;
     }
-    JSON_PRINT_INDENT(depth - 1);
-    print("]");
+    return true;
 }
 
-static void json_print_string(json_string *a, int depth)
+// Strings point into the source, so the same text means the same pointer.
+static bool json_test_equal(json *a, json *b)
 {
-    print("\"");
-    print_count_chars(a->cstr, a->len);
-    print("\"");
+    if (a->type != b->type)
+        return false;
+    switch(a->type) {
+    case JSON_TYPE_STRING:
+        return a->str.len == b->str.len && a->str.cstr == b->str.cstr;
+    case JSON_TYPE_NUMBER:
+        return a->num == b->num;
+    case JSON_TYPE_BOOL:
+        return a->boolean == b->boolean;
+    case JSON_TYPE_NULL:
+        return true;
+    case JSON_TYPE_ARRAY:
+        return json_test_array_equal(&a->arr, &b->arr);
+    case JSON_TYPE_OBJECT:
+        if (a->obj.key_count != b->obj.key_count || a->obj.hash_cap != b->obj.hash_cap)
+            return false;
+        for(uint32 i = 0; i < a->obj.key_count; ++i)
+            if (a->obj.keys[i].cstr != b->obj.keys[i].cstr || a->obj.keys[i].len != b->obj.keys[i].len ||
+                !json_test_equal(&a->obj.values[i], &b->obj.values[i]))
+                return false;
+        return true;
+    default:
+        return false;
+    }
 }
 
-static void json_print_number(json_number *a, int depth)
+static void test_json_parallel(test_suite *suite)
 {
-    print("%f", *a);
+    BEGIN_TEST_MODULE("json_parallel", false, false);
+
+    // Large enough for several ranges per array, with arrays of objects,
+    // numbers and nothing, and values either side of them.
+    size_t cap = 1024 * 1024;
+    struct file f = {.data = allocate(suite->alloc, cap)};
+    f.size += stbsp_sprintf(f.data, "{ \"asset\": { \"version\": \"2.0\" }, \"accessors\": [");
+    for(uint32 i = 0; i < 2000; ++i)
+        f.size += stbsp_sprintf(f.data + f.size,
+            "%s{ \"bufferView\": %u, \"count\": %u, \"type\": \"VEC3\", \"max\": [ 1.0, 0.5, %u.25 ],"
+            " \"extras\": { \"a\": 0, \"b\": 1, \"c\": 2, \"d\": 3, \"e\": 4, \"f\": 5, \"g\": 6, \"h\": 7,"
+            " \"i\": 8, \"j\": 9, \"k\": 10, \"l\": 11, \"m\": 12, \"n\": 13, \"o\": 14, \"p\": [ true, false ] } }\n",
+            i ? ", " : "", i & 31, i, i % 7);
+    f.size += stbsp_sprintf(f.data + f.size, "], \"empty\": [ ], \"scene\": 0, \"weights\": [");
+    for(uint32 i = 0; i < 30000; ++i)
+        f.size += stbsp_sprintf(f.data + f.size, "%s%u.5", i ? ", " : "", i);
+    f.size += stbsp_sprintf(f.data + f.size, "], \"nodes\": [ [ 1, 2 ], [ ], [ \"x\" ] ] }");
+    assert(f.size < cap);
+
+    struct allocation serial_mem, parallel_mem;
+    json serial = parse_json(&f, suite->alloc, &serial_mem);
+    json parallel = parse_json_parallel(&f, NULL, suite->alloc, &parallel_mem);
+
+    TEST_EQ("type", parallel.type, JSON_TYPE_OBJECT, false);
+    TEST_EQ("key_count", parallel.obj.key_count, 6, false);
+    TEST_EQ("accessors.len", parallel.obj.values[1].arr.len, 2000, false);
+    TEST_EQ("weights.len", parallel.obj.values[4].arr.len, 30000, false);
+    TEST_EQ("no_pool", json_test_equal(&serial, &parallel), true, false);
+    deallocate(suite->alloc, parallel_mem.data);
+
+    thread_pool pool;
+    struct allocation heap_buffers[THREAD_COUNT];
+    struct allocation temp_buffers[THREAD_COUNT];
+    uint32 i;
+    for(i = 0; i < THREAD_COUNT; ++i) {
+        heap_buffers[i] = (struct allocation){.size = 1024 * 1024};
+        temp_buffers[i] = (struct allocation){allocate(suite->alloc, 1024 * 1024), 1024 * 1024};
+    }
+    new_thread_pool(heap_buffers, temp_buffers, suite->alloc, &pool);
+
+    parallel = parse_json_parallel(&f, &pool, suite->alloc, &parallel_mem);
+    TEST_EQ("pool", json_test_equal(&serial, &parallel), true, false);
+
+    // The tape is the same token for token, and sized exactly.
+    struct allocation serial_tape_mem, parallel_tape_mem;
+    json_tape serial_tape = parse_json_tape(&f, suite->alloc, &serial_tape_mem);
+    for(i = 0; i < 2; ++i) {
+        json_tape parallel_tape = parse_json_tape_parallel(&f, i ? &pool : NULL, suite->alloc, &parallel_tape_mem);
+        TEST_EQ("tape.count", parallel_tape.count, serial_tape.count, false);
+        TEST_EQ("tape.cap", parallel_tape.cap, parallel_tape.count, false);
+        TEST_EQ("tape.tokens", memcmp(parallel_tape.tokens, serial_tape.tokens,
+                                      sizeof(*serial_tape.tokens) * serial_tape.count), 0, false);
+        deallocate(suite->alloc, parallel_tape_mem.data);
+    }
+
+    // From a linear allocator the tokens are left at its start, with the plan
+    // freed from above them.
+    allocator linear = new_linear_allocator(sizeof(*serial_tape.tokens) * serial_tape.count + f.size, NULL);
+    json_tape linear_tape = parse_json_tape_parallel(&f, &pool, &linear, &parallel_tape_mem);
+    TEST_EQ("tape.linear.tokens", memcmp(linear_tape.tokens, serial_tape.tokens,
+                                         sizeof(*serial_tape.tokens) * serial_tape.count), 0, false);
+    TEST_EQ("tape.linear.data", parallel_tape_mem.data == linear.linear.mem, true, false);
+    TEST_EQ("tape.linear.used", linear.linear.used, alloc_align(parallel_tape_mem.size), false);
+    free_allocator(&linear);
+    deallocate(suite->alloc, serial_tape_mem.data);
+
+#if !LOG_BREAK
+    // A missing ',' deep in a range, and a trailing one at the end of an array.
+    char *sep = strstr(f.data, "15000.5,");
+    char *end = strstr(f.data, "29999.5]");
+    sep[7] = ' ';
+    json_tape bad = parse_json_tape_parallel(&f, &pool, suite->alloc, &parallel_tape_mem);
+    TEST_EQ("tape.missing_comma", bad.count, 0, false);
+    deallocate(suite->alloc, parallel_tape_mem.data);
+    sep[7] = ',';
+    memset(end, ' ', 7);
+    bad = parse_json_tape_parallel(&f, &pool, suite->alloc, &parallel_tape_mem);
+    TEST_EQ("tape.trailing_comma", bad.count, 0, false);
+    deallocate(suite->alloc, parallel_tape_mem.data);
+    memcpy(end, "29999.5", 7);
+#endif
+
+    free_thread_pool(&pool, true);
+    for(i = THREAD_COUNT; i > 0; --i) {
+        free_allocator(&pool.threads[i - 1].persistent);
+        deallocate(suite->alloc, temp_buffers[i - 1].data);
+    }
+    deallocate(suite->alloc, parallel_mem.data);
+    deallocate(suite->alloc, serial_mem.data);
+    deallocate(suite->alloc, f.data);
+
+    END_TEST_MODULE();
 }
 
-static void json_print_bool(json_bool *a, int depth)
+static void test_json_strings(test_suite *suite)
 {
-    *a ? print("true") : println("false");
+    BEGIN_TEST_MODULE("json_strings", false, false);
+
+    // Escaped quotes and backslashes either side of the 16 byte scan width.
+    char buf[256] = {0};
+    const char *src =
+        "{ \"uri\": \"dir\\/a\\\"b\\\\\", \"long\": \"0123456789abcdef\\\\\\\"0123456789\\u00e9\\ud83d\\ude00\","
+        "  \"plain\": \"abc\", \"after\": 1 }";
+    memcpy(buf, src, strlen(src));
+    struct file f = {.data = buf, .size = strlen(src)};
+    struct allocation mem_used;
+    json_tape tape = parse_json_tape(&f, suite->alloc, &mem_used);
+    json_cursor root = json_tape_root(&tape);
+
+    json_string uri = json_cursor_str(json_cursor_find_key_lit(root, "uri"));
+    json_string lng = json_cursor_str(json_cursor_find_key_lit(root, "long"));
+    json_string plain = json_cursor_str(json_cursor_find_key_lit(root, "plain"));
+    TEST_EQ("tape.uri.len", uri.len, 11, false);
+    TEST_EQ("tape.long.len", lng.len, 48, false);
+    TEST_FEQ("tape.after", json_cursor_num(json_cursor_find_key_lit(root, "after")), 1, false);
+
+    char to[64];
+    TEST_EQ("uri.unescape.len", json_string_unescape_to(uri, to), 8, false);
+    TEST_EQ("uri.unescape", memcmp(to, "dir/a\"b\\", 8), 0, false);
+    TEST_EQ("long.unescape.len", json_string_unescape_to(lng, to), 34, false);
+    TEST_EQ("long.unescape", memcmp(to + 16, "\\\"0123456789\xc3\xa9\xf0\x9f\x98\x80", 18), 0, false);
+
+    uint64 used = allocator_used(suite->alloc);
+    json_string s = json_string_unescape(plain, suite->alloc);
+    TEST_EQ("plain.no_copy", s.cstr == plain.cstr && s.len == plain.len, true, false);
+    TEST_EQ("plain.no_alloc", allocator_used(suite->alloc), used, false);
+
+    s = json_string_unescape(uri, suite->alloc);
+    TEST_EQ("uri.copy.len", s.len, 8, false);
+    TEST_EQ("uri.copy.null", s.cstr[8], '\0', false);
+    deallocate(suite->alloc, (void*)s.cstr);
+
+    deallocate(suite->alloc, mem_used.data);
+
+    END_TEST_MODULE();
 }
 
-static void json_print_null(json_null *a, int depth)
+static void test_json_validate(test_suite *suite)
 {
-    print("NULL");
+    BEGIN_TEST_MODULE("json_validate", false, false);
+
+    const char *files[] = {"test/test_json.json", "test/test_gltf.gltf"};
+    struct file f;
+    json_error err;
+    for(uint32 i = 0; i < carrlen(files); ++i) {
+        f = file_read_char_all(files[i], suite->alloc);
+        err = json_validate(f.data, f.size);
+        TEST_EQ(files[i], err.msg == NULL, true, false);
+        deallocate(suite->alloc, f.data);
+    }
+
+    const char *valid[] = {
+        "[]",
+        " { \"a\" : [ true , false , null , -0.5e+3 , \"\\u00e9\\/\" ] , \"b\" : { } }\n",
+    };
+    for(uint32 i = 0; i < carrlen(valid); ++i) {
+        err = json_validate(valid[i], strlen(valid[i]));
+        TEST_EQ("valid", err.msg == NULL, true, false);
+    }
+
+    // Whatever validates must also parse, including "\r\n" and "\t".
+    const char *ws = "{\r\n\t\"a\": [1,\t2\t],\r\n\t\"b\": {\"c\": true\r\n\t}\r\n}\r\n";
+    err = json_validate(ws, strlen(ws));
+    TEST_EQ("ws.validate", err.msg == NULL, true, false);
+    {
+        struct file f = {.size = strlen(ws)};
+        f.data = allocate(suite->alloc, f.size + 64);
+        memcpy(f.data, ws, f.size);
+        memset(f.data + f.size, 0, 64);
+
+        struct allocation mem_used;
+        json j = parse_json(&f, suite->alloc, &mem_used);
+        TEST_EQ("ws.type", j.type, JSON_TYPE_OBJECT, false);
+        TEST_EQ("ws.key_count", j.obj.key_count, 2, false);
+        TEST_EQ("ws.a.len", j.obj.values[0].arr.len, 2, false);
+        TEST_EQ("ws.a[1]", j.obj.values[0].arr.nums[1], 2, false);
+        TEST_EQ("ws.b.c", j.obj.values[1].obj.values[0].boolean, true, false);
+
+        json_tape tape = parse_json_tape(&f, suite->alloc, &mem_used);
+        json_cursor root = json_tape_root(&tape);
+        json_cursor a = json_cursor_find_key_lit(root, "a");
+        TEST_EQ("ws.tape.type", json_cursor_type(root), JSON_TYPE_OBJECT, false);
+        TEST_EQ("ws.tape.a.len", json_cursor_len(a), 2, false);
+        TEST_EQ("ws.tape.a[1]", json_cursor_num(json_cursor_next(json_cursor_child(a))), 2, false);
+    }
+
+    struct {
+        const char *data;
+        uint32 offset, line, column;
+    } invalid[] = {
+        {"{\n  \"a\": 1,\n  \"b\": tru\n}", 19, 3, 8},
+        {"{\"a\": 01}", 6, 1, 7},
+        {"[1, 2,]", 6, 1, 7},
+        {"[1 2]", 1, 1, 2},
+        {"{\"a\" 1}", 5, 1, 6},
+        {"{\"a\": \"x\ty\"}", 8, 1, 9},
+        {"{\"a\": \"\\q\"}", 7, 1, 8},
+        {"{\"a\": [1}", 8, 1, 9},
+        {"{\"a\": 1", 7, 1, 8},
+        {"{} {}", 3, 1, 4},
+        {"\"str\"", 0, 1, 1},
+        {"{\"a\": \"x}", 6, 1, 7},
+        {"\n\n", 2, 3, 1},
+    };
+    for(uint32 i = 0; i < carrlen(invalid); ++i) {
+        err = json_validate(invalid[i].data, strlen(invalid[i].data));
+        TEST_EQ("invalid", err.msg != NULL, true, false);
+        TEST_EQ("invalid.offset", err.offset, invalid[i].offset, false);
+        TEST_EQ("invalid.line", err.line, invalid[i].line, false);
+        TEST_EQ("invalid.column", err.column, invalid[i].column, false);
+    }
+
+    // Strings spanning 64 byte blocks, with the bad char after the block of
+    // the opening quote.
+    char buf[160];
+    memset(buf, 'x', sizeof(buf));
+    memcpy(buf, "[\"", 2);
+    memcpy(buf + sizeof(buf) - 2, "\"]", 2);
+    err = json_validate(buf, sizeof(buf));
+    TEST_EQ("span.valid", err.msg == NULL, true, false);
+    buf[100] = '\t';
+    err = json_validate(buf, sizeof(buf));
+    TEST_EQ("span.control", err.offset, 100, false);
+    buf[100] = '\\';
+    buf[101] = 'q';
+    err = json_validate(buf, sizeof(buf));
+    TEST_EQ("span.escape", err.offset, 100, false);
+
+    END_TEST_MODULE();
+}
+
+static void test_json_writer(test_suite *suite)
+{
+    BEGIN_TEST_MODULE("json_writer", false, false);
+
+    // Escapes on both sides of a 16 byte block boundary.
+    const char str[] = "tab\there \"quoted\" back\\slash \x01 caf\xc3\xa9";
+    const char *expect =
+        "{\n"
+        "  \"name\": \"tab\\there \\\"quoted\\\" back\\\\slash \\u0001 caf\xc3\xa9\",\n"
+        "  \"nums\": [\n"
+        "    1,\n"
+        "    -0.1,\n"
+        "    1e+23\n"
+        "  ],\n"
+        "  \"nan\": null,\n"
+        "  \"empty\": {},\n"
+        "  \"none\": [],\n"
+        "  \"flags\": [\n"
+        "    true,\n"
+        "    false\n"
+        "  ]\n"
+        "}";
+    json_writer w;
+    for(uint32 pretty = 0; pretty < 2; ++pretty) {
+        w = json_writer_new(0, suite->alloc, pretty ? JSON_WRITER_PRETTY : JSON_WRITER_COMPACT);
+        json_write_object_begin(&w);
+        json_write_key_lit(&w, "name");
+        json_write_string(&w, str, cstr_arrlen(str));
+        json_write_key_lit(&w, "nums");
+        json_write_array_begin(&w);
+        json_write_int(&w, 1);
+        json_write_number(&w, -0.1);
+        json_write_number(&w, 1e23);
+        json_write_array_end(&w);
+        json_write_key_lit(&w, "nan");
+        json_write_number(&w, NAN);
+        json_write_key_lit(&w, "empty");
+        json_write_object_begin(&w);
+        json_write_object_end(&w);
+        json_write_key_lit(&w, "none");
+        json_write_array_begin(&w);
+        json_write_array_end(&w);
+        json_write_key_lit(&w, "flags");
+        json_write_array_begin(&w);
+        json_write_bool(&w, true);
+        json_write_bool(&w, false);
+        json_write_array_end(&w);
+        json_write_object_end(&w);
+        TEST_EQ("finish", json_writer_finish(&w), true, false);
+
+        if (pretty) {
+            TEST_EQ("pretty.len", w.sb.used, strlen(expect), false);
+            TEST_EQ("pretty", strcmp(w.sb.data, expect), 0, false);
+        } else {
+            TEST_EQ("compact.validate", json_validate(w.sb.data, w.sb.used).msg == NULL, true, false);
+            struct allocation mem_used;
+            json j = parse_json(&(struct file){.data = w.sb.data, .size = w.sb.used}, suite->alloc, &mem_used);
+            TEST_EQ("compact.keys", j.obj.key_count, 6, false);
+            json_string s = json_string_unescape(j.obj.values[0].str, suite->alloc);
+            TEST_EQ("compact.name.len", s.len, cstr_arrlen(str), false);
+            TEST_EQ("compact.name", memcmp(s.cstr, str, s.len), 0, false);
+            TEST_FEQ("compact.nums[1]", j.obj.values[1].arr.nums[1], -0.1, false);
+            if (s.cstr != j.obj.values[0].str.cstr)
+                deallocate(suite->alloc, (char*)s.cstr);
+            deallocate(suite->alloc, mem_used.data);
+        }
+        deallocate(suite->alloc, w.sb.data);
+    }
+
+    w = json_writer_new(0, suite->alloc, JSON_WRITER_COMPACT);
+    json_write_object_begin(&w);
+    json_write_array_begin(&w); // value without a key
+    TEST_EQ("malformed", json_writer_finish(&w), false, false);
+    deallocate(suite->alloc, w.sb.data);
+
+    // Every double parses back to itself, as does every float in range.
+    const double nums[] = {
+        0.1, 1.0/3.0, 1e23, 5e-324, 1.7976931348623157e308, 2.2250738585072014e-308,
+        9007199254740993.0, 123456.789, -65.613616999999977, 0.30000000000000004,
+    };
+    double d;
+    float f;
+    for(uint32 i = 0; i < carrlen(nums); ++i) {
+        w = json_writer_new(0, suite->alloc, JSON_WRITER_COMPACT);
+        json_write_number(&w, nums[i]);
+        json_writer_finish(&w);
+        TEST_EQ("double.len", ascii_parse_double(w.sb.data, &d), w.sb.used, false);
+        TEST_EQ("double", memcmp(&d, &nums[i], sizeof(d)), 0, false);
+        deallocate(suite->alloc, w.sb.data);
+
+        if (!isfinite((float)nums[i]))
+            continue;
+        w = json_writer_new(0, suite->alloc, JSON_WRITER_COMPACT);
+        json_write_f32(&w, (float)nums[i]);
+        json_writer_finish(&w);
+        TEST_EQ("float.len", ascii_parse_float(w.sb.data, &f), w.sb.used, false);
+        TEST_EQ("float", f == (float)nums[i], true, false);
+        deallocate(suite->alloc, w.sb.data);
+    }
+
+    // Written glTF parses to a tree which writes the same text again, and a
+    // staging buffer smaller than the output flushed to a file gives the
+    // same bytes as the growable buffer.
+    struct file src = file_read_char_all("test/test_gltf.gltf", suite->alloc);
+    struct allocation src_tree, a_tree;
+    json j = parse_json(&src, suite->alloc, &src_tree);
+    json_writer a = json_writer_new(0, suite->alloc, JSON_WRITER_PRETTY);
+    json_write_json(&a, &j);
+    TEST_EQ("gltf.finish", json_writer_finish(&a), true, false);
+
+    j = parse_json(&(struct file){.data = a.sb.data, .size = a.sb.used}, suite->alloc, &a_tree);
+    json_writer b = json_writer_new(0, suite->alloc, JSON_WRITER_PRETTY);
+    json_write_json(&b, &j);
+    json_writer_finish(&b);
+    TEST_EQ("gltf.rewrite.len", b.sb.used, a.sb.used, false);
+    TEST_EQ("gltf.rewrite", memcmp(a.sb.data, b.sb.data, a.sb.used), 0, false);
+
+    FILE *tmp = tmpfile();
+    char buf[JSON_WRITER_MIN_CAP];
+    char *back = allocate(suite->alloc, a.sb.used);
+    w = json_writer_new_fd(fileno(tmp), 0, sizeof(buf), buf, JSON_WRITER_PRETTY);
+    json_write_json(&w, &j);
+    TEST_EQ("fd.finish", json_writer_finish(&w), true, false);
+    TEST_EQ("fd.len", w.fd_offset, a.sb.used, false);
+    file_read(fileno(tmp), 0, a.sb.used, back);
+    TEST_EQ("fd", memcmp(back, a.sb.data, a.sb.used), 0, false);
+    fclose(tmp);
+
+    deallocate(suite->alloc, back);
+    deallocate(suite->alloc, b.sb.data);
+    deallocate(suite->alloc, a_tree.data);
+    deallocate(suite->alloc, a.sb.data);
+    deallocate(suite->alloc, src_tree.data);
+    deallocate(suite->alloc, src.data);
+
+    END_TEST_MODULE();
+}
+
+#endif
+
+#if BENCH
+#include "bench.h"
+
+#define JSON_BENCH_TARGET_BYTES (256 * 1024 * 1024)
+#define JSON_BENCH_SYNTHETIC_SIZE (100 * 1024 * 1024)
+#define JSON_BENCH_STREAM_CHUNK_SIZE (64 * 1024)
+
+// Accessors and nodes are the bulk of large glTF files.
+static struct file json_bench_synthetic_gltf(size_t size, allocator *alloc)
+{
+    struct file ret;
+    ret.data = allocate(alloc, size + 1024);
+    ret.size = 0;
+
+    const char *head = "{\n    \"asset\": { \"version\": \"2.0\" },\n    \"accessors\": [\n";
+    ret.size += copied(ret.data, head, strlen(head));
+
+    for(uint32 i = 0; ret.size < size; ++i) {
+        ret.size += stbsp_sprintf(ret.data + ret.size,
+            "        {\n"
+            "            \"bufferView\": %u,\n"
+            "            \"byteOffset\": %u,\n"
+            "            \"componentType\": 5126,\n"
+            "            \"count\": %u,\n"
+            "            \"type\": \"VEC3\",\n"
+            "            \"max\": [ 1.0, 0.5, %u.25 ],\n"
+            "            \"min\": [ -1.0, -0.5, -%u.25 ],\n"
+            "            \"extras\": { \"name\": \"accessor_%u\", \"matrix\": [ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0.5, -2.75, 3e-2, 1 ] }\n"
+            "        },\n", i & 31, i * 12, i % 1000 + 1, i % 7, i % 5, i);
+    }
+    ret.size -= 2; // trailing ",\n"
+    const char *tail = "\n    ]\n}\n";
+    ret.size += copied(ret.data + ret.size, tail, strlen(tail) + 1) - 1;
+    return ret;
+}
+
+static void bench_json_file(const char *name, struct file *f, thread_pool *pool, allocator *alloc)
+{
+    println("  %s:", name);
+
+    uint32 iters = bench_iterations(f->size, JSON_BENCH_TARGET_BYTES);
+    uint64 mark = alloc->linear.used;
+    double t;
+    uint32 i;
+
+    t = bench_time();
+    for(i = 0; i < iters; ++i) {
+        json_build_index(f->data, f->size, alloc);
+        allocator_reset_linear_to(alloc, mark);
+    }
+    bench_print_throughput("structural index", f->size, iters, bench_time() - t);
+
+    t = bench_time();
+    for(i = 0; i < iters; ++i)
+        json_validate(f->data, f->size);
+    bench_print_throughput("json_validate", f->size, iters, bench_time() - t);
+
+    t = bench_time();
+    for(i = 0; i < iters; ++i) {
+        parse_json(f, alloc, NULL);
+        allocator_reset_linear_to(alloc, mark);
+    }
+    bench_print_throughput("parse_json", f->size, iters, bench_time() - t);
+
+    t = bench_time();
+    for(i = 0; i < iters; ++i) {
+        parse_json_parallel(f, pool, alloc, NULL);
+        allocator_reset_linear_to(alloc, mark);
+    }
+    bench_print_throughput("parse_json_parallel", f->size, iters, bench_time() - t);
+
+    t = bench_time();
+    for(i = 0; i < iters; ++i) {
+        parse_json_tape(f, alloc, NULL);
+        allocator_reset_linear_to(alloc, mark);
+    }
+    bench_print_throughput("parse_json_tape", f->size, iters, bench_time() - t);
+
+    t = bench_time();
+    for(i = 0; i < iters; ++i) {
+        parse_json_tape_parallel(f, pool, alloc, NULL);
+        allocator_reset_linear_to(alloc, mark);
+    }
+    bench_print_throughput("parse_json_tape_parallel", f->size, iters, bench_time() - t);
+
+    json_stream stream;
+    json_event ev;
+    uint64 events = 0;
+    uint32 size;
+    t = bench_time();
+    for(i = 0; i < iters; ++i) {
+        json_stream_init(&stream);
+        for(size_t pos = 0; pos < f->size; pos += size) {
+            size = f->size - pos < JSON_BENCH_STREAM_CHUNK_SIZE ? f->size - pos : JSON_BENCH_STREAM_CHUNK_SIZE;
+            json_stream_feed(&stream, f->data + pos, size);
+            while((ev = json_stream_next(&stream)).type != JSON_EVENT_NONE)
+                events++;
+        }
+    }
+    bench_print_throughput("json_stream (64KB chunks)", f->size, iters, bench_time() - t);
+
+    // Throughput of the text written, sized up front so that it does not grow.
+    json j = parse_json(f, alloc, NULL);
+    uint64 tree_mark = alloc->linear.used;
+    json_writer w;
+    t = bench_time();
+    for(i = 0; i < iters; ++i) {
+        w = json_writer_new(f->size + JSON_WRITER_MIN_CAP, alloc, JSON_WRITER_COMPACT);
+        json_write_json(&w, &j);
+        json_writer_finish(&w);
+        allocator_reset_linear_to(alloc, tree_mark);
+    }
+    bench_print_throughput("json_writer (compact)", w.sb.used, iters, bench_time() - t);
+    allocator_reset_linear_to(alloc, mark);
+}
+
+#define JSON_BENCH_NUMBER_COUNT (4 * 1024 * 1024)
+
+// Numbers like those in glTF accessor bounds, matrices and animation data.
+static char* json_bench_numbers(uint32 count, uint32 *offsets, allocator *alloc)
+{
+    char *ret = allocate(alloc, count * 32 + 16);
+    uint64 r = 88172645463325252;
+    uint32 pos = 0;
+    double d;
+    for(uint32 i = 0; i < count; ++i) {
+        r ^= r << 13;
+        r ^= r >> 7;
+        r ^= r << 17;
+        offsets[i] = pos;
+        d = (double)(int64)(r >> 16) / (double)(1ull << (r % 48));
+        switch(i & 3) {
+        case 0:
+            pos += stbsp_sprintf(ret + pos, "%.9g,", d);
+            break;
+        case 1:
+            pos += stbsp_sprintf(ret + pos, "%.17g,", d);
+            break;
+        case 2:
+            pos += stbsp_sprintf(ret + pos, "%u,", (uint32)r);
+            break;
+        case 3:
+            pos += stbsp_sprintf(ret + pos, "%.6f,", d);
+            break;
+        }
+    }
+    memset(ret + pos, 0, 16);
+    return ret;
+}
+
+static void bench_json_numbers(allocator *alloc)
+{
+    println("  numbers:");
+
+    uint32 *offsets = sallocate(alloc, *offsets, JSON_BENCH_NUMBER_COUNT);
+    char *data = json_bench_numbers(JSON_BENCH_NUMBER_COUNT, offsets, alloc);
+    size_t size = offsets[JSON_BENCH_NUMBER_COUNT - 1];
+
+    double t;
+    uint32 i;
+    volatile double sum = 0; // keep the results live
+    double d = 0;
+    float f = 0;
+
+    t = bench_time();
+    for(i = 0; i < JSON_BENCH_NUMBER_COUNT; ++i)
+        sum += ascii_to_double(data + offsets[i]);
+    bench_print_throughput("ascii_to_double", size, 1, bench_time() - t);
+
+    t = bench_time();
+    for(i = 0; i < JSON_BENCH_NUMBER_COUNT; ++i)
+        sum += strtod(data + offsets[i], NULL);
+    bench_print_throughput("strtod", size, 1, bench_time() - t);
+
+    t = bench_time();
+    for(i = 0; i < JSON_BENCH_NUMBER_COUNT; ++i) {
+        ascii_parse_double(data + offsets[i], &d);
+        sum += d;
+    }
+    bench_print_throughput("ascii_parse_double", size, 1, bench_time() - t);
+
+    t = bench_time();
+    for(i = 0; i < JSON_BENCH_NUMBER_COUNT; ++i) {
+        ascii_parse_float(data + offsets[i], &f);
+        sum += f;
+    }
+    bench_print_throughput("ascii_parse_float", size, 1, bench_time() - t);
 }
 
+void bench_json(thread_pool *pool, allocator *alloc)
+{
+    // Own linear allocator, as the synthetic file and its tree do not fit in
+    // the main temp allocator.
+    allocator a = new_linear_allocator(JSON_BENCH_SYNTHETIC_SIZE * 12, NULL);
+    println("json:");
+
+    struct file f = file_read_char_all("test/test_json.json", &a);
+    bench_json_file("test/test_json.json", &f, pool, &a);
+    allocator_reset_linear(&a);
+
+    f = json_bench_synthetic_gltf(JSON_BENCH_SYNTHETIC_SIZE, &a);
+    bench_json_file("synthetic gltf", &f, pool, &a);
+    allocator_reset_linear(&a);
+
+    bench_json_numbers(&a);
+
+    free_allocator(&a);
+}
+#endif
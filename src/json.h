@@ -5,6 +5,8 @@
 #include "allocator.h"
 #include "ascii.h"
 #include "string.h"
+#include "test.h"
+#include "thread.h"
 
 typedef enum {
     JSON_TYPE_INVALID = 0,
@@ -23,12 +25,19 @@ typedef uint64 json_null;
 
 typedef struct json json;
 
+// Objects with at least JSON_OBJECT_HASH_MIN_KEYS keys get a hash index of
+// 'hash_cap' slots, stored immediately after the values array: hash_cap tags
+// (top bit set if the slot is full, low 7 bits from the key hash), then
+// hash_cap key indices. Smaller objects are searched linearly.
 typedef struct {
     uint32 key_count;
+    uint32 hash_cap; // zero if the object has no hash index
     json_string *keys;
     struct json *values;
 } json_object;
 
+#define JSON_OBJECT_HASH_MIN_KEYS 16
+
 typedef struct json_array json_array;
 
 struct json_array {
@@ -57,14 +66,330 @@ struct json {
 };
 
 json parse_json(struct file *f, allocator *alloc, struct allocation *mem_used);
+
+// Same result as parse_json, but the array values of a top level object are
+// built in ranges of elems spread over the thread pool and the calling thread.
+// Falls back to parse_json for small files and files without a top level
+// object. 'pool' may be NULL, in which case the calling thread does every range.
+json parse_json_parallel(struct file *f, thread_pool *pool, allocator *alloc, struct allocation *mem_used);
 void print_json(json *j);
 
-static inline uint json_find_key(json_object *obj, const char *key) {
+// Strings in every mode are views of the source between the quotes, escapes
+// and all, so nothing is allocated for them. The decoded form is produced on
+// demand: json_string_unescape returns 'str' itself if it has no escapes, and
+// otherwise decodes into a null terminated copy from 'alloc'.
+// json_string_unescape_to decodes into 'to', which must hold str.len bytes
+// (decoding never lengthens a string), and returns the decoded length, or
+// Max_u32 if an escape is invalid.
+static inline bool json_string_has_escapes(json_string str) {
+    return memchr(str.cstr, '\\', str.len) != NULL;
+}
+
+uint32 json_string_unescape_to(json_string str, char *to);
+json_string json_string_unescape(json_string str, allocator *alloc);
+
+#define JSON_MAX_DEPTH 1024
+
+// Structural index: the byte offset of every '{', '}', '[', ']', ':' and ','
+// outside of strings, and of every unescaped '"', in document order. Built in
+// a single sweep 64 bytes at a time, and used by parse_json to build the tree
+// without rescanning the source. 'aux' is scratch for the tree builder, which
+// stores the elem/key count of each container at its opening bracket.
+typedef struct {
+    uint32 count;
+    uint32 *pos;
+    uint32 *aux;
+} json_index;
+
+json_index json_build_index(const char *data, size_t size, allocator *alloc);
+
+// Validating pre-pass: check the whole document against the json grammar
+// without building or allocating anything, stopping at the first error. Nothing is logged,
+// so callers can reject bad input gracefully. 'msg' is NULL if the document
+// is valid; line and column are 1-based, and the column counts bytes.
+typedef struct {
+    const char *msg;
+    uint64 offset;
+    uint32 line;
+    uint32 column;
+} json_error;
+
+json_error json_validate(const char *data, size_t size);
+
+// Tape mode: rather than building the pointer tree above, emit one flat array
+// of tokens in document order. Object members are stored as a string token for
+// the key immediately followed by the tokens for the value. Every token stores
+// the tape index one past the end of its subtree, so siblings can be reached
+// without walking children. Nothing is copied out of the source, so the file
+// data must outlive the tape.
+typedef struct {
+    json_type type;
+    uint32 offset; // byte offset in the source (string tokens exclude the quotes)
+    uint32 len;    // strings/numbers: byte length; objects: key count; arrays: elem count
+    uint32 next;   // tape index of the next sibling
+} json_token;
+
+typedef struct {
+    uint32 count;
+    uint32 cap;
+    json_token *tokens;
+    const char *data;
+    uint32 size;
+} json_tape;
+
+typedef struct {
+    json_tape *tape;
+    uint32 i;
+} json_cursor;
+
+json_tape parse_json_tape(struct file *f, allocator *alloc, struct allocation *mem_used);
+
+// Same tape as parse_json_tape, but large array values of a top level object
+// are cut into ranges of elems, which are spread over the thread pool and the
+// calling thread as in parse_json_parallel. A planning pass over the source
+// counts the tokens of each range, so every range is written straight to its
+// place in the tape and the tape is allocated at its exact size. Falls back to
+// parse_json_tape for small files and files without a top level object.
+json_tape parse_json_tape_parallel(struct file *f, thread_pool *pool, allocator *alloc, struct allocation *mem_used);
+
+static inline json_cursor json_tape_root(json_tape *tape) {
+    return (json_cursor){tape, tape->count ? 0 : Max_u32};
+}
+
+static inline bool json_cursor_valid(json_cursor c) {
+    return c.i != Max_u32;
+}
+
+static inline json_token* json_cursor_token(json_cursor c) {
+    return &c.tape->tokens[c.i];
+}
+
+static inline json_type json_cursor_type(json_cursor c) {
+    return json_cursor_valid(c) ? c.tape->tokens[c.i].type : JSON_TYPE_INVALID;
+}
+
+// object key count or array elem count
+static inline uint32 json_cursor_len(json_cursor c) {
+    return c.tape->tokens[c.i].len;
+}
+
+// For an object, the first key; for an array, the first elem.
+static inline json_cursor json_cursor_child(json_cursor c) {
+    c.i = json_cursor_len(c) ? c.i + 1 : Max_u32;
+    return c;
+}
+
+// Skip over the subtree at 'c'. Does not check for the end of the parent
+// container, use the parent's len to bound iteration.
+static inline json_cursor json_cursor_next(json_cursor c) {
+    c.i = c.tape->tokens[c.i].next;
+    return c;
+}
+
+// From an object key to its value.
+static inline json_cursor json_cursor_value(json_cursor key) {
+    key.i += 1;
+    return key;
+}
+
+static inline json_string json_cursor_str(json_cursor c) {
+    json_token *t = json_cursor_token(c);
+    return (json_string){c.tape->data + t->offset, t->len};
+}
+
+static inline json_number json_cursor_num(json_cursor c) {
+    json_number ret = 0;
+    ascii_parse_double(c.tape->data + c.tape->tokens[c.i].offset, &ret);
+    return ret;
+}
+
+static inline json_bool json_cursor_bool(json_cursor c) {
+    return c.tape->data[c.tape->tokens[c.i].offset] == 't';
+}
+
+static inline json_cursor json_cursor_elem(json_cursor arr, uint32 elem) {
+    if (elem >= json_cursor_len(arr))
+        return (json_cursor){arr.tape, Max_u32};
+    json_cursor c = json_cursor_child(arr);
+    for(uint32 i = 0; i < elem; ++i)
+        c = json_cursor_next(c);
+    return c;
+}
+
+// Returns the value associated with 'key', or an invalid cursor.
+static inline json_cursor json_cursor_find_key_len(json_cursor obj, const char *key, uint32 len) {
+    uint32 cnt = json_cursor_len(obj);
+    json_cursor c = json_cursor_child(obj);
+    for(uint32 i = 0; i < cnt; ++i) {
+        json_token *t = json_cursor_token(c);
+        if (t->len == len && memcmp(key, c.tape->data + t->offset, len) == 0)
+            return json_cursor_value(c);
+        c = json_cursor_next(json_cursor_value(c));
+    }
+    return (json_cursor){obj.tape, Max_u32};
+}
+
+static inline json_cursor json_cursor_find_key(json_cursor obj, const char *key) {
+    return json_cursor_find_key_len(obj, key, strlen(key));
+}
+
+// 'key' must be a string literal.
+#define json_cursor_find_key_lit(obj, key) json_cursor_find_key_len(obj, key, cstr_arrlen(key))
+
+// Write the elems of a number array straight to 'dst', without going through
+// json_number. Return the number of elems written, or Max_u32 if the array
+// has more than 'cap' elems or an elem is not a number (or for
+// json_array_as_u32, not an integer in range).
+uint32 json_array_as_f32(json_cursor arr, float *dst, uint32 cap);
+uint32 json_array_as_u32(json_cursor arr, uint32 *dst, uint32 cap);
+
+// Streaming mode: a resumable parser fed arbitrary chunks of a document, e.g.
+// from read() or a ring buffer, which emits one event per token. Memory use
+// is fixed regardless of document size, and offsets are 64 bit.
+//
+//     json_stream_init(&s);
+//     while((size = read(fd, buf, sizeof(buf))) > 0) {
+//         json_stream_feed(&s, buf, size);
+//         while((ev = json_stream_next(&s)).type != JSON_EVENT_NONE)
+//             ...
+//     }
+//
+// A chunk must stay valid until json_stream_next returns JSON_EVENT_NONE, as
+// must the strings in events. A string or key that crosses a chunk boundary
+// is emitted as one or more _PART events holding the contents seen so far,
+// then a final event with the rest. Strings are not unescaped. Nothing is
+// logged: an error event carries its message and offset, and every later
+// call returns the same error.
+typedef enum {
+    JSON_EVENT_NONE = 0, // chunk exhausted, feed more
+    JSON_EVENT_OBJECT_BEGIN,
+    JSON_EVENT_OBJECT_END,
+    JSON_EVENT_ARRAY_BEGIN,
+    JSON_EVENT_ARRAY_END,
+    JSON_EVENT_KEY,
+    JSON_EVENT_KEY_PART,
+    JSON_EVENT_STRING,
+    JSON_EVENT_STRING_PART,
+    JSON_EVENT_NUMBER,
+    JSON_EVENT_BOOL,
+    JSON_EVENT_NULL,
+    JSON_EVENT_ERROR,
+} json_event_type;
+
+typedef struct {
+    json_event_type type;
+    uint32 depth;  // after the event, so the root's begin and end are at 1 and 0
+    uint64 offset; // strings and keys: offset of 'str', else offset of the token
+    union {
+        json_string str;
+        json_number num;
+        json_bool   boolean;
+        const char *msg; // JSON_EVENT_ERROR
+    };
+} json_event;
+
+#define JSON_STREAM_SCALAR_MAX 64
+
+typedef struct {
+    uint64 offset; // stream offset of data[0]
+    const char *data;
+    uint32 size;
+    uint32 pos;
+    uint32 state;
+    uint32 depth;
+    uint64 token_offset;
+    const char *msg; // set once the stream is in error
+    bool escape; // the last string char of the previous chunk was an unescaped '\'
+    uint32 scalar_len;
+    char scalar[JSON_STREAM_SCALAR_MAX + 16]; // numbers and literals, zero padded
+    uint64 containers[JSON_MAX_DEPTH / 64];   // bit per depth, set for objects
+} json_stream;
+
+void json_stream_init(json_stream *s);
+void json_stream_feed(json_stream *s, const char *data, uint32 size);
+json_event json_stream_next(json_stream *s);
+bool json_stream_done(json_stream *s); // the root has been closed
+
+uint json_object_find_key_hashed(json_object *obj, const char *key, uint32 len);
+
+static inline uint json_find_key_len(json_object *obj, const char *key, uint32 len) {
+    if (obj->hash_cap)
+        return json_object_find_key_hashed(obj, key, len);
     uint cnt = obj->key_count;
     for(uint i = 0; i < cnt; ++i)
-        if (memcmp(key, obj->keys[i].cstr, strlen(key)) == 0)
+        if (obj->keys[i].len == len && memcmp(key, obj->keys[i].cstr, len) == 0)
             return i;
     return Max_u32;
 }
 
+static inline uint json_find_key(json_object *obj, const char *key) {
+    return json_find_key_len(obj, key, strlen(key));
+}
+
+// 'key' must be a string literal.
+#define json_find_key_lit(obj, key) json_find_key_len(obj, key, cstr_arrlen(key))
+
+// Writer: streams json text into a string_builder which either grows from an
+// allocator or is flushed to a file descriptor when full.
+//
+//     json_writer w = json_writer_new(4096, alloc, JSON_WRITER_PRETTY);
+//     json_write_object_begin(&w);
+//     json_write_key_lit(&w, "name");
+//     json_write_string(&w, name, len);
+//     json_write_object_end(&w);
+//     if (json_writer_finish(&w)) ... w.sb.data, w.sb.used ...
+//
+// Commas, colons and indentation are inserted by the writer. Strings are
+// escaped; numbers are written with enough digits to parse back to the same
+// value, and non finite numbers are written as null.
+enum {
+    JSON_WRITER_COMPACT = 0x0,
+    JSON_WRITER_PRETTY  = 0x1, // newlines and two space indents
+};
+
+#define JSON_WRITER_MIN_CAP 256
+
+typedef struct {
+    string_builder sb;
+    allocator *alloc; // NULL if writing to 'fd'
+    int fd;
+    uint64 fd_offset; // file offset of sb.data[0]
+    uint32 flags;
+    uint32 depth;
+    bool need_comma;
+    bool after_key;
+    bool error; // a flush failed or the output is malformed
+} json_writer;
+
+json_writer json_writer_new(uint32 cap, allocator *alloc, uint32 flags);
+// 'buf' is the staging buffer of 'cap' bytes, at least JSON_WRITER_MIN_CAP.
+json_writer json_writer_new_fd(int fd, uint64 offset, uint32 cap, char *buf, uint32 flags);
+// Flushes to the fd if there is one. Returns false if the writer errored.
+bool json_writer_finish(json_writer *w);
+
+void json_write_object_begin(json_writer *w);
+void json_write_object_end(json_writer *w);
+void json_write_array_begin(json_writer *w);
+void json_write_array_end(json_writer *w);
+void json_write_key(json_writer *w, const char *key, uint32 len);
+void json_write_string(json_writer *w, const char *str, uint32 len);
+void json_write_number(json_writer *w, double num);
+void json_write_f32(json_writer *w, float num);
+void json_write_int(json_writer *w, int64 num);
+void json_write_bool(json_writer *w, bool b);
+void json_write_null(json_writer *w);
+// Writes a parsed tree. Its strings are views of the source, so they are
+// written as is rather than escaped again.
+void json_write_json(json_writer *w, json *j);
+
+#define json_write_key_lit(w, key) json_write_key(w, key, cstr_arrlen(key))
+
+#if TEST
+void test_json(test_suite *suite);
+#endif
+
+#if BENCH
+void bench_json(thread_pool *pool, allocator *alloc);
+#endif
+
 #endif // include guard
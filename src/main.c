@@ -102,6 +102,7 @@ static void prog_shutdown(prog_resources *pr)
 #endif // CHECK_END_STATE
 
 static void run_tests(allocator *alloc);
+static void run_benchmarks(thread_pool *pool, allocator *alloc);
 static void thread_tests(thread_pool *pool);
 static void run_tests_thread(struct thread_work_arg *w);
 
@@ -133,12 +134,16 @@ int main() {
     prog_init(&pr, &cam);
 
     run_tests(&pr.allocs.heap);
+    run_benchmarks(&pr.threads, &pr.allocs.heap);
 
     struct shader_config conf = {0};
 
     gltf model;
-    load_gltf(MODEL_FILES[MODEL], &pr.gpu.shader_dir, &conf,
-            &pr.allocs.temp, &pr.allocs.heap, &model);
+    if (!load_gltf(MODEL_FILES[MODEL], &pr.gpu.shader_dir, &conf, &pr.threads,
+            &pr.allocs.temp, &pr.allocs.heap, &model)) {
+        log_print_error("failed to load model %s", MODEL_FILES[MODEL]);
+        return -1;
+    }
 
     struct vertex_info_descriptor vs_info_desc;
     Vertex_Info *vs_info = init_vs_info(&pr.gpu, cam.pos, cam.dir, &vs_info_desc);
@@ -665,13 +670,26 @@ static void run_tests(allocator *alloc)
     #if TEST
     test_suite suite = load_tests(alloc);
 
+    test_json(&suite);
+    test_math(&suite);
+    test_mesh(&suite);
     test_gltf(&suite);
+    test_asset(&suite);
     test_spirv(&suite);
 
     end_tests(&suite);
     #endif
 }
 
+static void run_benchmarks(thread_pool *pool, allocator *alloc)
+{
+    #if BENCH
+    bench_json(pool, alloc);
+    bench_math(pool, alloc);
+    bench_asset(pool, alloc);
+    #endif
+}
+
 static void init_allocators(allocator_info *allocs)
 {
     #if ARENA
@@ -15,200 +15,648 @@ static inline void store_vector3_ua(float *to, vector from)
     memcpy(to, &from.x, sizeof(from.x) * 3);
 }
 
-void calc_vertex_normals16( // @Todo Need a version that does not use indices
-    uint    index_count,
-    uint16 *indices,
-    uint    vertex_count,
-    uint    vertex_stride,
-    float  *vertices,
-    vector *ret_normals)
-{
-    assert(index_count % 3 == 0);
-
-    vertex_stride /= 4;
-    memset(ret_normals, 0, sizeof(*ret_normals) * vertex_count);
-
-    vector p[3];
-    uint i,j;
-    for(i=0; i < index_count; i += 3) {
-        for(j = 0; j < 3; ++j)
-            p[j] = vector3_ua(&vertices[indices[i+j] * vertex_stride]);
-
-        p[0] = cross(sub_vector(p[1], p[0]), sub_vector(p[2], p[0]));
-
-        for(j=0; j < 3; ++j)
-            ret_normals[indices[i+j]] = add_vector(ret_normals[indices[i+j]], p[0]);
-    }
-    for(i=0; i < vertex_count; ++i)
-        ret_normals[i] = normalize(ret_normals[i]);
-}
-
-void calc_vertex_normals( // @Todo Need a version that does not use indices
-    uint    index_count,
-    uint   *indices,
-    uint    vertex_count,
-    uint    vertex_stride,
-    float  *vertices,
-    vector *ret_normals)
-{
-
-    assert(index_count % 3 == 0);
-
-    vertex_stride /= 4;
-    memset(ret_normals, 0, sizeof(*ret_normals) * vertex_count);
-
-    vector p[3];
-    uint i,j;
-    for(i=0; i < index_count; i += 3) {
-        for(j = 0; j < 3; ++j)
-            p[j] = vector3_ua(&vertices[indices[i+j] * vertex_stride]);
-
-        p[0] = cross(sub_vector(p[1], p[0]), sub_vector(p[2], p[0]));
-
-        for(j=0; j < 3; ++j)
-            ret_normals[indices[i+j]] = add_vector(ret_normals[indices[i+j]], p[0]);
-    }
-    for(i=0; i < vertex_count; ++i)
-        ret_normals[i] = normalize(ret_normals[i]);
-}
-
-void calc_vertex_tangents16( // @Todo Without indices.
-    uint       index_count,
-    uint16    *indices,
-    uint       vertex_count,
-    uint       vertex_stride,
-    float     *vertices,
-    bool       aligned_normals,
-    uint       normal_stride,
-    float     *normals,
-    uint       texcoord_stride,
-    float     *texcoords,
-    allocator *alloc,
-    vector    *ret_tangents)
-{
-    vertex_stride /= 4;
-    normal_stride /= 4;
-    texcoord_stride /= 4;
-
-    vector *tan1 = sallocate(alloc, *tan1, 2 * vertex_count);
-    vector *tan2 = tan1 + vertex_count;
-    smemset(tan1, 0, *tan1, 2 * vertex_count);
-
-    vector v3[3];
-    vector v2[3];
-
-    uint i,j;
-    for (i = 0; i < index_count; i += 3) {
-        for(j = 0; j < 3; ++j)
-            v3[j] = vector3_ua(&vertices[indices[i+j]*vertex_stride]);
-        for(j = 0; j < 3; ++j)
-            v2[j] = vector2_ua(&texcoords[indices[i+j]*texcoord_stride]);
-
-        float x1 = v3[1].x - v3[0].x;
-        float x2 = v3[2].x - v3[0].x;
-        float y1 = v3[1].y - v3[0].y;
-        float y2 = v3[2].y - v3[0].y;
-        float z1 = v3[1].z - v3[0].z;
-        float z2 = v3[2].z - v3[0].z;
-        float s1 = v2[1].x - v2[0].x;
-        float s2 = v2[2].x - v2[0].x;
-        float t1 = v2[1].y - v2[0].y;
-        float t2 = v2[2].y - v2[0].y;
-        float r = 1.0 / (s1 * t2 - s2 * t1);
-
-        v3[0] = (vector) {
-            (t2 * x1 - t1 * x2) * r,
-            (t2 * y1 - t1 * y2) * r,
-            (t2 * z1 - t1 * z2) * r,
-        };
-        v3[1] = (vector) {
-            (s1 * x2 - s2 * x1) * r,
-            (s1 * y2 - s2 * y1) * r,
-            (s1 * z2 - s2 * z1) * r,
-        };
+// Triangles and vertices are each split into chunks of this many, which are
+// claimed from a shared counter by the pool's workers and the calling thread.
+#define VERTEX_ATTR_CHUNK_SIZE (16 * 1024)
+
+struct vertex_attr_parallel {
+    void (*fn)(void *arg, uint begin, uint end);
+    void *arg;
+    uint count;
+    uint chunk_count;
+    uint next;
+    uint done;
+    uint exited;
+};
+
+static void vertex_attr_parallel_chunks(struct vertex_attr_parallel *w)
+{
+    uint i;
+    while((i = atomic_add(&w->next, 1)) < w->chunk_count) {
+        uint begin = i * VERTEX_ATTR_CHUNK_SIZE;
+        uint end = w->count - begin < VERTEX_ATTR_CHUNK_SIZE ? w->count : begin + VERTEX_ATTR_CHUNK_SIZE;
+        w->fn(w->arg, begin, end);
+        atomic_add(&w->done, 1);
+    }
+}
+
+static void* vertex_attr_parallel_tf(struct thread_work_arg *arg)
+{
+    struct vertex_attr_parallel *w = arg->arg;
+    vertex_attr_parallel_chunks(w);
+    atomic_add(&w->exited, 1);
+    return NULL;
+}
+
+// Call 'fn' on each chunk of [0, count), and return once every chunk is done.
+static void vertex_attr_parallel_for(thread_pool *pool, uint count, void (*fn)(void*, uint, uint), void *arg)
+{
+    struct vertex_attr_parallel w = {
+        .fn = fn,
+        .arg = arg,
+        .count = count,
+        .chunk_count = (count + VERTEX_ATTR_CHUNK_SIZE - 1) / VERTEX_ATTR_CHUNK_SIZE,
+    };
+
+    uint submitted = 0;
+    if (pool && w.chunk_count > 1) {
+        struct thread_work work[THREAD_COUNT];
+        uint work_count = w.chunk_count - 1 < THREAD_COUNT ? w.chunk_count - 1 : THREAD_COUNT;
+        for(uint i = 0; i < work_count; ++i) {
+            work[i].fn = cast_work_fn(vertex_attr_parallel_tf);
+            work[i].arg = cast_work_arg(&w);
+        }
+        submitted = thread_add_work_high(pool, work_count, work);
+    }
+    vertex_attr_parallel_chunks(&w);
+
+    // Work items may still be queued behind other work, and 'w' is on the stack.
+    uint done, exited;
+    while(1) {
+        atomic_load(&w.done, &done);
+        atomic_load(&w.exited, &exited);
+        if (done == w.chunk_count && exited == submitted)
+            break;
+        _mm_pause();
+    }
+}
+
+struct vertex_attr_work {
+    const struct triangle_indices *tris;
+    uint         vertex_stride; // strides in floats
+    const float *vertices;
+    uint         normal_stride;
+    const float *normals;
+    uint         texcoord_stride;
+    const float *texcoords;
+    uint         flags;
+
+    vector      *face_s; // per triangle normal, or tangent s direction
+    vector      *face_t; // per triangle tangent t direction
+    float       *angles; // per corner, for CALC_TANGENTS_MIKKTSPACE_BIT
+
+    // The corners using each vertex, in index order, or NULL if the triangles
+    // are not indexed, when each vertex is only its own corner.
+    uint        *adj_offsets;
+    uint        *adj_corners;
+
+    vector      *ret;
+};
+
+static inline uint triangle_corner(const struct triangle_indices *tris, uint i)
+{
+    if (!tris->data)
+        return i;
+    return tris->size == 2 ? ((const uint16*)tris->data)[i] : ((const uint*)tris->data)[i];
+}
+
+// One component per register of the attribute at corner 'c' of the four
+// triangles from 't'.
+static inline void vertex_attr_gather(const struct triangle_indices *tris, uint t, uint c,
+                                      const float *attr, uint stride, uint component_count, __m128 *ret)
+{
+    const float *p[4];
+    for(uint i = 0; i < 4; ++i)
+        p[i] = attr + (uint64)triangle_corner(tris, (t + i) * 3 + c) * stride;
+    for(uint i = 0; i < component_count; ++i)
+        ret[i] = _mm_setr_ps(p[0][i], p[1][i], p[2][i], p[3][i]);
+}
+
+static inline void vertex_attr_scatter(vector *to, __m128 x, __m128 y, __m128 z)
+{
+    __m128 w = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    _mm_store_ps(&to[0].x, x);
+    _mm_store_ps(&to[1].x, y);
+    _mm_store_ps(&to[2].x, z);
+    _mm_store_ps(&to[3].x, w);
+}
+
+// Zero rather than nan for a zero length vector. w is ignored.
+static inline __m128 vertex_attr_normalize(__m128 v)
+{
+    __m128 len = _mm_sqrt_ps(_mm_dp_ps(v, v, 0x7f));
+    return _mm_and_ps(_mm_div_ps(v, len), _mm_cmpgt_ps(len, _mm_setzero_ps()));
+}
+
+static void vertex_attr_corner_angles(vector p[3], float *ret)
+{
+    for(uint c = 0; c < 3; ++c) {
+        __m128 o = _mm_load_ps(&p[c].x);
+        __m128 a = vertex_attr_normalize(_mm_sub_ps(_mm_load_ps(&p[(c+1) % 3].x), o));
+        __m128 b = vertex_attr_normalize(_mm_sub_ps(_mm_load_ps(&p[(c+2) % 3].x), o));
+        ret[c] = acosf(clamp(_mm_cvtss_f32(_mm_dp_ps(a, b, 0x71)), -1, 1));
+    }
+}
+
+// Four triangles at a time with one component per register, then the rest one
+// at a time. Both do the same float operations in the same order, so a
+// triangle's result does not depend on where the chunk boundaries fall.
+static void vertex_attr_face_normals(void *arg, uint begin, uint end)
+{
+    struct vertex_attr_work *w = arg;
+    uint t = begin;
+    for(; t + 4 <= end; t += 4) {
+        __m128 p[3][3];
+        for(uint c = 0; c < 3; ++c)
+            vertex_attr_gather(w->tris, t, c, w->vertices, w->vertex_stride, 3, p[c]);
+
+        __m128 e1[3], e2[3];
+        for(uint i = 0; i < 3; ++i) {
+            e1[i] = _mm_sub_ps(p[1][i], p[0][i]);
+            e2[i] = _mm_sub_ps(p[2][i], p[0][i]);
+        }
+        vertex_attr_scatter(w->face_s + t,
+                            _mm_sub_ps(_mm_mul_ps(e1[1], e2[2]), _mm_mul_ps(e1[2], e2[1])),
+                            _mm_sub_ps(_mm_mul_ps(e1[2], e2[0]), _mm_mul_ps(e1[0], e2[2])),
+                            _mm_sub_ps(_mm_mul_ps(e1[0], e2[1]), _mm_mul_ps(e1[1], e2[0])));
+    }
+    for(; t < end; ++t) {
+        vector p[3];
+        for(uint c = 0; c < 3; ++c)
+            p[c] = vector3_ua((float*)w->vertices + (uint64)triangle_corner(w->tris, t * 3 + c) * w->vertex_stride);
+        w->face_s[t] = cross(sub_vector(p[1], p[0]), sub_vector(p[2], p[0]));
+    }
+}
+
+static void vertex_attr_face_tangents(void *arg, uint begin, uint end)
+{
+    struct vertex_attr_work *w = arg;
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1);
+    uint t = begin;
+    for(; t + 4 <= end; t += 4) {
+        __m128 p[3][3], uv[3][2];
+        for(uint c = 0; c < 3; ++c) {
+            vertex_attr_gather(w->tris, t, c, w->vertices, w->vertex_stride, 3, p[c]);
+            vertex_attr_gather(w->tris, t, c, w->texcoords, w->texcoord_stride, 2, uv[c]);
+        }
+
+        __m128 e1[3], e2[3];
+        for(uint i = 0; i < 3; ++i) {
+            e1[i] = _mm_sub_ps(p[1][i], p[0][i]);
+            e2[i] = _mm_sub_ps(p[2][i], p[0][i]);
+        }
+        __m128 s1 = _mm_sub_ps(uv[1][0], uv[0][0]);
+        __m128 s2 = _mm_sub_ps(uv[2][0], uv[0][0]);
+        __m128 t1 = _mm_sub_ps(uv[1][1], uv[0][1]);
+        __m128 t2 = _mm_sub_ps(uv[2][1], uv[0][1]);
+
+        // Degenerate texcoords contribute nothing rather than inf.
+        __m128 d = _mm_sub_ps(_mm_mul_ps(s1, t2), _mm_mul_ps(s2, t1));
+        __m128 r = _mm_and_ps(_mm_div_ps(one, d), _mm_cmpneq_ps(d, zero));
+
+        __m128 sd[3], td[3];
+        for(uint i = 0; i < 3; ++i) {
+            sd[i] = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(t2, e1[i]), _mm_mul_ps(t1, e2[i])), r);
+            td[i] = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(s1, e2[i]), _mm_mul_ps(s2, e1[i])), r);
+        }
+        vertex_attr_scatter(w->face_s + t, sd[0], sd[1], sd[2]);
+        vertex_attr_scatter(w->face_t + t, td[0], td[1], td[2]);
+    }
+    for(; t < end; ++t) {
+        vector p[3], uv[3];
+        for(uint c = 0; c < 3; ++c) {
+            uint v = triangle_corner(w->tris, t * 3 + c);
+            p[c] = vector3_ua((float*)w->vertices + (uint64)v * w->vertex_stride);
+            uv[c] = vector2_ua((float*)w->texcoords + (uint64)v * w->texcoord_stride);
+        }
+        vector e1 = sub_vector(p[1], p[0]);
+        vector e2 = sub_vector(p[2], p[0]);
+        float s1 = uv[1].x - uv[0].x;
+        float s2 = uv[2].x - uv[0].x;
+        float t1 = uv[1].y - uv[0].y;
+        float t2 = uv[2].y - uv[0].y;
+        float d = s1 * t2 - s2 * t1;
+        float r = d != 0 ? 1.0f / d : 0;
 
-        for(j = 0; j < 3; ++j)
-            tan1[indices[i+j]] = add_vector(v3[0], tan1[indices[i+j]]);
-        for(j = 0; j < 3; ++j)
-            tan2[indices[i+j]] = add_vector(v3[1], tan1[indices[i+j]]);
-    }
-    for(i = 0; i < vertex_count; i++) {
-        if (!aligned_normals)
-            v3[0] = vector3_ua(&normals[i*normal_stride]);
-        else
-            v3[0] = *(vector*)&normals[i*4];
-        ret_tangents[i] = normalize(gram_schmidt(v3[0], tan1[i]));
-        ret_tangents[i].w = tangent_handedness(v3[0], tan1[i], tan2[i]);
-    }
-}
-
-void calc_vertex_tangents( // @Todo Without indices.
-    uint       index_count,
-    uint      *indices,
-    uint       vertex_count,
-    uint       vertex_stride,
-    float     *vertices,
-    bool       aligned_normals,
-    uint       normal_stride,
-    float     *normals,
-    uint       texcoord_stride,
-    float     *texcoords,
-    allocator *alloc,
-    vector    *ret_tangents)
-{
-    vertex_stride /= 4;
-    normal_stride /= 4;
-    texcoord_stride /= 4;
-
-    vector *tan1 = sallocate(alloc, *tan1, 2 * vertex_count);
-    vector *tan2 = tan1 + vertex_count;
-    smemset(tan1, 0, *tan1, 2 * vertex_count);
-
-    vector v3[3];
-    vector v2[3];
-
-    uint i,j;
-    for (i = 0; i < index_count; i += 3) {
-        for(j = 0; j < 3; ++j)
-            v3[j] = vector3_ua(&vertices[indices[i+j]*vertex_stride]);
-        for(j = 0; j < 3; ++j)
-            v2[j] = vector2_ua(&texcoords[indices[i+j]*texcoord_stride]);
-
-        float x1 = v3[1].x - v3[0].x;
-        float x2 = v3[2].x - v3[0].x;
-        float y1 = v3[1].y - v3[0].y;
-        float y2 = v3[2].y - v3[0].y;
-        float z1 = v3[1].z - v3[0].z;
-        float z2 = v3[2].z - v3[0].z;
-        float s1 = v2[1].x - v2[0].x;
-        float s2 = v2[2].x - v2[0].x;
-        float t1 = v2[1].y - v2[0].y;
-        float t2 = v2[2].y - v2[0].y;
-        float r = 1.0 / (s1 * t2 - s2 * t1);
-
-        v3[0] = (vector) {
-            (t2 * x1 - t1 * x2) * r,
-            (t2 * y1 - t1 * y2) * r,
-            (t2 * z1 - t1 * z2) * r,
+        w->face_s[t] = (vector) {
+            (t2 * e1.x - t1 * e2.x) * r,
+            (t2 * e1.y - t1 * e2.y) * r,
+            (t2 * e1.z - t1 * e2.z) * r,
         };
-        v3[1] = (vector) {
-            (s1 * x2 - s2 * x1) * r,
-            (s1 * y2 - s2 * y1) * r,
-            (s1 * z2 - s2 * z1) * r,
+        w->face_t[t] = (vector) {
+            (s1 * e2.x - s2 * e1.x) * r,
+            (s1 * e2.y - s2 * e1.y) * r,
+            (s1 * e2.z - s2 * e1.z) * r,
         };
+    }
+    if (w->flags & CALC_TANGENTS_MIKKTSPACE_BIT) {
+        for(t = begin; t < end; ++t) {
+            vector p[3];
+            for(uint c = 0; c < 3; ++c)
+                p[c] = vector3_ua((float*)w->vertices + (uint64)triangle_corner(w->tris, t * 3 + c) * w->vertex_stride);
+            vertex_attr_corner_angles(p, w->angles + t * 3);
+        }
+    }
+}
+
+static inline void vertex_attr_corners(struct vertex_attr_work *w, uint v, uint *begin, uint *end)
+{
+    *begin = w->adj_offsets ? w->adj_offsets[v] : v;
+    *end = w->adj_offsets ? w->adj_offsets[v + 1] : v + 1;
+}
+
+static inline uint vertex_attr_corner(struct vertex_attr_work *w, uint i)
+{
+    return w->adj_offsets ? w->adj_corners[i] : i;
+}
+
+static void vertex_attr_vertex_normals(void *arg, uint begin, uint end)
+{
+    struct vertex_attr_work *w = arg;
+    for(uint v = begin; v < end; ++v) {
+        uint cb, ce;
+        vertex_attr_corners(w, v, &cb, &ce);
+        __m128 n = _mm_setzero_ps();
+        for(uint i = cb; i < ce; ++i)
+            n = _mm_add_ps(n, _mm_load_ps(&w->face_s[vertex_attr_corner(w, i) / 3].x));
+        _mm_store_ps(&w->ret[v].x, vertex_attr_normalize(n));
+    }
+}
+
+static void vertex_attr_vertex_tangents(void *arg, uint begin, uint end)
+{
+    struct vertex_attr_work *w = arg;
+    const __m128 zero = _mm_setzero_ps();
+    for(uint v = begin; v < end; ++v) {
+        vector nv = vector3_ua((float*)w->normals + (uint64)v * w->normal_stride);
+        __m128 n = vertex_attr_normalize(_mm_load_ps(&nv.x));
 
-        for(j = 0; j < 3; ++j)
-            tan1[indices[i+j]] = add_vector(v3[0], tan1[indices[i+j]]);
-        for(j = 0; j < 3; ++j)
-            tan2[indices[i+j]] = add_vector(v3[1], tan1[indices[i+j]]);
+        uint cb, ce;
+        vertex_attr_corners(w, v, &cb, &ce);
+
+        __m128 t;
+        float handedness = 0;
+        if (w->flags & CALC_TANGENTS_MIKKTSPACE_BIT) {
+            // Each face's s direction is projected onto the plane of the
+            // vertex normal before its magnitude is dropped, and weighted by
+            // the angle of the corner, as MikkTSpace does.
+            t = zero;
+            for(uint i = cb; i < ce; ++i) {
+                uint c = vertex_attr_corner(w, i);
+                __m128 s = _mm_load_ps(&w->face_s[c / 3].x);
+                __m128 sp = vertex_attr_normalize(_mm_sub_ps(s, _mm_mul_ps(n, _mm_dp_ps(n, s, 0x7f))));
+                __m128 a = _mm_set1_ps(w->angles[c]);
+                t = _mm_add_ps(t, _mm_mul_ps(sp, a));
+
+                vector vn, vs, vt;
+                _mm_store_ps(&vn.x, n);
+                _mm_store_ps(&vs.x, s);
+                vt = w->face_t[c / 3];
+                handedness += w->angles[c] * tangent_handedness(vn, vs, vt);
+            }
+        } else {
+            __m128 s = zero, tt = zero;
+            for(uint i = cb; i < ce; ++i) {
+                uint c = vertex_attr_corner(w, i);
+                s = _mm_add_ps(s, _mm_load_ps(&w->face_s[c / 3].x));
+                tt = _mm_add_ps(tt, _mm_load_ps(&w->face_t[c / 3].x));
+            }
+            t = _mm_sub_ps(s, _mm_mul_ps(n, _mm_dp_ps(n, s, 0x7f)));
+
+            vector vn, vs, vt;
+            _mm_store_ps(&vn.x, n);
+            _mm_store_ps(&vs.x, s);
+            _mm_store_ps(&vt.x, tt);
+            handedness = tangent_handedness(vn, vs, vt);
+        }
+
+        t = vertex_attr_normalize(t);
+        if (_mm_testz_si128(_mm_castps_si128(t), _mm_castps_si128(t))) {
+            // No usable texcoords, so any vector perpendicular to the normal.
+            vector a = fabsf(nv.x) < 0.9f ? vector3(1, 0, 0) : vector3(0, 1, 0);
+            a = cross(nv, a);
+            t = vertex_attr_normalize(_mm_load_ps(&a.x));
+        }
+        _mm_store_ps(&w->ret[v].x, t);
+        w->ret[v].w = handedness < 0 ? -1 : 1;
+    }
+}
+
+// Corners grouped by vertex with a counting sort. Each vertex's corners are in
+// index order, so the sums over them are the same whatever the thread count.
+// Returns false if an index is out of range of 'vertex_count'.
+static bool vertex_attr_adjacency(struct vertex_attr_work *w, uint index_count, uint vertex_count, allocator *alloc)
+{
+    uint *o = sallocate(alloc, *o, vertex_count + 2);
+    uint *adj = sallocate(alloc, *adj, index_count);
+    memset(o, 0, sizeof(*o) * (vertex_count + 2));
+
+    for(uint i = 0; i < index_count; ++i) {
+        uint v = triangle_corner(w->tris, i);
+        if (v >= vertex_count) {
+            log_print_error("index %u is out of range of %u vertices", v, vertex_count);
+            return false;
+        }
+        o[v + 2]++;
+    }
+    for(uint v = 2; v < vertex_count + 2; ++v)
+        o[v] += o[v - 1];
+    for(uint i = 0; i < index_count; ++i)
+        adj[o[triangle_corner(w->tris, i) + 1]++] = i;
+
+    // o[v] is now the first corner of v.
+    w->adj_offsets = o;
+    w->adj_corners = adj;
+    return true;
+}
+
+bool calc_vertex_normals(
+    struct triangle_indices *tris,
+    uint         vertex_count,
+    uint         vertex_stride,
+    const float *vertices,
+    thread_pool *pool,
+    allocator   *alloc,
+    vector      *ret_normals)
+{
+    assert(tris->count % 3 == 0);
+    assert(tris->data || tris->count == vertex_count);
+
+    uint64 mark = allocator_used(alloc);
+    uint tri_count = tris->count / 3;
+    struct vertex_attr_work w = {
+        .tris = tris,
+        .vertex_stride = vertex_stride / 4,
+        .vertices = vertices,
+        .face_s = sallocate(alloc, vector, tri_count),
+        .ret = ret_normals,
+    };
+
+    // The indices are checked before the faces read the vertices.
+    bool ok = !tris->data || vertex_attr_adjacency(&w, tris->count, vertex_count, alloc);
+    if (ok) {
+        vertex_attr_parallel_for(pool, tri_count, vertex_attr_face_normals, &w);
+        vertex_attr_parallel_for(pool, vertex_count, vertex_attr_vertex_normals, &w);
+    }
+    allocator_reset_linear_to(alloc, mark);
+    return ok;
+}
+
+bool calc_vertex_tangents(
+    struct triangle_indices *tris,
+    uint         vertex_count,
+    uint         vertex_stride,
+    const float *vertices,
+    uint         normal_stride,
+    const float *normals,
+    uint         texcoord_stride,
+    const float *texcoords,
+    uint         flags,
+    thread_pool *pool,
+    allocator   *alloc,
+    vector      *ret_tangents)
+{
+    assert(tris->count % 3 == 0);
+    assert(tris->data || tris->count == vertex_count);
+
+    uint64 mark = allocator_used(alloc);
+    uint tri_count = tris->count / 3;
+    struct vertex_attr_work w = {
+        .tris = tris,
+        .vertex_stride = vertex_stride / 4,
+        .vertices = vertices,
+        .normal_stride = normal_stride / 4,
+        .normals = normals,
+        .texcoord_stride = texcoord_stride / 4,
+        .texcoords = texcoords,
+        .flags = flags,
+        .face_s = sallocate(alloc, vector, tri_count),
+        .face_t = sallocate(alloc, vector, tri_count),
+        .angles = flags & CALC_TANGENTS_MIKKTSPACE_BIT ? sallocate(alloc, float, tris->count) : NULL,
+        .ret = ret_tangents,
+    };
+
+    bool ok = !tris->data || vertex_attr_adjacency(&w, tris->count, vertex_count, alloc);
+    if (ok) {
+        vertex_attr_parallel_for(pool, tri_count, vertex_attr_face_tangents, &w);
+        vertex_attr_parallel_for(pool, vertex_count, vertex_attr_vertex_tangents, &w);
+    }
+    allocator_reset_linear_to(alloc, mark);
+    return ok;
+}
+
+#if TEST
+static void test_math_vertex_attrs(test_suite *suite);
+
+void test_math(test_suite *suite)
+{
+    test_math_vertex_attrs(suite);
+}
+
+// A grid of (n+1)^2 vertices with position, normal and texcoord interleaved,
+// bumped so that no two faces are alike.
+static float* test_math_grid(uint n, allocator *alloc, uint **ret_indices)
+{
+    uint vc = (n + 1) * (n + 1);
+    float *v = sallocate(alloc, float, vc * 8);
+    for(uint y = 0; y <= n; ++y)
+        for(uint x = 0; x <= n; ++x) {
+            float *p = v + (y * (n + 1) + x) * 8;
+            p[0] = x;
+            p[1] = y;
+            p[2] = sinf(x * 0.7f) * cosf(y * 1.3f);
+            p[3] = p[4] = 0;
+            p[5] = 1;
+            p[6] = x / (float)n + 0.01f * sinf(y);
+            p[7] = y / (float)n;
+        }
+
+    uint *ind = sallocate(alloc, uint, n * n * 6);
+    for(uint y = 0; y < n; ++y)
+        for(uint x = 0; x < n; ++x) {
+            uint *q = ind + (y * n + x) * 6;
+            uint i = y * (n + 1) + x;
+            q[0] = i;     q[1] = i + 1;     q[2] = i + n + 2;
+            q[3] = i;     q[4] = i + n + 2; q[5] = i + n + 1;
+        }
+    *ret_indices = ind;
+    return v;
+}
+
+static void test_math_vertex_attrs(test_suite *suite)
+{
+    BEGIN_TEST_MODULE("math_vertex_attrs", false, false);
+
+    // A quad in the xy plane with u along x and v along y.
+    float quad[] = {
+        0,0,0, 0,0,1, 0,0,
+        1,0,0, 0,0,1, 1,0,
+        1,1,0, 0,0,1, 1,1,
+        0,1,0, 0,0,1, 0,1,
+    };
+    uint16 quad_ind[] = {0,1,2, 0,2,3};
+    struct triangle_indices tris = {6, 2, quad_ind};
+    vector n[4], t[4];
+
+    calc_vertex_normals(&tris, 4, 32, quad, NULL, suite->alloc, n);
+    calc_vertex_tangents(&tris, 4, 32, quad, 32, quad + 3, 32, quad + 6, 0, NULL, suite->alloc, t);
+    TEST_FEQ("quad normal z", n[0].z, 1, false);
+    TEST_FEQ("quad normal x", n[2].x, 0, false);
+    TEST_FEQ("quad tangent x", t[3].x, 1, false);
+    TEST_FEQ("quad tangent w", t[1].w, 1, false);
+
+    calc_vertex_tangents(&tris, 4, 32, quad, 32, quad + 3, 32, quad + 6,
+                         CALC_TANGENTS_MIKKTSPACE_BIT, NULL, suite->alloc, t);
+    TEST_FEQ("quad mikk tangent x", t[0].x, 1, false);
+    TEST_FEQ("quad mikk tangent w", t[2].w, 1, false);
+
+    // Flipping v flips the bitangent.
+    for(uint i = 0; i < 4; ++i)
+        quad[i * 8 + 7] = 1 - quad[i * 8 + 7];
+    calc_vertex_tangents(&tris, 4, 32, quad, 32, quad + 3, 32, quad + 6, 0, NULL, suite->alloc, t);
+    TEST_FEQ("flipped tangent x", t[0].x, 1, false);
+    TEST_FEQ("flipped tangent w", t[0].w, -1, false);
+
+    // Without indices each vertex is its own corner, so normals are flat.
+    float tri[] = {0,0,0, 0,1,0, 0,0,1};
+    struct triangle_indices flat = {3, 4, NULL};
+    calc_vertex_normals(&flat, 3, 12, tri, NULL, suite->alloc, n);
+    TEST_FEQ("non-indexed normal x", n[0].x, 1, false);
+    TEST_FEQ("non-indexed normal x", n[2].x, 1, false);
+
+    // The scratch memory is given back.
+    allocator lin = new_linear_allocator(64 * 1024, NULL);
+    TEST_EQ("normals temp", calc_vertex_normals(&tris, 4, 32, quad, NULL, &lin, n), true, false);
+    TEST_EQ("normals temp used", allocator_used(&lin), 0, false);
+    calc_vertex_tangents(&tris, 4, 32, quad, 32, quad + 3, 32, quad + 6,
+                         CALC_TANGENTS_MIKKTSPACE_BIT, NULL, &lin, t);
+    TEST_EQ("tangents temp used", allocator_used(&lin), 0, false);
+
+    // An index out of range fails before any vertex is read. This logs, so
+    // only run it when logging does not break.
+    #if !LOG_BREAK
+    uint16 bad_ind[] = {0,1,2, 0,2,4};
+    struct triangle_indices bad_tris = {6, 2, bad_ind};
+    TEST_EQ("bad index normals", calc_vertex_normals(&bad_tris, 4, 32, quad, NULL, &lin, n), false, false);
+    TEST_EQ("bad index tangents", calc_vertex_tangents(&bad_tris, 4, 32, quad, 32, quad + 3, 32, quad + 6,
+                                                       0, NULL, &lin, t), false, false);
+    TEST_EQ("bad index temp used", allocator_used(&lin), 0, false);
+    #endif
+    free_allocator(&lin);
+
+    // Several chunks, so the pool splits the work. The sums for each vertex
+    // are in index order either way, so the results must be bit identical.
+    uint grid = 200;
+    uint vc = (grid + 1) * (grid + 1);
+    uint *ind;
+    float *v = test_math_grid(grid, suite->alloc, &ind);
+    struct triangle_indices grid_tris = {grid * grid * 6, 4, ind};
+
+    vector *serial = sallocate(suite->alloc, vector, vc * 4);
+    vector *parallel = serial + vc * 2;
+
+    thread_pool pool;
+    struct allocation heap_buffers[THREAD_COUNT];
+    struct allocation temp_buffers[THREAD_COUNT];
+    for(uint i = 0; i < THREAD_COUNT; ++i) {
+        heap_buffers[i] = (struct allocation){.size = 1024 * 1024};
+        temp_buffers[i] = (struct allocation){allocate(suite->alloc, 1024 * 1024), 1024 * 1024};
     }
-    for(i = 0; i < vertex_count; i++) {
-        if (!aligned_normals)
-            v3[0] = vector3_ua(&normals[i*normal_stride]);
-        else
-            v3[0] = *(vector*)&normals[i*4];
-        ret_tangents[i] = normalize(gram_schmidt(v3[0], tan1[i]));
-        ret_tangents[i].w = tangent_handedness(v3[0], tan1[i], tan2[i]);
+    new_thread_pool(heap_buffers, temp_buffers, suite->alloc, &pool);
+
+    calc_vertex_normals(&grid_tris, vc, 32, v, NULL, suite->alloc, serial);
+    calc_vertex_normals(&grid_tris, vc, 32, v, &pool, suite->alloc, parallel);
+    TEST_EQ("pool normals", memcmp(serial, parallel, sizeof(*serial) * vc), 0, false);
+
+    calc_vertex_tangents(&grid_tris, vc, 32, v, 16, &serial[0].x, 32, v + 6,
+                         CALC_TANGENTS_MIKKTSPACE_BIT, NULL, suite->alloc, serial + vc);
+    calc_vertex_tangents(&grid_tris, vc, 32, v, 16, &serial[0].x, 32, v + 6,
+                         CALC_TANGENTS_MIKKTSPACE_BIT, &pool, suite->alloc, parallel + vc);
+    TEST_EQ("pool tangents", memcmp(serial + vc, parallel + vc, sizeof(*serial) * vc), 0, false);
+
+    // The tangents are unit length and orthogonal to the normals.
+    uint bad = 0;
+    for(uint i = 0; i < vc; ++i) {
+        vector tn = vector3(serial[vc + i].x, serial[vc + i].y, serial[vc + i].z);
+        bad += fabsf(dot(tn, serial[i])) > 1e-5;
+        bad += fabsf(dot(tn, tn) - 1) > 1e-5;
     }
+    TEST_EQ("tangents orthonormal", bad, 0, false);
+
+    free_thread_pool(&pool, true);
+
+    END_TEST_MODULE();
+}
+#endif
+
+#if BENCH
+#include "bench.h"
+
+// 708^2 * 2 is just over a million triangles.
+#define MATH_BENCH_GRID_SIZE 708
+
+static void bench_math_print(const char *name, uint tri_count, double sec)
+{
+    println("    %s: %f M triangles/s (%f sec)", name, tri_count / sec / 1e6, sec);
 }
 
+void bench_math(thread_pool *pool, allocator *alloc)
+{
+    // Own linear allocator, as the mesh does not fit in the main temp allocator.
+    allocator a = new_linear_allocator(256 * 1024 * 1024, NULL);
+    println("math:");
+    println("  vertex attributes, %u triangles:", MATH_BENCH_GRID_SIZE * MATH_BENCH_GRID_SIZE * 2);
+
+    uint n = MATH_BENCH_GRID_SIZE;
+    uint vc = (n + 1) * (n + 1);
+    uint tc = n * n * 2;
+    float *v = sallocate(&a, float, vc * 8);
+    uint *ind = sallocate(&a, uint, tc * 3);
+    for(uint y = 0; y <= n; ++y)
+        for(uint x = 0; x <= n; ++x) {
+            float *p = v + (y * (n + 1) + x) * 8;
+            p[0] = x;
+            p[1] = y;
+            p[2] = sinf(x * 0.1f) * cosf(y * 0.1f);
+            p[6] = x / (float)n;
+            p[7] = y / (float)n;
+        }
+    for(uint y = 0; y < n; ++y)
+        for(uint x = 0; x < n; ++x) {
+            uint *q = ind + (y * n + x) * 6;
+            uint i = y * (n + 1) + x;
+            q[0] = i;     q[1] = i + 1;     q[2] = i + n + 2;
+            q[3] = i;     q[4] = i + n + 2; q[5] = i + n + 1;
+        }
+
+    struct triangle_indices tris = {tc * 3, 4, ind};
+    vector *normals = sallocate(&a, vector, vc);
+    vector *tangents = sallocate(&a, vector, vc);
+    uint64 mark = allocator_used(&a);
+
+    thread_pool *pools[] = {NULL, pool};
+    const char *names[] = {"serial", "pool"};
+    char buf[64];
+    double t;
+    for(uint i = 0; i < carrlen(pools); ++i) {
+        t = bench_time();
+        calc_vertex_normals(&tris, vc, 32, v, pools[i], &a, normals);
+        stbsp_sprintf(buf, "normals (%s)", names[i]);
+        bench_math_print(buf, tc, bench_time() - t);
+        allocator_reset_linear_to(&a, mark);
+
+        t = bench_time();
+        calc_vertex_tangents(&tris, vc, 32, v, 16, &normals[0].x, 32, v + 6, 0, pools[i], &a, tangents);
+        stbsp_sprintf(buf, "tangents (%s)", names[i]);
+        bench_math_print(buf, tc, bench_time() - t);
+        allocator_reset_linear_to(&a, mark);
+
+        t = bench_time();
+        calc_vertex_tangents(&tris, vc, 32, v, 16, &normals[0].x, 32, v + 6,
+                             CALC_TANGENTS_MIKKTSPACE_BIT, pools[i], &a, tangents);
+        stbsp_sprintf(buf, "mikktspace tangents (%s)", names[i]);
+        bench_math_print(buf, tc, bench_time() - t);
+        allocator_reset_linear_to(&a, mark);
+    }
+
+    tris.data = NULL;
+    tris.count = vc - vc % 3;
+    t = bench_time();
+    calc_vertex_normals(&tris, tris.count, 32, v, pool, &a, normals);
+    bench_math_print("non-indexed normals (pool)", tris.count / 3, bench_time() - t);
+
+    free_allocator(&a);
+}
+#endif
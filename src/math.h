@@ -2,6 +2,8 @@
 #define SOL_MATH_H_INCLUDE_GUARD_
 
 #include "defs.h"
+#include "thread.h"
+#include "test.h"
 
 // @Todo Idk if this is too big/too small. Same magnitude as used in test.c.
 #define FLOAT_ERROR 0.000001
@@ -825,48 +827,58 @@ static inline float tangent_handedness(vector n, vector t1, vector t2)
     return dot(cross(n,t1),t2) > 0 ? 1 : -1;
 }
 
-void calc_vertex_normals16(
-    uint    index_count,
-    uint16 *indices,
-    uint    vertex_count,
-    uint    vertex_stride,
-    float  *vertices,
-    vector *ret_normals);
-
-void calc_vertex_normals(
-    uint    index_count,
-    uint   *indices,
-    uint    vertex_count,
-    uint    vertex_stride,
-    float  *vertices,
-    vector *ret_normals);
-
-void calc_vertex_tangents16(
-    uint       index_count,
-    uint16    *indices,
-    uint       vertex_count,
-    uint       vertex_stride,
-    float     *vertices,
-    bool       aligned_normals,
-    uint       normal_stride,
-    float     *normals,
-    uint       texcoord_stride,
-    float     *texcoords,
-    allocator *alloc,
-    vector    *ret_tangents);
-
-void calc_vertex_tangents(
-    uint       index_count,
-    uint      *indices,
-    uint       vertex_count,
-    uint       vertex_stride,
-    float     *vertices,
-    bool       aligned_normals,
-    uint       normal_stride,
-    float     *normals,
-    uint       texcoord_stride,
-    float     *texcoords,
-    allocator *alloc,
-    vector    *ret_tangents);
+// Triangle list indices, 2 or 4 bytes each. If 'data' is NULL the triangles
+// are not indexed, and 'count' is the vertex count.
+struct triangle_indices {
+    uint        count;
+    uint        size;
+    const void *data;
+};
+
+// Strides are in bytes. Large meshes are split into chunks across 'pool',
+// which may be NULL, and each vertex sums its faces in index order, so the
+// result is the same with or without it. Shared vertices are smoothed;
+// non-indexed triangles get flat normals. Scratch memory comes from 'alloc'
+// and is given back before returning. Returns false, having written nothing,
+// if an index is out of range of 'vertex_count'.
+bool calc_vertex_normals(
+    struct triangle_indices *tris,
+    uint         vertex_count,
+    uint         vertex_stride,
+    const float *vertices,
+    thread_pool *pool,
+    allocator   *alloc,
+    vector      *ret_normals);
+
+enum {
+    // Weight each face by its corner angle, and orthogonalize per face rather
+    // than per vertex, as MikkTSpace (and so glTF) does. Vertices are not
+    // split where the tangent space is discontinuous, so only vertices which
+    // the model already splits match exactly.
+    CALC_TANGENTS_MIKKTSPACE_BIT = 0x01,
+};
+
+// w is the bitangent sign. As calc_vertex_normals otherwise.
+bool calc_vertex_tangents(
+    struct triangle_indices *tris,
+    uint         vertex_count,
+    uint         vertex_stride,
+    const float *vertices,
+    uint         normal_stride,
+    const float *normals,
+    uint         texcoord_stride,
+    const float *texcoords,
+    uint         flags,
+    thread_pool *pool,
+    allocator   *alloc,
+    vector      *ret_tangents);
+
+#if TEST
+void test_math(test_suite *suite);
+#endif
+
+#if BENCH
+void bench_math(thread_pool *pool, allocator *alloc);
+#endif
 
 #endif // include guard
@@ -0,0 +1,826 @@
+#include "mesh.h"
+#include "bitset.h"
+
+#include <stdlib.h> // qsort
+
+// A vertex is in the cache if fewer than 'size' misses have happened since it
+// was last missed. Timestamps start at zero and the clock at 'size', so that
+// every vertex starts out cold, and moving the clock on by 'size' flushes it.
+static inline uint mesh_cache_miss(uint *timestamps, uint *time, uint size, uint v)
+{
+    if (*time - timestamps[v] < size)
+        return 0;
+    timestamps[v] = (*time)++;
+    return 1;
+}
+
+static inline uint mesh_triangle_misses(uint *timestamps, uint *time, const uint *tri)
+{
+    return mesh_cache_miss(timestamps, time, MESH_VERTEX_CACHE_SIZE, tri[0]) +
+           mesh_cache_miss(timestamps, time, MESH_VERTEX_CACHE_SIZE, tri[1]) +
+           mesh_cache_miss(timestamps, time, MESH_VERTEX_CACHE_SIZE, tri[2]);
+}
+
+struct mesh_cache_stats mesh_cache_stats(uint index_count, const uint *indices, uint vertex_count, allocator *temp)
+{
+    struct mesh_cache_stats ret = {};
+    if (!index_count)
+        return ret;
+
+    uint *timestamps = sallocate(temp, *timestamps, vertex_count);
+    uint64 *referenced = new_bitset(vertex_count, temp);
+    smemset(timestamps, 0, *timestamps, vertex_count);
+
+    uint time = MESH_VERTEX_CACHE_SIZE;
+    uint misses = 0;
+    for(uint i = 0; i < index_count; i += 3)
+        misses += mesh_triangle_misses(timestamps, &time, indices + i);
+    for(uint i = 0; i < index_count; ++i)
+        bitset_set(referenced, indices[i]);
+
+    ret.acmr = misses / (index_count / 3.0f);
+    ret.atvr = misses / (float)bitset_count(referenced, vertex_count);
+    return ret;
+}
+
+float mesh_fetch_stats(uint index_count, const uint *indices, uint vertex_count, uint vertex_size, allocator *temp)
+{
+    if (!index_count)
+        return 0;
+
+    uint line_count = ((uint64)vertex_count * vertex_size + MESH_FETCH_LINE_SIZE - 1) / MESH_FETCH_LINE_SIZE;
+    uint *timestamps = sallocate(temp, *timestamps, line_count);
+    uint64 *referenced = new_bitset(vertex_count, temp);
+    smemset(timestamps, 0, *timestamps, line_count);
+
+    uint time = MESH_FETCH_CACHE_LINES;
+    uint lines = 0;
+    for(uint i = 0; i < index_count; ++i) {
+        uint64 begin = (uint64)indices[i] * vertex_size;
+        uint64 end = begin + vertex_size - 1;
+        for(uint64 l = begin / MESH_FETCH_LINE_SIZE; l <= end / MESH_FETCH_LINE_SIZE; ++l)
+            lines += mesh_cache_miss(timestamps, &time, MESH_FETCH_CACHE_LINES, l);
+        bitset_set(referenced, indices[i]);
+    }
+    return (float)lines * MESH_FETCH_LINE_SIZE / ((float)bitset_count(referenced, vertex_count) * vertex_size);
+}
+
+// The triangles using each vertex, in index order: offsets[v] to offsets[v+1]
+// index 'ret_triangles'.
+static uint* mesh_vertex_triangles(uint index_count, const uint *indices, uint vertex_count,
+                                   allocator *temp, uint **ret_triangles)
+{
+    uint *o = sallocate(temp, *o, vertex_count + 2);
+    uint *t = sallocate(temp, *t, index_count);
+    memset(o, 0, sizeof(*o) * (vertex_count + 2));
+
+    for(uint i = 0; i < index_count; ++i)
+        o[indices[i] + 2]++;
+    for(uint v = 2; v < vertex_count + 2; ++v)
+        o[v] += o[v - 1];
+    for(uint i = 0; i < index_count; ++i)
+        t[o[indices[i] + 1]++] = i / 3;
+
+    *ret_triangles = t;
+    return o;
+}
+
+void mesh_optimize_vertex_cache(uint index_count, uint *indices, uint vertex_count, allocator *temp)
+{
+    assert(index_count % 3 == 0);
+    if (!index_count)
+        return;
+
+    const int k = MESH_VERTEX_CACHE_SIZE;
+    uint tri_count = index_count / 3;
+
+    uint *adj;
+    uint *adj_offsets = mesh_vertex_triangles(index_count, indices, vertex_count, temp, &adj);
+    uint *live = sallocate(temp, *live, vertex_count);
+    uint *timestamps = sallocate(temp, *timestamps, vertex_count);
+    uint *dead_end = sallocate(temp, *dead_end, index_count);
+    uint *out = sallocate(temp, *out, index_count);
+    uint64 *emitted = new_bitset(tri_count, temp);
+
+    for(uint v = 0; v < vertex_count; ++v)
+        live[v] = adj_offsets[v + 1] - adj_offsets[v];
+    smemset(timestamps, 0, *timestamps, vertex_count);
+
+    int time = k + 1;
+    uint cursor = 0;
+    uint dead_end_count = 0;
+    uint out_count = 0;
+
+    uint fan = 0;
+    while(fan < vertex_count && !live[fan])
+        fan++;
+
+    while(fan != Max_u32) {
+        uint candidates = dead_end_count;
+        for(uint i = adj_offsets[fan]; i < adj_offsets[fan + 1]; ++i) {
+            uint t = adj[i];
+            if (bitset_test(emitted, t))
+                continue;
+            bitset_set(emitted, t);
+            for(uint c = 0; c < 3; ++c) {
+                uint v = indices[t * 3 + c];
+                out[out_count++] = v;
+                dead_end[dead_end_count++] = v;
+                live[v]--;
+                if (time - (int)timestamps[v] > k)
+                    timestamps[v] = time++;
+            }
+        }
+
+        // The oldest of the fan's vertices that will still be in the cache
+        // once its own remaining triangles are emitted, else any of them with
+        // triangles left.
+        fan = Max_u32;
+        int best = -1;
+        for(uint i = candidates; i < dead_end_count; ++i) {
+            uint v = dead_end[i];
+            if (!live[v])
+                continue;
+            int p = 0;
+            if (time - (int)timestamps[v] + 2 * (int)live[v] <= k)
+                p = time - (int)timestamps[v];
+            if (p > best) {
+                best = p;
+                fan = v;
+            }
+        }
+        if (fan != Max_u32)
+            continue;
+
+        // Dead end: the most recent vertex with triangles left, else the next
+        // in input order.
+        while(dead_end_count) {
+            uint v = dead_end[--dead_end_count];
+            if (live[v]) {
+                fan = v;
+                break;
+            }
+        }
+        while(fan == Max_u32 && cursor < vertex_count) {
+            if (live[cursor])
+                fan = cursor;
+            cursor++;
+        }
+    }
+    assert(out_count == index_count);
+    memcpy(indices, out, sizeof(*indices) * index_count);
+}
+
+struct mesh_overdraw_cluster {
+    uint  begin; // first triangle
+    uint  end;
+    float key;
+};
+
+static int mesh_overdraw_cluster_cmp(const void *a, const void *b)
+{
+    const struct mesh_overdraw_cluster *x = a;
+    const struct mesh_overdraw_cluster *y = b;
+    if (x->key != y->key)
+        return x->key > y->key ? -1 : 1;
+    return x->begin < y->begin ? -1 : 1;
+}
+
+static inline const float* mesh_position(const float *positions, uint vertex_stride, uint v)
+{
+    return (const float*)((const char*)positions + (uint64)v * vertex_stride);
+}
+
+void mesh_optimize_overdraw(uint index_count, uint *indices, uint vertex_count, uint vertex_stride,
+                            const float *positions, float threshold, allocator *temp)
+{
+    assert(index_count % 3 == 0);
+    uint tri_count = index_count / 3;
+    if (tri_count < 2)
+        return;
+
+    uint *timestamps = sallocate(temp, *timestamps, vertex_count);
+    struct mesh_overdraw_cluster *clusters = sallocate(temp, *clusters, tri_count);
+    smemset(timestamps, 0, *timestamps, vertex_count);
+
+    // Hard boundaries, where a triangle misses on all three vertices and so
+    // the order before it does not matter to the cache.
+    uint *hard = sallocate(temp, *hard, tri_count + 1);
+    uint hard_count = 0;
+    uint time = MESH_VERTEX_CACHE_SIZE;
+    for(uint t = 0; t < tri_count; ++t)
+        if (mesh_triangle_misses(timestamps, &time, indices + t * 3) == 3 || t == 0)
+            hard[hard_count++] = t;
+    hard[hard_count] = tri_count;
+
+    // Soft boundaries, wherever the cluster so far is already as cache
+    // friendly as the hard cluster it is part of.
+    uint cluster_count = 0;
+    for(uint h = 0; h < hard_count; ++h) {
+        uint begin = hard[h];
+        uint end = hard[h + 1];
+
+        time += MESH_VERTEX_CACHE_SIZE;
+        uint misses = 0;
+        for(uint t = begin; t < end; ++t)
+            misses += mesh_triangle_misses(timestamps, &time, indices + t * 3);
+        float limit = misses / (float)(end - begin) * threshold;
+
+        time += MESH_VERTEX_CACHE_SIZE;
+        misses = 0;
+        for(uint t = begin; t < end; ++t) {
+            misses += mesh_triangle_misses(timestamps, &time, indices + t * 3);
+            if (t + 1 < end && misses <= limit * (t + 1 - begin)) {
+                clusters[cluster_count++] = (struct mesh_overdraw_cluster) {.begin = begin, .end = t + 1};
+                begin = t + 1;
+                time += MESH_VERTEX_CACHE_SIZE;
+                misses = 0;
+            }
+        }
+        clusters[cluster_count++] = (struct mesh_overdraw_cluster) {.begin = begin, .end = end};
+    }
+    if (cluster_count == 1)
+        return;
+
+    // Area weighted centroids and normals. The cross product is twice the
+    // area along the normal, so its length is the weight. The key is
+    // dot(centroid - mesh centroid, normal), but the mesh centroid is only
+    // known at the end, so dot(mesh centroid, normal) is subtracted then.
+    float *normals = sallocate(temp, float, cluster_count * 3);
+    float mesh_centroid[3] = {};
+    float mesh_area = 0;
+    for(uint c = 0; c < cluster_count; ++c) {
+        float n[3] = {}, p[3] = {}, area = 0;
+        for(uint t = clusters[c].begin; t < clusters[c].end; ++t) {
+            const float *a = mesh_position(positions, vertex_stride, indices[t * 3 + 0]);
+            const float *b = mesh_position(positions, vertex_stride, indices[t * 3 + 1]);
+            const float *d = mesh_position(positions, vertex_stride, indices[t * 3 + 2]);
+            float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            float e2[3] = {d[0] - a[0], d[1] - a[1], d[2] - a[2]};
+            float x[3] = {
+                e1[1] * e2[2] - e1[2] * e2[1],
+                e1[2] * e2[0] - e1[0] * e2[2],
+                e1[0] * e2[1] - e1[1] * e2[0],
+            };
+            float w = sqrtf(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+            for(uint i = 0; i < 3; ++i) {
+                n[i] += x[i];
+                p[i] += (a[i] + b[i] + d[i]) * (1 / 3.0f) * w;
+            }
+            area += w;
+        }
+
+        float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        clusters[c].key = 0;
+        for(uint i = 0; i < 3; ++i) {
+            normals[c * 3 + i] = len > 0 ? n[i] / len : 0;
+            clusters[c].key += normals[c * 3 + i] * (area > 0 ? p[i] / area : 0);
+            mesh_centroid[i] += p[i];
+        }
+        mesh_area += area;
+    }
+    if (mesh_area > 0)
+        for(uint i = 0; i < 3; ++i)
+            mesh_centroid[i] /= mesh_area;
+    for(uint c = 0; c < cluster_count; ++c)
+        for(uint i = 0; i < 3; ++i)
+            clusters[c].key -= normals[c * 3 + i] * mesh_centroid[i];
+
+    qsort(clusters, cluster_count, sizeof(*clusters), mesh_overdraw_cluster_cmp);
+
+    uint *out = sallocate(temp, *out, index_count);
+    uint out_count = 0;
+    for(uint c = 0; c < cluster_count; ++c) {
+        uint count = (clusters[c].end - clusters[c].begin) * 3;
+        memcpy(out + out_count, indices + clusters[c].begin * 3, sizeof(*out) * count);
+        out_count += count;
+    }
+    memcpy(indices, out, sizeof(*indices) * index_count);
+}
+
+uint mesh_optimize_vertex_fetch(uint index_count, uint *indices, uint vertex_count, uint *ret_remap)
+{
+    memset(ret_remap, 0xff, sizeof(*ret_remap) * vertex_count);
+    uint next = 0;
+    for(uint i = 0; i < index_count; ++i) {
+        uint v = indices[i];
+        if (ret_remap[v] == Max_u32)
+            ret_remap[v] = next++;
+        indices[i] = ret_remap[v];
+    }
+    uint ret = next;
+    for(uint v = 0; v < vertex_count; ++v)
+        if (ret_remap[v] == Max_u32)
+            ret_remap[v] = next++;
+    return ret;
+}
+
+void mesh_remap_vertices(uint vertex_count, const uint *remap, uint stride, uint size, char *data, allocator *temp)
+{
+    char *copy = allocate(temp, (uint64)vertex_count * size);
+    for(uint v = 0; v < vertex_count; ++v)
+        memcpy(copy + (uint64)v * size, data + (uint64)v * stride, size);
+    for(uint v = 0; v < vertex_count; ++v)
+        memcpy(data + (uint64)remap[v] * stride, copy + (uint64)v * size, size);
+}
+
+void mesh_position_bounds(uint vertex_count, uint vertex_stride, const float *positions,
+                          float ret_min[3], float ret_max[3])
+{
+    for(uint c = 0; c < 3; ++c) {
+        ret_min[c] = vertex_count ? Max_f32 : 0;
+        ret_max[c] = vertex_count ? -Max_f32 : 0;
+    }
+    for(uint v = 0; v < vertex_count; ++v) {
+        const float *p = mesh_position(positions, vertex_stride, v);
+        for(uint c = 0; c < 3; ++c) {
+            ret_min[c] = p[c] < ret_min[c] ? p[c] : ret_min[c];
+            ret_max[c] = p[c] > ret_max[c] ? p[c] : ret_max[c];
+        }
+    }
+}
+
+static inline void mesh_store_norm(void *out, uint i, uint bits, int q)
+{
+    if (bits == 8)
+        ((uint8*)out)[i] = q;
+    else
+        ((uint16*)out)[i] = q;
+}
+
+float mesh_quantize_unorm(uint count, uint stride, const float *data, uint in_count, uint out_count,
+                          uint bits, const float *offset, float scale, void *out)
+{
+    assert(in_count <= out_count && (bits == 8 || bits == 16));
+    float max = (1 << bits) - 1;
+    float inv = scale ? max / scale : 0;
+    float err = 0;
+    for(uint i = 0; i < count; ++i) {
+        const float *f = (const float*)((const char*)data + (uint64)i * stride);
+        for(uint c = 0; c < out_count; ++c) {
+            float q = c < in_count ? clamp((f[c] - offset[c]) * inv, 0, max) : 0;
+            int r = (int)(q + 0.5f);
+            mesh_store_norm(out, i * out_count + c, bits, r);
+            if (c < in_count) {
+                float e = fabsf(r / max * scale + offset[c] - f[c]);
+                err = e > err ? e : err;
+            }
+        }
+    }
+    return err;
+}
+
+float mesh_quantize_snorm(uint count, uint stride, const float *data, uint in_count, uint out_count,
+                          uint bits, void *out)
+{
+    assert(in_count <= out_count && (bits == 8 || bits == 16));
+    float max = (1 << (bits - 1)) - 1;
+    float err = 0;
+    for(uint i = 0; i < count; ++i) {
+        const float *f = (const float*)((const char*)data + (uint64)i * stride);
+        for(uint c = 0; c < out_count; ++c) {
+            int r = c < in_count ? (int)roundf(clamp(f[c], -1, 1) * max) : 0;
+            mesh_store_norm(out, i * out_count + c, bits, r);
+            if (c < in_count) {
+                float e = fabsf(r / max - f[c]);
+                err = e > err ? e : err;
+            }
+        }
+    }
+    return err;
+}
+
+static inline void mesh_triangle_normal(const float *a, const float *b, const float *c, float *n)
+{
+    float e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    float e1[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+    n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+    n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+    float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    float inv = len > 0 ? 1 / len : 0;
+    n[0] *= inv;
+    n[1] *= inv;
+    n[2] *= inv;
+}
+
+// The sphere is centered on the bounding box, which is close enough to the
+// smallest for the compact clusters that a cache optimized order makes. The
+// cone is as in meshoptimizer: the axis is the mean normal, and the apex is
+// moved back along it until it is behind every triangle, so that an eye
+// inside the cone around it sees only back faces.
+static void mesh_cluster_bounds(struct mesh_cluster *c, const uint *indices, uint vertex_stride, const float *positions)
+{
+    float min[3] = {Max_f32, Max_f32, Max_f32};
+    float max[3] = {-Max_f32, -Max_f32, -Max_f32};
+    float axis[3] = {0, 0, 0};
+    uint i, j;
+    for(i = 0; i < c->triangle_count * 3; i += 3) {
+        const float *p[3];
+        for(j = 0; j < 3; ++j) {
+            p[j] = mesh_position(positions, vertex_stride, indices[i + j]);
+            for(uint k = 0; k < 3; ++k) {
+                min[k] = p[j][k] < min[k] ? p[j][k] : min[k];
+                max[k] = p[j][k] > max[k] ? p[j][k] : max[k];
+            }
+        }
+        float n[3];
+        mesh_triangle_normal(p[0], p[1], p[2], n);
+        for(j = 0; j < 3; ++j)
+            axis[j] += n[j];
+    }
+    float radius = 0;
+    for(j = 0; j < 3; ++j)
+        c->center[j] = (min[j] + max[j]) * 0.5f;
+    for(i = 0; i < c->triangle_count * 3; ++i) {
+        const float *p = mesh_position(positions, vertex_stride, indices[i]);
+        float d[3] = {p[0] - c->center[0], p[1] - c->center[1], p[2] - c->center[2]};
+        float r = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        radius = r > radius ? r : radius;
+    }
+    c->radius = sqrtf(radius);
+
+    float len = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    float inv = len > 0 ? 1 / len : 0;
+    float min_dot = len > 0 ? 1 : -1;
+    for(j = 0; j < 3; ++j)
+        axis[j] *= inv;
+    for(i = 0; i < c->triangle_count * 3; i += 3) {
+        float n[3];
+        mesh_triangle_normal(mesh_position(positions, vertex_stride, indices[i]),
+                             mesh_position(positions, vertex_stride, indices[i + 1]),
+                             mesh_position(positions, vertex_stride, indices[i + 2]), n);
+        float d = n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2];
+        min_dot = d < min_dot ? d : min_dot;
+    }
+
+    // Past about 84 degrees from the axis the apex would be too far back to
+    // ever cull anything.
+    if (min_dot <= 0.1f) {
+        memcpy(c->cone_apex, c->center, sizeof(c->cone_apex));
+        memset(c->cone_axis, 0, sizeof(c->cone_axis));
+        c->cone_cutoff = 1;
+        return;
+    }
+    float max_t = 0;
+    for(i = 0; i < c->triangle_count * 3; i += 3) {
+        const float *a = mesh_position(positions, vertex_stride, indices[i]);
+        float n[3];
+        mesh_triangle_normal(a, mesh_position(positions, vertex_stride, indices[i + 1]),
+                             mesh_position(positions, vertex_stride, indices[i + 2]), n);
+        float dc = (c->center[0] - a[0]) * n[0] + (c->center[1] - a[1]) * n[1] + (c->center[2] - a[2]) * n[2];
+        float dn = axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2];
+        float t = dn > 0 ? dc / dn : 0;
+        max_t = t > max_t ? t : max_t;
+    }
+    for(j = 0; j < 3; ++j) {
+        c->cone_apex[j] = c->center[j] - axis[j] * max_t;
+        c->cone_axis[j] = axis[j];
+    }
+    c->cone_cutoff = sqrtf(1 - min_dot * min_dot);
+}
+
+// Vertices of 'tri' not yet in 'cluster', counting a repeated vertex once.
+static inline uint mesh_new_vertices(const uint *clusters, uint cluster, const uint *tri)
+{
+    return (clusters[tri[0]] != cluster) +
+           (clusters[tri[1]] != cluster && tri[1] != tri[0]) +
+           (clusters[tri[2]] != cluster && tri[2] != tri[0] && tri[2] != tri[1]);
+}
+
+uint mesh_build_clusters(uint index_count, const uint *indices, uint vertex_count, uint vertex_stride,
+                         const float *positions, struct mesh_cluster *ret, allocator *temp)
+{
+    // The cluster each vertex was last added to.
+    uint *cluster = sallocate(temp, *cluster, vertex_count);
+    memset(cluster, 0xff, sizeof(*cluster) * vertex_count);
+
+    uint count = 0;
+    uint first = 0;
+    uint vertices = 0;
+    uint triangle_count = index_count / 3;
+    for(uint t = 0; t <= triangle_count; ++t) {
+        const uint *tri = indices + t * 3;
+        uint add = t < triangle_count ? mesh_new_vertices(cluster, count, tri) : 0;
+
+        if (t == triangle_count || vertices + add > MESH_CLUSTER_MAX_VERTICES ||
+            t - first == MESH_CLUSTER_MAX_TRIANGLES)
+        {
+            if (t > first) {
+                ret[count] = (struct mesh_cluster) {
+                    .first_index = first * 3,
+                    .triangle_count = t - first,
+                    .vertex_count = vertices,
+                };
+                mesh_cluster_bounds(&ret[count], indices + first * 3, vertex_stride, positions);
+                count++;
+            }
+            if (t == triangle_count)
+                break;
+            first = t;
+            vertices = 0;
+            add = mesh_new_vertices(cluster, count, tri);
+        }
+        for(uint c = 0; c < 3; ++c)
+            cluster[tri[c]] = count;
+        vertices += add;
+    }
+    assert(count <= mesh_cluster_bound(index_count));
+    return count;
+}
+
+#if TEST
+static void test_mesh_optimize(test_suite *suite);
+static void test_mesh_quantize(test_suite *suite);
+static void test_mesh_clusters(test_suite *suite);
+static void test_mesh_bitset(test_suite *suite);
+
+void test_mesh(test_suite *suite)
+{
+    test_mesh_optimize(suite);
+    test_mesh_quantize(suite);
+    test_mesh_clusters(suite);
+    test_mesh_bitset(suite);
+}
+
+// Each triangle rotated so that its smallest index is first, which keeps its
+// winding, packed so that the triangles can be compared as a sorted list.
+static int test_mesh_triangle_cmp(const void *a, const void *b)
+{
+    uint64 x = *(const uint64*)a;
+    uint64 y = *(const uint64*)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint64* test_mesh_triangle_keys(uint index_count, const uint *indices, const uint *remap, allocator *alloc)
+{
+    uint64 *ret = sallocate(alloc, *ret, index_count / 3);
+    for(uint t = 0; t < index_count / 3; ++t) {
+        uint v[3];
+        for(uint c = 0; c < 3; ++c)
+            v[c] = remap ? remap[indices[t * 3 + c]] : indices[t * 3 + c];
+        uint r = v[0] <= v[1] && v[0] <= v[2] ? 0 : v[1] <= v[2] ? 1 : 2;
+        ret[t] = (uint64)v[r] << 42 | (uint64)v[(r + 1) % 3] << 21 | v[(r + 2) % 3];
+    }
+    qsort(ret, index_count / 3, sizeof(*ret), test_mesh_triangle_cmp);
+    return ret;
+}
+
+static void test_mesh_optimize(test_suite *suite)
+{
+    BEGIN_TEST_MODULE("mesh_optimize", false, false);
+
+    // A grid with its quads shuffled, so that the input order is bad for
+    // every cache.
+    uint n = 64;
+    uint vc = (n + 1) * (n + 1);
+    uint ic = n * n * 6;
+    float *positions = sallocate(suite->alloc, float, vc * 3);
+    uint *indices = sallocate(suite->alloc, uint, ic);
+    uint *original = sallocate(suite->alloc, uint, ic);
+    for(uint y = 0; y <= n; ++y)
+        for(uint x = 0; x <= n; ++x) {
+            float *p = positions + (y * (n + 1) + x) * 3;
+            p[0] = x;
+            p[1] = y;
+            p[2] = sinf(x * 0.3f) * 4;
+        }
+    for(uint y = 0; y < n; ++y)
+        for(uint x = 0; x < n; ++x) {
+            // An odd multiplier is a permutation of the quads, as n is a power of two.
+            uint *q = indices + ((y * n + x) * 2654435761u & (n * n - 1)) * 6;
+            uint i = y * (n + 1) + x;
+            q[0] = i;     q[1] = i + 1;     q[2] = i + n + 2;
+            q[3] = i;     q[4] = i + n + 2; q[5] = i + n + 1;
+        }
+    memcpy(original, indices, sizeof(*indices) * ic);
+    uint64 *before = test_mesh_triangle_keys(ic, indices, NULL, suite->alloc);
+
+    struct mesh_cache_stats s0 = mesh_cache_stats(ic, indices, vc, suite->alloc);
+    mesh_optimize_vertex_cache(ic, indices, vc, suite->alloc);
+    struct mesh_cache_stats s1 = mesh_cache_stats(ic, indices, vc, suite->alloc);
+    TEST_EQ("acmr", s1.acmr < s0.acmr, true, false);
+    TEST_EQ("acmr bound", s1.acmr < 0.8f, true, false);
+    TEST_EQ("atvr", s1.atvr < 1.5f, true, false);
+    TEST_EQ("same triangles", memcmp(before, test_mesh_triangle_keys(ic, indices, NULL, suite->alloc),
+                                     sizeof(*before) * ic / 3), 0, false);
+
+    mesh_optimize_overdraw(ic, indices, vc, 12, positions, MESH_OVERDRAW_THRESHOLD, suite->alloc);
+    struct mesh_cache_stats s2 = mesh_cache_stats(ic, indices, vc, suite->alloc);
+    TEST_EQ("overdraw acmr", s2.acmr < s1.acmr * MESH_OVERDRAW_THRESHOLD + 0.01f, true, false);
+    TEST_EQ("overdraw same triangles", memcmp(before, test_mesh_triangle_keys(ic, indices, NULL, suite->alloc),
+                                              sizeof(*before) * ic / 3), 0, false);
+
+    // Renumbered vertices must still make the same triangles once mapped
+    // back, and the data must have moved with them.
+    float f0 = mesh_fetch_stats(ic, indices, vc, 12, suite->alloc);
+    uint *remap = sallocate(suite->alloc, uint, vc);
+    uint *unmap = sallocate(suite->alloc, uint, vc);
+    float *moved = sallocate(suite->alloc, float, vc * 3);
+    memcpy(moved, positions, sizeof(*moved) * vc * 3);
+    TEST_EQ("referenced", mesh_optimize_vertex_fetch(ic, indices, vc, remap), vc, false);
+    mesh_remap_vertices(vc, remap, 12, 12, (char*)moved, suite->alloc);
+    for(uint v = 0; v < vc; ++v)
+        unmap[remap[v]] = v;
+    TEST_EQ("fetch same triangles", memcmp(before, test_mesh_triangle_keys(ic, indices, unmap, suite->alloc),
+                                           sizeof(*before) * ic / 3), 0, false);
+    TEST_EQ("fetch moved", memcmp(moved + remap[n + 2] * 3, positions + (n + 2) * 3, 12), 0, false);
+    TEST_EQ("fetch", mesh_fetch_stats(ic, indices, vc, 12, suite->alloc) < f0, true, false);
+    TEST_EQ("fetch first", indices[0], 0, false);
+
+    END_TEST_MODULE();
+}
+
+static void test_mesh_quantize(test_suite *suite)
+{
+    BEGIN_TEST_MODULE("mesh_quantize", false, false);
+
+    // Positions every 16 bytes, as if interleaved with something else.
+    float p[] = {
+        -2, 1, 0.5f, 9,
+         6, 3, 0.5f, 9,
+         0, 2, 1.25f, 9,
+    };
+    float min[3], max[3];
+    mesh_position_bounds(3, 16, p, min, max);
+    TEST_FEQ("min x", min[0], -2, false);
+    TEST_FEQ("max z", max[2], 1.25f, false);
+
+    uint16 q[12];
+    float err = mesh_quantize_unorm(3, 16, p, 3, 4, 16, min, 8, q);
+    TEST_EQ("unorm error", err <= 8.0f / 65535, true, false);
+    TEST_EQ("unorm min", q[0], 0, false);
+    TEST_EQ("unorm max", q[4], 65535, false);
+    TEST_EQ("unorm pad", q[7], 0, false);
+    TEST_EQ("unorm y", q[5], (uint)(2.0f / 8 * 65535 + 0.5f), false);
+
+    float uv[] = {0, 1, 0.5f, 1.5f};
+    err = mesh_quantize_unorm(2, 8, uv, 2, 2, 16, (float[]){0, 0}, 1, q);
+    TEST_EQ("unorm clamped", q[3], 65535, false);
+    TEST_FEQ("unorm clamped error", err, 0.5f, false);
+
+    float n[] = {0, -1, 0, 0.6f, 0.8f, 0};
+    int8 b[8];
+    err = mesh_quantize_snorm(2, 12, n, 3, 4, 8, b);
+    TEST_EQ("snorm error", err <= 0.5f / 127 + FLOAT_ERROR, true, false);
+    TEST_EQ("snorm -1", b[1], -127, false);
+    TEST_EQ("snorm 0.8", b[5], 102, false);
+    TEST_EQ("snorm pad", b[7], 0, false);
+
+    int16 s[8];
+    err = mesh_quantize_snorm(2, 12, n, 3, 4, 16, s);
+    TEST_EQ("snorm 16 error", err <= 0.5f / 32767 + FLOAT_ERROR, true, false);
+    TEST_EQ("snorm 16 -1", s[1], -32767, false);
+
+    END_TEST_MODULE();
+}
+
+static void test_mesh_clusters(test_suite *suite)
+{
+    BEGIN_TEST_MODULE("mesh_clusters", false, false);
+
+    // A flat grid facing +z, in cache order.
+    uint n = 64;
+    uint vc = (n + 1) * (n + 1);
+    uint ic = n * n * 6;
+    float *positions = sallocate(suite->alloc, float, vc * 3);
+    uint *indices = sallocate(suite->alloc, uint, ic);
+    for(uint y = 0; y <= n; ++y)
+        for(uint x = 0; x <= n; ++x) {
+            float *p = positions + (y * (n + 1) + x) * 3;
+            p[0] = x;
+            p[1] = y;
+            p[2] = 0;
+        }
+    for(uint y = 0; y < n; ++y)
+        for(uint x = 0; x < n; ++x) {
+            uint *q = indices + (y * n + x) * 6;
+            uint i = y * (n + 1) + x;
+            q[0] = i;     q[1] = i + 1;     q[2] = i + n + 2;
+            q[3] = i;     q[4] = i + n + 2; q[5] = i + n + 1;
+        }
+    mesh_optimize_vertex_cache(ic, indices, vc, suite->alloc);
+
+    struct mesh_cluster *clusters = sallocate(suite->alloc, struct mesh_cluster, mesh_cluster_bound(ic));
+    uint count = mesh_build_clusters(ic, indices, vc, 12, positions, clusters, suite->alloc);
+    TEST_EQ("count", count > ic / 3 / MESH_CLUSTER_MAX_TRIANGLES, true, false);
+
+    // Every triangle in order, within the limits and the spheres.
+    uint next = 0;
+    bool limits = true, inside = true, facing = true;
+    float below[3] = {32, 32, -10};
+    float above[3] = {32, 32, 10};
+    for(uint i = 0; i < count; ++i) {
+        struct mesh_cluster *c = &clusters[i];
+        TEST_EQ("contiguous", c->first_index, next, false);
+        next += c->triangle_count * 3;
+        limits = limits && c->triangle_count <= MESH_CLUSTER_MAX_TRIANGLES &&
+                 c->vertex_count <= MESH_CLUSTER_MAX_VERTICES && c->vertex_count >= 3;
+        for(uint j = 0; j < c->triangle_count * 3; ++j) {
+            float *p = positions + indices[c->first_index + j] * 3;
+            float d[3] = {p[0] - c->center[0], p[1] - c->center[1], p[2] - c->center[2]};
+            inside = inside && sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) <= c->radius + 0.0001f;
+        }
+        facing = facing && mesh_cluster_backfacing(c, below) && !mesh_cluster_backfacing(c, above);
+    }
+    TEST_EQ("every triangle", next, ic, false);
+    TEST_EQ("limits", limits, true, false);
+    TEST_EQ("spheres", inside, true, false);
+    TEST_EQ("cones", facing, true, false);
+
+    // Faces at right angles can still all face away, but a two sided
+    // triangle never can.
+    float corner[] = {0,0,0, 1,0,0, 0,1,0, 0,0,1};
+    uint corner_indices[] = {0,1,2, 0,3,1};
+    uint two_sided_indices[] = {0,1,2, 0,2,1};
+    float behind[3] = {0.2f, -5, -5};
+    mesh_build_clusters(6, corner_indices, 4, 12, corner, clusters, suite->alloc);
+    TEST_EQ("corner", mesh_cluster_backfacing(&clusters[0], behind), true, false);
+    TEST_EQ("corner front", mesh_cluster_backfacing(&clusters[0], above), false, false);
+    mesh_build_clusters(6, two_sided_indices, 4, 12, corner, clusters, suite->alloc);
+    TEST_FEQ("two sided cutoff", clusters[0].cone_cutoff, 1, false);
+    TEST_EQ("two sided", mesh_cluster_backfacing(&clusters[0], behind), false, false);
+
+    END_TEST_MODULE();
+}
+
+// Check the scans of bitset.h against a bit at a time walk of 'set'.
+static bool test_mesh_bitset_scans(const uint64 *set, uint bit_count)
+{
+    uint count = 0;
+    uint next = Max_u32;
+    for(uint i = bit_count; i-- > 0;) {
+        if (bitset_test(set, i)) {
+            count++;
+            next = i;
+        }
+        if (bitset_next(set, bit_count, i) != next)
+            return false;
+    }
+    return bitset_count(set, bit_count) == count &&
+           bitset_is_zero(set, bit_count) == !count &&
+           bitset_next(set, bit_count, bit_count) == Max_u32;
+}
+
+static void test_mesh_bitset(test_suite *suite)
+{
+    BEGIN_TEST_MODULE("bitset", false, false);
+
+    // Sizes either side of the word and lane edges.
+    uint sizes[] = {0, 1, 63, 64, 65, 127, 128, 129, 191, 192, 255, 256, 257, 1000};
+    uint edges[] = {0, 1, 62, 63, 64, 65, 126, 127, 128, 129, 191, 192, 255, 256, 999};
+    uint64 *set = new_bitset(1000, suite->alloc);
+
+    for(uint s = 0; s < carrlen(sizes); ++s) {
+        uint n = sizes[s];
+        TEST_EQ("word_count", bitset_word_count(n) % BITSET_LANE_WORDS, 0, false);
+        TEST_EQ("word_count.min", bitset_word_count(n) >= BITSET_LANE_WORDS, true, false);
+
+        bitset_zero(set, n);
+        TEST_EQ("empty.is_zero", bitset_is_zero(set, n), true, false);
+        TEST_EQ("empty.count", bitset_count(set, n), 0, false);
+        TEST_EQ("empty.next", bitset_next(set, n, 0), Max_u32, false);
+
+        // One bit at each edge, then each edge added to the last.
+        for(uint e = 0; e < carrlen(edges) && edges[e] < n; ++e) {
+            bitset_zero(set, n);
+            bitset_set(set, edges[e]);
+            TEST_EQ("one.scans", test_mesh_bitset_scans(set, n), true, false);
+            TEST_EQ("one.next", bitset_next(set, n, 0), edges[e], false);
+            TEST_EQ("one.next_after", bitset_next(set, n, edges[e] + 1), Max_u32, false);
+        }
+        bitset_zero(set, n);
+        for(uint e = 0; e < carrlen(edges) && edges[e] < n; ++e) {
+            bitset_set(set, edges[e]);
+            TEST_EQ("edges.scans", test_mesh_bitset_scans(set, n), true, false);
+        }
+
+        // Full, then emptied a bit at a time from the front.
+        for(uint i = 0; i < n; ++i)
+            bitset_set(set, i);
+        TEST_EQ("full.count", bitset_count(set, n), n, false);
+        bool ok = true;
+        for(uint i = 0; i < n; ++i) {
+            ok = ok && bitset_next(set, n, 0) == i;
+            bitset_clear(set, i);
+        }
+        TEST_EQ("full.drain", ok, true, false);
+        TEST_EQ("full.is_zero", bitset_is_zero(set, n), true, false);
+
+        // Sparse and dense random sets.
+        uint rng = n + 1;
+        for(uint density = 1; density < 32; density *= 4) {
+            bitset_zero(set, n);
+            for(uint i = 0; i < n; ++i) {
+                rng = rng * 1664525 + 1013904223;
+                bitset_set_if(set, i, (rng >> 27) < density);
+            }
+            TEST_EQ("random.scans", test_mesh_bitset_scans(set, n), true, false);
+        }
+    }
+
+    deallocate(suite->alloc, set);
+
+    END_TEST_MODULE();
+}
+#endif
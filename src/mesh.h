@@ -0,0 +1,127 @@
+#ifndef SOL_MESH_H_INCLUDE_GUARD_
+#define SOL_MESH_H_INCLUDE_GUARD_
+
+#include "defs.h"
+#include "allocator.h"
+#include "test.h"
+
+// Reordering of triangle list index buffers and their vertices, for the
+// post transform vertex cache, overdraw and vertex fetch. Indices are always
+// u32 and rewritten in place; 'vertex_count' is the count of the vertex
+// buffers which they index.
+
+// FIFO size assumed by Tipsify and simulated for the statistics. Small
+// enough to be a fair model of recent hardware.
+#define MESH_VERTEX_CACHE_SIZE 16
+
+// Simulated for mesh_fetch_stats: 16KB of 64 byte lines.
+#define MESH_FETCH_LINE_SIZE 64
+#define MESH_FETCH_CACHE_LINES 256
+
+// How much worse than a cluster's own ACMR mesh_optimize_overdraw may make it
+// by splitting it further.
+#define MESH_OVERDRAW_THRESHOLD 1.05f
+
+struct mesh_cache_stats {
+    float acmr; // cache misses per triangle: 3 at worst, about 0.5 for a regular grid
+    float atvr; // cache misses per referenced vertex: 1 at best
+};
+
+struct mesh_cache_stats mesh_cache_stats(uint index_count, const uint *indices, uint vertex_count, allocator *temp);
+
+// Bytes read per byte of referenced vertex data, for vertices of 'vertex_size'
+// bytes packed back to back: 1 at best.
+float mesh_fetch_stats(uint index_count, const uint *indices, uint vertex_count, uint vertex_size, allocator *temp);
+
+// Tipsify (Sander et al. 2007): fan around each vertex in turn, then continue
+// from the oldest vertex that will still be in the cache.
+void mesh_optimize_vertex_cache(uint index_count, uint *indices, uint vertex_count, allocator *temp);
+
+// Split the triangles into clusters where the cache is already cold, and then
+// further while each cluster's ACMR stays within 'threshold' of the whole
+// cluster's. Clusters are ordered by how much they face away from the center
+// of the mesh, so that the outside of a convex-ish mesh is drawn first. Call
+// after mesh_optimize_vertex_cache. 'positions' are three floats every
+// 'vertex_stride' bytes.
+void mesh_optimize_overdraw(uint index_count, uint *indices, uint vertex_count, uint vertex_stride,
+                            const float *positions, float threshold, allocator *temp);
+
+// Renumber vertices in the order that the indices first use them, then the
+// unreferenced vertices in their original order. ret_remap[old] is the new
+// index of each vertex. Returns the referenced vertex count.
+uint mesh_optimize_vertex_fetch(uint index_count, uint *indices, uint vertex_count, uint *ret_remap);
+
+// Move each element of 'size' bytes every 'stride' bytes to its index in
+// 'remap'. Bytes between elements are untouched, so interleaved attributes can
+// be moved one at a time.
+void mesh_remap_vertices(uint vertex_count, const uint *remap, uint stride, uint size, char *data, allocator *temp);
+
+// Bounds of 'vertex_count' positions of three floats every 'vertex_stride'
+// bytes.
+void mesh_position_bounds(uint vertex_count, uint vertex_stride, const float *positions,
+                          float ret_min[3], float ret_max[3]);
+
+// Write 'count' elements of 'in_count' floats every 'stride' bytes to 'out' as
+// 'out_count' normalized integers of 'bits' (8 or 16) bits each, back to back.
+// Components past in_count are zero. The unsigned form maps offset[c] to 0
+// and offset[c] + scale to 1, the signed form -1 to -1 and 1 to 1, clamping
+// whatever is outside. Both return the largest error of any component once
+// decoded again, in the units of 'data', so clamping shows up as error.
+float mesh_quantize_unorm(uint count, uint stride, const float *data, uint in_count, uint out_count,
+                          uint bits, const float *offset, float scale, void *out);
+float mesh_quantize_snorm(uint count, uint stride, const float *data, uint in_count, uint out_count,
+                          uint bits, void *out);
+
+// Limits of a cluster. 124 rather than 128 triangles leaves room for a per
+// cluster header in a 128 entry mesh shader output, should one be used.
+#define MESH_CLUSTER_MAX_VERTICES 64
+#define MESH_CLUSTER_MAX_TRIANGLES 124
+
+// A run of consecutive triangles of an index buffer, so that it can be drawn
+// on its own with an indexed draw, or skipped, and its bounds. 'cone_axis'
+// and 'cone_cutoff' bound the triangles' normals, with 'cone_cutoff' 1 where
+// they face too many ways to ever all face away (see
+// mesh_cluster_backfacing).
+struct mesh_cluster {
+    uint  first_index;
+    uint  triangle_count;
+    uint  vertex_count;
+    float center[3];
+    float radius;
+    float cone_apex[3];
+    float cone_axis[3];
+    float cone_cutoff;
+};
+
+// Most clusters which mesh_build_clusters makes from 'index_count' indices:
+// a cluster is only closed early once it has MESH_CLUSTER_MAX_VERTICES - 2
+// vertices, and so at least a third of that many triangles.
+static inline uint mesh_cluster_bound(uint index_count)
+{
+    uint min_triangles = (MESH_CLUSTER_MAX_VERTICES - 2) / 3;
+    return index_count / 3 / min_triangles + 1;
+}
+
+// Split the triangles into clusters in the order they are drawn, closing a
+// cluster when the next triangle would take it over either limit. This does
+// not move any triangles, so clusters are only as tight as the order is; call
+// after mesh_optimize_vertex_cache. 'positions' are three floats every
+// 'vertex_stride' bytes. 'ret' holds mesh_cluster_bound(index_count)
+// clusters. Returns the cluster count.
+uint mesh_build_clusters(uint index_count, const uint *indices, uint vertex_count, uint vertex_stride,
+                         const float *positions, struct mesh_cluster *ret, allocator *temp);
+
+// Whether every triangle of 'c' faces away from 'eye', which is in the space
+// of the positions that 'c' was built from.
+static inline bool mesh_cluster_backfacing(const struct mesh_cluster *c, const float eye[3])
+{
+    float d[3] = {c->cone_apex[0] - eye[0], c->cone_apex[1] - eye[1], c->cone_apex[2] - eye[2]};
+    float dot = d[0] * c->cone_axis[0] + d[1] * c->cone_axis[1] + d[2] * c->cone_axis[2];
+    return dot >= c->cone_cutoff * sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+}
+
+#if TEST
+void test_mesh(test_suite *suite);
+#endif
+
+#endif // include guard
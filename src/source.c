@@ -8,7 +8,9 @@
 #include "dict.c"
 #include "ringbuffer.c"
 #include "math.c"
+#include "mesh.c"
 #include "print.c"
+#include "ascii.c"
 #include "string.c"
 #include "file.c"
 #include "json.c"